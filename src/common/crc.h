@@ -34,4 +34,6 @@ unsigned short CRC_Value(unsigned short crcvalue);
 unsigned short CRC_Block(byte* start, int count);
 unsigned short CRC_ChecksumFile(const char* name, qboolean fatal);
 
+unsigned CRC32_Block(unsigned crc, const byte* start, int count);
+
 #endif /*_PRAGMA_CRC_H_*/
\ No newline at end of file
@@ -0,0 +1,65 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+
+/*
+========================================================================
+
+.pk3 files are plain zip archives, each file is either stored or
+compressed with deflate. Only fields used by pragma are listed, all
+values are little endian and records are not aligned so they must be
+read byte by byte. Zip64 and encrypted entries are not supported.
+
+========================================================================
+*/
+
+#ifndef _PRAGMA_ZIP_H_
+#define _PRAGMA_ZIP_H_
+
+#define ZIP_LOCAL_SIG			0x04034b50
+#define ZIP_CENTRAL_SIG			0x02014b50
+#define ZIP_END_SIG				0x06054b50
+
+#define ZIP_LOCAL_SIZE			30		// followed by name and extra field
+#define ZIP_CENTRAL_SIZE		46		// followed by name, extra field and comment
+#define ZIP_END_SIZE			22		// followed by archive comment
+#define ZIP_MAX_COMMENT			0xffff
+
+// local file header
+#define ZIP_LOCAL_METHOD		8
+#define ZIP_LOCAL_NAMELEN		26
+#define ZIP_LOCAL_EXTRALEN		28
+
+// central directory record
+#define ZIP_CENTRAL_VERSION		4
+#define ZIP_CENTRAL_FLAGS		8
+#define ZIP_CENTRAL_METHOD		10
+#define ZIP_CENTRAL_TIME		12
+#define ZIP_CENTRAL_CRC			16
+#define ZIP_CENTRAL_COMPSIZE	20
+#define ZIP_CENTRAL_FILESIZE	24
+#define ZIP_CENTRAL_NAMELEN		28
+#define ZIP_CENTRAL_EXTRALEN	30
+#define ZIP_CENTRAL_COMMENTLEN	32
+#define ZIP_CENTRAL_LOCALOFS	42
+
+// end of central directory record
+#define ZIP_END_NUMFILES		10
+#define ZIP_END_DIRSIZE			12
+#define ZIP_END_DIROFS			16
+#define ZIP_END_COMMENTLEN		20
+
+#define ZIP_FLAG_ENCRYPTED		0x0001
+
+#define ZIP_METHOD_STORED		0
+#define ZIP_METHOD_DEFLATE		8
+
+#define ZIP_VERSION_NEEDED		20		// 2.0, deflate
+
+#endif /*_PRAGMA_ZIP_H_*/
@@ -20,6 +20,7 @@ See the attached GNU General Public License v2 for more details.
 
 #include "fileformats/bsp.h"
 #include "fileformats/pak.h"
+#include "fileformats/zip.h"
 #include "fileformats/smdl.h"
 #include "fileformats/md3.h"
 #include "fileformats/pmodel.h"
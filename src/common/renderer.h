@@ -180,7 +180,7 @@ typedef struct
 } refdef_t;
 
 
-#define	API_VERSION		8
+#define	API_VERSION		10
 
 //
 // these are the functions exported by the refresh module
@@ -268,6 +268,15 @@ typedef struct
 	qboolean (*LerpTag)(orientation_t* tag, struct model_s* model, int startFrame, int endFrame, float frac, int tagIndex);
 } refexport_t;
 
+// engine ready data from persistent asset cache, data stays valid until released
+typedef struct
+{
+	const byte	*data;
+	int			length;
+	void		*mapped;	// private
+	int			mappedsize;
+} cacheblob_t;
+
 //
 // these are the functions imported by the rendering module
 //
@@ -291,6 +300,11 @@ typedef struct
 	int		(*LoadFile) (const char *name, void **buf);
 	int		(*LoadTextFile)(const char* filename, char** buffer);
 	void	(*FreeFile) (void *buf);
+
+	// read only view of a file which points into mapped pak when possible, returns length or -1
+	// when not found, handle must be passed to UnmapFile once done with buf
+	int		(*MapFile) (const char *name, const void **buf, void **handle);
+	void	(*UnmapFile) (void *handle);
 	char	*(*GetGameDir) (void);
 
 	cvar_t	*(*Cvar_Get) (const char *name, const char *value, int flags, char *desc);
@@ -307,6 +321,13 @@ typedef struct
 
 	unsigned int (*GetBSPLimit)(bspDataType type, qboolean extendedbsp);
 	unsigned int (*GetBSPElementSize)(bspDataType type, qboolean extendedbsp);
+
+	// decoded assets are cached on disk keyed by crc and length of the source file and params,
+	// kind is a short tag which tells asset types apart
+	unsigned (*CacheSourceCRC)(const void* src, int srclen);
+	qboolean (*CacheFind)(const char* kind, unsigned crc, int srclen, unsigned params, cacheblob_t* out);
+	void	(*CacheRelease)(cacheblob_t* blob);
+	void	(*CacheStore)(const char* kind, unsigned crc, int srclen, unsigned params, const void* data, int datalen);
 } refimport_t;
 
 
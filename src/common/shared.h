@@ -206,6 +206,7 @@ SYSTEM SPECIFIC
 extern	int	curtime;		// time returned by last Sys_Milliseconds, FIXME: 64BIT
 
 int		Sys_Milliseconds (void);
+unsigned long long Sys_Microseconds (void);	// high resolution, for profiling
 void	Sys_Mkdir (const char *path);
 
 // large block stack allocation routines
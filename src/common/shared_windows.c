@@ -133,6 +133,23 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+unsigned long long Sys_Microseconds (void)
+{
+	static LARGE_INTEGER	freq;
+	LARGE_INTEGER			count;
+
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+
+	QueryPerformanceCounter(&count);
+	return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000ULL + (unsigned long long)(count.QuadPart % freq.QuadPart) * 1000000ULL / freq.QuadPart;
+}
+
 void Sys_Mkdir (const char *path)
 {
 	int ret = _mkdir (path);
@@ -140,12 +157,157 @@ void Sys_Mkdir (const char *path)
 
 //============================================
 
+typedef struct
+{
+	void	(*func)(void* param);
+	void	*param;
+} sys_threadstart_t;
+
+static DWORD WINAPI Sys_ThreadStart(LPVOID param)
+{
+	sys_threadstart_t start = *(sys_threadstart_t*)param;
+
+	free(param);
+	start.func(start.param);
+	return 0;
+}
+
+/*
+================
+Sys_CreateThread
+================
+*/
+sys_thread_t Sys_CreateThread(void (*func)(void* param), void* param)
+{
+	sys_threadstart_t	*start;
+	HANDLE				thread;
+
+	start = malloc(sizeof(sys_threadstart_t));
+	if (!start)
+		return NULL;
+	start->func = func;
+	start->param = param;
+
+	thread = CreateThread(NULL, 0, Sys_ThreadStart, start, 0, NULL);
+	if (!thread)
+	{
+		free(start);
+		return NULL;
+	}
+	return (sys_thread_t)thread;
+}
+
+/*
+================
+Sys_WaitThread
+
+Waits for thread to finish and releases it.
+================
+*/
+void Sys_WaitThread(sys_thread_t thread)
+{
+	WaitForSingleObject((HANDLE)thread, INFINITE);
+	CloseHandle((HANDLE)thread);
+}
+
+sys_semaphore_t Sys_CreateSemaphore(int count)
+{
+	return (sys_semaphore_t)CreateSemaphore(NULL, count, 0x7fffffff, NULL);
+}
+
+void Sys_DestroySemaphore(sys_semaphore_t sem)
+{
+	CloseHandle((HANDLE)sem);
+}
+
+void Sys_SemaphorePost(sys_semaphore_t sem, int count)
+{
+	ReleaseSemaphore((HANDLE)sem, count, NULL);
+}
+
+void Sys_SemaphoreWait(sys_semaphore_t sem)
+{
+	WaitForSingleObject((HANDLE)sem, INFINITE);
+}
+
+/*
+================
+Sys_AtomicIncrement
+
+Returns incremented value.
+================
+*/
+int Sys_AtomicIncrement(volatile int* value)
+{
+	return (int)InterlockedIncrement((volatile LONG*)value);
+}
+
+int Sys_NumProcessors(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+//============================================
+
+/*
+================
+Sys_MapFile
+
+Maps whole file read only, returns NULL if it can't be mapped.
+================
+*/
+void *Sys_MapFile(const char *path, int *size)
+{
+	HANDLE			file, mapping;
+	LARGE_INTEGER	filesize;
+	void			*base;
+
+	*size = 0;
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0 || filesize.QuadPart > 0x7fffffff)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return NULL;
+
+	base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // the view keeps mapping alive
+	if (!base)
+		return NULL;
+
+	*size = (int)filesize.QuadPart;
+	return base;
+}
+
+void Sys_UnmapFile(void *base, int size)
+{
+	if (base)
+		UnmapViewOfFile(base);
+}
+
+//============================================
+
 static char		findbase[MAX_OSPATH];
 static char		findpath[MAX_OSPATH];
 static int		findhandle;
 
-static qboolean CompareAttributes( unsigned found, unsigned musthave, unsigned canthave )
+static qboolean CompareAttributes( const char *name, unsigned found, unsigned musthave, unsigned canthave )
 {
+	// . and .. never match
+	if ( !strcmp( name, "." ) || !strcmp( name, ".." ) )
+		return false;
+
 	if ( ( found & _A_RDONLY ) && ( canthave & SFF_RDONLY ) )
 		return false;
 	if ( ( found & _A_HIDDEN ) && ( canthave & SFF_HIDDEN ) )
@@ -183,8 +345,14 @@ char *Sys_FindFirst (const char *path, unsigned musthave, unsigned canthave )
 	findhandle = _findfirst (path, &findinfo);
 	if (findhandle == -1)
 		return NULL;
-	if ( !CompareAttributes( findinfo.attrib, musthave, canthave ) )
-		return NULL;
+
+	// skip entries which don't match instead of ending the search
+	while ( !CompareAttributes( findinfo.name, findinfo.attrib, musthave, canthave ) )
+	{
+		if (_findnext (findhandle, &findinfo) == -1)
+			return NULL;
+	}
+
 	Com_sprintf (findpath, sizeof(findpath), "%s/%s", findbase, findinfo.name);
 	return findpath;
 }
@@ -195,10 +363,11 @@ char *Sys_FindNext ( unsigned musthave, unsigned canthave )
 
 	if (findhandle == -1)
 		return NULL;
-	if (_findnext (findhandle, &findinfo) == -1)
-		return NULL;
-	if ( !CompareAttributes( findinfo.attrib, musthave, canthave ) )
-		return NULL;
+	do
+	{
+		if (_findnext (findhandle, &findinfo) == -1)
+			return NULL;
+	} while ( !CompareAttributes( findinfo.name, findinfo.attrib, musthave, canthave ) );
 
 	Com_sprintf (findpath, sizeof(findpath), "%s/%s", findbase, findinfo.name);
 	return findpath;
@@ -19,12 +19,38 @@ void Nav_Init();
 int Nav_AddPathNode(float x, float y, float z);
 qboolean Nav_AddPathNodeLink(int nodeId, int linkTo);
 int Nav_GetNearestNode(vec3_t origin);
+int Nav_GetNearestNodes(vec3_t origin, float maxDist, int* nodes, int maxNodes);
 int Nav_SearchPath(int startWaypoint, int goalWaypoint);
+int Nav_FindPath(int startWaypoint, int goalWaypoint, int* path, int maxLength);
+qboolean Nav_RequestPath(int entnum, int startWaypoint, int goalWaypoint);
+void Nav_ResolvePathRequests();
+void Nav_BuildNextHopTable(const char* mapname);
+void Nav_Stats_f(void);
 
 #define NO_WAYPOINT -1
 #define MAX_WAYPOINTS (MAX_GENTITIES - 256)
 #define MAX_WAYPOINT_LINKS 8
 
+#define NAV_GRID_CELL_SIZE 256	// waypoints are bucketed into 2D cells of this size
+#define NAV_GRID_HASH_SIZE 1024	// must be power of two
+
+#define NAV_MAX_NEAREST 64		// max candidates returned by Nav_GetNearestNodes
+
+#define NAV_MAX_PATH_LENGTH 256	// longer paths are cut, entity has to request the rest when it gets there
+#define NAV_MAX_REQUESTS 512	// path requests queued in a single server frame
+
+#define NAV_NO_HOP 0xFFFF		// no route in next-hop table
+#define NAV_CACHE_IDENT (('V'<<24)+('A'<<16)+('N'<<8)+'P') // "PNAV"
+#define NAV_CACHE_VERSION 1
+
+typedef struct navcacheheader_s
+{
+	int ident;
+	int version;
+	unsigned int checksum; // of waypoints and links the table was built for
+	int numWaypoints; // followed by numWaypoints * numWaypoints next hops
+} navcacheheader_t;
+
 typedef struct waypoint_s
 {
 	int wpIdx;
@@ -34,33 +60,100 @@ typedef struct waypoint_s
 
 	int linkCount;
 	int links[MAX_WAYPOINT_LINKS];
+
+	int cell[2]; // grid cell the waypoint is bucketed in
 } waypoint_t;
 
-typedef struct pathnode_s pathnode_t;
 typedef struct pathnode_s
 {
 	int wpIdx;	// index to nav.waypoints[]
 	float g;	// distance between the current node and the start node
 	float f;	// total cost of the node
 	float h;	// estimated distance from the current node to the end node (heuristic)
-	pathnode_t* parent;
+	int parent;	// index to search nodes[], NO_WAYPOINT for root node
+
+	int heapIndex; // position in search openHeap[], NODE_CLOSED once expanded
+	unsigned int generation; // search state is only valid when equal to search generation
 } pathnode_t;
 
+#define NODE_CLOSED -1
+
+typedef struct navsearch_s
+{
+	pathnode_t* nodes; // one per waypoint
+	int* openHeap; // binary heap of indexes to nodes[], ordered by f
+	int openHeapSize;
+	unsigned int generation; // bumped for each search, invalidates all nodes at once
+} navsearch_t;
+
+typedef enum
+{
+	NAV_PATH_NONE,		// no path was requested, or there's no route to goal
+	NAV_PATH_PENDING,	// queued with Nav_RequestPath, resolved at the end of server frame
+	NAV_PATH_READY
+} navpathstatus_t;
+
+typedef struct navpath_s
+{
+	navpathstatus_t status;
+	int goal;
+	int length;
+	int nodes[NAV_MAX_PATH_LENGTH]; // nodes[0] is the next waypoint after start, last one is goal
+} navpath_t;
+
+typedef struct navrequest_s
+{
+	int entnum;
+	int start;
+	int goal;
+} navrequest_t;
 
 typedef struct nav_s
 {
 	waypoint_t* waypoints;
 	int waypoints_count;
-
-	int openNodesSize;
-	int closedNodesSize;
+	int graphVersion; // bumped whenever waypoints or links change
+
+	// spatial hash of waypoints for nearest node queries
+	int gridHead[NAV_GRID_HASH_SIZE]; // first waypoint in bucket
+	int* gridNext; // [MAX_WAYPOINTS] next waypoint in the same bucket
+	int gridMins[2], gridMaxs[2]; // cell range covered by waypoints
+
+	// search state, preallocated once per map so queries don't allocate
+	navsearch_t search; // forward A* for single queries
+
+	// reverse search from a goal shared by all requests to that goal,
+	// expanded lazily and kept until goal or graph changes
+	navsearch_t goalTree;
+	int goalTreeRoot;
+	int goalTreeVersion;
+
+	// reverse links, rebuilt from waypoints when graph changes
+	int* incomingFirst; // [MAX_WAYPOINTS + 1]
+	int* incomingLinks; // [MAX_WAYPOINTS * MAX_WAYPOINT_LINKS]
+	int incomingVersion;
+
+	// per entity path buffers, allocated on first use
+	navpath_t* paths[MAX_GENTITIES];
+
+	navrequest_t requests[NAV_MAX_REQUESTS];
+	int numRequests;
+
+	// precomputed next hop for every (start, goal) pair, only used while the
+	// graph is the same it was built for, otherwise searches run live
+	unsigned short* nextHop; // [start * nextHopCount + goal]
+	int nextHopCount;
+	int nextHopVersion;
+	int nextHopBuildTime; // msec, -1 if loaded from cache
+
+	// statistics for nav_stats
+	int numAStarSearches;
+	int numGoalTrees;
+	int numTableLookups;
 } nav_t;
 
 static nav_t nav;
-
-static pathnode_t null_pathnode;
-static pathnode_t *openNodes[MAX_WAYPOINTS];
-static pathnode_t *closedNodes[MAX_WAYPOINTS];
+static cvar_t* nav_precompute;
 
 /*
 =================
@@ -160,6 +253,19 @@ int Nav_GetNodeLink(int node, int link)
 	return nav.waypoints[node].links[link];
 }
 
+/*
+=================
+Nav_AllocSearch
+=================
+*/
+static void Nav_AllocSearch(navsearch_t* search)
+{
+	search->nodes = Z_TagMalloc(MAX_WAYPOINTS * sizeof(pathnode_t), TAG_NAV_NODES);
+	search->openHeap = Z_TagMalloc(MAX_WAYPOINTS * sizeof(int), TAG_NAV_NODES);
+	search->openHeapSize = 0;
+	search->generation = 0;
+}
+
 /*
 =================
 Nav_Init
@@ -174,11 +280,8 @@ void Nav_Init()
 		Z_Free(nav.waypoints);
 		nav.waypoints = NULL;
 	}
+	Z_FreeTags(TAG_NAV_NODES);
 
-	null_pathnode.wpIdx = NO_WAYPOINT;
-
-	memset(openNodes, 0, sizeof(openNodes));
-	memset(closedNodes, 0, sizeof(closedNodes));
 	memset(&nav, 0, sizeof(nav));
 
 	nav.waypoints_count = 0;
@@ -190,6 +293,23 @@ void Nav_Init()
 		for (int j = 0; j < MAX_WAYPOINT_LINKS; j++)
 			nav.waypoints[i].links[j] = NO_WAYPOINT;
 	}
+
+	// search state is allocated once and reused by every query
+	Nav_AllocSearch(&nav.search);
+	Nav_AllocSearch(&nav.goalTree);
+	nav.goalTreeRoot = NO_WAYPOINT;
+
+	nav.incomingFirst = Z_TagMalloc((MAX_WAYPOINTS + 1) * sizeof(int), TAG_NAV_NODES);
+	nav.incomingLinks = Z_TagMalloc(MAX_WAYPOINTS * MAX_WAYPOINT_LINKS * sizeof(int), TAG_NAV_NODES);
+	nav.incomingVersion = -1;
+	nav.nextHopVersion = -1;
+
+	nav.gridNext = Z_TagMalloc(MAX_WAYPOINTS * sizeof(int), TAG_NAV_NODES);
+	for (int i = 0; i < NAV_GRID_HASH_SIZE; i++)
+		nav.gridHead[i] = NO_WAYPOINT;
+
+	nav_precompute = Cvar_Get("nav_precompute", "0", 0, "Precompute next hop table for all waypoint pairs at map load and cache it in maps/<mapname>.nav.");
+
 	Com_Printf("Nav_Init: allocated space for %d waypoints\n", MAX_WAYPOINTS);
 }
 
@@ -203,12 +323,6 @@ void Nav_Shutdown()
 	if (!Nav_IsInitialized())
 		return;
 
-	memset(openNodes, 0, sizeof(openNodes));
-	memset(closedNodes, 0, sizeof(closedNodes));
-	memset(&nav, 0, sizeof(nav));
-
-	nav.waypoints_count = 0;
-
 	if (nav.waypoints != NULL)
 	{
 		Z_Free(nav.waypoints);
@@ -216,6 +330,55 @@ void Nav_Shutdown()
 	}
 
 	Z_FreeTags(TAG_NAV_NODES);
+	memset(&nav, 0, sizeof(nav));
+}
+
+/*
+=================
+Nav_GridCoord
+=================
+*/
+static int Nav_GridCoord(float v)
+{
+	return (int)floor(v / NAV_GRID_CELL_SIZE);
+}
+
+/*
+=================
+Nav_GridHash
+=================
+*/
+static int Nav_GridHash(int x, int y)
+{
+	return (int)(((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u)) & (NAV_GRID_HASH_SIZE - 1);
+}
+
+/*
+=================
+Nav_GridInsert
+
+Buckets waypoint into spatial hash
+=================
+*/
+static void Nav_GridInsert(int num)
+{
+	waypoint_t* wp = &nav.waypoints[num];
+	int bucket;
+
+	wp->cell[0] = Nav_GridCoord(wp->origin[0]);
+	wp->cell[1] = Nav_GridCoord(wp->origin[1]);
+
+	bucket = Nav_GridHash(wp->cell[0], wp->cell[1]);
+	nav.gridNext[num] = nav.gridHead[bucket];
+	nav.gridHead[bucket] = num;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (num == 0 || wp->cell[i] < nav.gridMins[i])
+			nav.gridMins[i] = wp->cell[i];
+		if (num == 0 || wp->cell[i] > nav.gridMaxs[i])
+			nav.gridMaxs[i] = wp->cell[i];
+	}
 }
 
 /*
@@ -238,8 +401,10 @@ int Nav_AddPathNode(float x, float y, float z)
 	nav.waypoints[nav.waypoints_count].origin[1] = y;
 	nav.waypoints[nav.waypoints_count].origin[2] = z;
 //	VectorCopy(nav.waypoints[nav.waypoints_count].origin, pos);
+	Nav_GridInsert(nav.waypoints_count);
 
 	nav.waypoints_count++;
+	nav.graphVersion++;
 	return (nav.waypoints_count - 1);
 }
 
@@ -264,6 +429,7 @@ qboolean Nav_AddPathNodeLink(int nodeId, int linkTo)
 //	nodeId = nav.waypoints_count - 1;
 	nav.waypoints[nodeId].links[nav.waypoints[nodeId].linkCount] = linkTo;
 	nav.waypoints[nodeId].linkCount++;
+	nav.graphVersion++;
 	return true;
 }
 
@@ -289,37 +455,133 @@ void Nav_GetNodePos(int num, float *x, float *y, float *z)
 
 /*
 =================
-Nav_GetNearestNode
+Nav_InsertNearest
 
-returns index to waypoint that is closest to origin, or -1 if not found
+Keeps nodes[] sorted from closest to farthest, returns new count
 =================
 */
-int Nav_GetNearestNode(vec3_t origin)
+static int Nav_InsertNearest(int num, float dist, int* nodes, float* dists, int count, int maxNodes)
 {
-	int nearestNode, nearestDist, i;
-	float dist;
-
-	nearestNode = NO_WAYPOINT;
-	nearestDist = 9999999999;
+	int i;
 
-	if (!Nav_IsInitialized() || !Nav_GetNodesCount())
-		return nearestNode;
+	if (count == maxNodes && dist >= dists[count - 1])
+		return count;
 
+	if (count < maxNodes)
+		count++;
 
-	// loop through all waypoints
-	for (i = 0; i < nav.waypoints_count; i++)
+	for (i = count - 1; i > 0 && dists[i - 1] > dist; i--)
 	{
-		// get the squared distance
-		dist = distance3dsquared(origin, nav.waypoints[i].origin);
+		nodes[i] = nodes[i - 1];
+		dists[i] = dists[i - 1];
+	}
+	nodes[i] = num;
+	dists[i] = dist;
+	return count;
+}
+
+/*
+=================
+Nav_GetNearestNodes
+
+Finds up to maxNodes waypoints closest to origin and within maxDist (0 for
+unlimited), sorted from closest to farthest. Returns the number of nodes found.
+
+Walks rings of grid cells around origin, clamped to cells which have
+waypoints, and stops once no unvisited cell can hold anything closer
+than what was already found.
+=================
+*/
+int Nav_GetNearestNodes(vec3_t origin, float maxDist, int* nodes, int maxNodes)
+{
+	float dists[NAV_MAX_NEAREST];
+	float dist, maxDistSq, ringDist;
+	int cx, cy, x, y, r, step, num, count;
+	int minRing, maxRing, x0, x1, y0, y1;
+
+	if (!Nav_IsInitialized() || !Nav_GetNodesCount() || maxNodes <= 0)
+		return 0;
+
+	if (maxNodes > NAV_MAX_NEAREST)
+		maxNodes = NAV_MAX_NEAREST;
 
-		// check if the distance is closer than the currently closest
-		if (dist < nearestDist)
+	maxDistSq = (maxDist > 0) ? (maxDist * maxDist) : -1;
+	count = 0;
+
+	cx = Nav_GridCoord(origin[0]);
+	cy = Nav_GridCoord(origin[1]);
+
+	// rings closer than this don't touch the grid when origin is outside of it,
+	// rings further than maxRing have no cells with waypoints
+	minRing = max(max(nav.gridMins[0] - cx, cx - nav.gridMaxs[0]), max(nav.gridMins[1] - cy, cy - nav.gridMaxs[1]));
+	minRing = max(minRing, 0);
+	maxRing = max(max(cx - nav.gridMins[0], nav.gridMaxs[0] - cx), max(cy - nav.gridMins[1], nav.gridMaxs[1] - cy));
+
+	for (r = minRing; r <= maxRing; r++)
+	{
+		// every cell on ring r is at least (r - 1) cells away from origin in x or y
+		ringDist = (r > 0) ? (r - 1) * NAV_GRID_CELL_SIZE : 0;
+		ringDist *= ringDist;
+
+		if (maxDistSq >= 0 && ringDist > maxDistSq)
+			break;
+		if (count == maxNodes && ringDist >= dists[count - 1])
+			break;
+
+		// part of the ring which overlaps the grid
+		x0 = max(cx - r, nav.gridMins[0]);
+		x1 = min(cx + r, nav.gridMaxs[0]);
+		y0 = max(cy - r, nav.gridMins[1]);
+		y1 = min(cy + r, nav.gridMaxs[1]);
+
+		for (y = y0; y <= y1; y++)
 		{
-			// memorize the current waypoint
-			nearestDist = dist;
-			nearestNode = i;
+			// only visit the border of the ring
+			if (y == cy - r || y == cy + r)
+			{
+				x = x0;
+				step = 1;
+			}
+			else
+			{
+				x = cx - r;
+				step = r * 2;
+			}
+
+			for (; x <= x1; x += step)
+			{
+				if (x < x0)
+					continue;
+
+				for (num = nav.gridHead[Nav_GridHash(x, y)]; num != NO_WAYPOINT; num = nav.gridNext[num])
+				{
+					if (nav.waypoints[num].cell[0] != x || nav.waypoints[num].cell[1] != y)
+						continue; // hash collision with another cell
+
+					dist = distance3dsquared(origin, nav.waypoints[num].origin);
+					if (maxDistSq >= 0 && dist > maxDistSq)
+						continue;
+					count = Nav_InsertNearest(num, dist, nodes, dists, count, maxNodes);
+				}
+			}
 		}
-	}	
+	}
+	return count;
+}
+
+/*
+=================
+Nav_GetNearestNode
+
+returns index to waypoint that is closest to origin, or -1 if not found
+=================
+*/
+int Nav_GetNearestNode(vec3_t origin)
+{
+	int nearestNode;
+
+	if (!Nav_GetNearestNodes(origin, 0, &nearestNode, 1))
+		return NO_WAYPOINT;
 	return nearestNode; // return the ID of the closest waypoint
 }
 
@@ -336,18 +598,12 @@ extern void SV_AddDebugPoint(vec3_t pos, vec3_t color, float thickness, float dr
 extern void SV_AddDebugBox(vec3_t pos, vec3_t p1, vec3_t p2, vec3_t color, float thickness, float drawtime, qboolean depthtested);
 extern void SV_AddDebugString(vec3_t pos, vec3_t color, float fontSize, float drawtime, qboolean depthtested, const char* text);
 #endif
-static void Nav_DebugDrawNodes()
+static void Nav_DebugDrawNodes(navsearch_t* search)
 {
 #ifdef DEBUG_PATHFINDING
 	vec3_t p;
-	vec3_t oldp;
 	int i;
 
-
-	vec3_t mins = { -16, 16, 0 };
-	vec3_t maxs = { 16, 16, 56 };
-
-	//memset(str, sizeof(str), 0);
 	for (i = 0; i < nav.waypoints_count; i++)
 	{
 		vec3_t c = { 1,1,0 };
@@ -364,254 +620,946 @@ static void Nav_DebugDrawNodes()
 		}
 	}
 
-	for (i = 0; i < nav.openNodesSize; i++)
+	printf("======\n");
+	for (i = 0; i < nav.waypoints_count; i++)
 	{
+		if (search->nodes[i].generation != search->generation)
+			continue; // not visited by last search
+
 		vec3_t c = { 0,1,0 };
-		VectorCopy(nav.waypoints[openNodes[i]->wpIdx].origin, p);
+		if (search->nodes[i].heapIndex == NODE_CLOSED)
+			VectorSet(c, 1, 0, 0);
+
+		VectorCopy(nav.waypoints[i].origin, p);
 		p[2] += 48;
-		SV_AddDebugLine(nav.waypoints[openNodes[i]->wpIdx].origin, p,c, 4, 0.1, false);
+		SV_AddDebugLine(nav.waypoints[i].origin, p, c, 4, 0.1, false);
+
+		printf("%s node %i, parent %i, f %f\n", search->nodes[i].heapIndex == NODE_CLOSED ? "closed" : "open", i, search->nodes[i].parent, search->nodes[i].f);
 	}
+	printf("======\n");
+#endif
+}
 
-	for (i = 0; i < nav.closedNodesSize; i++)
-	{
-		vec3_t c = { 1,0,0 };
-//		if (i > 0)
-//			SV_AddDebugLine(nav.waypoints[closedNodes[i].wpIdx].origin, oldp, c, 2, 0.1, false);
 
-		VectorCopy(nav.waypoints[closedNodes[i]->wpIdx].origin, p);
-		p[2] += 48;
+/*
+=================
+Nav_HeapSwap
+=================
+*/
+static void Nav_HeapSwap(navsearch_t* search, int a, int b)
+{
+	int tmp = search->openHeap[a];
+	search->openHeap[a] = search->openHeap[b];
+	search->openHeap[b] = tmp;
 
-		SV_AddDebugLine(nav.waypoints[closedNodes[i]->wpIdx].origin, p, c, 4, 0.1, false);
-		VectorCopy(nav.waypoints[closedNodes[i]->wpIdx].origin, oldp);
-	}
+	search->nodes[search->openHeap[a]].heapIndex = a;
+	search->nodes[search->openHeap[b]].heapIndex = b;
+}
 
-	printf("======\n");
-	for (i = 0; i < nav.openNodesSize; i++)
-		printf("openNodes[%i] = %i\n", i, openNodes[i]->wpIdx);
+/*
+=================
+Nav_HeapLess
 
-	for (i = 0; i < nav.closedNodesSize; i++)
-		printf("closedNodes[%i] = %i\n", i, closedNodes[i]->wpIdx);
-	printf("======\n");
-#endif
+returns true when node a should be expanded before node b
+=================
+*/
+static qboolean Nav_HeapLess(navsearch_t* search, int a, int b)
+{
+	pathnode_t* na = &search->nodes[search->openHeap[a]];
+	pathnode_t* nb = &search->nodes[search->openHeap[b]];
+
+	if (na->f != nb->f)
+		return na->f < nb->f;
+	return na->h < nb->h; // prefer nodes closer to goal on ties
 }
 
+/*
+=================
+Nav_HeapSiftUp
+=================
+*/
+static void Nav_HeapSiftUp(navsearch_t* search, int i)
+{
+	while (i > 0)
+	{
+		int parent = (i - 1) >> 1;
+		if (!Nav_HeapLess(search, i, parent))
+			break;
+		Nav_HeapSwap(search, i, parent);
+		i = parent;
+	}
+}
 
 /*
 =================
-Nav_NodeExistsInList
+Nav_HeapSiftDown
 =================
 */
-static qboolean Nav_NodeExistsInList(pathnode_t* nodes[], int num, int listSize)
+static void Nav_HeapSiftDown(navsearch_t* search, int i)
 {
-	for (int i = 0; i < listSize; i++)
+	while (1)
 	{
-		if (nodes[i]->wpIdx == num)
-			return true;
+		int left = (i << 1) + 1;
+		int right = left + 1;
+		int best = i;
+
+		if (left < search->openHeapSize && Nav_HeapLess(search, left, best))
+			best = left;
+		if (right < search->openHeapSize && Nav_HeapLess(search, right, best))
+			best = right;
+		if (best == i)
+			break;
+
+		Nav_HeapSwap(search, i, best);
+		i = best;
 	}
-	return false;
 }
 
 /*
 =================
-Nav_AllocNode
+Nav_HeapPush
 =================
 */
-static pathnode_t* Nav_AllocNode()
+static void Nav_HeapPush(navsearch_t* search, int node)
 {
-	pathnode_t* n = Z_TagMalloc(sizeof(pathnode_t), TAG_NAV_NODES);
-	n->wpIdx = NO_WAYPOINT;
-	return  n;
+	int i = search->openHeapSize++;
+	search->openHeap[i] = node;
+	search->nodes[node].heapIndex = i;
+	Nav_HeapSiftUp(search, i);
 }
 
 /*
 =================
-Nav_SearchPath
+Nav_HeapPop
 
-Returns the next node on a path from one waypoint to another, 
-which will be index to nav.waypoints, returns -1 if there's no route.
+removes node with lowest f from open heap and marks it closed
+=================
+*/
+static int Nav_HeapPop(navsearch_t* search)
+{
+	int node = search->openHeap[0];
 
-startWaypoint - index to the waypoint we're currently at
-goalWaypoint - index to the waypoint we'd like to go
+	search->openHeapSize--;
+	if (search->openHeapSize > 0)
+	{
+		search->openHeap[0] = search->openHeap[search->openHeapSize];
+		search->nodes[search->openHeap[0]].heapIndex = 0;
+		Nav_HeapSiftDown(search, 0);
+	}
+
+	search->nodes[node].heapIndex = NODE_CLOSED;
+	return node;
+}
 
+/*
+=================
+Nav_BeginSearch
+
+invalidates state of all nodes from previous search and opens root node
 =================
 */
-int Nav_SearchPath(int startWaypoint, int goalWaypoint) 
+static void Nav_BeginSearch(navsearch_t* search, int root, float h)
 {
-	pathnode_t *startnode;
-	int bestNode, highestPriority;
+	pathnode_t* n;
 
-	if (!Nav_IsInitialized() || !Nav_GetNodesCount())
-		return NO_WAYPOINT; // for maps without pathnodes
+	search->openHeapSize = 0;
+	search->generation++;
 
-	if (startWaypoint < 0)
+	if (search->generation == 0)
 	{
-		Com_Printf("%s: startWaypoint < 0\n", __FUNCTION__); 
-		//Com_Error(ERR_DROP, "%s: startWaypoint < 0\n", __FUNCTION__);
-		return NO_WAYPOINT;
+		// wrapped around, stale nodes could alias the new generation
+		for (int i = 0; i < MAX_WAYPOINTS; i++)
+			search->nodes[i].generation = 0;
+		search->generation = 1;
 	}
 
-	if (goalWaypoint >= nav.waypoints_count)
+	n = &search->nodes[root];
+	n->wpIdx = root;
+	n->g = 0;
+	n->h = h;
+	n->f = n->g + n->h;
+	n->parent = NO_WAYPOINT;
+	n->generation = search->generation;
+	Nav_HeapPush(search, root);
+}
+
+/*
+=================
+Nav_RelaxNode
+
+updates node reached from parent with cost g, (re)opens it when route is cheaper
+=================
+*/
+static void Nav_RelaxNode(navsearch_t* search, int node, int parent, float g, int goal)
+{
+	pathnode_t* nc = &search->nodes[node];
+
+	if (nc->generation == search->generation)
 	{
-		Com_Printf("%s: goalWaypoint %i >= %i nav.waypoints_count\n", __FUNCTION__, goalWaypoint, nav.waypoints_count); 
-		//Com_Error(ERR_DROP, "%s: goalWaypoint %i >= %i nav.waypoints_count\n", __FUNCTION__, goalWaypoint, nav.waypoints_count);
-		return NO_WAYPOINT;
+		// skip if nc was already reached with a cheaper or equal route
+		if (nc->g <= g)
+			return;
+	}
+	else
+	{
+		nc->generation = search->generation;
+		nc->wpIdx = node;
+		nc->h = (goal == NO_WAYPOINT) ? 0 : distance3d(nav.waypoints[node].origin, nav.waypoints[goal].origin);
+		nc->heapIndex = NODE_CLOSED;
 	}
 
-#if 1
-	Z_FreeTags(TAG_NAV_NODES);
-	// is this too paranoid?
-	memset(openNodes, 0, sizeof(openNodes));
-	memset(closedNodes, 0, sizeof(closedNodes));
-#endif
+	nc->parent = parent;
+	nc->g = g;
+	nc->f = nc->g + nc->h;
 
-	nav.openNodesSize = 0;
-	nav.closedNodesSize = 0;
+	// reopen closed nodes, otherwise just move nc up the heap
+	if (nc->heapIndex == NODE_CLOSED)
+		Nav_HeapPush(search, node);
+	else
+		Nav_HeapSiftUp(search, nc->heapIndex);
+}
+
+/*
+=================
+Nav_CheckWaypoints
+=================
+*/
+static qboolean Nav_CheckWaypoints(const char *caller, int startWaypoint, int goalWaypoint)
+{
+	if (!Nav_IsInitialized() || !Nav_GetNodesCount())
+		return false; // for maps without pathnodes
 
-	// create start node and add it to openNodes list
-	startnode = Nav_AllocNode();
-	startnode->g = 0;
-	startnode->h = distance3d(nav.waypoints[startWaypoint].origin, nav.waypoints[goalWaypoint].origin);
-	startnode->f = startnode->g + startnode->h;
-	startnode->wpIdx = startWaypoint;
-	startnode->parent = &null_pathnode;
-	openNodes[nav.openNodesSize++] = startnode; 
+	if (startWaypoint < 0 || startWaypoint >= nav.waypoints_count)
+	{
+		Com_Printf("%s: startWaypoint %i out of range [0,%i)\n", caller, startWaypoint, nav.waypoints_count);
+		return false;
+	}
 
-	while(nav.openNodesSize > 0)
+	if (goalWaypoint < 0 || goalWaypoint >= nav.waypoints_count)
 	{
-		// remove node n with lowest f from openNodes
-		bestNode = NO_WAYPOINT;
-		highestPriority = 9999999999;
-		pathnode_t *n = openNodes[0];
+		Com_Printf("%s: goalWaypoint %i out of range [0,%i)\n", caller, goalWaypoint, nav.waypoints_count);
+		return false;
+	}
+	return true;
+}
 
-		for (int i = 0; i < nav.openNodesSize; i++) 
-		{
-			if (openNodes[i]->f < highestPriority) 
-			{
-				bestNode = i;
-				highestPriority = openNodes[i]->f;
-			}
-		}
+/*
+=================
+Nav_AStar
 
-		if (bestNode != NO_WAYPOINT)
-		{
-			// remove node from openNodes
-			n = openNodes[bestNode];
-			//openNodes[bestNode]->wpIdx = NO_WAYPOINT;
-			for (int i = bestNode; i < nav.openNodesSize - 1; i++) 
-			{
-				openNodes[i] = openNodes[i + 1];
-			}
-			nav.openNodesSize--;
-		}
-		else 
-		{
-			Nav_DebugDrawNodes();
-			return NO_WAYPOINT;
-		}
+Forward A* search from start to goal in nav.search, returns false if there's no route.
+=================
+*/
+static qboolean Nav_AStar(int startWaypoint, int goalWaypoint)
+{
+	navsearch_t *search = &nav.search;
+	waypoint_t *wp;
+	int current, link, i;
 
-		// if n is goal node, build path and return success
-		if (n->wpIdx == goalWaypoint) 
+	Nav_BeginSearch(search, startWaypoint, distance3d(nav.waypoints[startWaypoint].origin, nav.waypoints[goalWaypoint].origin));
+	nav.numAStarSearches++;
+
+	while (search->openHeapSize > 0)
+	{
+		// remove node n with lowest f from open heap
+		current = Nav_HeapPop(search);
+		if (current == goalWaypoint)
 		{
-			pathnode_t *x = n;
-			for (int j = 0; j < 1000; j++) // TODO - isn't 1000 to little? 
-			{
-				pathnode_t* parent = x->parent;
-				if (parent == NULL || parent->parent == NULL || parent->parent->wpIdx == NO_WAYPOINT)
-				{
-					Nav_DebugDrawNodes();
-//					printf("goal node!\n");
-					return x->wpIdx;
-				}
-				x = parent;
-			}
-			Nav_DebugDrawNodes();
-			return NO_WAYPOINT;
+			Nav_DebugDrawNodes(search);
+			return true;
 		}
 
 		// for all neightbors (nc) of node n
-		for (int i = 0; i < nav.waypoints[n->wpIdx].linkCount; i++)
+		wp = &nav.waypoints[current];
+		for (i = 0; i < wp->linkCount; i++)
 		{
-			int newg = n->g + distance3d(nav.waypoints[n->wpIdx].origin, nav.waypoints[nav.waypoints[n->wpIdx].links[i]].origin);
-
-			if (Nav_NodeExistsInList(openNodes, nav.waypoints[n->wpIdx].links[i], nav.openNodesSize)) 
-			{
-				// skip if nc exists in openNodes and nc.g <= newg
-				pathnode_t *nc = Nav_AllocNode(); 
-				for (int p = 0; p < nav.openNodesSize; p++) 
-				{
-					if (openNodes[p]->wpIdx == nav.waypoints[n->wpIdx].links[i]) 
-					{
-						nc = openNodes[p];
-						break;
-					}
-				}
-
-				if (nc->g <= newg) 
-				{
-					continue;
-				}
-			}
-			else if (Nav_NodeExistsInList(closedNodes, nav.waypoints[n->wpIdx].links[i], nav.closedNodesSize)) 
-			{
-				// skip if nc is in closedNodes and nc.g <= newg
-				pathnode_t *nc = Nav_AllocNode();
-				for (int p = 0; p < nav.closedNodesSize; p++) 
-				{
-					if (closedNodes[p]->wpIdx == nav.waypoints[n->wpIdx].links[i]) 
-					{
-						nc = closedNodes[p];
-						break;
-					}
-				}
+			link = wp->links[i];
+			if (link < 0 || link >= nav.waypoints_count)
+				continue; // linked to a node that was never added
 
-				if (nc->g <= newg) 
-				{
-					continue;
-				}
-			}
+			Nav_RelaxNode(search, link, current, search->nodes[current].g + distance3d(wp->origin, nav.waypoints[link].origin), goalWaypoint);
+		}
+	}
+	Nav_DebugDrawNodes(search);
+	return false;
+}
 
-			pathnode_t *nc = Nav_AllocNode();
-			nc->parent = n;
-			nc->g = newg;
-			nc->h = distance3d(nav.waypoints[nav.waypoints[n->wpIdx].links[i]].origin, nav.waypoints[goalWaypoint].origin);
-			nc->f = nc->g + nc->h;
-			nc->wpIdx = nav.waypoints[n->wpIdx].links[i];
+/*
+=================
+Nav_BuildIncomingLinks
 
-			// if nc is in closedNodes, remove it from that list
-			if (Nav_NodeExistsInList(closedNodes, nc->wpIdx, nav.closedNodesSize)) 
-			{
-				qboolean deleted = false;
-				for (int p = 0; p < nav.closedNodesSize; p++) 
-				{
-					if (closedNodes[p]->wpIdx == nc->wpIdx) 
-					{
-						closedNodes[p]->wpIdx = NO_WAYPOINT;
-						for (int x = p; x < nav.closedNodesSize - 1; x++)
-							closedNodes[x] = closedNodes[x + 1];
-
-						deleted = true;
-						break;
-					}
-
-					if (deleted)
-						break;
-				}
-				nav.closedNodesSize--;
-			}
+Builds reverse adjacency so goal trees can walk links backwards
+=================
+*/
+static void Nav_BuildIncomingLinks()
+{
+	int i, j, link;
+	int *count;
 
-			// if nc doesn't exist in openNodes, add it to that list
-			if (!Nav_NodeExistsInList(openNodes, nc->wpIdx, nav.openNodesSize)) 
-			{
-				openNodes[nav.openNodesSize++] = nc;
-			}
-		}
+	if (nav.incomingVersion == nav.graphVersion)
+		return;
 
-		// we're done with all links, push n onto closedNodes
-		if (!Nav_NodeExistsInList(closedNodes, n->wpIdx, nav.closedNodesSize)) 
+	// count incoming links per node, then turn counts into offsets
+	count = nav.incomingFirst + 1;
+	memset(nav.incomingFirst, 0, (MAX_WAYPOINTS + 1) * sizeof(int));
+	for (i = 0; i < nav.waypoints_count; i++)
+	{
+		for (j = 0; j < nav.waypoints[i].linkCount; j++)
 		{
-			closedNodes[nav.closedNodesSize++] = n;
+			link = nav.waypoints[i].links[j];
+			if (link >= 0 && link < nav.waypoints_count)
+				count[link]++;
 		}
 	}
-	Nav_DebugDrawNodes();
-	return NO_WAYPOINT;
-}
\ No newline at end of file
+
+	for (i = 0; i < nav.waypoints_count; i++)
+		nav.incomingFirst[i + 1] += nav.incomingFirst[i];
+
+	// fill, using incomingFirst[link] as cursor and shifting it back afterwards
+	for (i = 0; i < nav.waypoints_count; i++)
+	{
+		for (j = 0; j < nav.waypoints[i].linkCount; j++)
+		{
+			link = nav.waypoints[i].links[j];
+			if (link >= 0 && link < nav.waypoints_count)
+				nav.incomingLinks[nav.incomingFirst[link]++] = i;
+		}
+	}
+
+	for (i = nav.waypoints_count; i > 0; i--)
+		nav.incomingFirst[i] = nav.incomingFirst[i - 1];
+	nav.incomingFirst[0] = 0;
+
+	nav.incomingVersion = nav.graphVersion;
+}
+
+/*
+=================
+Nav_HasGoalTree
+
+Returns true when nav.goalTree is rooted at goal and up to date
+=================
+*/
+static qboolean Nav_HasGoalTree(int goalWaypoint)
+{
+	return (nav.goalTreeRoot == goalWaypoint && nav.goalTreeVersion == nav.graphVersion);
+}
+
+/*
+=================
+Nav_GoalTreeStep
+
+Settles the closest open node of goal tree
+=================
+*/
+static void Nav_GoalTreeStep()
+{
+	navsearch_t* search = &nav.goalTree;
+	int current, from, i;
+
+	current = Nav_HeapPop(search);
+
+	// walk links backwards, parent is the next hop towards goal
+	for (i = nav.incomingFirst[current]; i < nav.incomingFirst[current + 1]; i++)
+	{
+		from = nav.incomingLinks[i];
+		Nav_RelaxNode(search, from, current, search->nodes[current].g + distance3d(nav.waypoints[from].origin, nav.waypoints[current].origin), NO_WAYPOINT);
+	}
+}
+
+/*
+=================
+Nav_ExpandGoalTree
+
+Grows reverse dijkstra tree rooted at goal until startWaypoint is settled.
+Nodes settled for previous starts stay valid, so every entity heading to the
+same goal only pays for the part of the graph nobody else explored.
+Returns false if there's no route.
+=================
+*/
+static qboolean Nav_ExpandGoalTree(int startWaypoint, int goalWaypoint)
+{
+	navsearch_t* search = &nav.goalTree;
+	pathnode_t* start;
+
+	if (!Nav_HasGoalTree(goalWaypoint))
+	{
+		Nav_BuildIncomingLinks();
+		Nav_BeginSearch(search, goalWaypoint, 0);
+		nav.goalTreeRoot = goalWaypoint;
+		nav.goalTreeVersion = nav.graphVersion;
+		nav.numGoalTrees++;
+	}
+
+	start = &search->nodes[startWaypoint];
+	while (!(start->generation == search->generation && start->heapIndex == NODE_CLOSED))
+	{
+		if (search->openHeapSize <= 0)
+			return false; // whole reachable graph explored
+		Nav_GoalTreeStep();
+	}
+	return true;
+}
+
+/*
+=================
+Nav_StorePath
+
+Writes path found by last search to buffer, first node is the one after start.
+Returns the number of nodes written, at most maxLength.
+=================
+*/
+static int Nav_StorePath(qboolean fromGoalTree, int startWaypoint, int goalWaypoint, int* path, int maxLength)
+{
+	pathnode_t* nodes;
+	int n, length, count;
+
+	if (startWaypoint == goalWaypoint)
+	{
+		if (maxLength > 0)
+			path[0] = goalWaypoint;
+		return (maxLength > 0 ? 1 : 0);
+	}
+
+	if (fromGoalTree)
+	{
+		// parents point towards goal, so path comes out in order
+		nodes = nav.goalTree.nodes;
+		count = 0;
+		for (n = nodes[startWaypoint].parent; n != NO_WAYPOINT && count < maxLength; n = nodes[n].parent)
+			path[count++] = n;
+		return count;
+	}
+
+	// parents point towards start, count the nodes first and fill backwards
+	nodes = nav.search.nodes;
+	length = 0;
+	for (n = goalWaypoint; nodes[n].parent != NO_WAYPOINT; n = nodes[n].parent)
+		length++;
+
+	count = 0;
+	for (n = goalWaypoint; nodes[n].parent != NO_WAYPOINT; n = nodes[n].parent)
+	{
+		length--;
+		if (length < maxLength)
+		{
+			path[length] = n;
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+=================
+Nav_HasNextHopTable
+
+Returns true when next-hop table matches current graph
+=================
+*/
+static qboolean Nav_HasNextHopTable()
+{
+	return (nav.nextHop != NULL && nav.nextHopVersion == nav.graphVersion && nav.nextHopCount == nav.waypoints_count);
+}
+
+/*
+=================
+Nav_StoreNextHopPath
+
+Like Nav_StorePath, but follows the precomputed table.
+Returns the number of nodes written, 0 if there's no route.
+=================
+*/
+static int Nav_StoreNextHopPath(int startWaypoint, int goalWaypoint, int* path, int maxLength)
+{
+	int n, count;
+
+	nav.numTableLookups++;
+
+	if (startWaypoint == goalWaypoint)
+	{
+		if (maxLength > 0)
+			path[0] = goalWaypoint;
+		return (maxLength > 0 ? 1 : 0);
+	}
+
+	count = 0;
+	for (n = startWaypoint; n != goalWaypoint && count < maxLength; )
+	{
+		n = nav.nextHop[n * nav.nextHopCount + goalWaypoint];
+		if (n == NAV_NO_HOP)
+			return 0;
+		path[count++] = n;
+	}
+	return count;
+}
+
+/*
+=================
+Nav_SearchPath
+
+Returns the next node on a path from one waypoint to another, 
+which will be index to nav.waypoints, returns -1 if there's no route.
+
+startWaypoint - index to the waypoint we're currently at
+goalWaypoint - index to the waypoint we'd like to go
+
+=================
+*/
+int Nav_SearchPath(int startWaypoint, int goalWaypoint) 
+{
+	int next;
+
+	if (!Nav_FindPath(startWaypoint, goalWaypoint, &next, 1))
+		return NO_WAYPOINT;
+	return next;
+}
+
+/*
+=================
+Nav_FindPath
+
+Like Nav_SearchPath, but writes the whole route to path[], starting with the
+node after startWaypoint and ending with goalWaypoint. Routes longer than 
+maxLength are cut. Returns the number of nodes written or 0 if there's no route.
+=================
+*/
+int Nav_FindPath(int startWaypoint, int goalWaypoint, int* path, int maxLength)
+{
+	if (!Nav_CheckWaypoints(__FUNCTION__, startWaypoint, goalWaypoint))
+		return 0;
+
+	if (Nav_HasNextHopTable())
+		return Nav_StoreNextHopPath(startWaypoint, goalWaypoint, path, maxLength);
+
+	// somebody already asked for a path to this goal, reuse the tree
+	if (Nav_HasGoalTree(goalWaypoint))
+	{
+		if (!Nav_ExpandGoalTree(startWaypoint, goalWaypoint))
+			return 0;
+		return Nav_StorePath(true, startWaypoint, goalWaypoint, path, maxLength);
+	}
+
+	if (!Nav_AStar(startWaypoint, goalWaypoint))
+		return 0;
+	return Nav_StorePath(false, startWaypoint, goalWaypoint, path, maxLength);
+}
+
+/*
+=================
+Nav_GetEntityPath
+
+Returns path buffer of entity, allocating it when alloc is true
+=================
+*/
+static navpath_t* Nav_GetEntityPath(int entnum, qboolean alloc)
+{
+	if (!Nav_IsInitialized() || entnum < 0 || entnum >= MAX_GENTITIES)
+		return NULL;
+
+	if (nav.paths[entnum] == NULL && alloc)
+		nav.paths[entnum] = Z_TagMalloc(sizeof(navpath_t), TAG_NAV_NODES);
+	return nav.paths[entnum];
+}
+
+/*
+=================
+Nav_FindPathForEntity
+
+Immediately finds route for entity and stores it in its path buffer.
+Returns path length or 0 if there's no route.
+=================
+*/
+int Nav_FindPathForEntity(int entnum, int startWaypoint, int goalWaypoint)
+{
+	navpath_t* path = Nav_GetEntityPath(entnum, true);
+
+	if (!path)
+		return 0;
+
+	path->goal = goalWaypoint;
+	path->length = Nav_FindPath(startWaypoint, goalWaypoint, path->nodes, NAV_MAX_PATH_LENGTH);
+	path->status = path->length ? NAV_PATH_READY : NAV_PATH_NONE;
+	return path->length;
+}
+
+/*
+=================
+Nav_RequestPath
+
+Queues path request for entity, all requests are resolved at once by 
+Nav_ResolvePathRequests at the end of server frame. Requesting again in 
+the same frame replaces previous request.
+=================
+*/
+qboolean Nav_RequestPath(int entnum, int startWaypoint, int goalWaypoint)
+{
+	navpath_t* path;
+	navrequest_t* req;
+	int i;
+
+	if (!Nav_CheckWaypoints(__FUNCTION__, startWaypoint, goalWaypoint))
+		return false;
+
+	if ((path = Nav_GetEntityPath(entnum, true)) == NULL)
+		return false;
+
+	req = NULL;
+	for (i = 0; i < nav.numRequests; i++)
+	{
+		if (nav.requests[i].entnum == entnum)
+		{
+			req = &nav.requests[i];
+			break;
+		}
+	}
+
+	if (req == NULL)
+	{
+		if (nav.numRequests >= NAV_MAX_REQUESTS)
+		{
+			Com_Printf("%s: too many path requests this frame\n", __FUNCTION__);
+			return false;
+		}
+		req = &nav.requests[nav.numRequests++];
+	}
+
+	req->entnum = entnum;
+	req->start = startWaypoint;
+	req->goal = goalWaypoint;
+
+	path->status = NAV_PATH_PENDING;
+	path->goal = goalWaypoint;
+	path->length = 0;
+	return true;
+}
+
+/*
+=================
+Nav_CompareRequests
+=================
+*/
+static int Nav_CompareRequests(const void* a, const void* b)
+{
+	const navrequest_t* ra = (const navrequest_t*)a;
+	const navrequest_t* rb = (const navrequest_t*)b;
+
+	// the goal we already have a tree for goes first
+	if ((ra->goal == nav.goalTreeRoot) != (rb->goal == nav.goalTreeRoot))
+		return (ra->goal == nav.goalTreeRoot) ? -1 : 1;
+	if (ra->goal != rb->goal)
+		return ra->goal - rb->goal;
+	return ra->entnum - rb->entnum;
+}
+
+/*
+=================
+Nav_ResolvePathRequests
+
+Resolves all path requests queued during this frame. Requests are grouped 
+by goal so each goal is searched once for all entities heading there.
+=================
+*/
+void Nav_ResolvePathRequests()
+{
+	navrequest_t* req;
+	navpath_t* path;
+	int i;
+
+	if (!Nav_IsInitialized() || !nav.numRequests)
+		return;
+
+	qsort(nav.requests, nav.numRequests, sizeof(navrequest_t), Nav_CompareRequests);
+
+	for (i = 0; i < nav.numRequests; i++)
+	{
+		req = &nav.requests[i];
+		path = nav.paths[req->entnum];
+
+		if (path == NULL || path->status != NAV_PATH_PENDING)
+			continue; // cleared before frame ended
+
+		path->length = 0;
+		if (req->start >= nav.waypoints_count || req->goal >= nav.waypoints_count)
+		{
+			path->status = NAV_PATH_NONE;
+			continue;
+		}
+
+		if (Nav_HasNextHopTable())
+			path->length = Nav_StoreNextHopPath(req->start, req->goal, path->nodes, NAV_MAX_PATH_LENGTH);
+		else if (Nav_ExpandGoalTree(req->start, req->goal))
+			path->length = Nav_StorePath(true, req->start, req->goal, path->nodes, NAV_MAX_PATH_LENGTH);
+
+		path->status = path->length ? NAV_PATH_READY : NAV_PATH_NONE;
+	}
+	nav.numRequests = 0;
+}
+
+/*
+=================
+Nav_GetPathLength
+
+Returns the number of nodes in entity's path, -1 if request is still pending
+=================
+*/
+int Nav_GetPathLength(int entnum)
+{
+	navpath_t* path = Nav_GetEntityPath(entnum, false);
+
+	if (!path)
+		return 0;
+	if (path->status == NAV_PATH_PENDING)
+		return -1;
+	return path->length;
+}
+
+/*
+=================
+Nav_GetPathNode
+
+Returns waypoint at index in entity's path, or -1
+=================
+*/
+int Nav_GetPathNode(int entnum, int index)
+{
+	navpath_t* path = Nav_GetEntityPath(entnum, false);
+
+	if (!path || path->status != NAV_PATH_READY)
+		return NO_WAYPOINT;
+	if (index < 0 || index >= path->length)
+		return NO_WAYPOINT;
+	return path->nodes[index];
+}
+
+/*
+=================
+Nav_ClearPath
+
+Forgets entity's path and any pending request
+=================
+*/
+void Nav_ClearPath(int entnum)
+{
+	navpath_t* path = Nav_GetEntityPath(entnum, false);
+
+	if (!path)
+		return;
+
+	path->status = NAV_PATH_NONE;
+	path->goal = NO_WAYPOINT;
+	path->length = 0;
+}
+
+
+/*
+=================
+Nav_GraphChecksum
+=================
+*/
+static unsigned int Nav_GraphChecksum()
+{
+	return Com_BlockChecksum(nav.waypoints, nav.waypoints_count * sizeof(waypoint_t));
+}
+
+/*
+=================
+Nav_AllocNextHopTable
+=================
+*/
+static void Nav_AllocNextHopTable()
+{
+	if (nav.nextHop)
+		Z_Free(nav.nextHop);
+
+	nav.nextHopCount = nav.waypoints_count;
+	nav.nextHop = Z_TagMalloc(nav.nextHopCount * nav.nextHopCount * sizeof(unsigned short), TAG_NAV_NODES);
+}
+
+/*
+=================
+Nav_LoadNextHopTable
+
+Loads table from maps/<mapname>.nav if it was built for the same graph
+=================
+*/
+static qboolean Nav_LoadNextHopTable(const char* filename, unsigned int checksum)
+{
+	navcacheheader_t* header;
+	unsigned short* hops;
+	byte* buf;
+	int len, i, count;
+
+	len = FS_LoadFile(filename, (void**)&buf);
+	if (!buf)
+		return false;
+
+	header = (navcacheheader_t*)buf;
+	count = (len >= (int)sizeof(navcacheheader_t)) ? LittleLong(header->numWaypoints) : 0;
+
+	if (!count || LittleLong(header->ident) != NAV_CACHE_IDENT || LittleLong(header->version) != NAV_CACHE_VERSION ||
+		(unsigned int)LittleLong(header->checksum) != checksum || count != nav.waypoints_count ||
+		len != (int)(sizeof(navcacheheader_t) + count * count * sizeof(unsigned short)))
+	{
+		Com_DPrintf(DP_SV, "%s is outdated and will be rebuilt\n", filename);
+		FS_FreeFile(buf);
+		return false;
+	}
+
+	Nav_AllocNextHopTable();
+
+	hops = (unsigned short*)(buf + sizeof(navcacheheader_t));
+	for (i = 0; i < count * count; i++)
+		nav.nextHop[i] = (unsigned short)LittleShort(hops[i]);
+
+	FS_FreeFile(buf);
+	return true;
+}
+
+/*
+=================
+Nav_WriteNextHopTable
+=================
+*/
+static void Nav_WriteNextHopTable(const char* filename, unsigned int checksum)
+{
+	navcacheheader_t header;
+	char path[MAX_OSPATH];
+	FILE* file;
+	int i;
+	unsigned short hop;
+
+	Com_sprintf(path, sizeof(path), "%s/%s", FS_Gamedir(), filename);
+
+	FS_CreatePath(path);
+	file = fopen(path, "wb");
+	if (!file)
+	{
+		Com_Printf("Failed to open %s for writing.\n", path);
+		return;
+	}
+
+	header.ident = LittleLong(NAV_CACHE_IDENT);
+	header.version = LittleLong(NAV_CACHE_VERSION);
+	header.checksum = LittleLong(checksum);
+	header.numWaypoints = LittleLong(nav.nextHopCount);
+	fwrite(&header, sizeof(header), 1, file);
+
+	for (i = 0; i < nav.nextHopCount * nav.nextHopCount; i++)
+	{
+		hop = LittleShort(nav.nextHop[i]);
+		fwrite(&hop, sizeof(hop), 1, file);
+	}
+	fclose(file);
+}
+
+/*
+=================
+Nav_BuildNextHopTable
+
+When nav_precompute is enabled, fills next-hop table for all waypoint pairs 
+by growing a full goal tree for every waypoint. The result is cached on disk
+next to the map and reused as long as waypoints and links don't change.
+=================
+*/
+void Nav_BuildNextHopTable(const char* mapname)
+{
+	char filename[MAX_QPATH];
+	unsigned int checksum;
+	int goal, start, count, time;
+	pathnode_t* node;
+
+	if (!Nav_IsInitialized() || !nav_precompute || !nav_precompute->value)
+		return;
+
+	count = nav.waypoints_count;
+	if (!count)
+		return;
+
+	checksum = Nav_GraphChecksum();
+	Com_sprintf(filename, sizeof(filename), "maps/%s.nav", mapname);
+
+	if (Nav_LoadNextHopTable(filename, checksum))
+	{
+		nav.nextHopVersion = nav.graphVersion;
+		nav.nextHopBuildTime = -1;
+		Com_Printf("Nav_BuildNextHopTable: loaded %s\n", filename);
+		return;
+	}
+
+	time = Sys_Milliseconds();
+	Nav_AllocNextHopTable();
+
+	for (goal = 0; goal < count; goal++)
+	{
+		// grow the whole tree, everything settled has a route to goal
+		Nav_ExpandGoalTree(goal, goal);
+		while (nav.goalTree.openHeapSize > 0)
+			Nav_GoalTreeStep();
+
+		for (start = 0; start < count; start++)
+		{
+			node = &nav.goalTree.nodes[start];
+			if (node->generation != nav.goalTree.generation)
+				nav.nextHop[start * count + goal] = NAV_NO_HOP;
+			else if (start == goal)
+				nav.nextHop[start * count + goal] = goal;
+			else
+				nav.nextHop[start * count + goal] = node->parent;
+		}
+	}
+
+	nav.nextHopVersion = nav.graphVersion;
+	nav.nextHopBuildTime = Sys_Milliseconds() - time;
+	Com_Printf("Nav_BuildNextHopTable: %i waypoints in %i msec\n", count, nav.nextHopBuildTime);
+
+	Nav_WriteNextHopTable(filename, checksum);
+}
+
+/*
+=================
+Nav_Stats_f
+=================
+*/
+void Nav_Stats_f(void)
+{
+	int i, links, bytes;
+
+	if (!Nav_IsInitialized())
+	{
+		Com_Printf("Navigation is not initialized.\n");
+		return;
+	}
+
+	links = 0;
+	for (i = 0; i < nav.waypoints_count; i++)
+		links += nav.waypoints[i].linkCount;
+
+	bytes = MAX_WAYPOINTS * sizeof(waypoint_t);
+	bytes += 2 * MAX_WAYPOINTS * (sizeof(pathnode_t) + sizeof(int)); // forward search and goal tree
+	bytes += (MAX_WAYPOINTS + 1 + MAX_WAYPOINTS * MAX_WAYPOINT_LINKS) * sizeof(int); // incoming links
+	bytes += MAX_WAYPOINTS * sizeof(int); // grid
+	for (i = 0; i < MAX_GENTITIES; i++)
+	{
+		if (nav.paths[i])
+			bytes += sizeof(navpath_t);
+	}
+
+	Com_Printf("%i waypoints, %i links, %i bytes of search memory\n", nav.waypoints_count, links, bytes);
+
+	if (!nav.nextHop)
+		Com_Printf("next-hop table: not built (nav_precompute is %s)\n", nav_precompute && nav_precompute->value ? "on" : "off");
+	else
+	{
+		bytes = nav.nextHopCount * nav.nextHopCount * sizeof(unsigned short);
+		if (nav.nextHopBuildTime < 0)
+			Com_Printf("next-hop table: %i waypoints, %i bytes, loaded from cache\n", nav.nextHopCount, bytes);
+		else
+			Com_Printf("next-hop table: %i waypoints, %i bytes, built in %i msec\n", nav.nextHopCount, bytes, nav.nextHopBuildTime);
+
+		if (!Nav_HasNextHopTable())
+			Com_Printf("next-hop table is stale (graph changed at runtime), using live searches\n");
+	}
+
+	Com_Printf("queries: %i A* searches, %i goal trees, %i table lookups\n", nav.numAStarSearches, nav.numGoalTrees, nav.numTableLookups);
+}
@@ -0,0 +1,583 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// cl_cache.c -- persistent cache of decoded assets
+
+/*
+Decoded textures, alias model vertex arrays and resampled sounds are
+written to <basedir>/cache/ so following runs can skip decoding. Blobs
+are keyed by CRC and length of the source file plus loader params, and
+are only valid for the engine version which wrote them. They are mapped
+read only when found. index.dat remembers when each blob was last used
+so the least recently used ones go first once cache_maxmb is exceeded.
+*/
+
+#include "client.h"
+
+#define CACHE_IDENT			(('C'<<24)+('A'<<16)+('C'<<8)+'P')	// little-endian "PCAC"
+#define CACHE_INDEX_IDENT	(('X'<<24)+('I'<<16)+('C'<<8)+'P')	// little-endian "PCIX"
+#define CACHE_FORMAT		1
+
+#define CACHE_HASH_SIZE		4096	// must be power of two
+#define CACHE_MAX_ENTRIES	(1 << 20)
+
+typedef struct
+{
+	int			ident;
+	int			format;
+	char		version[16];	// PRAGMA_VERSION
+	char		kind[8];
+	unsigned	crc;
+	int			srclen;
+	unsigned	params;
+	int			datalen;		// followed by data
+} cacheheader_t;
+
+typedef struct
+{
+	int			ident;
+	int			format;
+	char		version[16];
+	unsigned	sequence;
+	int			numentries;		// followed by entries
+} cacheindex_t;
+
+typedef struct
+{
+	char		kind[8];
+	unsigned	crc;
+	int			srclen;
+	unsigned	params;
+	int			size;			// of the whole file
+	unsigned	lastused;		// sequence of last store or hit
+	int			next;			// next entry in hash chain or -1
+} cacheentry_t;
+
+typedef struct
+{
+	cacheentry_t	*entries;
+	int				numentries, maxentries;
+	int				hash[CACHE_HASH_SIZE];
+	unsigned long long	totalsize;
+	unsigned		sequence;
+	qboolean		dirty;			// index has to be written
+
+	// this session
+	int				hits, misses, stores, evictions;
+	unsigned long long	hitbytes, storebytes;
+} assetcache_t;
+
+static assetcache_t	cache;
+
+cvar_t	*cache_assets;
+cvar_t	*cache_maxmb;
+
+extern cvar_t	*fs_basedir;
+
+/*
+=================
+CL_CacheHash
+=================
+*/
+static unsigned CL_CacheHash(const char* kind, unsigned crc, int srclen, unsigned params)
+{
+	unsigned	hash;
+
+	hash = crc ^ ((unsigned)srclen * 31) ^ (params * 131);
+	while (*kind)
+		hash = hash * 31 + *kind++;
+	return hash & (CACHE_HASH_SIZE - 1);
+}
+
+static void CL_CacheRehash(void)
+{
+	cacheentry_t	*entry;
+	unsigned		hash;
+	int				i;
+
+	memset(cache.hash, -1, sizeof(cache.hash));
+	for (i = 0, entry = cache.entries; i < cache.numentries; i++, entry++)
+	{
+		hash = CL_CacheHash(entry->kind, entry->crc, entry->srclen, entry->params);
+		entry->next = cache.hash[hash];
+		cache.hash[hash] = i;
+	}
+}
+
+static cacheentry_t *CL_CacheFindEntry(const char* kind, unsigned crc, int srclen, unsigned params)
+{
+	cacheentry_t	*entry;
+	int				i;
+
+	for (i = cache.hash[CL_CacheHash(kind, crc, srclen, params)]; i != -1; i = entry->next)
+	{
+		entry = &cache.entries[i];
+		if (entry->crc == crc && entry->srclen == srclen && entry->params == params && !strcmp(entry->kind, kind))
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+=================
+CL_CacheAddEntry
+
+Returned pointer is valid until next CL_CacheAddEntry or removal
+=================
+*/
+static cacheentry_t *CL_CacheAddEntry(const char* kind, unsigned crc, int srclen, unsigned params)
+{
+	cacheentry_t	*entry, *newentries;
+	unsigned		hash;
+
+	if (strlen(kind) >= sizeof(entry->kind) || cache.numentries >= CACHE_MAX_ENTRIES)
+		return NULL;
+
+	if (cache.numentries == cache.maxentries)
+	{
+		cache.maxentries = cache.maxentries ? cache.maxentries * 2 : 1024;
+		newentries = Z_Malloc(cache.maxentries * sizeof(cacheentry_t));
+		if (cache.entries)
+		{
+			memcpy(newentries, cache.entries, cache.numentries * sizeof(cacheentry_t));
+			Z_Free(cache.entries);
+		}
+		cache.entries = newentries;
+	}
+
+	entry = &cache.entries[cache.numentries];
+	memset(entry, 0, sizeof(*entry));
+	strcpy(entry->kind, kind);
+	entry->crc = crc;
+	entry->srclen = srclen;
+	entry->params = params;
+
+	hash = CL_CacheHash(kind, crc, srclen, params);
+	entry->next = cache.hash[hash];
+	cache.hash[hash] = cache.numentries++;
+	return entry;
+}
+
+static void CL_CacheFileName(char* out, int size, const cacheentry_t* entry)
+{
+	Com_sprintf(out, size, "%s/cache/%s_%08x_%08x_%08x.bin", fs_basedir->string, entry->kind, entry->crc, entry->srclen, entry->params);
+}
+
+/*
+=================
+CL_CacheRemoveEntry
+
+Deletes blob from disk, hash must be rebuilt afterwards
+=================
+*/
+static void CL_CacheRemoveEntry(int index)
+{
+	char	path[MAX_OSPATH];
+
+	CL_CacheFileName(path, sizeof(path), &cache.entries[index]);
+	remove(path);
+
+	cache.totalsize -= cache.entries[index].size;
+	cache.entries[index] = cache.entries[--cache.numentries];
+	cache.dirty = true;
+}
+
+/*
+=================
+CL_CacheEvict
+
+Removes least recently used blobs until the cache fits in cache_maxmb
+=================
+*/
+static void CL_CacheEvict(void)
+{
+	unsigned long long	limit;
+	int					i, oldest, removed;
+
+	if (cache_maxmb->value <= 0)
+		return; // disabled, keep what's on disk
+
+	limit = (unsigned long long)(cache_maxmb->value * 1024 * 1024);
+
+	removed = 0;
+	while (cache.totalsize > limit && cache.numentries)
+	{
+		oldest = 0;
+		for (i = 1; i < cache.numentries; i++)
+		{
+			if (cache.entries[i].lastused < cache.entries[oldest].lastused)
+				oldest = i;
+		}
+		CL_CacheRemoveEntry(oldest);
+		removed++;
+	}
+
+	if (!removed)
+		return;
+
+	CL_CacheRehash();
+	cache.evictions += removed;
+	Com_DPrintf(DP_FS, "Asset cache: evicted %i files\n", removed);
+}
+
+static qboolean CL_CacheEnabled(void)
+{
+	return cache_assets && cache_assets->value && cache_maxmb->value > 0;
+}
+
+/*
+=================
+CL_CacheSourceCRC
+
+Key of the source file, compute once per asset and pass it to both
+CL_CacheFind and CL_CacheStore
+=================
+*/
+unsigned CL_CacheSourceCRC(const void* src, int srclen)
+{
+	if (!CL_CacheEnabled() || !src || srclen <= 0)
+		return 0;
+	return CRC32_Block(0, src, srclen);
+}
+
+/*
+=================
+CL_CacheFind
+
+Maps blob made from source file with the given crc, length and params,
+returns false when there is none and the asset has to be decoded and stored
+=================
+*/
+qboolean CL_CacheFind(const char* kind, unsigned crc, int srclen, unsigned params, cacheblob_t* out)
+{
+	cacheentry_t	*entry;
+	cacheheader_t	*header;
+	char			path[MAX_OSPATH];
+
+	memset(out, 0, sizeof(*out));
+
+	if (!CL_CacheEnabled() || srclen <= 0)
+		return false;
+
+	entry = CL_CacheFindEntry(kind, crc, srclen, params);
+	if (!entry)
+	{
+		cache.misses++;
+		return false;
+	}
+
+	CL_CacheFileName(path, sizeof(path), entry);
+	out->mapped = Sys_MapFile(path, &out->mappedsize);
+	header = out->mapped;
+
+	if (!header || out->mappedsize < (int)sizeof(cacheheader_t)
+		|| header->ident != CACHE_IDENT || header->format != CACHE_FORMAT
+		|| strncmp(header->version, PRAGMA_VERSION, sizeof(header->version))
+		|| strncmp(header->kind, kind, sizeof(header->kind))
+		|| header->crc != crc || header->srclen != srclen || header->params != params
+		|| header->datalen != out->mappedsize - (int)sizeof(cacheheader_t))
+	{
+		// stale or broken, gets written again after decoding
+		if (header)
+			Sys_UnmapFile(out->mapped, out->mappedsize);
+		memset(out, 0, sizeof(*out));
+
+		CL_CacheRemoveEntry(entry - cache.entries);
+		CL_CacheRehash();
+		cache.misses++;
+		return false;
+	}
+
+	entry->lastused = ++cache.sequence;
+	cache.dirty = true;
+
+	out->data = (const byte*)(header + 1);
+	out->length = header->datalen;
+
+	cache.hits++;
+	cache.hitbytes += header->datalen;
+	return true;
+}
+
+/*
+=================
+CL_CacheRelease
+=================
+*/
+void CL_CacheRelease(cacheblob_t* blob)
+{
+	if (blob->mapped)
+		Sys_UnmapFile(blob->mapped, blob->mappedsize);
+	memset(blob, 0, sizeof(*blob));
+}
+
+/*
+=================
+CL_CacheStore
+
+Writes decoded data for source file, least recently used blobs are evicted
+when the cache grows over cache_maxmb
+=================
+*/
+void CL_CacheStore(const char* kind, unsigned crc, int srclen, unsigned params, const void* data, int datalen)
+{
+	cacheentry_t	*entry;
+	cacheheader_t	header;
+	char			path[MAX_OSPATH];
+	FILE			*f;
+	qboolean		written;
+	int				size;
+
+	if (!CL_CacheEnabled() || srclen <= 0 || datalen < 0)
+		return;
+
+	size = sizeof(header) + datalen;
+	if (size > cache_maxmb->value * 1024 * 1024)
+		return;
+
+	memset(&header, 0, sizeof(header));
+	header.ident = CACHE_IDENT;
+	header.format = CACHE_FORMAT;
+	strncpy(header.version, PRAGMA_VERSION, sizeof(header.version) - 1);
+	strncpy(header.kind, kind, sizeof(header.kind) - 1);
+	header.crc = crc;
+	header.srclen = srclen;
+	header.params = params;
+	header.datalen = datalen;
+
+	entry = CL_CacheFindEntry(kind, crc, srclen, params);
+	if (!entry && (entry = CL_CacheAddEntry(kind, crc, srclen, params)) == NULL)
+		return;
+
+	CL_CacheFileName(path, sizeof(path), entry);
+
+	written = false;
+	if ((f = fopen(path, "wb")) != NULL)
+	{
+		written = fwrite(&header, sizeof(header), 1, f) == 1 && (!datalen || fwrite(data, datalen, 1, f) == 1);
+		fclose(f);
+	}
+
+	if (!written)
+	{
+		Com_DPrintf(DP_FS, "Asset cache: couldn't write %s\n", path);
+		CL_CacheRemoveEntry(entry - cache.entries);
+		CL_CacheRehash();
+		return;
+	}
+
+	cache.totalsize += size - entry->size;
+	entry->size = size;
+	entry->lastused = ++cache.sequence;
+	cache.dirty = true;
+
+	cache.stores++;
+	cache.storebytes += size;
+
+	CL_CacheEvict();
+}
+
+/*
+=================
+CL_CacheFlush
+
+Writes index, call after registration
+=================
+*/
+void CL_CacheFlush(void)
+{
+	cacheindex_t	index;
+	char			path[MAX_OSPATH];
+	FILE			*f;
+
+	if (!cache_maxmb)
+		return;
+
+	CL_CacheEvict();
+
+	if (!cache.dirty)
+		return;
+
+	memset(&index, 0, sizeof(index));
+	index.ident = CACHE_INDEX_IDENT;
+	index.format = CACHE_FORMAT;
+	strncpy(index.version, PRAGMA_VERSION, sizeof(index.version) - 1);
+	index.sequence = cache.sequence;
+	index.numentries = cache.numentries;
+
+	Com_sprintf(path, sizeof(path), "%s/cache/index.dat", fs_basedir->string);
+
+	if ((f = fopen(path, "wb")) == NULL)
+	{
+		Com_DPrintf(DP_FS, "Asset cache: couldn't write %s\n", path);
+		return;
+	}
+
+	fwrite(&index, sizeof(index), 1, f);
+	if (cache.numentries)
+		fwrite(cache.entries, sizeof(cacheentry_t), cache.numentries, f);
+	fclose(f);
+
+	cache.dirty = false;
+}
+
+/*
+=================
+CL_CacheLoadIndex
+
+Blobs missing from index (game quit before it was written) are added
+as the oldest ones
+=================
+*/
+static void CL_CacheLoadIndex(void)
+{
+	cacheindex_t	index;
+	cacheentry_t	entry, *added;
+	char			path[MAX_OSPATH], kind[8];
+	unsigned		crc, srclen, params;
+	char			*s, *name;
+	FILE			*f;
+	int				i;
+
+	memset(cache.hash, -1, sizeof(cache.hash));
+
+	Com_sprintf(path, sizeof(path), "%s/cache/index.dat", fs_basedir->string);
+	if ((f = fopen(path, "rb")) != NULL)
+	{
+		if (fread(&index, sizeof(index), 1, f) == 1 && index.ident == CACHE_INDEX_IDENT && index.format == CACHE_FORMAT
+			&& !strncmp(index.version, PRAGMA_VERSION, sizeof(index.version))
+			&& index.numentries >= 0 && index.numentries <= CACHE_MAX_ENTRIES)
+		{
+			cache.sequence = index.sequence;
+			for (i = 0; i < index.numentries; i++)
+			{
+				if (fread(&entry, sizeof(entry), 1, f) != 1)
+					break;
+
+				entry.kind[sizeof(entry.kind) - 1] = 0;
+				if (entry.size <= 0 || CL_CacheFindEntry(entry.kind, entry.crc, entry.srclen, entry.params))
+					continue;
+
+				if ((added = CL_CacheAddEntry(entry.kind, entry.crc, entry.srclen, entry.params)) == NULL)
+					break;
+				added->size = entry.size;
+				added->lastused = entry.lastused;
+				cache.totalsize += entry.size;
+			}
+		}
+		fclose(f);
+	}
+
+	Com_sprintf(path, sizeof(path), "%s/cache/*.bin", fs_basedir->string);
+	for (s = Sys_FindFirst(path, 0, SFF_SUBDIR | SFF_HIDDEN | SFF_SYSTEM); s; s = Sys_FindNext(0, SFF_SUBDIR | SFF_HIDDEN | SFF_SYSTEM))
+	{
+		name = strrchr(s, '/');
+		name = name ? name + 1 : s;
+		if (sscanf(name, "%7[^_]_%8x_%8x_%8x.bin", kind, &crc, &srclen, &params) != 4)
+			continue;
+
+		if (CL_CacheFindEntry(kind, crc, srclen, params))
+			continue;
+
+		if ((f = fopen(s, "rb")) == NULL)
+			continue;
+		fseek(f, 0, SEEK_END);
+		i = ftell(f);
+		fclose(f);
+
+		if ((added = CL_CacheAddEntry(kind, crc, srclen, params)) == NULL)
+			break;
+		added->size = i;
+		cache.totalsize += i;
+		cache.dirty = true;
+	}
+	Sys_FindClose();
+}
+
+/*
+=================
+CL_CacheStats_f
+=================
+*/
+static void CL_CacheStats_f(void)
+{
+	char	kinds[8][8];
+	int		numkinds, count, i, k;
+	double	size;
+
+	Com_Printf("Asset cache %s: %i files, %.1f MB of %.0f MB\n", CL_CacheEnabled() ? "enabled" : "disabled",
+		cache.numentries, cache.totalsize / (1024.0 * 1024.0), cache_maxmb->value);
+
+	numkinds = 0;
+	for (i = 0; i < cache.numentries; i++)
+	{
+		for (k = 0; k < numkinds; k++)
+		{
+			if (!strcmp(kinds[k], cache.entries[i].kind))
+				break;
+		}
+		if (k == numkinds && numkinds < 8)
+			strcpy(kinds[numkinds++], cache.entries[i].kind);
+	}
+
+	for (k = 0; k < numkinds; k++)
+	{
+		count = 0;
+		size = 0;
+		for (i = 0; i < cache.numentries; i++)
+		{
+			if (strcmp(kinds[k], cache.entries[i].kind))
+				continue;
+			count++;
+			size += cache.entries[i].size;
+		}
+		Com_Printf("  %-4s %6i files %8.1f MB\n", kinds[k], count, size / (1024.0 * 1024.0));
+	}
+
+	Com_Printf("This session: %i hits (%.1f MB), %i misses, %i stored (%.1f MB), %i evicted\n",
+		cache.hits, cache.hitbytes / (1024.0 * 1024.0), cache.misses, cache.stores, cache.storebytes / (1024.0 * 1024.0), cache.evictions);
+}
+
+/*
+=================
+CL_InitCache
+
+Must be called before the renderer is loaded
+=================
+*/
+void CL_InitCache(void)
+{
+	char	path[MAX_OSPATH];
+
+	cache_assets = Cvar_Get("cache_assets", "1", CVAR_ARCHIVE, "Keep decoded textures, models and sounds on disk so they load faster next time.");
+	cache_maxmb = Cvar_Get("cache_maxmb", "1024", CVAR_ARCHIVE, "Megabytes of disk used by asset cache, least recently used files are removed first.");
+
+	// created once here, FS_CreatePath for every blob would flush file lookup cache
+	Com_sprintf(path, sizeof(path), "%s/cache", fs_basedir->string);
+	Sys_Mkdir(path);
+
+	CL_CacheLoadIndex();
+	CL_CacheEvict();
+
+	Cmd_AddCommand("cache_stats", CL_CacheStats_f);
+}
+
+/*
+=================
+CL_ShutdownCache
+=================
+*/
+void CL_ShutdownCache(void)
+{
+	CL_CacheFlush();
+
+	if (cache.entries)
+		Z_Free(cache.entries);
+	memset(&cache, 0, sizeof(cache));
+}
@@ -209,6 +209,56 @@ static void CL_DownloadMapTextures(float allowDownload, char* fileDir, char* fil
 
 
 
+/*
+=================
+CL_PrefetchLevelAssets
+
+Reads files for everything in configstrings on job threads before
+sounds and refresh are registered, the map must already be loaded
+=================
+*/
+static void CL_PrefetchLevelAssets(void)
+{
+	csurface_t	*surf;
+	char		*name;
+	int			i;
+
+	// drop leftovers of a load which errored out
+	FS_ClearPrefetch();
+
+	// the renderer loads the map again, models are read through the mapping
+	FS_PrefetchFile(cl.configstrings[CS_MODELS + 1], true);
+
+	for (i = 2; i < MAX_MODELS && cl.configstrings[CS_MODELS + i][0]; i++)
+	{
+		name = cl.configstrings[CS_MODELS + i];
+		if (name[0] != '*' && name[0] != '#')
+			FS_PrefetchFile(name, true);
+	}
+
+	for (i = 1; i < MAX_SOUNDS && cl.configstrings[CS_SOUNDS + i][0]; i++)
+	{
+		name = cl.configstrings[CS_SOUNDS + i];
+		FS_PrefetchFile(name[0] == '#' ? name + 1 : va("sound/%s", name), true);
+	}
+
+	for (i = 1; i < MAX_IMAGES && cl.configstrings[CS_IMAGES + i][0]; i++)
+	{
+		name = cl.configstrings[CS_IMAGES + i];
+		FS_PrefetchFile((name[0] == '/' || name[0] == '\\') ? name + 1 : va("gfx/%s.tga", name), false);
+	}
+
+	for (i = 0; i < CM_NumSurfaceInfos(); i++)
+	{
+		surf = CM_SurfaceInfo(i);
+		if (!(surf->flags & (SURF_SKY | SURF_NODRAW | SURF_SKIP)))
+			FS_PrefetchFile(va("textures/%s.tga", surf->name), false);
+	}
+
+	FS_RunPrefetch();
+}
+
+
 void CL_RequestNextDownload(void)
 {
 	unsigned	map_checksum;
@@ -275,8 +325,11 @@ void CL_RequestNextDownload(void)
 //	CL_DownloadSkyImages((allow_download->value && allow_download_maps->value), TEXTURE_CNT);
 //	CL_DownloadMapTextures((allow_download->value && allow_download_maps->value), "textures", "wal", TEXTURE_CNT + 999);
 
+	CL_PrefetchLevelAssets();
 	CL_RegisterSounds();
 	CL_PrepRefresh();
+	FS_ClearPrefetch();
+	CL_CacheFlush();
 
 	CG_BeginGame();
 
@@ -302,8 +355,11 @@ void CL_Precache_f(void)
 		unsigned	map_checksum;		// for detecting cheater maps
 
 		CM_LoadMap(cl.configstrings[CS_MODELS + 1], true, &map_checksum);
+		CL_PrefetchLevelAssets();
 		CL_RegisterSounds();
 		CL_PrepRefresh();
+		FS_ClearPrefetch();
+		CL_CacheFlush();
 		return;
 	}
 
@@ -506,6 +562,7 @@ void CL_ParseDownload(void)
 		r = rename(oldn, newn);
 		if (r)
 			Com_Printf("failed to rename.\n");
+		FS_FlushLookupCache();
 
 		cls.download = NULL;
 		cls.downloadpercent = 0;
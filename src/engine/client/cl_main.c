@@ -33,6 +33,7 @@ cvar_t	*cl_add_blend;
 cvar_t	*cl_shownet;
 cvar_t	*cl_showmiss;
 cvar_t	*cl_showclamp;
+cvar_t	*cl_bitpacked;
 
 cvar_t	*cl_paused;
 cvar_t	*cl_timedemo;
@@ -189,7 +190,7 @@ void CL_Record_f (void)
 
 	// send the serverdata
 	MSG_WriteByte (&buf, SVC_SERVERDATA);
-	MSG_WriteLong (&buf, PROTOCOL_VERSION);
+	MSG_WriteLong (&buf, cls.serverProtocol); // frames are recorded as received
 	MSG_WriteLong (&buf, 0x10000 + cl.servercount);
 	MSG_WriteByte (&buf, 1);	// demos are always attract loops
 	MSG_WriteString (&buf, cl.gamedir); // write game dir
@@ -376,7 +377,8 @@ void CL_SendConnectPacket (void)
 	port = Cvar_VariableValue ("qport");
 	userinfo_modified = false;
 
-	Netchan_OutOfBandPrint (NS_CLIENT, adr, "connect %i %i %i \"%s\"\n", PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo() );
+	// servers which don't know bit packed frames ignore the last argument
+	Netchan_OutOfBandPrint (NS_CLIENT, adr, "connect %i %i %i \"%s\" %i\n", PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo(), cl_bitpacked->value ? PROTOCOL_VERSION_BITS : PROTOCOL_VERSION );
 }
 
 /*
@@ -537,6 +539,7 @@ void CL_ClearState ()
 {
 	S_StopAllSounds ();
 	CL_ShutdownClientGame();
+	FS_ClearPrefetch ();
 
 	// FIXME this should restart GUI progs
 
@@ -1119,6 +1122,7 @@ void CL_InitLocal (void)
 	cl_shownet = Cvar_Get ("cl_shownet", "0", 0, NULL);
 	cl_showmiss = Cvar_Get ("cl_showmiss", "0", 0, NULL);
 	cl_showclamp = Cvar_Get ("cl_showclamp", "0", 0, NULL);
+	cl_bitpacked = Cvar_Get ("cl_bitpacked", "1", CVAR_ARCHIVE, "Ask servers for bit packed frames when connecting.");
 	cl_timeout = Cvar_Get ("cl_timeout", "120", 0, NULL);
 	cl_paused = Cvar_Get ("paused", "0", 0, NULL);
 	cl_timedemo = Cvar_Get ("timedemo", "0", CVAR_CHEAT, NULL);
@@ -1225,6 +1229,7 @@ void CL_WriteConfiguration (void)
 	fclose (f);
 
 	Cvar_WriteVariables (path);
+	FS_FlushLookupCache ();
 }
 
 
@@ -1464,6 +1469,8 @@ void CL_Init (void)
 
 	Con_Init ();	
 
+	CL_InitCache ();	// renderer uses it while loading
+
 	VID_Init ();
 	S_Init ();	// sound must be initialized after window is created
 
@@ -1518,6 +1525,8 @@ void CL_Shutdown(void)
 	S_Shutdown();
 	IN_Shutdown();
 	VID_Shutdown();
+
+	CL_ShutdownCache();
 }
 
 
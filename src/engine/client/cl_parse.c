@@ -110,7 +110,7 @@ void CL_ParseServerData (void)
 	i = MSG_ReadLong (&net_message);
 	cls.serverProtocol = i;
 
-	if (i != PROTOCOL_VERSION)
+	if (i != PROTOCOL_VERSION && i != PROTOCOL_VERSION_BITS)
 		Com_Error(ERR_DROP, "Server is diferent version.");
 
 	cl.servercount = MSG_ReadLong (&net_message);
@@ -717,7 +717,10 @@ void CL_DeltaEntity(frame_t* frame, int newnum, entity_state_t* old, int bits)
 	cl.parse_entities++;
 	frame->num_entities++;
 
-	CL_ParseDelta(old, state, newnum, bits);
+	if (bits & U_BITPACKED)
+		MSG_ReadDeltaEntityBits(&net_message, old, state, newnum);
+	else
+		CL_ParseDelta(old, state, newnum, bits);
 
 	// some data changes will force no lerping
 	if (state->modelindex != ent->current.modelindex
@@ -770,6 +773,12 @@ void CL_ParsePacketEntities(frame_t* oldframe, frame_t* newframe)
 	unsigned int	bits;
 	entity_state_t* oldstate = NULL;
 	int			oldindex, oldnum;
+	qboolean	bitpacked, remove;
+
+	bitpacked = (cls.serverProtocol == PROTOCOL_VERSION_BITS);
+	if (bitpacked)
+		MSG_BeginReadingBits(&net_message);
+	newnum = 0;
 
 	newframe->parse_entities = cl.parse_entities;
 	newframe->num_entities = 0;
@@ -791,7 +800,14 @@ void CL_ParsePacketEntities(frame_t* oldframe, frame_t* newframe)
 
 	while (1)
 	{
-		newnum = CL_ParseEntityBits(&bits);
+		if (bitpacked)
+		{
+			newnum = MSG_ReadEntityNumBits(&net_message, newnum, &remove);
+			bits = remove ? U_REMOVE : U_BITPACKED;
+		}
+		else
+			newnum = CL_ParseEntityBits(&bits);
+
 		if (newnum >= MAX_GENTITIES)
 			Com_Error(ERR_DROP, "CL_ParsePacketEntities: bad number:%i", newnum);
 
@@ -906,6 +922,18 @@ void CL_ParsePlayerstate(frame_t* oldframe, frame_t* newframe)
 	else
 		memset(state, 0, sizeof(*state));
 
+	if (cls.serverProtocol == PROTOCOL_VERSION_BITS)
+	{
+		player_state_t	from = *state;
+
+		MSG_BeginReadingBits(&net_message);
+		MSG_ReadDeltaPlayerstateBits(&net_message, &from, state);
+
+		if (cl.attractloop)
+			state->pmove.pm_type = PM_FREEZE;		// demo playback
+		return;
+	}
+
 	flags = MSG_ReadShort(&net_message);
 	if (flags & PS_EXTRABYTES)
 		flags = (MSG_ReadShort(&net_message) << 16) | (flags & 0xFFFF); // reki --  Allow extra bytes, so we don't choke ourselves
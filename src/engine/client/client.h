@@ -275,6 +275,7 @@ extern	cvar_t	*cl_anglespeedkey;
 extern	cvar_t	*cl_shownet;
 extern	cvar_t	*cl_showmiss;
 extern	cvar_t	*cl_showclamp;
+extern	cvar_t	*cl_bitpacked;
 
 extern	cvar_t	*lookspring;
 extern	cvar_t	*lookstrafe;
@@ -431,6 +432,17 @@ void IN_CenterView (void);
 float CL_KeyState (kbutton_t *key);
 char *Key_KeynumToString (int keynum);
 
+//
+// cl_cache.c
+//
+void CL_InitCache(void);
+void CL_ShutdownCache(void);
+void CL_CacheFlush(void);
+unsigned CL_CacheSourceCRC(const void* src, int srclen);
+qboolean CL_CacheFind(const char* kind, unsigned crc, int srclen, unsigned params, cacheblob_t* out);
+void CL_CacheRelease(cacheblob_t* blob);
+void CL_CacheStore(const char* kind, unsigned crc, int srclen, unsigned params, const void* data, int datalen);
+
 //
 // cl_demo.c
 //
@@ -355,12 +355,7 @@ void S_EndRegistration (void)
 	}
 
 	// load everything in
-	for (i=0, sfx=known_sfx ; i < num_sfx ; i++,sfx++)
-	{
-		if (!sfx->name[0])
-			continue;
-		S_LoadSound (sfx);
-	}
+	S_LoadSounds (known_sfx, num_sfx);
 
 	s_registering = false;
 }
@@ -138,11 +138,11 @@ extern cvar_t	*s_mixahead;
 extern cvar_t	*s_testsound;
 extern cvar_t	*s_primary;
 
-wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
 void S_InitScaletable (void);
 
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_LoadSounds (sfx_t *sfx, int count);
 
 void S_IssuePlaysound (playsound_t *ps);
 
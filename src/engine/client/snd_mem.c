@@ -17,6 +17,9 @@ int			cache_full_cycle;
 
 byte *S_Alloc (int size);
 
+static const char wav_badloop[] = "bad loop length";	// S_ParseWav error which drops the game
+static const char *S_ParseWav (byte *data, int wavlength, wavinfo_t *info);
+
 /*
 ================
 ResampleSfx
@@ -81,32 +84,27 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 
 //=============================================================================
 
-/*
-==============
-S_LoadSound
-==============
-*/
-sfxcache_t *S_LoadSound (sfx_t *s)
+// sounds are loaded in steps so S_LoadSounds can run the slow ones for many
+// sounds on job threads, steps marked main thread may use zone, print or asset cache
+typedef struct
 {
-    char	namebuffer[MAX_QPATH];
-	byte	*data;
+	sfx_t		*sfx;
+	fsmapped_t	file;
+	unsigned	params, crc;
 	wavinfo_t	info;
-	int		len;
-	float	stepscale;
-	sfxcache_t	*sc;
-	int		size;
-	char	*name;
+	const char	*error;			// from parsing wav, printed on main thread
+	int			len;			// of resampled samples
+} sfxload_t;
 
-	if (s->name[0] == '*')
-		return NULL;
+// main thread, false when there's no file
+static qboolean S_OpenSound (sfx_t *s, sfxload_t *load)
+{
+	char	namebuffer[MAX_QPATH];
+	char	*name;
 
-// see if still in memory
-	sc = s->cache;
-	if (sc)
-		return sc;
+	memset (load, 0, sizeof(*load));
+	load->sfx = s;
 
-//Com_Printf ("S_LoadSound: %x\n", (int)stackbuf);
-// load it in
 	if (s->truename)
 		name = s->truename;
 	else
@@ -119,45 +117,197 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 //	Com_Printf ("loading %s\n",namebuffer);
 
-	size = FS_LoadFile (namebuffer, (void **)&data);
-
-	if (!data)
+	if (!FS_MapFile (namebuffer, &load->file))
 	{
 		Com_DPrintf (DP_SND,"Couldn't load %s\n", namebuffer);
-		return NULL;
+		return false;
+	}
+
+	// already resampled to this rate and width
+	load->params = dma.speed | (s_loadas8bit->value ? 0x80000000 : 0);
+	return true;
+}
+
+// any thread
+static void S_ParseSound (sfxload_t *load)
+{
+	load->crc = CL_CacheSourceCRC (load->file.data, load->file.length);
+	load->error = S_ParseWav ((byte *)load->file.data, load->file.length, &load->info);
+}
+
+// main thread, true when cached samples were used
+static qboolean S_LoadCachedSound (sfxload_t *load)
+{
+	cacheblob_t	blob;
+	sfxcache_t	*sc;
+
+	if (!CL_CacheFind ("snd", load->crc, load->file.length, load->params, &blob))
+		return false;
+
+	if (blob.length < (int)sizeof(sfxcache_t))
+	{
+		CL_CacheRelease (&blob);
+		return false;
 	}
 
-	info = GetWavinfo (s->name, data, size);
-	if (info.channels != 1)
+	sc = load->sfx->cache = Z_Malloc (blob.length);
+	memcpy (sc, blob.data, blob.length);
+	CL_CacheRelease (&blob);
+	FS_UnmapFile (&load->file);
+	return true;
+}
+
+// main thread, allocates samples for S_ResampleSound
+static qboolean S_AllocSound (sfxload_t *load)
+{
+	wavinfo_t	*info = &load->info;
+	sfxcache_t	*sc;
+	float		stepscale;
+
+	if (load->error == wav_badloop)
+		Com_Error (ERR_DROP, "Sound %s has a bad loop length", load->sfx->name);
+	if (load->error)
+		Com_Printf ("%s\n", load->error);
+
+	if (info->channels != 1)
 	{
-		Com_Printf ("%s is a stereo sample\n",s->name);
-		FS_FreeFile (data);
-		return NULL;
+		Com_Printf ("%s is a stereo sample\n", load->sfx->name);
+		FS_UnmapFile (&load->file);
+		return false;
 	}
 
-	stepscale = (float)info.rate / dma.speed;	
-	len = info.samples / stepscale;
+	stepscale = (float)info->rate / dma.speed;	
+	load->len = info->samples / stepscale;
 
-	len = len * info.width * info.channels;
+	load->len = load->len * info->width * info->channels;
 
-	sc = s->cache = Z_Malloc (len + sizeof(sfxcache_t));
+	sc = load->sfx->cache = Z_Malloc (load->len + sizeof(sfxcache_t));
 	if (!sc)
 	{
-		FS_FreeFile (data);
-		return NULL;
+		FS_UnmapFile (&load->file);
+		return false;
 	}
 	
-	sc->length = info.samples;
-	sc->loopstart = info.loopstart;
-	sc->speed = info.rate;
-	sc->width = info.width;
-	sc->stereo = info.channels;
+	sc->length = info->samples;
+	sc->loopstart = info->loopstart;
+	sc->speed = info->rate;
+	sc->width = info->width;
+	sc->stereo = info->channels;
+	return true;
+}
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+// any thread
+static void S_ResampleSound (sfxload_t *load)
+{
+	sfxcache_t	*sc = load->sfx->cache;
 
-	FS_FreeFile (data);
+	ResampleSfx (load->sfx, sc->speed, sc->width, (byte *)load->file.data + load->info.dataofs);
+}
 
-	return sc;
+// main thread
+static void S_FinishSound (sfxload_t *load)
+{
+	CL_CacheStore ("snd", load->crc, load->file.length, load->params, load->sfx->cache, load->len + sizeof(sfxcache_t));
+	FS_UnmapFile (&load->file);
+}
+
+/*
+==============
+S_LoadSound
+==============
+*/
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	sfxload_t	load;
+
+	if (s->name[0] == '*')
+		return NULL;
+
+// see if still in memory
+	if (s->cache)
+		return s->cache;
+
+// load it in
+	if (!S_OpenSound (s, &load))
+		return NULL;
+
+	S_ParseSound (&load);
+	if (S_LoadCachedSound (&load))
+		return s->cache;
+
+	if (!S_AllocSound (&load))
+		return NULL;
+
+	S_ResampleSound (&load);
+	S_FinishSound (&load);
+	return s->cache;
+}
+
+static void S_ParseSoundJob (void *data, int index, int thread)
+{
+	S_ParseSound (&((sfxload_t *)data)[index]);
+}
+
+static void S_ResampleSoundJob (void *data, int index, int thread)
+{
+	S_ResampleSound (&((sfxload_t *)data)[index]);
+}
+
+/*
+==============
+S_LoadSounds
+
+Loads all sounds which aren't in memory, wav parsing and resampling run
+on job threads
+==============
+*/
+void S_LoadSounds (sfx_t *sfx, int count)
+{
+	sfxload_t	*loads;
+	int			i, j, numloads, numresample;
+
+	if (count <= 0)
+		return;
+
+	loads = Z_Malloc (count * sizeof(sfxload_t));
+
+	numloads = 0;
+	for (i = 0; i < count; i++, sfx++)
+	{
+		if (!sfx->name[0] || sfx->name[0] == '*' || sfx->cache)
+			continue;
+		if (S_OpenSound (sfx, &loads[numloads]))
+			numloads++;
+	}
+
+	Job_ParallelFor (numloads, S_ParseSoundJob, loads);
+
+	// drop doesn't leave files mapped
+	for (i = 0; i < numloads; i++)
+	{
+		if (loads[i].error != wav_badloop)
+			continue;
+		sfx = loads[i].sfx;
+		for (j = 0; j < numloads; j++)
+			FS_UnmapFile (&loads[j].file);
+		Z_Free (loads);
+		Com_Error (ERR_DROP, "Sound %s has a bad loop length", sfx->name);
+	}
+
+	numresample = 0;
+	for (i = 0; i < numloads; i++)
+	{
+		if (S_LoadCachedSound (&loads[i]) || !S_AllocSound (&loads[i]))
+			continue;
+		loads[numresample++] = loads[i];
+	}
+
+	Job_ParallelFor (numresample, S_ResampleSoundJob, loads);
+
+	for (i = 0; i < numresample; i++)
+		S_FinishSound (&loads[i]);
+
+	Z_Free (loads);
 }
 
 
@@ -170,181 +320,173 @@ WAV loading
 ===============================================================================
 */
 
-
-byte	*data_p;
-byte 	*iff_end;
-byte 	*last_chunk;
-byte 	*iff_data;
-int 	iff_chunk_len;
-
-
-short GetLittleShort(void)
+typedef struct
+{
+	byte	*data_p;
+	byte 	*iff_end;
+	byte 	*last_chunk;
+	byte 	*iff_data;
+	int 	iff_chunk_len;
+} wavparse_t;
+
+static short GetLittleShort(wavparse_t *wav)
 {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	data_p += 2;
+	val = *wav->data_p;
+	val = val + (*(wav->data_p+1)<<8);
+	wav->data_p += 2;
 	return val;
 }
 
-int GetLittleLong(void)
+static int GetLittleLong(wavparse_t *wav)
 {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	val = val + (*(data_p+2)<<16);
-	val = val + (*(data_p+3)<<24);
-	data_p += 4;
+	val = *wav->data_p;
+	val = val + (*(wav->data_p+1)<<8);
+	val = val + (*(wav->data_p+2)<<16);
+	val = val + (*(wav->data_p+3)<<24);
+	wav->data_p += 4;
 	return val;
 }
 
-void FindNextChunk(char *name)
+static void FindNextChunk(wavparse_t *wav, char *name)
 {
 	while (1)
 	{
-		data_p=last_chunk;
+		wav->data_p=wav->last_chunk;
 
-		if (data_p >= iff_end)
+		if (wav->data_p >= wav->iff_end)
 		{	// didn't find the chunk
-			data_p = NULL;
+			wav->data_p = NULL;
 			return;
 		}
 		
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		if (iff_chunk_len < 0)
+		wav->data_p += 4;
+		wav->iff_chunk_len = GetLittleLong(wav);
+		if (wav->iff_chunk_len < 0)
 		{
-			data_p = NULL;
+			wav->data_p = NULL;
 			return;
 		}
 //		if (iff_chunk_len > 1024*1024)
 //			Sys_Error ("FindNextChunk: %i length is past the 1 meg sanity limit", iff_chunk_len);
-		data_p -= 8;
-		last_chunk = data_p + 8 + ( (iff_chunk_len + 1) & ~1 );
-		if (!strncmp(data_p, name, 4))
+		wav->data_p -= 8;
+		wav->last_chunk = wav->data_p + 8 + ( (wav->iff_chunk_len + 1) & ~1 );
+		if (!strncmp(wav->data_p, name, 4))
 			return;
 	}
 }
 
-void FindChunk(char *name)
+static void FindChunk(wavparse_t *wav, char *name)
 {
-	last_chunk = iff_data;
-	FindNextChunk (name);
+	wav->last_chunk = wav->iff_data;
+	FindNextChunk (wav, name);
 }
 
 
-void DumpChunks(void)
+static void DumpChunks(wavparse_t *wav)
 {
 	char	str[5];
 	
 	str[4] = 0;
-	data_p=iff_data;
+	wav->data_p=wav->iff_data;
 	do
 	{
-		memcpy (str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Com_Printf ("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
+		memcpy (str, wav->data_p, 4);
+		wav->data_p += 4;
+		wav->iff_chunk_len = GetLittleLong(wav);
+		Com_Printf ("0x%x : %s (%d)\n", (int)(wav->data_p - 4), str, wav->iff_chunk_len);
+		wav->data_p += (wav->iff_chunk_len + 1) & ~1;
+	} while (wav->data_p < wav->iff_end);
 }
 
 /*
 ============
-GetWavinfo
+S_ParseWav
+
+Fills info from wav header, returns message to print when the file
+can't be used or wav_badloop. Doesn't print so it's safe on job threads.
 ============
 */
-wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength)
+static const char *S_ParseWav (byte *data, int wavlength, wavinfo_t *info)
 {
-	wavinfo_t	info;
+	wavparse_t	wav;
 	int     i;
 	int     format;
 	int		samples;
 
-	memset (&info, 0, sizeof(info));
+	memset (info, 0, sizeof(*info));
 
-	if (!wav)
-		return info;
+	if (!data)
+		return NULL;
 		
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	wav.iff_data = data;
+	wav.iff_end = data + wavlength;
 
 // find "RIFF" chunk
-	FindChunk("RIFF");
-	if (!(data_p && !strncmp(data_p+8, "WAVE", 4)))
-	{
-		Com_Printf("Missing RIFF/WAVE chunks\n");
-		return info;
-	}
+	FindChunk(&wav, "RIFF");
+	if (!(wav.data_p && !strncmp(wav.data_p+8, "WAVE", 4)))
+		return "Missing RIFF/WAVE chunks";
 
 // get "fmt " chunk
-	iff_data = data_p + 12;
-// DumpChunks ();
-
-	FindChunk("fmt ");
-	if (!data_p)
-	{
-		Com_Printf("Missing fmt chunk\n");
-		return info;
-	}
-	data_p += 8;
-	format = GetLittleShort();
+	wav.iff_data = wav.data_p + 12;
+// DumpChunks (&wav);
+
+	FindChunk(&wav, "fmt ");
+	if (!wav.data_p)
+		return "Missing fmt chunk";
+	wav.data_p += 8;
+	format = GetLittleShort(&wav);
 	if (format != 1)
-	{
-		Com_Printf("Microsoft PCM format only\n");
-		return info;
-	}
+		return "Microsoft PCM format only";
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4+2;
-	info.width = GetLittleShort() / 8;
+	info->channels = GetLittleShort(&wav);
+	info->rate = GetLittleLong(&wav);
+	wav.data_p += 4+2;
+	info->width = GetLittleShort(&wav) / 8;
 
 // get cue chunk
-	FindChunk("cue ");
-	if (data_p)
+	FindChunk(&wav, "cue ");
+	if (wav.data_p)
 	{
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+		wav.data_p += 32;
+		info->loopstart = GetLittleLong(&wav);
 //		Com_Printf("loopstart=%d\n", sfx->loopstart);
 
 	// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
-		if (data_p)
+		FindNextChunk (&wav, "LIST");
+		if (wav.data_p)
 		{
-			if (!strncmp (data_p + 28, "mark", 4))
+			if (!strncmp (wav.data_p + 28, "mark", 4))
 			{	// this is not a proper parse, but it works with cooledit...
-				data_p += 24;
-				i = GetLittleLong ();	// samples in loop
-				info.samples = info.loopstart + i;
+				wav.data_p += 24;
+				i = GetLittleLong (&wav);	// samples in loop
+				info->samples = info->loopstart + i;
 //				Com_Printf("looped length: %i\n", i);
 			}
 		}
 	}
 	else
-		info.loopstart = -1;
+		info->loopstart = -1;
 
 // find data chunk
-	FindChunk("data");
-	if (!data_p)
-	{
-		Com_Printf("Missing data chunk\n");
-		return info;
-	}
+	FindChunk(&wav, "data");
+	if (!wav.data_p)
+		return "Missing data chunk";
 
-	data_p += 4;
-	samples = GetLittleLong () / info.width;
+	wav.data_p += 4;
+	samples = GetLittleLong (&wav) / info->width;
 
-	if (info.samples)
+	if (info->samples)
 	{
-		if (samples < info.samples)
-			Com_Error (ERR_DROP, "Sound %s has a bad loop length", name);
+		if (samples < info->samples)
+			return wav_badloop;
 	}
 	else
-		info.samples = samples;
+		info->samples = samples;
 
-	info.dataofs = data_p - wav;
+	info->dataofs = wav.data_p - data;
 	
-	return info;
+	return NULL;
 }
 
@@ -122,6 +122,39 @@ void VID_Error (int err_level, char *fmt, ...)
 	Com_Error (err_level,"%s", msg);
 }
 
+/*
+============
+VID_MapFile
+
+FS_MapFile for the renderer, handle is what has to be freed once done
+============
+*/
+static int VID_MapFile (const char *name, const void **buf, void **handle)
+{
+	fsmapped_t	file;
+
+	if (!FS_MapFile (name, &file))
+	{
+		*buf = NULL;
+		*handle = NULL;
+		return -1;
+	}
+
+	*buf = file.data;
+	*handle = file.allocated;
+	return file.length;
+}
+
+static void VID_UnmapFile (void *handle)
+{
+	fsmapped_t	file;
+
+	file.data = NULL;
+	file.length = 0;
+	file.allocated = handle;
+	FS_UnmapFile (&file);
+}
+
 //==========================================================================
 
 byte        scantokey[128] = 
@@ -569,6 +602,8 @@ qboolean VID_LoadRefresh( char *name )
 	ri.LoadFile = FS_LoadFile;
 	ri.LoadTextFile = FS_LoadTextFile;
 	ri.FreeFile = FS_FreeFile;
+	ri.MapFile = VID_MapFile;
+	ri.UnmapFile = VID_UnmapFile;
 	ri.GetGameDir = FS_Gamedir;
 	ri.Cvar_Get = Cvar_Get;
 	ri.Cvar_Set = Cvar_Set;
@@ -584,6 +619,11 @@ qboolean VID_LoadRefresh( char *name )
 	ri.GetBSPLimit = _GetBSPLimit;
 	ri.GetBSPElementSize = _GetBSPElementSize;
 
+	ri.CacheSourceCRC = CL_CacheSourceCRC;
+	ri.CacheFind = CL_CacheFind;
+	ri.CacheRelease = CL_CacheRelease;
+	ri.CacheStore = CL_CacheStore;
+
 	GetRefAPI = (GetRefAPI_t)GetProcAddress(reflib_library, "GetRefAPI");
 	if ((GetRefAPI) == 0)
 	{
@@ -12,6 +12,11 @@ See the attached GNU General Public License v2 for more details.
 
 #include "pragma.h"
 
+#if defined(_M_X64) || defined(__SSE2__)
+	#include <emmintrin.h>
+	#define CM_USE_SSE2
+#endif
+
 qboolean bExtendedBSP = false;
 
 typedef struct
@@ -128,7 +133,6 @@ typedef struct
 	int contents;
 	int numsides;
 	int firstbrushside;
-	unsigned int checkcount; // to avoid repeated testings
 } cbrush_t;
 
 typedef struct
@@ -191,20 +195,21 @@ static qboolean map_openAreaPortalsList[MAX_MAP_AREAPORTALS];
 
 // ============================================================================
 
-static unsigned int checkcount = 0;
 static int emptyleaf, solidleaf;
 static mapsurface_t nullsurface = { 0 };
 static int floodvalid;
 
 static cvar_t *map_noareas; // debugging aid
+static cvar_t *cm_viscache;
 
 static void CM_InitBoxHull();
+static void CM_FreeVisCache();
 static void CM_FloodAreaConnections();
 
 int	c_pointcontents; // performance counters
 int c_traces, c_brush_traces; // performance counters
 
-static byte* cmod_base; // pointer to BSP data
+static const byte* cmod_base; // pointer to BSP data
 
 /*
 ===============================================================================
@@ -625,6 +630,7 @@ void CM_FreeMap()
 	map_numEntityStringChars = 0;
 	map_entityString[0] = 0;
 
+	CM_FreeVisCache();
 }
 
 /*
@@ -636,13 +642,13 @@ Loads in the map and all submodels
 */
 cmodel_t *CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 {
-	unsigned		*buf;
+	fsmapped_t		file;
 	int				i;
 	dbsp_header_t		header;
-	int				length;
 	static unsigned	last_checksum;
 
 	map_noareas = Cvar_Get ("cm_noareas", "0", 0, NULL);
+	cm_viscache = Cvar_Get ("cm_viscache", "16", 0, "Megabytes for decompressed PVS/PHS rows, 0 disables the cache.");
 
 	if ( !strcmp (map_name, name) && (clientload || !Cvar_VariableValue ("cm_flushmap")) )
 	{
@@ -670,17 +676,16 @@ cmodel_t *CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	//
 	// load the file
 	//
-	length = FS_LoadFile (name, (void **)&buf);
-	if (!buf)
+	if (!FS_MapFile (name, &file))
 	{
 		Com_Error(ERR_DROP, "Could not load BSP %s\n", name);
 		return NULL; //msvc
 	}
 
-	last_checksum = LittleLong (Com_BlockChecksum (buf, length));
+	last_checksum = LittleLong (Com_BlockChecksum ((void *)file.data, file.length));
 	*checksum = last_checksum;
 
-	header = *(dbsp_header_t *)buf;
+	header = *(const dbsp_header_t *)file.data;
 	for (i=0 ; i<sizeof(dbsp_header_t)/4 ; i++)
 		((int *)&header)[i] = LittleLong ( ((int *)&header)[i]);
 
@@ -697,7 +702,7 @@ cmodel_t *CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	if (header.version != BSP_VERSION)
 		Com_Error(ERR_DROP, "%s: %s has wrong version number (%i should be %i)", __FUNCTION__, name, header.version, BSP_VERSION);
 
-	cmod_base = (byte *)buf;
+	cmod_base = file.data;
 
 	// load into heap
 	CMod_LoadSurfaceParams(&header.lumps[LUMP_TEXINFO]);
@@ -713,7 +718,8 @@ cmodel_t *CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	CMod_LoadVisibility(&header.lumps[LUMP_VISIBILITY]);
 	CMod_LoadEntityString(&header.lumps[LUMP_ENTITIES]);
 
-	FS_FreeFile (buf);
+	FS_UnmapFile (&file);
+	cmod_base = NULL;
 
 	CM_InitBoxHull();
 
@@ -776,6 +782,30 @@ int	CM_NumInlineModels()
 	return map_numInlineModels;
 }
 
+/*
+==================
+CM_NumSurfaceInfos
+Returns the number of texinfos
+==================
+*/
+int	CM_NumSurfaceInfos()
+{
+	return map_numSurfaceInfos;
+}
+
+/*
+==================
+CM_SurfaceInfo
+Returns surface name and flags of a texinfo
+==================
+*/
+csurface_t* CM_SurfaceInfo(int index)
+{
+	if (index < 0 || index >= map_numSurfaceInfos)
+		return &nullsurface.c;
+	return &map_surfaceInfos[index].c;
+}
+
 /*
 ==================
 CM_EntityString
@@ -843,6 +873,142 @@ static int		box_headnode;
 static cbrush_t* box_brush;
 static cleaf_t* box_leaf;
 
+/*
+===============================================================================
+
+TRACE CONTEXT
+
+All queries which need scratch state keep it in a cmcontext_t, so each thread
+can run traces with its own context. The old API uses cm_mainContext.
+
+===============================================================================
+*/
+
+struct cmcontext_s
+{
+	// brushes are marked with checkcount to test them once per trace
+	unsigned int	*brushCheck;
+	int				numBrushCheck;
+	unsigned int	checkcount;
+
+	// box hull set by CM_HeadnodeForBoxCtx, replaces the shared one at box_headnode
+	cplane_t		boxPlanes[12];
+	cnode_t			boxNodes[6];
+	cbrushside_t	boxSides[6];
+	cbrush_t		boxBrush;
+
+	// current trace
+	vec3_t			start, end;
+	vec3_t			mins, maxs;
+	vec3_t			extents;
+	trace_t			trace;
+	int				contents;
+	qboolean		ispoint;		// optimized case
+};
+
+static cmcontext_t cm_mainContext;
+
+/*
+===================
+CM_InitContext
+===================
+*/
+static void CM_InitContext(cmcontext_t* ctx)
+{
+	int			i, side;
+	cplane_t	*plane;
+
+	memset(ctx, 0, sizeof(*ctx));
+
+	ctx->boxBrush.numsides = 6;
+	ctx->boxBrush.contents = CONTENTS_MONSTER;
+
+	for (i = 0; i < 6; i++)
+	{
+		side = i & 1;
+
+		ctx->boxSides[i].plane = &ctx->boxPlanes[i * 2 + side];
+		ctx->boxSides[i].surface = &nullsurface;
+
+		plane = &ctx->boxPlanes[i * 2];
+		plane->type = i >> 1;
+		plane->normal[i >> 1] = 1;
+
+		plane = &ctx->boxPlanes[i * 2 + 1];
+		plane->type = 3 + (i >> 1);
+		plane->normal[i >> 1] = -1;
+	}
+}
+
+/*
+===================
+CM_NewContext
+
+Allocates trace context for use in one thread at a time.
+===================
+*/
+cmcontext_t* CM_NewContext()
+{
+	cmcontext_t* ctx;
+
+	ctx = malloc(sizeof(cmcontext_t)); // not from zone, may be called by worker threads
+	if (!ctx)
+	{
+		Com_Error(ERR_FATAL, "%s: out of memory\n", __FUNCTION__);
+		return NULL;
+	}
+
+	CM_InitContext(ctx);
+	return ctx;
+}
+
+/*
+===================
+CM_FreeContext
+===================
+*/
+void CM_FreeContext(cmcontext_t* ctx)
+{
+	if (!ctx || ctx == &cm_mainContext)
+		return;
+
+	free(ctx->brushCheck);
+	free(ctx);
+}
+
+/*
+===================
+CM_BeginCheck
+
+Starts a new brush check for a trace, sizes brushCheck for current map.
+Marks left from previous maps are always older than checkcount, so they are harmless.
+===================
+*/
+static void CM_BeginCheck(cmcontext_t* ctx)
+{
+	unsigned int	*check;
+	int				count = map_numBrushes + 1; // box hull
+
+	if (ctx->numBrushCheck < count)
+	{
+		check = realloc(ctx->brushCheck, count * sizeof(unsigned int));
+		if (!check)
+		{
+			Com_Error(ERR_FATAL, "%s: out of memory\n", __FUNCTION__);
+			return;
+		}
+		memset(check + ctx->numBrushCheck, 0, (count - ctx->numBrushCheck) * sizeof(unsigned int));
+		ctx->brushCheck = check;
+		ctx->numBrushCheck = count;
+	}
+
+	if (++ctx->checkcount == 0)
+	{
+		memset(ctx->brushCheck, 0, ctx->numBrushCheck * sizeof(unsigned int));
+		ctx->checkcount = 1;
+	}
+}
+
 /*
 ===================
 CM_InitBoxHull
@@ -859,6 +1025,9 @@ static void CM_InitBoxHull()
 	cplane_t	*plane;
 	cbrushside_t	*brushSide;
 
+	if (!cm_mainContext.boxBrush.numsides)
+		CM_InitContext(&cm_mainContext);
+
 	box_headnode = map_numNodes;
 	box_planes = &map_planes[map_numPlanes];
 
@@ -911,9 +1080,59 @@ static void CM_InitBoxHull()
 		plane->signbits = 0;
 		VectorClear (plane->normal);
 		plane->normal[i>>1] = -1;
-	}	
+	}
 }
 
+/*
+===================
+CM_SetBoxPlanes
+===================
+*/
+static void CM_SetBoxPlanes(cplane_t* planes, vec3_t mins, vec3_t maxs)
+{
+	planes[0].dist = maxs[0];
+	planes[1].dist = -maxs[0];
+	planes[2].dist = mins[0];
+	planes[3].dist = -mins[0];
+	planes[4].dist = maxs[1];
+	planes[5].dist = -maxs[1];
+	planes[6].dist = mins[1];
+	planes[7].dist = -mins[1];
+	planes[8].dist = maxs[2];
+	planes[9].dist = -maxs[2];
+	planes[10].dist = mins[2];
+	planes[11].dist = -mins[2];
+}
+
+/*
+===================
+CM_HeadnodeForBoxCtx
+
+Box is stored in context, the returned headnode is only valid
+for traces and point contents with the same context.
+===================
+*/
+int	CM_HeadnodeForBoxCtx(cmcontext_t* ctx, vec3_t mins, vec3_t maxs)
+{
+	int		i, side;
+	cnode_t	*node;
+
+	CM_SetBoxPlanes(ctx->boxPlanes, mins, maxs);
+
+	// same tree as in CM_InitBoxHull
+	for (i = 0; i < 6; i++)
+	{
+		side = i & 1;
+		node = &ctx->boxNodes[i];
+		node->plane = &ctx->boxPlanes[i * 2];
+		node->children[side] = -1 - emptyleaf;
+		if (i != 5)
+			node->children[side ^ 1] = box_headnode + i + 1;
+		else
+			node->children[side ^ 1] = -1 - map_numLeafs;
+	}
+	return box_headnode;
+}
 
 /*
 ===================
@@ -925,20 +1144,9 @@ BSP trees instead of being compared directly.
 */
 int	CM_HeadnodeForBox(vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
-
-	return box_headnode;
+	if (box_planes)
+		CM_SetBoxPlanes(box_planes, mins, maxs);
+	return CM_HeadnodeForBoxCtx(&cm_mainContext, mins, maxs);
 }
 
 
@@ -957,7 +1165,7 @@ static int CM_PointLeafnum_r(vec3_t p, int nodenum)
 	{
 		node = map_nodes + nodenum;
 		plane = node->plane;
-		
+
 		if (plane->type < 3)
 			d = p[plane->type] - plane->dist;
 		else
@@ -988,10 +1196,13 @@ int CM_PointLeafnum(vec3_t p)
 }
 
 
-static int		leaf_count, leaf_maxcount;
-static int		*leaf_list;
-static float	*leaf_mins, *leaf_maxs;
-static int		leaf_topnode;
+typedef struct
+{
+	int		count, maxcount;
+	int		*list;
+	float	*mins, *maxs;
+	int		topnode;
+} leafnums_t;
 
 /*
 =============
@@ -1000,7 +1211,7 @@ CM_BoxLeafnums_r
 Fills in a list of all the leafs touched
 =============
 */
-static void CM_BoxLeafnums_r(int nodenum)
+static void CM_BoxLeafnums_r(leafnums_t *ln, int nodenum)
 {
 	cplane_t	*plane;
 	cnode_t		*node;
@@ -1010,28 +1221,28 @@ static void CM_BoxLeafnums_r(int nodenum)
 	{
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (ln->count >= ln->maxcount)
 			{
 //				Com_Printf ("CM_BoxLeafnums_r: overflow\n");
 				return;
 			}
-			leaf_list[leaf_count++] = -1 - nodenum;
+			ln->list[ln->count++] = -1 - nodenum;
 			return;
 		}
-	
+
 		node = &map_nodes[nodenum];
 		plane = node->plane;
-//		s = BoxOnPlaneSide (leaf_mins, leaf_maxs, plane);
-		s = BOX_ON_PLANE_SIDE(leaf_mins, leaf_maxs, plane);
+//		s = BoxOnPlaneSide (ln->mins, ln->maxs, plane);
+		s = BOX_ON_PLANE_SIDE(ln->mins, ln->maxs, plane);
 		if (s == 1)
 			nodenum = node->children[0];
 		else if (s == 2)
 			nodenum = node->children[1];
 		else
 		{	// go down both
-			if (leaf_topnode == -1)
-				leaf_topnode = nodenum;
-			CM_BoxLeafnums_r (node->children[0]);
+			if (ln->topnode == -1)
+				ln->topnode = nodenum;
+			CM_BoxLeafnums_r (ln, node->children[0]);
 			nodenum = node->children[1];
 		}
 
@@ -1045,26 +1256,28 @@ CM_BoxLeafnums_headnode
 */
 static int CM_BoxLeafnums_headnode(vec3_t mins, vec3_t maxs, int *list, int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	leafnums_t	ln;
 
-	leaf_topnode = -1;
+	ln.list = list;
+	ln.count = 0;
+	ln.maxcount = listsize;
+	ln.mins = mins;
+	ln.maxs = maxs;
 
-	CM_BoxLeafnums_r (headnode);
+	ln.topnode = -1;
+
+	CM_BoxLeafnums_r (&ln, headnode);
 
 	if (topnode)
-		*topnode = leaf_topnode;
+		*topnode = ln.topnode;
 
-	return leaf_count;
+	return ln.count;
 }
 
 /*
 =============
 CM_BoxLeafnums
-Fills in a list of all the leafs touched
+Fills in a list of all the leafs touched, safe to call from any thread
 =============
 */
 int CM_BoxLeafnums(vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode)
@@ -1075,17 +1288,30 @@ int CM_BoxLeafnums(vec3_t mins, vec3_t maxs, int *list, int listsize, int *topno
 
 /*
 ==================
-CM_PointContents
+CM_PointContentsCtx
 Returns contents of inlinemodel at point
 ==================
 */
-int CM_PointContents(vec3_t p, int headnode)
+int CM_PointContentsCtx(cmcontext_t* ctx, vec3_t p, int headnode)
 {
-	int		l;
+	int			l, i;
+	cplane_t	*plane;
 
 	if (!map_numNodes)	// map not loaded
 		return 0;
 
+	if (headnode == box_headnode)
+	{
+		// walk box tree of this context
+		for (i = 0; i < 6; i++)
+		{
+			plane = ctx->boxNodes[i].plane;
+			if ((p[plane->type] - plane->dist < 0) == (i & 1))
+				return map_leafs[emptyleaf].contents;
+		}
+		return ctx->boxBrush.contents;
+	}
+
 	l = CM_PointLeafnum_r (p, headnode);
 
 	return map_leafs[l].contents;
@@ -1093,17 +1319,27 @@ int CM_PointContents(vec3_t p, int headnode)
 
 /*
 ==================
-CM_TransformedPointContents
+CM_PointContents
+Returns contents of inlinemodel at point
+==================
+*/
+int CM_PointContents(vec3_t p, int headnode)
+{
+	return CM_PointContentsCtx(&cm_mainContext, p, headnode);
+}
+
+/*
+==================
+CM_TransformedPointContentsCtx
 
 Handles offseting and rotation of the end points for moving and rotating entities
 ==================
 */
-int CM_TransformedPointContents(vec3_t p, int headnode, vec3_t origin, vec3_t angles)
+int CM_TransformedPointContentsCtx(cmcontext_t* ctx, vec3_t p, int headnode, vec3_t origin, vec3_t angles)
 {
 	vec3_t		p_l;
 	vec3_t		temp;
 	vec3_t		forward, right, up;
-	int			l;
 
 	// subtract origin offset
 	VectorSubtract (p, origin, p_l);
@@ -1120,9 +1356,17 @@ int CM_TransformedPointContents(vec3_t p, int headnode, vec3_t origin, vec3_t an
 		p_l[2] = DotProduct (temp, up);
 	}
 
-	l = CM_PointLeafnum_r (p_l, headnode);
+	return CM_PointContentsCtx(ctx, p_l, headnode);
+}
 
-	return map_leafs[l].contents;
+/*
+==================
+CM_TransformedPointContents
+==================
+*/
+int CM_TransformedPointContents(vec3_t p, int headnode, vec3_t origin, vec3_t angles)
+{
+	return CM_TransformedPointContentsCtx(&cm_mainContext, p, headnode, origin, angles);
 }
 
 
@@ -1137,19 +1381,24 @@ BOX TRACING
 // 1/32 epsilon to keep floating point happy
 #define DIST_EPSILON    (1 / 32.f)
 
-static vec3_t	trace_start, trace_end;
-static vec3_t	trace_mins, trace_maxs;
-static vec3_t	trace_extents;
-static trace_t	trace_trace;
-static int		trace_contents;
-static qboolean	trace_ispoint;		// optimized case
+/*
+================
+CM_BrushSides
+================
+*/
+static __inline cbrushside_t* CM_BrushSides(cmcontext_t* ctx, cbrush_t* brush)
+{
+	if (brush == &ctx->boxBrush)
+		return ctx->boxSides;
+	return &map_brushSides[brush->firstbrushside];
+}
 
 /*
 ================
 CM_ClipBoxToBrush
 ================
 */
-static void CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, trace_t *trace, cbrush_t *brush)
+static void CM_ClipBoxToBrush(cmcontext_t *ctx, vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, trace_t *trace, cbrush_t *brush)
 {
 	int			i, j;
 	cplane_t	*plane, *clipplane;
@@ -1159,7 +1408,7 @@ static void CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, tr
 	float		d1, d2;
 	qboolean	getout, startout;
 	float		f;
-	cbrushside_t	*side, *leadside;
+	cbrushside_t	*sides, *side, *leadside;
 
 	enterfrac = -1;
 	leavefrac = 1;
@@ -1174,20 +1423,20 @@ static void CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, tr
 	startout = false;
 	leadside = NULL;
 
-	for (i = 0; i < brush->numsides; i++)
+	if (brush != &ctx->boxBrush && (brush->firstbrushside + brush->numsides) > GetBSPLimit(BSP_BRUSHSIDES))
 	{
+		Com_Error(ERR_DROP, "brushside > maxbrushsides");
+	}
+	sides = CM_BrushSides(ctx, brush);
 
-		if ((brush->firstbrushside + i) >= GetBSPLimit(BSP_BRUSHSIDES))
-		{
-			Com_Error(ERR_DROP, "brushside > maxbrushsides");
-		}
-
-		side = &map_brushSides[brush->firstbrushside+i];
+	for (i = 0; i < brush->numsides; i++)
+	{
+		side = &sides[i];
 		plane = side->plane;
 
 		// FIXME: special case for axial
 
-		if (!trace_ispoint)
+		if (!ctx->ispoint)
 		{	// general box case
 
 			// push the plane out apropriately for mins/maxs
@@ -1246,7 +1495,7 @@ static void CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, tr
 	}
 
 	if (!startout)
-	{	
+	{
 		// original point was inside brush
 		trace->startsolid = true;
 		if (!getout)
@@ -1276,22 +1525,23 @@ static void CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2, tr
 CM_TestBoxInBrush
 ================
 */
-static void CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1, trace_t *trace, cbrush_t *brush)
+static void CM_TestBoxInBrush(cmcontext_t *ctx, vec3_t mins, vec3_t maxs, vec3_t p1, trace_t *trace, cbrush_t *brush)
 {
 	int			i, j;
 	cplane_t	*plane;
 	float		dist;
 	vec3_t		ofs;
 	float		d1;
-	cbrushside_t	*side;
+	cbrushside_t	*sides;
 
 	if (!brush->numsides)
 		return;
 
+	sides = CM_BrushSides(ctx, brush);
+
 	for (i = 0; i < brush->numsides; i++)
 	{
-		side = &map_brushSides[brush->firstbrushside+i];
-		plane = side->plane;
+		plane = sides[i].plane;
 
 		// FIXME: special case for axial
 		// general box case
@@ -1328,7 +1578,7 @@ static void CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1, trace_t *trac
 CM_TraceToLeaf
 ================
 */
-static void CM_TraceToLeaf(int leafnum)
+static void CM_TraceToLeaf(cmcontext_t *ctx, int leafnum)
 {
 	int			k;
 	int			brushnum;
@@ -1336,21 +1586,30 @@ static void CM_TraceToLeaf(int leafnum)
 	cbrush_t	*b;
 
 	leaf = &map_leafs[leafnum];
-	if ( !(leaf->contents & trace_contents))
+	if ( !(leaf->contents & ctx->contents))
 		return;
+
+	if (leaf == box_leaf)
+	{
+		// box hull of this context
+		if (ctx->boxBrush.contents & ctx->contents)
+			CM_ClipBoxToBrush (ctx, ctx->mins, ctx->maxs, ctx->start, ctx->end, &ctx->trace, &ctx->boxBrush);
+		return;
+	}
+
 	// trace line against all brushes in the leaf
 	for (k=0 ; k<leaf->numleafbrushes ; k++)
 	{
 		brushnum = map_leafBrushes[leaf->firstleafbrush+k];
 		b = &map_brushes[brushnum];
-		if (b->checkcount == checkcount)
+		if (ctx->brushCheck[brushnum] == ctx->checkcount)
 			continue;	// already checked this brush in another leaf
-		b->checkcount = checkcount;
+		ctx->brushCheck[brushnum] = ctx->checkcount;
 
-		if ( !(b->contents & trace_contents))
+		if ( !(b->contents & ctx->contents))
 			continue;
-		CM_ClipBoxToBrush (trace_mins, trace_maxs, trace_start, trace_end, &trace_trace, b);
-		if (!trace_trace.fraction)
+		CM_ClipBoxToBrush (ctx, ctx->mins, ctx->maxs, ctx->start, ctx->end, &ctx->trace, b);
+		if (!ctx->trace.fraction)
 			return;
 	}
 
@@ -1362,7 +1621,7 @@ static void CM_TraceToLeaf(int leafnum)
 CM_TestInLeaf
 ================
 */
-static void CM_TestInLeaf(int leafnum)
+static void CM_TestInLeaf(cmcontext_t *ctx, int leafnum)
 {
 	int			k;
 	int			brushnum;
@@ -1370,21 +1629,21 @@ static void CM_TestInLeaf(int leafnum)
 	cbrush_t	*b;
 
 	leaf = &map_leafs[leafnum];
-	if ( !(leaf->contents & trace_contents))
+	if ( !(leaf->contents & ctx->contents))
 		return;
 	// trace line against all brushes in the leaf
 	for (k=0 ; k<leaf->numleafbrushes ; k++)
 	{
 		brushnum = map_leafBrushes[leaf->firstleafbrush+k];
 		b = &map_brushes[brushnum];
-		if (b->checkcount == checkcount)
+		if (ctx->brushCheck[brushnum] == ctx->checkcount)
 			continue;	// already checked this brush in another leaf
-		b->checkcount = checkcount;
+		ctx->brushCheck[brushnum] = ctx->checkcount;
 
-		if ( !(b->contents & trace_contents))
+		if ( !(b->contents & ctx->contents))
 			continue;
-		CM_TestBoxInBrush (trace_mins, trace_maxs, trace_start, &trace_trace, b);
-		if (!trace_trace.fraction)
+		CM_TestBoxInBrush (ctx, ctx->mins, ctx->maxs, ctx->start, &ctx->trace, b);
+		if (!ctx->trace.fraction)
 			return;
 	}
 
@@ -1396,7 +1655,7 @@ static void CM_TestInLeaf(int leafnum)
 CM_RecursiveHullCheck
 ==================
 */
-static void CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void CM_RecursiveHullCheck(cmcontext_t *ctx, int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 {
 	cnode_t		*node;
 	cplane_t	*plane;
@@ -1408,13 +1667,13 @@ static void CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3
 	int			side;
 	float		midf;
 
-	if (trace_trace.fraction <= p1f)
+	if (ctx->trace.fraction <= p1f)
 		return;		// already hit something nearer
 
 	// if < 0, we are in a leaf node
 	if (num < 0)
 	{
-		CM_TraceToLeaf (-1-num);
+		CM_TraceToLeaf (ctx, -1-num);
 		return;
 	}
 
@@ -1422,43 +1681,46 @@ static void CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3
 	// find the point distances to the seperating plane
 	// and the offset for the size of the box
 	//
-	node = map_nodes + num;
+	if (num >= box_headnode)
+		node = &ctx->boxNodes[num - box_headnode];
+	else
+		node = map_nodes + num;
 	plane = node->plane;
 
 	if (plane->type < 3)
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = ctx->extents[plane->type];
 	}
 	else
 	{
 		t1 = DotProduct (plane->normal, p1) - plane->dist;
 		t2 = DotProduct (plane->normal, p2) - plane->dist;
-		if (trace_ispoint)
+		if (ctx->ispoint)
 			offset = 0;
 		else
-			offset = fabs(trace_extents[0]*plane->normal[0]) +
-				fabs(trace_extents[1]*plane->normal[1]) +
-				fabs(trace_extents[2]*plane->normal[2]);
+			offset = fabs(ctx->extents[0]*plane->normal[0]) +
+				fabs(ctx->extents[1]*plane->normal[1]) +
+				fabs(ctx->extents[2]*plane->normal[2]);
 	}
 
 
 #if 0
-CM_RecursiveHullCheck (node->children[0], p1f, p2f, p1, p2);
-CM_RecursiveHullCheck (node->children[1], p1f, p2f, p1, p2);
+CM_RecursiveHullCheck (ctx, node->children[0], p1f, p2f, p1, p2);
+CM_RecursiveHullCheck (ctx, node->children[1], p1f, p2f, p1, p2);
 return;
 #endif
 
 	// see which sides we need to consider
 	if (t1 >= offset && t2 >= offset)
 	{
-		CM_RecursiveHullCheck (node->children[0], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck (ctx, node->children[0], p1f, p2f, p1, p2);
 		return;
 	}
 	if (t1 < -offset && t2 < -offset)
 	{
-		CM_RecursiveHullCheck (node->children[1], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck (ctx, node->children[1], p1f, p2f, p1, p2);
 		return;
 	}
 
@@ -1489,12 +1751,12 @@ return;
 		frac = 0;
 	if (frac > 1)
 		frac = 1;
-		
+
 	midf = p1f + (p2f - p1f)*frac;
 	for (i=0 ; i<3 ; i++)
 		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
 
-	CM_RecursiveHullCheck (node->children[side], p1f, midf, p1, mid);
+	CM_RecursiveHullCheck (ctx, node->children[side], p1f, midf, p1, mid);
 
 
 	// go past the node
@@ -1502,12 +1764,12 @@ return;
 		frac2 = 0;
 	if (frac2 > 1)
 		frac2 = 1;
-		
+
 	midf = p1f + (p2f - p1f)*frac2;
 	for (i=0 ; i<3 ; i++)
 		mid[i] = p1[i] + frac2*(p2[i] - p1[i]);
 
-	CM_RecursiveHullCheck (node->children[side^1], midf, p2f, mid, p2);
+	CM_RecursiveHullCheck (ctx, node->children[side^1], midf, p2f, mid, p2);
 }
 
 
@@ -1516,30 +1778,30 @@ return;
 
 /*
 ==================
-CM_BoxTrace
+CM_BoxTraceCtx
 ==================
 */
-trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask)
+trace_t CM_BoxTraceCtx(cmcontext_t* ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask)
 {
 	int		i;
 
-	checkcount++;		// for multi-check avoidance
-
 	c_traces++;			// for statistics, may be zeroed
 
 	// fill in a default trace
-	memset (&trace_trace, 0, sizeof(trace_trace));
-	trace_trace.fraction = 1;
-	trace_trace.surface = &(nullsurface.c);
+	memset (&ctx->trace, 0, sizeof(ctx->trace));
+	ctx->trace.fraction = 1;
+	ctx->trace.surface = &(nullsurface.c);
 
 	if (!map_numNodes)	// map not loaded
-		return trace_trace;
+		return ctx->trace;
 
-	trace_contents = brushmask;
-	VectorCopy (start, trace_start);
-	VectorCopy (end, trace_end);
-	VectorCopy (mins, trace_mins);
-	VectorCopy (maxs, trace_maxs);
+	CM_BeginCheck(ctx);		// for multi-check avoidance
+
+	ctx->contents = brushmask;
+	VectorCopy (start, ctx->start);
+	VectorCopy (end, ctx->end);
+	VectorCopy (mins, ctx->mins);
+	VectorCopy (maxs, ctx->maxs);
 
 	//
 	// check for position test special case
@@ -1551,6 +1813,15 @@ trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int head
 		vec3_t	c1, c2;
 		int		topnode;
 
+		if (headnode == box_headnode)
+		{
+			// box hull of this context
+			if (ctx->boxBrush.contents & brushmask)
+				CM_TestBoxInBrush (ctx, ctx->mins, ctx->maxs, ctx->start, &ctx->trace, &ctx->boxBrush);
+			VectorCopy (start, ctx->trace.endpos);
+			return ctx->trace;
+		}
+
 		VectorAdd (start, mins, c1);
 		VectorAdd (start, maxs, c2);
 		for (i=0 ; i<3 ; i++)
@@ -1562,12 +1833,12 @@ trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int head
 		num_leafs = CM_BoxLeafnums_headnode (c1, c2, leafs, 1024, headnode, &topnode);
 		for (i=0 ; i<num_leafs ; i++)
 		{
-			CM_TestInLeaf (leafs[i]);
-			if (trace_trace.allsolid)
+			CM_TestInLeaf (ctx, leafs[i]);
+			if (ctx->trace.allsolid)
 				break;
 		}
-		VectorCopy (start, trace_trace.endpos);
-		return trace_trace;
+		VectorCopy (start, ctx->trace.endpos);
+		return ctx->trace;
 	}
 
 	//
@@ -1576,32 +1847,42 @@ trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int head
 	if (mins[0] == 0 && mins[1] == 0 && mins[2] == 0
 		&& maxs[0] == 0 && maxs[1] == 0 && maxs[2] == 0)
 	{
-		trace_ispoint = true;
-		VectorClear (trace_extents);
+		ctx->ispoint = true;
+		VectorClear (ctx->extents);
 	}
 	else
 	{
-		trace_ispoint = false;
-		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		ctx->ispoint = false;
+		ctx->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		ctx->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		ctx->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	//
 	// general sweeping through world
 	//
-	CM_RecursiveHullCheck (headnode, 0, 1, start, end);
+	CM_RecursiveHullCheck (ctx, headnode, 0, 1, start, end);
 
-	if (trace_trace.fraction == 1)
+	if (ctx->trace.fraction == 1)
 	{
-		VectorCopy (end, trace_trace.endpos);
+		VectorCopy (end, ctx->trace.endpos);
 	}
 	else
 	{
 		for (i = 0; i < 3; i++)
-			trace_trace.endpos[i] = start[i] + trace_trace.fraction * (end[i] - start[i]);
+			ctx->trace.endpos[i] = start[i] + ctx->trace.fraction * (end[i] - start[i]);
 	}
-	return trace_trace;
+	return ctx->trace;
+}
+
+/*
+==================
+CM_BoxTrace
+==================
+*/
+trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask)
+{
+	return CM_BoxTraceCtx(&cm_mainContext, start, end, mins, maxs, headnode, brushmask);
 }
 
 
@@ -1611,12 +1892,12 @@ trace_t CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int head
 
 /*
 ==================
-CM_TransformedBoxTrace
+CM_TransformedBoxTraceCtx
 
 Handles offseting and rotation of the end points for moving and rotating entities
 ==================
 */
-trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask, vec3_t origin, vec3_t angles)
+trace_t CM_TransformedBoxTraceCtx(cmcontext_t* ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask, vec3_t origin, vec3_t angles)
 {
 	trace_t		trace;
 	vec3_t		start_l, end_l;
@@ -1630,7 +1911,7 @@ trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t max
 	VectorSubtract (end, origin, end_l);
 
 	// rotate start and end into the models frame of reference
-	if (headnode != box_headnode && 
+	if (headnode != box_headnode &&
 	(angles[0] || angles[1] || angles[2]) )
 		rotated = true;
 	else
@@ -1652,7 +1933,7 @@ trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t max
 	}
 
 	// sweep the box through the model
-	trace = CM_BoxTrace (start_l, end_l, mins, maxs, headnode, brushmask);
+	trace = CM_BoxTraceCtx (ctx, start_l, end_l, mins, maxs, headnode, brushmask);
 
 	if (rotated && trace.fraction != 1.0)
 	{
@@ -1677,6 +1958,16 @@ trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t max
 #pragma optimize( "", on )
 #endif
 
+/*
+==================
+CM_TransformedBoxTrace
+==================
+*/
+trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headnode, int brushmask, vec3_t origin, vec3_t angles)
+{
+	return CM_TransformedBoxTraceCtx(&cm_mainContext, start, end, mins, maxs, headnode, brushmask, origin, angles);
+}
+
 
 
 /*
@@ -1708,7 +1999,7 @@ static void CM_DecompressVis(byte *in, byte *out)
 			*out_p++ = 0xff;
 			row--;
 		}
-		return;		
+		return;
 	}
 
 	do
@@ -1718,7 +2009,7 @@ static void CM_DecompressVis(byte *in, byte *out)
 			*out_p++ = *in++;
 			continue;
 		}
-	
+
 		c = in[1];
 		in += 2;
 		if ((out_p - out) + c > row)
@@ -1734,20 +2025,205 @@ static void CM_DecompressVis(byte *in, byte *out)
 	} while (out_p - out < row);
 }
 
-static byte pvsrow[MAX_MAP_LEAFS/8];
-static byte phsrow[MAX_MAP_LEAFS/8];
+/*
+===================
+CM_ClusterBytes
+
+Size of a decompressed PVS/PHS row for current map
+===================
+*/
+int CM_ClusterBytes()
+{
+	return (map_numLeafClusters + 7) >> 3;
+}
+
+/*
+===================
+CM_DecompressClusterPVS
+
+Writes PVS of a cluster to out which must hold CM_ClusterBytes() bytes
+===================
+*/
+void CM_DecompressClusterPVS(int cluster, byte *out)
+{
+	if (cluster == -1)
+		memset (out, 0, CM_ClusterBytes());
+	else
+		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][DVIS_PVS], out);
+}
 
 /*
 ===================
-CM_ClusterPVS
+CM_DecompressClusterPHS
+
+Writes PHS of a cluster to out which must hold CM_ClusterBytes() bytes
 ===================
 */
-byte *CM_ClusterPVS(int cluster)
+void CM_DecompressClusterPHS(int cluster, byte *out)
 {
 	if (cluster == -1)
-		memset (pvsrow, 0, (map_numLeafClusters+7)>>3);
+		memset (out, 0, CM_ClusterBytes());
+	else
+		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][DVIS_PHS], out);
+}
+
+static byte pvsrow[MAX_MAP_LEAFS_QBSP/8];
+static byte phsrow[MAX_MAP_LEAFS_QBSP/8];
+
+/*
+	Decompressed rows are kept in a cache of cm_viscache megabytes, when it can
+	hold every cluster of the map it is never evicted, on bigger maps least
+	recently used rows are replaced (clock). Rows returned last by CM_ClusterPVS
+	and CM_ClusterPHS are never replaced, so they stay valid until the next call
+	like the static rows did. The cache is for the main thread only.
+*/
+typedef struct
+{
+	qboolean	checked;		// rows allocated, or cache disabled
+	byte		*rows;			// numSlots rows of rowBytes
+	int			rowBytes;		// CM_ClusterBytes() padded for word-wide operations
+	int			numSlots;
+	int			*slotRow;		// row in slot (cluster * 2 + DVIS_PVS/PHS) or -1
+	int			*rowSlot;		// slot holding row or -1
+	byte		*slotUsed;		// clock reference bits
+	int			hand;
+	int			recent[2];		// slots last returned for DVIS_PVS and DVIS_PHS
+	int			hits, misses;
+} cvischache_t;
+
+static cvischache_t visCache;
+static byte visrow[MAX_MAP_LEAFS_QBSP/8];	// CM_ClusterVisible without cache
+
+/*
+===================
+CM_FreeVisCache
+===================
+*/
+static void CM_FreeVisCache()
+{
+	if (visCache.rows)
+	{
+		Z_Free(visCache.rows);
+		Z_Free(visCache.slotRow);
+		Z_Free(visCache.rowSlot);
+		Z_Free(visCache.slotUsed);
+	}
+	memset(&visCache, 0, sizeof(visCache));
+}
+
+/*
+===================
+CM_InitVisCache
+===================
+*/
+static void CM_InitVisCache()
+{
+	int		numRows, i;
+	double	cap;
+
+	visCache.checked = true;
+
+	if (!cm_viscache || cm_viscache->value <= 0 || !map_numNodes)
+		return;
+
+	visCache.rowBytes = (CM_ClusterBytes() + 15) & ~15;
+	numRows = map_numLeafClusters * 2;
+
+	cap = cm_viscache->value * 1024.0 * 1024.0 / visCache.rowBytes;
+	visCache.numSlots = (cap >= numRows) ? numRows : (int)cap;
+	if (visCache.numSlots < 8)
+	{
+		visCache.numSlots = 0;
+		return; // not worth it
+	}
+
+	visCache.rows = Z_Malloc(visCache.numSlots * visCache.rowBytes);
+	visCache.slotRow = Z_Malloc(visCache.numSlots * sizeof(int));
+	visCache.slotUsed = Z_Malloc(visCache.numSlots);
+	visCache.rowSlot = Z_Malloc(numRows * sizeof(int));
+
+	for (i = 0; i < visCache.numSlots; i++)
+		visCache.slotRow[i] = -1;
+	for (i = 0; i < numRows; i++)
+		visCache.rowSlot[i] = -1;
+	visCache.recent[DVIS_PVS] = visCache.recent[DVIS_PHS] = -1;
+
+	Com_DPrintf(DP_ALL, "Vis cache: %i of %i rows, %i KB\n", visCache.numSlots, numRows, (visCache.numSlots * visCache.rowBytes) >> 10);
+}
+
+/*
+===================
+CM_CachedVisRow
+
+Returns decompressed row from cache, or NULL when cache is disabled.
+keep protects the row until next call with keep for the same type.
+===================
+*/
+static byte* CM_CachedVisRow(int cluster, int type, qboolean keep)
+{
+	int		row, slot;
+
+	if (cm_viscache && cm_viscache->modified)
+	{
+		cm_viscache->modified = false;
+		CM_FreeVisCache();
+	}
+	if (!visCache.checked)
+		CM_InitVisCache();
+	if (!visCache.rows || cluster < 0 || cluster >= map_numLeafClusters)
+		return NULL;
+
+	row = cluster * 2 + type;
+	slot = visCache.rowSlot[row];
+	if (slot != -1)
+	{
+		visCache.hits++;
+	}
 	else
-		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][DVIS_PVS], pvsrow);
+	{
+		visCache.misses++;
+
+		// find a slot which was not used since last pass
+		while (1)
+		{
+			slot = visCache.hand;
+			if (++visCache.hand == visCache.numSlots)
+				visCache.hand = 0;
+
+			if (slot == visCache.recent[DVIS_PVS] || slot == visCache.recent[DVIS_PHS])
+				continue;
+			if (!visCache.slotUsed[slot])
+				break;
+			visCache.slotUsed[slot] = 0;
+		}
+
+		if (visCache.slotRow[slot] != -1)
+			visCache.rowSlot[visCache.slotRow[slot]] = -1;
+		visCache.slotRow[slot] = row;
+		visCache.rowSlot[row] = slot;
+
+		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][type], visCache.rows + slot * visCache.rowBytes);
+	}
+
+	visCache.slotUsed[slot] = 1;
+	if (keep)
+		visCache.recent[type] = slot;
+	return visCache.rows + slot * visCache.rowBytes;
+}
+
+/*
+===================
+CM_ClusterPVS
+===================
+*/
+byte *CM_ClusterPVS(int cluster)
+{
+	byte *row;
+
+	if (cluster != -1 && (row = CM_CachedVisRow(cluster, DVIS_PVS, true)) != NULL)
+		return row;
+
+	CM_DecompressClusterPVS (cluster, pvsrow);
 	return pvsrow;
 }
 
@@ -1758,13 +2234,85 @@ CM_ClusterPHS
 */
 byte *CM_ClusterPHS(int cluster)
 {
-	if (cluster == -1)
-		memset (phsrow, 0, (map_numLeafClusters+7)>>3);
-	else
-		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][DVIS_PHS], phsrow);
+	byte *row;
+
+	if (cluster != -1 && (row = CM_CachedVisRow(cluster, DVIS_PHS, true)) != NULL)
+		return row;
+
+	CM_DecompressClusterPHS (cluster, phsrow);
 	return phsrow;
 }
 
+/*
+===================
+CM_ClusterVisible
+
+Returns true if cluster other is in PVS (or PHS) of cluster,
+doesn't invalidate rows returned by CM_ClusterPVS/PHS.
+===================
+*/
+qboolean CM_ClusterVisible(int cluster, int other, qboolean phs)
+{
+	byte	*row;
+	int		type = phs ? DVIS_PHS : DVIS_PVS;
+
+	if (cluster < 0 || other < 0 || cluster >= map_numLeafClusters || other >= map_numLeafClusters)
+		return false;
+
+	row = CM_CachedVisRow(cluster, type, false);
+	if (!row)
+	{
+		row = visrow;
+		CM_DecompressVis (map_visibilityData + map_vis->bitofs[cluster][type], row);
+	}
+	return (row[other >> 3] & (1 << (other & 7))) != 0;
+}
+
+/*
+===================
+CM_VisCacheStats_f
+===================
+*/
+void CM_VisCacheStats_f()
+{
+	if (!visCache.rows)
+	{
+		Com_Printf("Vis cache is not in use (cm_viscache %s).\n", cm_viscache ? cm_viscache->string : "0");
+		return;
+	}
+
+	Com_Printf("Vis cache: %i slots of %i bytes (%i KB) for %i rows\n", visCache.numSlots, visCache.rowBytes,
+		(visCache.numSlots * visCache.rowBytes) >> 10, map_numLeafClusters * 2);
+	Com_Printf("%i hits, %i misses\n", visCache.hits, visCache.misses);
+}
+
+/*
+===================
+CM_OrVisRows
+
+dst |= src for bytes of a decompressed row
+===================
+*/
+void CM_OrVisRows(byte *dst, const byte *src, int bytes)
+{
+	int		i = 0;
+
+#ifdef CM_USE_SSE2
+	for (; i + 16 <= bytes; i += 16)
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_loadu_si128((const __m128i*)(dst + i)), _mm_loadu_si128((const __m128i*)(src + i))));
+#else
+	for (; i + 8 <= bytes; i += 8)
+	{
+		unsigned long long a, b;
+		memcpy(&a, dst + i, 8);
+		memcpy(&b, src + i, 8);
+		a |= b;
+		memcpy(dst + i, &a, 8);
+	}
+#endif
+	for (; i < bytes; i++)
+		dst[i] |= src[i];
+}
 
 /*
 ===============================================================================
@@ -27,6 +27,8 @@ cmodel_t* CM_InlineModel(const char* name); // *1, *2, etc
 
 int			CM_NumClusters();
 int			CM_NumInlineModels();
+int			CM_NumSurfaceInfos();
+csurface_t* CM_SurfaceInfo(int index);
 char* CM_EntityString();
 
 // creates a clipping hull for an arbitrary box
@@ -46,8 +48,13 @@ trace_t		CM_TransformedBoxTrace(vec3_t start, vec3_t end,
 	int headnode, int brushmask,
 	vec3_t origin, vec3_t angles);
 
+// returned rows are read only and valid until next call for the same type
 byte* CM_ClusterPVS(int cluster);
 byte* CM_ClusterPHS(int cluster);
+qboolean	CM_ClusterVisible(int cluster, int other, qboolean phs);
+
+void		CM_OrVisRows(byte* dst, const byte* src, int bytes);
+void		CM_VisCacheStats_f();
 
 int			CM_PointLeafnum(vec3_t p);
 
@@ -68,4 +75,31 @@ qboolean	CM_HeadnodeVisible(int headnode, byte* visbits);
 void		CM_WritePortalState(FILE* f);
 void		CM_ReadPortalState(FILE* f);
 
+//
+// reentrant versions of the queries above, each thread must use its own context
+//
+typedef struct cmcontext_s cmcontext_t;
+
+cmcontext_t* CM_NewContext();
+void		CM_FreeContext(cmcontext_t* ctx);
+
+int			CM_HeadnodeForBoxCtx(cmcontext_t* ctx, vec3_t mins, vec3_t maxs);
+int			CM_PointContentsCtx(cmcontext_t* ctx, vec3_t p, int headnode);
+int			CM_TransformedPointContentsCtx(cmcontext_t* ctx, vec3_t p, int headnode, vec3_t origin, vec3_t angles);
+
+trace_t		CM_BoxTraceCtx(cmcontext_t* ctx, vec3_t start, vec3_t end,
+	vec3_t mins, vec3_t maxs,
+	int headnode, int brushmask);
+
+trace_t		CM_TransformedBoxTraceCtx(cmcontext_t* ctx, vec3_t start, vec3_t end,
+	vec3_t mins, vec3_t maxs,
+	int headnode, int brushmask,
+	vec3_t origin, vec3_t angles);
+
+// decompress into caller's buffer of CM_ClusterBytes() bytes,
+// CM_PointLeafnum, CM_BoxLeafnums and CM_Leaf* need no context
+int			CM_ClusterBytes();
+void		CM_DecompressClusterPVS(int cluster, byte* out);
+void		CM_DecompressClusterPHS(int cluster, byte* out);
+
 #endif /*_PRAGMA_CMODEL_H_*/
@@ -9,6 +9,7 @@ See the attached GNU General Public License v2 for more details.
 */
 
 #include "pragma.h"
+#include <ctype.h>
 
 
 /*
@@ -28,6 +29,9 @@ typedef struct
 {
 	char	name[MAX_QPATH];
 	int		filepos, filelen;
+	int		complen;		// bytes stored in pack, same as filelen unless compressed
+	int		compression;	// ZIP_METHOD_STORED or ZIP_METHOD_DEFLATE
+	unsigned	crc;		// CRC32 of uncompressed data, only for .pk3
 } packfile_t;
 
 typedef struct pack_s
@@ -36,6 +40,8 @@ typedef struct pack_s
 	FILE	*handle;
 	int		numfiles;
 	packfile_t	*files;
+	byte	*mapped;		// whole pak mapped read only, NULL if mapping failed
+	int		mappedsize;
 } pack_t;
 
 char	fs_gamedir[MAX_OSPATH];
@@ -63,6 +69,15 @@ typedef struct searchpath_s
 static searchpath_t	*fs_searchpaths;
 static searchpath_t	*fs_base_searchpaths;	// without gamedirs
 
+cvar_t	*fs_hashlookups;
+cvar_t	*fs_mmap;
+
+int file_from_pak = 0;
+
+// pack entry found by the last FS_FindFile, NULL for loose files
+static pack_t		*fs_foundpack;
+static packfile_t	*fs_foundpakfile;
+
 
 /*
 
@@ -105,6 +120,8 @@ Creates any directories needed to store the given filename
 void FS_CreatePath(const char *path)
 {
 	char	*ofs;
+
+	FS_FlushLookupCache (); // file is about to be written
 	
 	for (ofs = (char*)(path+1) ; *ofs ; ofs++)
 	{
@@ -152,19 +169,391 @@ int	Developer_searchpath ()
 }
 
 
+/*
+=============================================================================
+
+HASHED FILE INDEX
+
+Files of all search paths are kept in a case insensitive hash table so
+FS_FOpenFile doesn't walk pack directories and probe the disk for every
+search path. Pack directories are indexed as they are, loose directories
+are scanned once. Names missing from the index are probed on disk in case
+they were written after the scan and a miss is remembered until
+FS_FlushLookupCache. The index is rebuilt on the first lookup after the
+search path changes.
+
+=============================================================================
+*/
+
+#define FS_HASH_SIZE		4096	// must be power of two
+#define FS_SCAN_DEPTH		8		// subdirectories scanned in loose directories
+
+typedef struct
+{
+	char			name[MAX_QPATH];
+	searchpath_t	*search;	// NULL if file was not found
+	int				packindex;	// index to search->pack->files or -1 for loose file
+	int				checked;	// fs_lookupcount of the last miss
+	int				next;		// next entry in hash chain or -1
+} fsentry_t;
+
+static int			fs_hash[FS_HASH_SIZE];
+static fsentry_t	*fs_entries;
+static int			fs_numentries, fs_maxentries;
+static qboolean		fs_indexdirty = true;
+static int			fs_lookupcount = 1;	// bumped to forget missing files
+
+char **FS_ListFiles(char *findname, int *numfiles, unsigned musthave, unsigned canthave);
+
+/*
+================
+FS_HashName
+
+Case insensitive, treats both slashes the same
+================
+*/
+static unsigned FS_HashName (const char *name)
+{
+	unsigned	hash;
+	int			c;
+
+	hash = 0;
+	while ((c = *name++) != 0)
+	{
+		if (c == '\\')
+			c = '/';
+		hash = hash * 31 + tolower(c);
+	}
+	return hash & (FS_HASH_SIZE - 1);
+}
+
+static qboolean FS_NamesEqual (const char *a, const char *b)
+{
+	int		ca, cb;
+
+	do
+	{
+		ca = tolower(*a++);
+		cb = tolower(*b++);
+		if (ca == '\\')
+			ca = '/';
+		if (cb == '\\')
+			cb = '/';
+		if (ca != cb)
+			return false;
+	} while (ca);
+
+	return true;
+}
+
+static fsentry_t *FS_FindEntry (const char *name)
+{
+	int		i;
+
+	for (i = fs_hash[FS_HashName(name)]; i != -1; i = fs_entries[i].next)
+	{
+		if (FS_NamesEqual(fs_entries[i].name, name))
+			return &fs_entries[i];
+	}
+	return NULL;
+}
+
+/*
+================
+FS_AddEntry
+
+Returned pointer is valid until next FS_AddEntry
+================
+*/
+static fsentry_t *FS_AddEntry (const char *name, searchpath_t *search, int packindex)
+{
+	fsentry_t	*entry, *newentries;
+	unsigned	hash;
+
+	if (strlen(name) >= MAX_QPATH)
+		return NULL;
+
+	if (fs_numentries == fs_maxentries)
+	{
+		fs_maxentries = fs_maxentries ? fs_maxentries * 2 : 4096;
+		newentries = Z_Malloc (fs_maxentries * sizeof(fsentry_t));
+		if (fs_entries)
+		{
+			memcpy (newentries, fs_entries, fs_numentries * sizeof(fsentry_t));
+			Z_Free (fs_entries);
+		}
+		fs_entries = newentries;
+	}
+
+	hash = FS_HashName(name);
+	entry = &fs_entries[fs_numentries];
+	strcpy (entry->name, name);
+	entry->search = search;
+	entry->packindex = packindex;
+	entry->checked = 0;
+	entry->next = fs_hash[hash];
+	fs_hash[hash] = fs_numentries++;
+
+	return entry;
+}
+
+/*
+================
+FS_IndexDirectory
+
+Adds files of a loose directory and its subdirectories to the index
+================
+*/
+static void FS_IndexDirectory (searchpath_t *search, const char *dir, int depth)
+{
+	char	findname[MAX_OSPATH];
+	char	**list;
+	int		i, count;
+	size_t	baselen;
+
+	baselen = strlen(search->filename) + 1;
+	Com_sprintf (findname, sizeof(findname), "%s/*", dir);
+
+	if ((list = FS_ListFiles(findname, &count, 0, SFF_SUBDIR | SFF_HIDDEN | SFF_SYSTEM)) != NULL)
+	{
+		for (i = 0; i < count - 1; i++)
+		{
+			if (strlen(list[i]) > baselen && !FS_FindEntry(list[i] + baselen))
+				FS_AddEntry (list[i] + baselen, search, -1);
+			free (list[i]);
+		}
+		free (list);
+	}
+
+	if (depth >= FS_SCAN_DEPTH)
+		return;
+
+	if ((list = FS_ListFiles(findname, &count, SFF_SUBDIR, SFF_HIDDEN | SFF_SYSTEM)) != NULL)
+	{
+		for (i = 0; i < count - 1; i++)
+		{
+			FS_IndexDirectory (search, list[i], depth + 1);
+			free (list[i]);
+		}
+		free (list);
+	}
+}
+
+/*
+================
+FS_BuildIndex
+
+Indexes search paths in order so the first file found wins just like
+walking the search path
+================
+*/
+static void FS_BuildIndex (void)
+{
+	searchpath_t	*search;
+	unsigned long long	t;
+	int				i;
+
+	t = Sys_Microseconds();
+
+	fs_numentries = 0;
+	memset (fs_hash, -1, sizeof(fs_hash));
+
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		if (search->pack)
+		{
+			for (i = 0; i < search->pack->numfiles; i++)
+			{
+				if (!FS_FindEntry(search->pack->files[i].name))
+					FS_AddEntry (search->pack->files[i].name, search, i);
+			}
+		}
+		else
+		{
+			FS_IndexDirectory (search, search->filename, 0);
+		}
+	}
+
+	fs_indexdirty = false;
+	Com_DPrintf (DP_FS, "Indexed %i files in %.2f ms\n", fs_numentries, (Sys_Microseconds() - t) / 1000.0f);
+}
+
+/*
+================
+FS_FlushLookupCache
+
+Forgets files which were not found, call after writing files to the search path
+================
+*/
+void FS_FlushLookupCache (void)
+{
+	fs_lookupcount++;
+}
+
+/*
+================
+FS_FOpenIndexedFile
+
+FS_FOpenFile using the index
+================
+*/
+static int FS_FOpenIndexedFile (const char *filename, FILE **file)
+{
+	searchpath_t	*search;
+	fsentry_t		*entry;
+	packfile_t		*pakfile;
+	char			netpath[MAX_OSPATH];
+
+	if (fs_indexdirty)
+		FS_BuildIndex ();
+
+	entry = FS_FindEntry(filename);
+	if (entry && entry->search)
+	{
+		if (entry->packindex >= 0)
+		{
+			file_from_pak = 1;
+			pakfile = &entry->search->pack->files[entry->packindex];
+			fs_foundpack = entry->search->pack;
+			fs_foundpakfile = pakfile;
+			Com_DPrintf (DP_FS, "PackFile: %s : %s\n", entry->search->pack->filename, filename);
+		// open a new file on the pakfile
+			*file = fopen (entry->search->pack->filename, "rb");
+			if (!*file)
+				Com_Error (ERR_FATAL, "Couldn't reopen %s", entry->search->pack->filename);
+			fseek (*file, pakfile->filepos, SEEK_SET);
+			return pakfile->filelen;
+		}
+
+		Com_sprintf (netpath, sizeof(netpath), "%s/%s", entry->search->filename, entry->name);
+		*file = fopen (netpath, "rb");
+		if (*file)
+		{
+			Com_DPrintf (DP_FS, "FindFile: %s\n", netpath);
+			return FS_filelength (*file);
+		}
+
+		// removed since it was indexed, a file further down the path may be used now
+		fs_indexdirty = true;
+		*file = NULL;
+		return -2;
+	}
+
+	if (entry && entry->checked == fs_lookupcount)
+	{
+		*file = NULL;
+		return -1; // known to be missing
+	}
+
+	// may have been written after the directories were scanned
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		if (search->pack)
+			continue;
+
+		Com_sprintf (netpath, sizeof(netpath), "%s/%s", search->filename, filename);
+		*file = fopen (netpath, "rb");
+		if (!*file)
+			continue;
+
+		if (entry)
+		{
+			entry->search = search;
+			entry->packindex = -1;
+		}
+		else
+			FS_AddEntry (filename, search, -1);
+
+		Com_DPrintf (DP_FS, "FindFile: %s\n", netpath);
+		return FS_filelength (*file);
+	}
+
+	if (!entry)
+		entry = FS_AddEntry (filename, NULL, -1);
+	if (entry)
+		entry->checked = fs_lookupcount;
+
+	Com_DPrintf (DP_FS, "FindFile: can't find %s\n", filename);
+
+	*file = NULL;
+	return -1;
+}
+
+/*
+================
+FS_LookupIndex
+
+Index entry for a file, NULL when the index is not used for it
+================
+*/
+static fsentry_t *FS_LookupIndex (const char *filename)
+{
+	if (!fs_hashlookups || !fs_hashlookups->value || fs_links || strlen(filename) >= MAX_QPATH)
+		return NULL;
+
+	if (fs_indexdirty)
+		FS_BuildIndex ();
+
+	return FS_FindEntry(filename);
+}
+
+/*
+================
+FS_IndexedFileLength
+
+Length of a file in a pack or -1 when it is known to be missing without
+opening anything, -2 when file has to be opened to find out
+================
+*/
+static int FS_IndexedFileLength (const char *filename)
+{
+	fsentry_t	*entry;
+
+	entry = FS_LookupIndex(filename);
+	if (!entry)
+		return -2;
+
+	if (entry->search && entry->packindex >= 0)
+		return entry->search->pack->files[entry->packindex].filelen;
+
+	if (!entry->search && entry->checked == fs_lookupcount)
+		return -1;
+
+	return -2;
+}
+
+/*
+================
+FS_CanMapEntry
+
+True when FS_MapFile reads the file straight from a mapped pack
+================
+*/
+static qboolean FS_CanMapEntry (fsentry_t *entry)
+{
+	packfile_t	*pakfile;
+	pack_t		*pak;
+
+	if (!fs_mmap || !fs_mmap->value || !entry || !entry->search || entry->packindex < 0 || !entry->search->pack->mapped)
+		return false;
+
+	pak = entry->search->pack;
+	pakfile = &pak->files[entry->packindex];
+	return pakfile->compression == ZIP_METHOD_STORED && pakfile->filepos >= 0 && pakfile->filelen >= 0 && pakfile->filepos <= pak->mappedsize - pakfile->filelen;
+}
+
+
 /*
 ===========
-FS_FOpenFile
+FS_FindFile
 
 Finds the file in the search path.
-returns filesize and an open FILE *
-Used for streaming data out of either a pak file or
-a seperate file.
+returns filesize and an open FILE * positioned at the start of
+file data, for pack entries fs_foundpakfile tells how it is stored.
 ===========
 */
-int file_from_pak = 0;
 #ifndef NO_ADDONS
-int FS_FOpenFile (const char *filename, FILE **file)
+static int FS_FindFile (const char *filename, FILE **file)
 {
 	searchpath_t	*search;
 	char			netpath[MAX_OSPATH];
@@ -173,6 +562,8 @@ int FS_FOpenFile (const char *filename, FILE **file)
 	filelink_t		*link;
 
 	file_from_pak = 0;
+	fs_foundpack = NULL;
+	fs_foundpakfile = NULL;
 
 	// check for links first
 	for (link = fs_links ; link ; link=link->next)
@@ -190,6 +581,13 @@ int FS_FOpenFile (const char *filename, FILE **file)
 		}
 	}
 
+	if (fs_hashlookups && fs_hashlookups->value && strlen(filename) < MAX_QPATH)
+	{
+		i = FS_FOpenIndexedFile (filename, file);
+		if (i != -2)
+			return i;
+	}
+
 //
 // search through the path, one element at a time
 //
@@ -204,6 +602,8 @@ int FS_FOpenFile (const char *filename, FILE **file)
 				if (!Q_strcasecmp (pak->files[i].name, filename))
 				{	// found it!
 					file_from_pak = 1;
+					fs_foundpack = pak;
+					fs_foundpakfile = &pak->files[i];
 					Com_DPrintf (DP_FS,"PackFile: %s : %s\n",pak->filename, filename);
 				// open a new file on the pakfile
 					*file = fopen (pak->filename, "rb");
@@ -225,123 +625,512 @@ int FS_FOpenFile (const char *filename, FILE **file)
 			
 			Com_DPrintf (DP_FS, "FindFile: %s\n",netpath);
 
-			return FS_filelength (*file);
+			return FS_filelength (*file);
+		}
+		
+	}
+	
+	Com_DPrintf (DP_FS, "FindFile: can't find %s\n", filename);
+	
+	*file = NULL;
+	return -1;
+}
+
+#else
+
+// this is just for demos to prevent add on hacking
+
+static int FS_FindFile (const char *filename, FILE **file)
+{
+	searchpath_t	*search;
+	char			netpath[MAX_OSPATH];
+	pack_t			*pak;
+	int				i;
+
+	file_from_pak = 0;
+	fs_foundpack = NULL;
+	fs_foundpakfile = NULL;
+
+	// get config from directory, everything else from pak
+	if (!strcmp(filename, "config.cfg") || !strncmp(filename, "players/", 8))
+	{
+		Com_sprintf (netpath, sizeof(netpath), "%s/%s",FS_Gamedir(), filename);
+		
+		*file = fopen (netpath, "rb");
+		if (!*file)
+			return -1;
+		
+		Com_DPrintf (DP_FS, "FindFile: %s\n",netpath);
+
+		return FS_filelength (*file);
+	}
+
+	for (search = fs_searchpaths ; search ; search = search->next)
+		if (search->pack)
+			break;
+	if (!search)
+	{
+		*file = NULL;
+		return -1;
+	}
+
+	pak = search->pack;
+	for (i=0 ; i<pak->numfiles ; i++)
+		if (!Q_strcasecmp (pak->files[i].name, filename))
+		{	// found it!
+			file_from_pak = 1;
+			fs_foundpack = pak;
+			fs_foundpakfile = &pak->files[i];
+			Com_DPrintf (DP_FS, "PackFile: %s : %s\n",pak->filename, filename);
+		// open a new file on the pakfile
+			*file = fopen (pak->filename, "rb");
+			if (!*file)
+				Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->filename);	
+			fseek (*file, pak->files[i].filepos, SEEK_SET);
+			return pak->files[i].filelen;
+		}
+	
+	Com_DPrintf (DP_FS, "FindFile: can't find %s\n", filename);
+	
+	*file = NULL;
+	return -1;
+}
+
+#endif
+
+
+/*
+=================
+FS_InflateRead
+
+Feeds compressed pack entry to the decoder in chunks
+=================
+*/
+#define FS_INFLATE_CHUNK	16384
+
+typedef struct
+{
+	FILE	*handle;
+	int		remaining;
+	byte	buf[FS_INFLATE_CHUNK];
+} fsinflate_t;
+
+static qboolean FS_InflateRead (inflate_t *inf)
+{
+	fsinflate_t	*ctx = inf->readctx;
+	int			len;
+
+	if (ctx->remaining <= 0)
+		return false;
+
+	len = ctx->remaining < FS_INFLATE_CHUNK ? ctx->remaining : FS_INFLATE_CHUNK;
+	len = (int)fread (ctx->buf, 1, len, ctx->handle);
+	if (len <= 0)
+		return false;
+
+	ctx->remaining -= len;
+	inf->in = ctx->buf;
+	inf->inlen = len;
+	return true;
+}
+
+/*
+=================
+FS_ReadPackedFile
+
+Reads pack entry into buf which must hold pakfile->filelen bytes.
+Compressed entries are decompressed straight into buf from the mapped
+pack or from the file in chunks. h must be positioned at entry data.
+Returns false for corrupt entry. Safe to call from job threads.
+=================
+*/
+static qboolean FS_ReadPackedFile (pack_t *pak, packfile_t *pakfile, FILE *h, byte *buf)
+{
+	fsinflate_t		ctx;
+	inflate_t		inf;
+	int				len;
+	qboolean		mapped;
+
+	mapped = pak->mapped && pakfile->filepos >= 0 && pakfile->complen >= 0 && pakfile->filepos <= pak->mappedsize - pakfile->complen;
+
+	if (pakfile->compression == ZIP_METHOD_STORED)
+	{
+		if (mapped)
+			memcpy (buf, pak->mapped + pakfile->filepos, pakfile->filelen);
+		else
+			fread (buf, pakfile->filelen, 1, h);
+		return true;
+	}
+
+	memset (&inf, 0, sizeof(inf));
+	if (mapped)
+	{
+		inf.in = pak->mapped + pakfile->filepos;
+		inf.inlen = pakfile->complen;
+	}
+	else
+	{
+		ctx.handle = h;
+		ctx.remaining = pakfile->complen;
+		inf.read = FS_InflateRead;
+		inf.readctx = &ctx;
+	}
+
+	len = Inflate (&inf, buf, pakfile->filelen);
+
+	return len == pakfile->filelen && CRC32_Block(0, buf, len) == pakfile->crc;
+}
+
+
+/*
+===========
+FS_FOpenFile
+
+Finds the file in the search path.
+returns filesize and an open FILE *
+Used for streaming data out of either a pak file or
+a seperate file. Compressed pack entries are decompressed into
+a temporary file, prefer FS_LoadFile for those.
+===========
+*/
+int FS_FOpenFile (const char *filename, FILE **file)
+{
+	pack_t		*pak;
+	packfile_t	*pakfile;
+	FILE		*temp;
+	byte		*buf;
+	int			len;
+
+	len = FS_FindFile (filename, file);
+	if (!*file || !fs_foundpakfile || fs_foundpakfile->compression == ZIP_METHOD_STORED)
+		return len;
+
+	pak = fs_foundpack;
+	pakfile = fs_foundpakfile;
+
+	buf = Z_Malloc (len + 1);
+	temp = NULL;
+	if (!FS_ReadPackedFile (pak, pakfile, *file, buf))
+		Com_Printf ("%s: %s is corrupt\n", pak->filename, pakfile->name);
+	else if ((temp = tmpfile()) != NULL)
+	{
+		fwrite (buf, 1, len, temp);
+		fseek (temp, 0, SEEK_SET);
+	}
+	Z_Free (buf);
+
+	fclose (*file);
+	*file = temp;
+	return temp ? len : -1;
+}
+
+
+/*
+=================
+FS_ReadFile
+
+Properly handles partial reads
+=================
+*/
+#define	MAX_READ	0x10000		// read in blocks of 64k
+void FS_Read (void *buffer, int len, FILE *f)
+{
+	int		block, remaining;
+	int		read;
+	byte	*buf;
+	int		tries;
+
+	buf = (byte *)buffer;
+
+	// read in chunks for progress bar
+	remaining = len;
+	tries = 0;
+	while (remaining)
+	{
+		block = remaining;
+		if (block > MAX_READ)
+			block = MAX_READ;
+		read = (int)fread (buf, 1, block, f);
+		if (read == 0)
+		{
+			// we might have been trying to read from a CD
+			if (!tries)
+			{
+				tries = 1;
+			}
+			else
+				Com_Error (ERR_FATAL, "FS_Read: 0 bytes read");
+		}
+
+		if (read == -1)
+			Com_Error (ERR_FATAL, "FS_Read: -1 bytes read");
+
+		// do some progress bar thing here...
+
+		remaining -= read;
+		buf += read;
+	}
+}
+
+/*
+=============================================================================
+
+PREFETCH
+
+Files a level needs are queued on the main thread while they are looked
+up and their buffers are allocated, then they are read and decompressed
+on job threads all at once. FS_LoadFile and FS_MapFile hand a prefetched
+buffer over to the caller so parsing and registration stay on the main
+thread as they were. Whatever wasn't asked for is freed by FS_ClearPrefetch.
+
+=============================================================================
+*/
+
+#define FS_PREFETCH_HASH	1024	// must be power of two
+
+typedef struct
+{
+	char		name[MAX_QPATH];
+	pack_t		*pack;				// NULL for loose file
+	packfile_t	*pakfile;
+	char		netpath[MAX_OSPATH];
+	int			length;
+	byte		*data;				// NULL once handed over
+	qboolean	loaded;
+	int			next;				// next entry in hash chain or -1
+} fsprefetch_t;
+
+static fsprefetch_t	*fs_prefetch;
+static int			fs_numprefetch, fs_maxprefetch;
+static int			fs_prefetchhash[FS_PREFETCH_HASH];
+static int			fs_prefetchbytes;
+static qboolean		fs_prefetchdone;
+
+cvar_t	*fs_prefetchmb;
+
+static fsprefetch_t *FS_FindPrefetch (const char *name)
+{
+	int		i;
+
+	if (!fs_numprefetch)
+		return NULL;
+
+	for (i = fs_prefetchhash[FS_HashName(name) & (FS_PREFETCH_HASH - 1)]; i != -1; i = fs_prefetch[i].next)
+	{
+		if (FS_NamesEqual(fs_prefetch[i].name, name))
+			return &fs_prefetch[i];
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_PrefetchFile
+
+Queues file to be loaded by FS_RunPrefetch, files which can't
+be found through the index or don't fit in fs_prefetchmb are skipped,
+and so are files FS_MapFile maps in place when mapped is set
+=================
+*/
+void FS_PrefetchFile (const char *name, qboolean mapped)
+{
+	fsprefetch_t	*pf, *newprefetch;
+	fsentry_t		*entry;
+	char			netpath[MAX_OSPATH];
+	FILE			*f;
+	int				length;
+	unsigned		hash;
+
+	if (!fs_prefetchmb || fs_prefetchmb->value <= 0 || fs_prefetchdone)
+		return;
+
+	if (!name || !name[0] || FS_FindPrefetch(name))
+		return;
+
+	entry = FS_LookupIndex(name);
+	if (!entry || !entry->search)
+		return;
+
+	// a copy would only be freed by FS_MapFile
+	if (mapped && FS_CanMapEntry(entry))
+		return;
+
+	if (entry->packindex >= 0)
+	{
+		length = entry->search->pack->files[entry->packindex].filelen;
+	}
+	else
+	{
+		Com_sprintf (netpath, sizeof(netpath), "%s/%s", entry->search->filename, entry->name);
+		f = fopen (netpath, "rb");
+		if (!f)
+			return;
+		length = FS_filelength (f);
+		fclose (f);
+	}
+
+	if (length <= 0 || fs_prefetchbytes + (double)length > fs_prefetchmb->value * 1024 * 1024)
+		return;
+
+	if (fs_numprefetch == fs_maxprefetch)
+	{
+		fs_maxprefetch = fs_maxprefetch ? fs_maxprefetch * 2 : 512;
+		newprefetch = Z_Malloc (fs_maxprefetch * sizeof(fsprefetch_t));
+		if (fs_prefetch)
+		{
+			memcpy (newprefetch, fs_prefetch, fs_numprefetch * sizeof(fsprefetch_t));
+			Z_Free (fs_prefetch);
+		}
+		else
+			memset (fs_prefetchhash, -1, sizeof(fs_prefetchhash));
+		fs_prefetch = newprefetch;
+	}
+
+	pf = &fs_prefetch[fs_numprefetch];
+	memset (pf, 0, sizeof(*pf));
+	strncpy (pf->name, name, sizeof(pf->name) - 1);
+	if (entry->packindex >= 0)
+	{
+		pf->pack = entry->search->pack;
+		pf->pakfile = &pf->pack->files[entry->packindex];
+	}
+	else
+	{
+		strcpy (pf->netpath, netpath);
+	}
+	pf->length = length;
+	pf->data = Z_Malloc (length + 1);
+
+	hash = FS_HashName(name) & (FS_PREFETCH_HASH - 1);
+	pf->next = fs_prefetchhash[hash];
+	fs_prefetchhash[hash] = fs_numprefetch++;
+	fs_prefetchbytes += length;
+}
+
+/*
+=================
+FS_PrefetchJob
+
+Runs on job threads, must not touch zone or print
+=================
+*/
+static void FS_PrefetchJob (void *data, int index, int thread)
+{
+	fsprefetch_t	*pf = &fs_prefetch[index];
+	FILE			*f;
+
+	f = NULL;
+	if (pf->pack)
+	{
+		// mapped packs don't need a file
+		if (!pf->pack->mapped)
+		{
+			if ((f = fopen (pf->pack->filename, "rb")) == NULL)
+				return;
+			fseek (f, pf->pakfile->filepos, SEEK_SET);
 		}
-		
+		pf->loaded = FS_ReadPackedFile (pf->pack, pf->pakfile, f, pf->data);
+	}
+	else
+	{
+		if ((f = fopen (pf->netpath, "rb")) == NULL)
+			return;
+		pf->loaded = (fread (pf->data, 1, pf->length, f) == (size_t)pf->length);
 	}
-	
-	Com_DPrintf (DP_FS, "FindFile: can't find %s\n", filename);
-	
-	*file = NULL;
-	return -1;
-}
 
-#else
+	if (f)
+		fclose (f);
+}
 
-// this is just for demos to prevent add on hacking
+/*
+=================
+FS_RunPrefetch
 
-int FS_FOpenFile (char *filename, FILE **file)
+Loads all queued files in parallel, further FS_PrefetchFile calls are
+ignored until FS_ClearPrefetch
+=================
+*/
+void FS_RunPrefetch (void)
 {
-	searchpath_t	*search;
-	char			netpath[MAX_OSPATH];
-	pack_t			*pak;
-	int				i;
-
-	file_from_pak = 0;
+	unsigned long long	t;
+	int					i, failed;
 
-	// get config from directory, everything else from pak
-	if (!strcmp(filename, "config.cfg") || !strncmp(filename, "players/", 8))
-	{
-		Com_sprintf (netpath, sizeof(netpath), "%s/%s",FS_Gamedir(), filename);
-		
-		*file = fopen (netpath, "rb");
-		if (!*file)
-			return -1;
-		
-		Com_DPrintf (DP_FS, "FindFile: %s\n",netpath);
+	if (!fs_numprefetch || fs_prefetchdone)
+		return;
 
-		return FS_filelength (*file);
-	}
+	t = Sys_Microseconds();
+	Job_ParallelFor (fs_numprefetch, FS_PrefetchJob, NULL);
+	fs_prefetchdone = true;
 
-	for (search = fs_searchpaths ; search ; search = search->next)
-		if (search->pack)
-			break;
-	if (!search)
+	failed = 0;
+	for (i = 0; i < fs_numprefetch; i++)
 	{
-		*file = NULL;
-		return -1;
+		if (fs_prefetch[i].loaded)
+			continue;
+
+		// FS_LoadFile will try again and complain
+		Z_Free (fs_prefetch[i].data);
+		fs_prefetch[i].data = NULL;
+		failed++;
 	}
 
-	pak = search->pack;
-	for (i=0 ; i<pak->numfiles ; i++)
-		if (!Q_strcasecmp (pak->files[i].name, filename))
-		{	// found it!
-			file_from_pak = 1;
-			Com_DPrintf (DP_FS, "PackFile: %s : %s\n",pak->filename, filename);
-		// open a new file on the pakfile
-			*file = fopen (pak->filename, "rb");
-			if (!*file)
-				Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->filename);	
-			fseek (*file, pak->files[i].filepos, SEEK_SET);
-			return pak->files[i].filelen;
-		}
-	
-	Com_DPrintf (DP_FS, "FindFile: can't find %s\n", filename);
-	
-	*file = NULL;
-	return -1;
+	Com_DPrintf (DP_FS, "Prefetched %i files (%i KB) on %i threads in %.2f ms, %i failed\n", fs_numprefetch - failed,
+		fs_prefetchbytes / 1024, Job_NumThreads(), (Sys_Microseconds() - t) / 1000.0f, failed);
 }
 
-#endif
-
-
 /*
 =================
-FS_ReadFile
+FS_TakePrefetched
 
-Properly handles partial reads
+Hands prefetched buffer over to the caller, NULL if file wasn't prefetched
 =================
 */
-#define	MAX_READ	0x10000		// read in blocks of 64k
-void FS_Read (void *buffer, int len, FILE *f)
+static byte *FS_TakePrefetched (const char *name, int *length)
 {
-	int		block, remaining;
-	int		read;
-	byte	*buf;
-	int		tries;
+	fsprefetch_t	*pf;
+	byte			*data;
 
-	buf = (byte *)buffer;
+	if (!fs_prefetchdone || (pf = FS_FindPrefetch(name)) == NULL || !pf->data)
+		return NULL;
 
-	// read in chunks for progress bar
-	remaining = len;
-	tries = 0;
-	while (remaining)
-	{
-		block = remaining;
-		if (block > MAX_READ)
-			block = MAX_READ;
-		read = (int)fread (buf, 1, block, f);
-		if (read == 0)
-		{
-			// we might have been trying to read from a CD
-			if (!tries)
-			{
-				tries = 1;
-			}
-			else
-				Com_Error (ERR_FATAL, "FS_Read: 0 bytes read");
-		}
+	data = pf->data;
+	pf->data = NULL;
+	data[pf->length] = 0;
+	*length = pf->length;
+	file_from_pak = pf->pack ? 1 : 0;
+	return data;
+}
 
-		if (read == -1)
-			Com_Error (ERR_FATAL, "FS_Read: -1 bytes read");
+/*
+=================
+FS_ClearPrefetch
 
-		// do some progress bar thing here...
+Frees prefetched files nobody asked for
+=================
+*/
+void FS_ClearPrefetch (void)
+{
+	int		i, unused;
 
-		remaining -= read;
-		buf += read;
+	unused = 0;
+	for (i = 0; i < fs_numprefetch; i++)
+	{
+		if (!fs_prefetch[i].data)
+			continue;
+		Z_Free (fs_prefetch[i].data);
+		unused++;
 	}
+
+	if (unused)
+		Com_DPrintf (DP_FS, "%i prefetched files were not used\n", unused);
+
+	fs_numprefetch = 0;
+	fs_prefetchbytes = 0;
+	fs_prefetchdone = false;
+	memset (fs_prefetchhash, -1, sizeof(fs_prefetchhash));
 }
 
+
 /*
 ============
 FS_LoadFile
@@ -355,11 +1144,25 @@ int FS_LoadFile (const char *path, void **buffer)
 	FILE	*h;
 	byte	*buf;
 	long	fileLength;
+	int		prefetchedLength;
 
 	buf = NULL;	// quiet compiler warning
 
+	// existence checks don't have to open files
+	if (!buffer)
+	{
+		fileLength = FS_IndexedFileLength (path);
+		if (fileLength != -2)
+			return fileLength;
+	}
+	else if ((buf = FS_TakePrefetched (path, &prefetchedLength)) != NULL)
+	{
+		*buffer = buf;
+		return prefetchedLength;
+	}
+
 // look for it in the filesystem or pack files
-	fileLength = FS_FOpenFile (path, &h);
+	fileLength = FS_FindFile (path, &h);
 	if (!h)
 	{
 		if (buffer)
@@ -376,7 +1179,18 @@ int FS_LoadFile (const char *path, void **buffer)
 	buf = Z_Malloc(fileLength+1);
 	*buffer = buf;
 
-	fread(buf, fileLength, 1, h);
+	if (fs_foundpakfile)
+	{
+		if (!FS_ReadPackedFile (fs_foundpack, fs_foundpakfile, h, buf))
+		{
+			Com_Printf ("%s: %s is corrupt\n", fs_foundpack->filename, fs_foundpakfile->name);
+			Z_Free (buf);
+			*buffer = NULL;
+			fileLength = -1;
+		}
+	}
+	else
+		fread(buf, fileLength, 1, h);
 
 	fclose (h);
 
@@ -405,30 +1219,107 @@ use Z_Free or FS_FreeFile to cleanup buffer
 */
 int FS_LoadTextFile(const char* filename, char** buffer)
 {
-	int		len;
-	byte	* buf;
-	byte	*raw;
+	fsmapped_t	file;
+	byte		*buf;
 
 	//
 	// load file
 	//
-	len = FS_LoadFile(filename, (void**)&raw);
-	if (!len || len == -1)
+	if (!FS_MapFile(filename, &file) || !file.length)
 	{
+		FS_UnmapFile(&file);
 		if (buffer)
 			*buffer = NULL;
-		return len;
+		return file.length;
+	}
+
+	if (file.allocated)
+	{
+		// loose file already has a private buffer with room for terminator
+		buf = file.allocated;
+	}
+	else
+	{
+		buf = Z_Malloc(file.length + 1);
+		memcpy(buf, file.data, file.length);
 	}
 
 	// NULL terminate the file
-	buf = Z_Malloc(len + 1);
-	*buffer = buf;
+	buf[file.length] = 0;
+	*buffer = (char*)buf;
+	return file.length + 1;
+}
+
+
+/*
+=============
+FS_MapFile
 
-	memcpy(buf, raw, len);
-	buf[len] = 0;
+Gives read only access to file contents, files stored in pak are not
+copied and point straight into mapped pak, loose and compressed files
+are loaded into memory.
+Returns false and -1 length when file is not found.
+Must be released with FS_UnmapFile before the gamedir changes.
+=============
+*/
+qboolean FS_MapFile (const char *path, fsmapped_t *out)
+{
+	fsentry_t	*entry;
+	packfile_t	*pakfile;
+	pack_t		*pak;
+	void		*buf;
+
+	out->data = NULL;
+	out->length = -1;
+	out->allocated = NULL;
+
+	// stored files in mapped packs are still mapped if somebody prefetched them for FS_LoadFile
+	if ((buf = FS_TakePrefetched (path, &out->length)) != NULL)
+	{
+		out->data = buf;
+		out->allocated = buf;
+	}
+
+	entry = FS_LookupIndex(path);
+	if (FS_CanMapEntry(entry))
+	{
+		pak = entry->search->pack;
+		pakfile = &pak->files[entry->packindex];
+
+		if (out->allocated)
+			FS_FreeFile (out->allocated);
+		out->allocated = NULL;
+
+		file_from_pak = 1;
+		Com_DPrintf (DP_FS, "MappedFile: %s : %s\n", pak->filename, path);
+		out->data = pak->mapped + pakfile->filepos;
+		out->length = pakfile->filelen;
+		return true;
+	}
+
+	if (out->allocated)
+		return true;
+
+	out->length = FS_LoadFile(path, &buf);
+	if (!buf)
+		return false;
 
-	FS_FreeFile(raw);
-	return len+1;
+	out->data = buf;
+	out->allocated = buf;
+	return true;
+}
+
+/*
+=============
+FS_UnmapFile
+=============
+*/
+void FS_UnmapFile (fsmapped_t *file)
+{
+	if (file->allocated)
+		FS_FreeFile(file->allocated);
+	file->data = NULL;
+	file->allocated = NULL;
 }
 
 
@@ -486,6 +1377,9 @@ pack_t *FS_LoadPackFile (const char *packfile)
 		strcpy (newfiles[i].name, info[i].name);
 		newfiles[i].filepos = LittleLong(info[i].filepos);
 		newfiles[i].filelen = LittleLong(info[i].filelen);
+		newfiles[i].complen = newfiles[i].filelen;
+		newfiles[i].compression = ZIP_METHOD_STORED;
+		newfiles[i].crc = 0;
 	}
 
 	pack = Z_Malloc (sizeof (pack_t));
@@ -493,8 +1387,155 @@ pack_t *FS_LoadPackFile (const char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
-	
-	Com_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
+	pack->mapped = NULL;
+	pack->mappedsize = 0;
+
+	if (fs_mmap && fs_mmap->value)
+		pack->mapped = Sys_MapFile(packfile, &pack->mappedsize);
+
+	Com_Printf ("Added packfile %s (%i files%s)\n", packfile, numpackfiles, pack->mapped ? ", mapped" : "");
+	return pack;
+}
+
+
+static unsigned FS_ZipShort (const byte *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned FS_ZipLong (const byte *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+/*
+=================
+FS_LoadZipFile
+
+Takes an explicit (not game tree related) path to a .pk3 file.
+
+Reads the central directory at the end of archive and finds where
+data of each file starts, there is no limit on number of files.
+Entries with too long names, encrypted entries and compression
+methods other than deflate are skipped.
+=================
+*/
+pack_t *FS_LoadZipFile (const char *zipfile)
+{
+	FILE			*handle;
+	pack_t			*pack;
+	packfile_t		*newfiles, *file;
+	byte			*tail, *dir, *p, local[ZIP_LOCAL_SIZE];
+	int				filelen, taillen, dirlen, dirofs, numfiles, numentries;
+	int				i, namelen, method, flags;
+
+	handle = fopen(zipfile, "rb");
+	if (!handle)
+		return NULL;
+
+	// find end of central directory record, it's followed by a comment
+	filelen = FS_filelength (handle);
+	taillen = filelen < ZIP_END_SIZE + ZIP_MAX_COMMENT ? filelen : ZIP_END_SIZE + ZIP_MAX_COMMENT;
+	if (taillen < ZIP_END_SIZE)
+		Com_Error (ERR_FATAL, "%s is not a zip file", zipfile);
+
+	tail = Z_Malloc (taillen);
+	fseek (handle, filelen - taillen, SEEK_SET);
+	fread (tail, 1, taillen, handle);
+
+	for (p = tail + taillen - ZIP_END_SIZE; p >= tail; p--)
+	{
+		if (FS_ZipLong(p) == ZIP_END_SIG)
+			break;
+	}
+	if (p < tail)
+		Com_Error (ERR_FATAL, "%s is not a zip file", zipfile);
+
+	numentries = FS_ZipShort (p + ZIP_END_NUMFILES);
+	dirlen = FS_ZipLong (p + ZIP_END_DIRSIZE);
+	dirofs = FS_ZipLong (p + ZIP_END_DIROFS);
+	Z_Free (tail);
+
+	if (dirofs < 0 || dirlen < 0 || dirofs > filelen - dirlen)
+		Com_Error (ERR_FATAL, "%s has bad central directory", zipfile);
+
+	dir = Z_Malloc (dirlen + 1);
+	fseek (handle, dirofs, SEEK_SET);
+	fread (dir, 1, dirlen, handle);
+
+	// parse the directory
+	newfiles = Z_Malloc ((numentries ? numentries : 1) * sizeof(packfile_t));
+	numfiles = 0;
+	for (i = 0, p = dir; i < numentries; i++)
+	{
+		if (p + ZIP_CENTRAL_SIZE > dir + dirlen || FS_ZipLong(p) != ZIP_CENTRAL_SIG)
+			Com_Error (ERR_FATAL, "%s has bad central directory", zipfile);
+
+		namelen = FS_ZipShort (p + ZIP_CENTRAL_NAMELEN);
+		method = FS_ZipShort (p + ZIP_CENTRAL_METHOD);
+		flags = FS_ZipShort (p + ZIP_CENTRAL_FLAGS);
+		if (p + ZIP_CENTRAL_SIZE + namelen > dir + dirlen)
+			Com_Error (ERR_FATAL, "%s has bad central directory", zipfile);
+
+		file = &newfiles[numfiles];
+		if (namelen >= MAX_QPATH)
+		{
+			Com_Printf ("%s: skipping file with too long name\n", zipfile);
+		}
+		else if (namelen > 0 && p[ZIP_CENTRAL_SIZE + namelen - 1] != '/') // not a directory
+		{
+			memcpy (file->name, p + ZIP_CENTRAL_SIZE, namelen);
+			file->name[namelen] = 0;
+
+			if ((flags & ZIP_FLAG_ENCRYPTED) || (method != ZIP_METHOD_STORED && method != ZIP_METHOD_DEFLATE))
+			{
+				Com_Printf ("%s: %s uses unsupported compression\n", zipfile, file->name);
+			}
+			else
+			{
+				file->compression = method;
+				file->crc = FS_ZipLong (p + ZIP_CENTRAL_CRC);
+				file->complen = FS_ZipLong (p + ZIP_CENTRAL_COMPSIZE);
+				file->filelen = FS_ZipLong (p + ZIP_CENTRAL_FILESIZE);
+				file->filepos = FS_ZipLong (p + ZIP_CENTRAL_LOCALOFS); // local header until resolved below
+				if (method == ZIP_METHOD_STORED && file->complen != file->filelen)
+					Com_Error (ERR_FATAL, "%s: %s has bad size", zipfile, file->name);
+				numfiles++;
+			}
+		}
+
+		p += ZIP_CENTRAL_SIZE + namelen + FS_ZipShort (p + ZIP_CENTRAL_EXTRALEN) + FS_ZipShort (p + ZIP_CENTRAL_COMMENTLEN);
+	}
+	Z_Free (dir);
+
+	// local headers may have different extra fields, so skip them here once
+	for (i = 0, file = newfiles; i < numfiles; i++, file++)
+	{
+		if (file->filepos < 0 || file->filepos > filelen - ZIP_LOCAL_SIZE)
+			Com_Error (ERR_FATAL, "%s: %s has bad offset", zipfile, file->name);
+
+		fseek (handle, file->filepos, SEEK_SET);
+		fread (local, 1, ZIP_LOCAL_SIZE, handle);
+		if (FS_ZipLong(local) != ZIP_LOCAL_SIG)
+			Com_Error (ERR_FATAL, "%s: %s has bad local header", zipfile, file->name);
+
+		file->filepos += ZIP_LOCAL_SIZE + FS_ZipShort (local + ZIP_LOCAL_NAMELEN) + FS_ZipShort (local + ZIP_LOCAL_EXTRALEN);
+		if (file->complen < 0 || file->filelen < 0 || file->filepos > filelen - file->complen)
+			Com_Error (ERR_FATAL, "%s: %s has bad size", zipfile, file->name);
+	}
+
+	pack = Z_Malloc (sizeof (pack_t));
+	strcpy (pack->filename, zipfile);
+	pack->handle = handle;
+	pack->numfiles = numfiles;
+	pack->files = newfiles;
+	pack->mapped = NULL;
+	pack->mappedsize = 0;
+
+	if (fs_mmap && fs_mmap->value)
+		pack->mapped = Sys_MapFile(zipfile, &pack->mappedsize);
+
+	Com_Printf ("Added packfile %s (%i files%s)\n", zipfile, numfiles, pack->mapped ? ", mapped" : "");
 	return pack;
 }
 
@@ -504,17 +1545,26 @@ pack_t *FS_LoadPackFile (const char *packfile)
 FS_AddGameDirectory
 
 Sets fs_gamedir, adds the directory to the head of the path,
-then loads and adds pak1.pak pak2.pak ... 
+then loads and adds pak1.pak pak2.pak ... and then all .pk3 files
+in alphabetical order, so pk3s override paks and later names
+override earlier ones.
 ================
 */
+static int FS_SortNames (const void *a, const void *b)
+{
+	return Q_strcasecmp (*(char **)a, *(char **)b);
+}
+
 void FS_AddGameDirectory (char *dir)
 {
-	int				i;
+	int				i, count;
 	searchpath_t	*search;
 	pack_t			*pak;
 	char			pakfile[MAX_OSPATH];
+	char			**list;
 
 	strcpy (fs_gamedir, dir);
+	fs_indexdirty = true;
 
 	//
 	// add the directory to the search path
@@ -539,6 +1589,25 @@ void FS_AddGameDirectory (char *dir)
 		fs_searchpaths = search;		
 	}
 
+#ifndef NO_ADDONS
+	Com_sprintf (pakfile, sizeof(pakfile), "%s/*.pk3", dir);
+	if ((list = FS_ListFiles(pakfile, &count, 0, SFF_SUBDIR | SFF_HIDDEN | SFF_SYSTEM)) != NULL)
+	{
+		qsort (list, count - 1, sizeof(char *), FS_SortNames);
+		for (i = 0; i < count - 1; i++)
+		{
+			pak = FS_LoadZipFile (list[i]);
+			free (list[i]);
+			if (!pak)
+				continue;
+			search = Z_Malloc (sizeof(searchpath_t));
+			search->pack = pak;
+			search->next = fs_searchpaths;
+			fs_searchpaths = search;
+		}
+		free (list);
+	}
+#endif
 
 }
 
@@ -593,6 +1662,9 @@ void FS_SetGamedir (const char *dir)
 		return;
 	}
 
+	// prefetched entries point to packs which are about to be freed
+	FS_ClearPrefetch ();
+
 	//
 	// free up any current game dir info
 	//
@@ -601,6 +1673,7 @@ void FS_SetGamedir (const char *dir)
 		if (fs_searchpaths->pack)
 		{
 			fclose (fs_searchpaths->pack->handle);
+			Sys_UnmapFile (fs_searchpaths->pack->mapped, fs_searchpaths->pack->mappedsize);
 			Z_Free (fs_searchpaths->pack->files);
 			Z_Free (fs_searchpaths->pack);
 		}
@@ -608,6 +1681,7 @@ void FS_SetGamedir (const char *dir)
 		Z_Free (fs_searchpaths);
 		fs_searchpaths = next;
 	}
+	fs_indexdirty = true;
 
 	//
 	// flush all data, so it will be forced to reload
@@ -796,6 +1870,13 @@ void FS_Path_f (void)
 			Com_Printf ("%s\n", s->filename);
 	}
 
+	if (fs_hashlookups->value)
+	{
+		if (fs_indexdirty)
+			FS_BuildIndex ();
+		Com_Printf ("\n%i files indexed\n", fs_numentries);
+	}
+
 	Com_Printf ("\nLinks:\n");
 	for (l=fs_links ; l ; l=l->next)
 		Com_Printf ("%s : %s\n", l->from, l->to);
@@ -830,6 +1911,75 @@ char *FS_NextPath (const char *prevpath)
 }
 
 
+/*
+================
+FS_Bench_f
+
+Times file lookups the way map loading does them, with linear
+search path walk and with the index
+================
+*/
+void FS_Bench_f (void)
+{
+	char	(*names)[MAX_QPATH];
+	int		numnames, maxnames, rounds;
+	int		i, r, mode, found[2];
+	float	ms[2];
+	unsigned long long	t;
+	float	oldvalue;
+
+	rounds = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 4;
+	if (rounds < 1)
+		rounds = 1;
+
+	if (fs_indexdirty)
+		FS_BuildIndex ();
+
+	// half of precache lookups are for files which exist
+	maxnames = 2048;
+	names = Z_Malloc (maxnames * sizeof(*names));
+	numnames = 0;
+	for (i = 0; i < fs_numentries && numnames < maxnames; i++)
+	{
+		if (!fs_entries[i].search)
+			continue;
+		strcpy (names[numnames++], fs_entries[i].name);
+		if (numnames < maxnames && strlen(fs_entries[i].name) + 5 < MAX_QPATH)
+			Com_sprintf (names[numnames++], MAX_QPATH, "%s.def", fs_entries[i].name);
+	}
+
+	oldvalue = fs_hashlookups->value;
+	for (mode = 0; mode < 2; mode++)
+	{
+		Cvar_SetValue ("fs_hashlookups", (float)mode);
+		FS_FlushLookupCache ();
+
+		found[mode] = 0;
+		t = Sys_Microseconds();
+		for (r = 0; r < rounds; r++)
+		{
+			for (i = 0; i < numnames; i++)
+			{
+				if (FS_LoadFile(names[i], NULL) != -1)
+					found[mode]++;
+			}
+		}
+		ms[mode] = (Sys_Microseconds() - t) / 1000.0f;
+	}
+	Cvar_SetValue ("fs_hashlookups", oldvalue);
+
+	Com_Printf ("%i lookups of %i names (%i found):\n", numnames * rounds, numnames, found[0]);
+	Com_Printf ("  linear: %8.2f ms\n", ms[0]);
+	Com_Printf ("  hashed: %8.2f ms", ms[1]);
+	if (ms[1] > 0.0f)
+		Com_Printf (" (%.1fx)", ms[0] / ms[1]);
+	Com_Printf ("\n");
+	if (found[0] != found[1])
+		Com_Printf ("WARNING: hashed lookups found %i files\n", found[1]);
+
+	Z_Free (names);
+}
+
 /*
 ================
 FS_InitFilesystem
@@ -840,6 +1990,11 @@ void FS_InitFilesystem (void)
 	Cmd_AddCommand ("path", FS_Path_f);
 	Cmd_AddCommand ("link", FS_Link_f);
 	Cmd_AddCommand ("dir", FS_Dir_f );
+	Cmd_AddCommand ("fs_bench", FS_Bench_f);
+
+	fs_hashlookups = Cvar_Get ("fs_hashlookups", "1", 0, "Find files using hashed index of all search paths instead of walking them.");
+	fs_mmap = Cvar_Get ("fs_mmap", "1", CVAR_NOSET, "Map pak files into memory and read assets from them without copying.");
+	fs_prefetchmb = Cvar_Get ("fs_prefetchmb", "256", 0, "Megabytes of level assets read ahead in parallel during level load, 0 disables.");
 
 	//
 	// basedir <path>
@@ -41,6 +41,24 @@ void FS_FreeFile(void* buffer);
 
 int FS_LoadTextFile(const char* filename, char** buffer);
 
+// read only view of a file, points into mapped pak when possible
+typedef struct
+{
+	const byte	*data;
+	int			length;
+	void		*allocated; // set when file had to be loaded into memory
+} fsmapped_t;
+
+qboolean FS_MapFile(const char* path, fsmapped_t* out);
+void FS_UnmapFile(fsmapped_t* file);
+
+// read files needed for a level in parallel before they are loaded one by one,
+// mapped is set for files read with FS_MapFile so those it maps in place are skipped
+void FS_PrefetchFile(const char* name, qboolean mapped);
+void FS_RunPrefetch(void);
+void FS_ClearPrefetch(void);
+
 void FS_CreatePath(const char* path);
+void FS_FlushLookupCache(void); // call after writing a file which may have been looked up
 
 #endif /*_PRAGMA_FILESYSTEM_H_*/
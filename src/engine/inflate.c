@@ -0,0 +1,392 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// inflate.c -- deflate (RFC 1951) decoder for compressed pk3 entries
+
+#include "pragma.h"
+
+#define INF_MAX_BITS		15
+#define INF_FAST_BITS		9		// codes up to this long are decoded with one lookup
+#define INF_MAX_LITLEN		288
+#define INF_MAX_DIST		30
+
+typedef struct
+{
+	short			count[INF_MAX_BITS + 1];	// number of codes of each length
+	short			symbol[INF_MAX_LITLEN];		// symbols ordered by their codes
+	unsigned short	fast[1 << INF_FAST_BITS];	// (length << 9) | symbol, 0 for longer codes
+} huffman_t;
+
+static const short lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static const byte codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/*
+=================
+Inf_FillBits
+
+Keeps at least 25 bits in the buffer, past the end of input zeros are
+shifted in and counted so reading far beyond the end is an error
+=================
+*/
+static void Inf_FillBits(inflate_t* inf)
+{
+	while (inf->bitcount <= 24)
+	{
+		if (inf->inlen <= 0 && (!inf->read || !inf->read(inf)))
+		{
+			inf->overrun++;
+			inf->bitcount += 8;
+			continue;
+		}
+		inf->bitbuf |= (unsigned)*inf->in++ << inf->bitcount;
+		inf->inlen--;
+		inf->bitcount += 8;
+	}
+}
+
+static int Inf_Bits(inflate_t* inf, int count)
+{
+	int		value;
+
+	if (inf->bitcount < count)
+		Inf_FillBits(inf);
+
+	value = inf->bitbuf & ((1u << count) - 1);
+	inf->bitbuf >>= count;
+	inf->bitcount -= count;
+	return value;
+}
+
+/*
+=================
+Inf_BuildHuffman
+
+Builds canonical huffman decoding tables from code lengths,
+returns false for over subscribed set of lengths
+=================
+*/
+static qboolean Inf_BuildHuffman(huffman_t* h, const byte* lengths, int numsymbols)
+{
+	short	offs[INF_MAX_BITS + 1];
+	int		i, len, left, code, index, reversed, r;
+
+	memset(h->count, 0, sizeof(h->count));
+	for (i = 0; i < numsymbols; i++)
+		h->count[lengths[i]]++;
+	h->count[0] = 0;
+
+	left = 1;
+	for (len = 1; len <= INF_MAX_BITS; len++)
+	{
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return false;
+	}
+
+	offs[1] = 0;
+	for (len = 1; len < INF_MAX_BITS; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+	for (i = 0; i < numsymbols; i++)
+	{
+		if (lengths[i])
+			h->symbol[offs[lengths[i]]++] = i;
+	}
+
+	// codes are sent most significant bit first, so the lookup is bit reversed
+	memset(h->fast, 0, sizeof(h->fast));
+	code = index = 0;
+	for (len = 1; len <= INF_FAST_BITS; len++)
+	{
+		for (i = 0; i < h->count[len]; i++, index++, code++)
+		{
+			for (reversed = 0, r = 0; r < len; r++)
+				reversed |= ((code >> r) & 1) << (len - 1 - r);
+
+			for (r = reversed; r < (1 << INF_FAST_BITS); r += 1 << len)
+				h->fast[r] = (len << 9) | h->symbol[index];
+		}
+		code <<= 1;
+	}
+	return true;
+}
+
+/*
+=================
+Inf_Decode
+
+Returns next symbol or -1 when there's no code for the bits
+=================
+*/
+static int Inf_Decode(inflate_t* inf, const huffman_t* h)
+{
+	int		entry, len, code, first, index, count;
+
+	if (inf->bitcount < INF_MAX_BITS)
+		Inf_FillBits(inf);
+
+	entry = h->fast[inf->bitbuf & ((1 << INF_FAST_BITS) - 1)];
+	if (entry)
+	{
+		len = entry >> 9;
+		inf->bitbuf >>= len;
+		inf->bitcount -= len;
+		return entry & 511;
+	}
+
+	code = first = index = 0;
+	for (len = 1; len <= INF_MAX_BITS; len++)
+	{
+		code |= (inf->bitbuf >> (len - 1)) & 1;
+		count = h->count[len];
+		if (code - count < first)
+		{
+			inf->bitbuf >>= len;
+			inf->bitcount -= len;
+			return h->symbol[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+/*
+=================
+Inf_Stored
+=================
+*/
+static int Inf_Stored(inflate_t* inf, byte* out, int pos, int outlen)
+{
+	int		len, nlen, chunk;
+
+	// go to byte boundary
+	Inf_Bits(inf, inf->bitcount & 7);
+
+	len = Inf_Bits(inf, 16);
+	nlen = Inf_Bits(inf, 16);
+	if (len != (~nlen & 0xffff) || pos + len > outlen || inf->overrun > 4)
+		return -1;
+
+	// whole bytes left in bit buffer go first
+	while (len && inf->bitcount - inf->overrun * 8 >= 8)
+	{
+		out[pos++] = Inf_Bits(inf, 8);
+		len--;
+	}
+
+	while (len)
+	{
+		if (inf->overrun || (inf->inlen <= 0 && (!inf->read || !inf->read(inf))))
+			return -1;
+
+		chunk = len < inf->inlen ? len : inf->inlen;
+		memcpy(out + pos, inf->in, chunk);
+		inf->in += chunk;
+		inf->inlen -= chunk;
+		pos += chunk;
+		len -= chunk;
+	}
+	return pos;
+}
+
+/*
+=================
+Inf_Codes
+=================
+*/
+static int Inf_Codes(inflate_t* inf, const huffman_t* litlen, const huffman_t* dist, byte* out, int pos, int outlen)
+{
+	int		symbol, len, distance;
+	byte	*src, *dst;
+
+	while (1)
+	{
+		symbol = Inf_Decode(inf, litlen);
+		if (symbol < 0 || inf->overrun > 4)
+			return -1;
+
+		if (symbol < 256)
+		{
+			if (pos >= outlen)
+				return -1;
+			out[pos++] = symbol;
+			continue;
+		}
+
+		if (symbol == 256)
+			return pos;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return -1;
+		len = lengthBase[symbol] + Inf_Bits(inf, lengthExtra[symbol]);
+
+		symbol = Inf_Decode(inf, dist);
+		if (symbol < 0 || symbol >= 30)
+			return -1;
+		distance = distBase[symbol] + Inf_Bits(inf, distExtra[symbol]);
+
+		if (distance > pos || pos + len > outlen)
+			return -1;
+
+		// may overlap, copy byte by byte
+		src = out + pos - distance;
+		dst = out + pos;
+		pos += len;
+		while (len--)
+			*dst++ = *src++;
+	}
+}
+
+/*
+=================
+Inf_DynamicTables
+=================
+*/
+static qboolean Inf_DynamicTables(inflate_t* inf, huffman_t* litlen, huffman_t* dist)
+{
+	byte		lengths[INF_MAX_LITLEN + INF_MAX_DIST];
+	huffman_t	codelen;
+	int			nlen, ndist, ncode, i, symbol, repeat, value;
+
+	nlen = Inf_Bits(inf, 5) + 257;
+	ndist = Inf_Bits(inf, 5) + 1;
+	ncode = Inf_Bits(inf, 4) + 4;
+	if (nlen > 286 || ndist > 30)
+		return false;
+
+	memset(lengths, 0, sizeof(lengths));
+	for (i = 0; i < ncode; i++)
+		lengths[codeLengthOrder[i]] = Inf_Bits(inf, 3);
+
+	if (!Inf_BuildHuffman(&codelen, lengths, 19))
+		return false;
+
+	for (i = 0; i < nlen + ndist; )
+	{
+		symbol = Inf_Decode(inf, &codelen);
+		if (symbol < 0 || inf->overrun > 4)
+			return false;
+
+		if (symbol < 16)
+		{
+			lengths[i++] = symbol;
+			continue;
+		}
+
+		value = 0;
+		if (symbol == 16)
+		{
+			if (i == 0)
+				return false;
+			value = lengths[i - 1];
+			repeat = 3 + Inf_Bits(inf, 2);
+		}
+		else if (symbol == 17)
+			repeat = 3 + Inf_Bits(inf, 3);
+		else
+			repeat = 11 + Inf_Bits(inf, 7);
+
+		if (i + repeat > nlen + ndist)
+			return false;
+		while (repeat--)
+			lengths[i++] = value;
+	}
+
+	// there must be an end of block code
+	if (!lengths[256])
+		return false;
+
+	return Inf_BuildHuffman(litlen, lengths, nlen) && Inf_BuildHuffman(dist, lengths + nlen, ndist);
+}
+
+/*
+=================
+Inf_FixedTables
+=================
+*/
+static void Inf_FixedTables(huffman_t* litlen, huffman_t* dist)
+{
+	byte	lengths[INF_MAX_LITLEN];
+	int		i;
+
+	for (i = 0; i < 144; i++)
+		lengths[i] = 8;
+	for (; i < 256; i++)
+		lengths[i] = 9;
+	for (; i < 280; i++)
+		lengths[i] = 7;
+	for (; i < INF_MAX_LITLEN; i++)
+		lengths[i] = 8;
+	Inf_BuildHuffman(litlen, lengths, INF_MAX_LITLEN);
+
+	for (i = 0; i < INF_MAX_DIST; i++)
+		lengths[i] = 5;
+	Inf_BuildHuffman(dist, lengths, INF_MAX_DIST);
+}
+
+/*
+=================
+Inflate
+=================
+*/
+int Inflate(inflate_t* inf, byte* out, int outlen)
+{
+	huffman_t	litlen, dist;
+	int			pos, last, type;
+
+	inf->bitbuf = 0;
+	inf->bitcount = 0;
+	inf->overrun = 0;
+
+	pos = 0;
+	do
+	{
+		last = Inf_Bits(inf, 1);
+		type = Inf_Bits(inf, 2);
+
+		switch (type)
+		{
+		case 0:
+			pos = Inf_Stored(inf, out, pos, outlen);
+			break;
+		case 1:
+			Inf_FixedTables(&litlen, &dist);
+			pos = Inf_Codes(inf, &litlen, &dist, out, pos, outlen);
+			break;
+		case 2:
+			if (!Inf_DynamicTables(inf, &litlen, &dist))
+				return -1;
+			pos = Inf_Codes(inf, &litlen, &dist, out, pos, outlen);
+			break;
+		default:
+			return -1;
+		}
+
+		if (pos < 0 || inf->overrun > 4)
+			return -1;
+	} while (!last);
+
+	return pos;
+}
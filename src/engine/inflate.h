@@ -0,0 +1,43 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+
+
+/*
+==============================================================
+INFLATE
+==============================================================
+*/
+
+#pragma once
+
+#ifndef _PRAGMA_INFLATE_H_
+#define _PRAGMA_INFLATE_H_
+
+// compressed input is pulled in chunks, when in is used up read is called
+// to point in and inlen at the next chunk, it returns false at the end of data
+typedef struct inflate_s
+{
+	const byte	*in;
+	int			inlen;
+	qboolean	(*read)(struct inflate_s* inf);
+	void		*readctx;
+
+	// private
+	unsigned	bitbuf;
+	int			bitcount;
+	int			overrun;
+} inflate_t;
+
+// decompresses raw deflate stream straight into out which is also the back
+// reference window, returns the number of bytes written or -1 if data is
+// corrupt or doesn't fit in outlen. Doesn't allocate and is thread safe.
+int Inflate(inflate_t* inf, byte* out, int outlen);
+
+#endif /*_PRAGMA_INFLATE_H_*/
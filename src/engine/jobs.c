@@ -0,0 +1,206 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// jobs.c -- worker threads for splitting loops across cpu cores
+
+#include "pragma.h"
+
+typedef struct
+{
+	int				numThreads;		// including main thread
+	sys_thread_t	threads[JOB_MAX_THREADS];
+	sys_semaphore_t	wake, done;
+	volatile int	quit;
+
+	// current job
+	qboolean		active;
+	jobfunc_t		func;
+	void			*data;
+	int				count;
+	int				workers;		// woken for current job
+	volatile int	next;
+} jobs_t;
+
+static jobs_t	jobs;
+static cvar_t	*com_threads;
+
+/*
+================
+Job_Run
+
+Takes indexes of current job until there are none left.
+================
+*/
+static void Job_Run(int thread)
+{
+	int index;
+
+	while ((index = Sys_AtomicIncrement(&jobs.next) - 1) < jobs.count)
+		jobs.func(jobs.data, index, thread);
+}
+
+static void Job_Worker(void* param)
+{
+	int thread = (int)(intptr_t)param;
+
+	while (1)
+	{
+		Sys_SemaphoreWait(jobs.wake);
+		if (jobs.quit)
+			break;
+
+		Job_Run(thread);
+		Sys_SemaphorePost(jobs.done, 1);
+	}
+}
+
+/*
+================
+Job_Init
+================
+*/
+void Job_Init(void)
+{
+	int i, count;
+
+	com_threads = Cvar_Get("com_threads", "0", CVAR_ARCHIVE, "Number of threads used for parallel work, 0 picks number of cpu cores. Requires restart.");
+
+	count = (int)com_threads->value;
+	if (count <= 0)
+		count = Sys_NumProcessors();
+	if (count > JOB_MAX_THREADS)
+		count = JOB_MAX_THREADS;
+
+	memset(&jobs, 0, sizeof(jobs));
+	jobs.numThreads = 1;
+
+	if (count < 2)
+		return;
+
+	jobs.wake = Sys_CreateSemaphore(0);
+	jobs.done = Sys_CreateSemaphore(0);
+	if (!jobs.wake || !jobs.done)
+	{
+		Com_Printf("Job_Init: couldn't create semaphores, running single threaded\n");
+		return;
+	}
+
+	for (i = 1; i < count; i++)
+	{
+		jobs.threads[i] = Sys_CreateThread(Job_Worker, (void*)(intptr_t)i);
+		if (!jobs.threads[i])
+			break;
+		jobs.numThreads++;
+	}
+
+	Com_Printf("Using %i threads for parallel jobs\n", jobs.numThreads);
+}
+
+/*
+================
+Job_Shutdown
+================
+*/
+void Job_Shutdown(void)
+{
+	int i;
+
+	if (jobs.numThreads > 1)
+	{
+		jobs.quit = 1;
+		Sys_SemaphorePost(jobs.wake, jobs.numThreads - 1);
+		for (i = 1; i < jobs.numThreads; i++)
+			Sys_WaitThread(jobs.threads[i]);
+	}
+
+	if (jobs.wake)
+		Sys_DestroySemaphore(jobs.wake);
+	if (jobs.done)
+		Sys_DestroySemaphore(jobs.done);
+
+	memset(&jobs, 0, sizeof(jobs));
+	jobs.numThreads = 1;
+}
+
+/*
+================
+Job_NumThreads
+================
+*/
+int Job_NumThreads(void)
+{
+	return jobs.numThreads > 0 ? jobs.numThreads : 1;
+}
+
+/*
+================
+Job_ParallelFor
+================
+*/
+void Job_ParallelFor(int count, jobfunc_t func, void* data)
+{
+	int i, workers;
+
+	if (count <= 0)
+		return;
+
+	if (jobs.active)
+	{
+		Com_Error(ERR_FATAL, "Job_ParallelFor: called from inside a job\n");
+		return;
+	}
+
+	workers = Job_NumThreads() - 1;
+	if (workers > count - 1)
+		workers = count - 1;
+
+	if (workers <= 0)
+	{
+		for (i = 0; i < count; i++)
+			func(data, i, 0);
+		return;
+	}
+
+	jobs.active = true;
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	jobs.workers = workers;
+	jobs.next = 0;
+
+	Sys_SemaphorePost(jobs.wake, workers);
+	Job_Run(0);
+	for (i = 0; i < workers; i++)
+		Sys_SemaphoreWait(jobs.done);
+
+	jobs.active = false;
+}
+
+/*
+================
+Job_Abort
+
+Called by Com_Error when job function errored on the main thread and is about
+to longjmp out of Job_ParallelFor. Lets workers finish what they are running
+so the next job starts from a clean state.
+================
+*/
+void Job_Abort(void)
+{
+	int i;
+
+	if (!jobs.active)
+		return;
+
+	jobs.next = jobs.count; // hand out no more indexes
+	for (i = 0; i < jobs.workers; i++)
+		Sys_SemaphoreWait(jobs.done);
+
+	jobs.active = false;
+}
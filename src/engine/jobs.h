@@ -0,0 +1,39 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+
+
+/*
+==============================================================
+PARALLEL JOBS
+==============================================================
+*/
+
+#pragma once
+
+#ifndef _PRAGMA_JOBS_H_
+#define _PRAGMA_JOBS_H_
+
+#define JOB_MAX_THREADS		16
+
+// thread is 0 for the calling thread and 1..Job_NumThreads()-1 for workers,
+// use it to index per thread data
+typedef void (*jobfunc_t)(void* data, int index, int thread);
+
+void		Job_Init(void);
+void		Job_Shutdown(void);
+int			Job_NumThreads(void);
+
+// calls func for every index in 0..count-1 and returns when all are done,
+// only the main thread may call it and func must not allocate from zone;
+// func may Com_Error only when thread is 0, workers can't unwind
+void		Job_ParallelFor(int count, jobfunc_t func, void* data);
+void		Job_Abort(void);
+
+#endif /*_PRAGMA_JOBS_H_*/
@@ -35,7 +35,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 typedef struct
 {
-	byte	data[MAX_MSGLEN];
+	byte	data[MAX_FRAGMSGLEN];	// loopback is never fragmented
 	int		datalen;
 } loopmsg_t;
 
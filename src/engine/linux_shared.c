@@ -26,8 +26,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 //#include "../linux/glob.h"
 
@@ -282,11 +286,147 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+unsigned long long Sys_Microseconds (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 void Sys_Mkdir (char *path)
 {
     mkdir (path, 0777);
 }
 
+//============================================
+
+typedef struct
+{
+	void	(*func)(void* param);
+	void	*param;
+} sys_threadstart_t;
+
+static void *Sys_ThreadStart(void *param)
+{
+	sys_threadstart_t start = *(sys_threadstart_t*)param;
+
+	free(param);
+	start.func(start.param);
+	return NULL;
+}
+
+sys_thread_t Sys_CreateThread(void (*func)(void* param), void* param)
+{
+	sys_threadstart_t	*start;
+	pthread_t			*thread;
+
+	start = malloc(sizeof(sys_threadstart_t));
+	thread = malloc(sizeof(pthread_t));
+	if (!start || !thread)
+	{
+		free(start);
+		free(thread);
+		return NULL;
+	}
+	start->func = func;
+	start->param = param;
+
+	if (pthread_create(thread, NULL, Sys_ThreadStart, start))
+	{
+		free(start);
+		free(thread);
+		return NULL;
+	}
+	return (sys_thread_t)thread;
+}
+
+void Sys_WaitThread(sys_thread_t thread)
+{
+	pthread_join(*(pthread_t*)thread, NULL);
+	free(thread);
+}
+
+sys_semaphore_t Sys_CreateSemaphore(int count)
+{
+	sem_t *sem = malloc(sizeof(sem_t));
+
+	if (sem && sem_init(sem, 0, count))
+	{
+		free(sem);
+		return NULL;
+	}
+	return (sys_semaphore_t)sem;
+}
+
+void Sys_DestroySemaphore(sys_semaphore_t sem)
+{
+	sem_destroy((sem_t*)sem);
+	free(sem);
+}
+
+void Sys_SemaphorePost(sys_semaphore_t sem, int count)
+{
+	while (count-- > 0)
+		sem_post((sem_t*)sem);
+}
+
+void Sys_SemaphoreWait(sys_semaphore_t sem)
+{
+	while (sem_wait((sem_t*)sem) == -1 && errno == EINTR)
+		;
+}
+
+int Sys_AtomicIncrement(volatile int* value)
+{
+	return __sync_add_and_fetch(value, 1);
+}
+
+int Sys_NumProcessors(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
+
+//============================================
+
+void *Sys_MapFile(const char *path, int *size)
+{
+	struct stat	st;
+	void		*base;
+	int			fd;
+
+	*size = 0;
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) == -1 || st.st_size <= 0 || st.st_size > 0x7fffffff)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // mapping keeps its own reference
+	if (base == MAP_FAILED)
+		return NULL;
+
+	*size = (int)st.st_size;
+	return base;
+}
+
+void Sys_UnmapFile(void *base, int size)
+{
+	if (base)
+		munmap(base, size);
+}
+
 char *strlwr (char *s)
 {
 	while (*s) {
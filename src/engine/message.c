@@ -343,4 +343,584 @@ void MSG_UnpackSolid32(int packedsolid, vec3_t mins, vec3_t maxs)
 
 	VectorSet(mins, -x, -y, -zd);
 	VectorSet(maxs, x, y, zu);
-}
\ No newline at end of file
+}
+
+//
+// bit packed reading and writing, bits fill each byte from lowest to highest
+//
+
+void MSG_BeginWritingBits(sizebuf_t* sb)
+{
+	sb->bit = sb->cursize << 3;
+}
+
+void MSG_WriteBits(sizebuf_t* sb, unsigned int value, int bits)
+{
+	int		put, shift;
+	byte	*b;
+
+	while (bits > 0)
+	{
+		shift = sb->bit & 7;
+		if (!shift)
+		{
+			b = SZ_GetSpace(sb, 1);
+			*b = 0;
+			sb->bit = (sb->cursize - 1) << 3; // buffer may have been cleared on overflow
+		}
+
+		put = 8 - shift;
+		if (put > bits)
+			put = bits;
+
+		sb->data[sb->bit >> 3] |= (value & ((1 << put) - 1)) << shift;
+		value >>= put;
+		bits -= put;
+		sb->bit += put;
+	}
+}
+
+// copies bits written by MSG_WriteBits to another buffer
+void MSG_WriteBitData(sizebuf_t* sb, const byte* data, int bits)
+{
+	int		i;
+
+	for (i = 0; bits > 0; i++, bits -= 8)
+		MSG_WriteBits(sb, data[i], bits < 8 ? bits : 8);
+}
+
+void MSG_BeginReadingBits(sizebuf_t* msg)
+{
+	msg->bit = msg->readcount << 3;
+}
+
+// readcount is kept past the last partially read byte, so byte reads may follow
+// returns -1 and sets readcount past cursize if no more bits are available
+int MSG_ReadBits(sizebuf_t* msg_read, int bits)
+{
+	unsigned int	value;
+	int				got, take, shift;
+
+	value = 0;
+	for (got = 0; got < bits; got += take)
+	{
+		if ((msg_read->bit >> 3) >= msg_read->cursize)
+		{
+			msg_read->readcount = msg_read->cursize + 1;
+			return -1;
+		}
+
+		shift = msg_read->bit & 7;
+		take = 8 - shift;
+		if (take > bits - got)
+			take = bits - got;
+
+		value |= ((msg_read->data[msg_read->bit >> 3] >> shift) & ((1 << take) - 1)) << got;
+		msg_read->bit += take;
+	}
+
+	msg_read->readcount = (msg_read->bit + 7) >> 3;
+	return value;
+}
+
+/*
+	Coordinates which are whole numbers within +/-4096 are sent in 13 bits,
+	anything else is sent as raw float so values arrive exactly as written.
+*/
+#define COORD_INT_BITS	13
+#define COORD_INT_BIAS	(1 << (COORD_INT_BITS - 1))
+
+static void MSG_WriteBitsCoord(sizebuf_t* sb, float f)
+{
+	union
+	{
+		float	f;
+		int		l;
+	} dat;
+	int		i;
+
+	i = (int)f;
+	if ((float)i == f && i >= -COORD_INT_BIAS && i < COORD_INT_BIAS)
+	{
+		MSG_WriteBits(sb, 0, 1);
+		MSG_WriteBits(sb, i + COORD_INT_BIAS, COORD_INT_BITS);
+		return;
+	}
+
+	dat.f = f;
+	MSG_WriteBits(sb, 1, 1);
+	MSG_WriteBits(sb, dat.l, 32);
+}
+
+static float MSG_ReadBitsCoord(sizebuf_t* msg_read)
+{
+	union
+	{
+		float	f;
+		int		l;
+	} dat;
+
+	if (!MSG_ReadBits(msg_read, 1))
+		return (float)(MSG_ReadBits(msg_read, COORD_INT_BITS) - COORD_INT_BIAS);
+
+	dat.l = MSG_ReadBits(msg_read, 32);
+	return dat.f;
+}
+
+
+/*
+==============================================================
+
+BIT PACKED DELTA COMPRESSION
+
+Each networked field has an entry in a table with its wire size and how it
+is quantized. A delta is the index of the last changed field followed by
+a changed bit for each field up to it, so tables are sorted with most
+frequently changing fields first.
+
+==============================================================
+*/
+
+typedef enum
+{
+	NF_INT,		// integer field stored in 1, 2 or 4 bytes
+	NF_COORD,	// float sent with MSG_WriteBitsCoord
+	NF_QUANT,	// unsigned float, value * scale
+	NF_SQUANT,	// signed float, value * scale
+	NF_ANGLE,	// angle in 'bits' precision
+	NF_EVENT	// integer which is sent when nonzero and is cleared when not sent
+} netfieldtype_t;
+
+typedef struct
+{
+	int		offset;
+	byte	size;		// size of field in structure
+	byte	type;		// netfieldtype_t
+	byte	bits;		// bits on wire, unused for NF_COORD
+	float	scale;		// for NF_QUANT and NF_SQUANT
+} netfield_t;
+
+#define NETFIELD_COUNT_BITS	6	// tables must have less than 64 fields
+
+#define NETF(type, field, ftype, bits, scale) { (int)(size_t)&((type*)0)->field, sizeof(((type*)0)->field), ftype, bits, scale }
+#define ESF(field, ftype, bits, scale) NETF(entity_state_t, field, ftype, bits, scale)
+#define PSF(field, ftype, bits, scale) NETF(player_state_t, field, ftype, bits, scale)
+
+static const netfield_t entityStateFields[] =
+{
+	ESF(origin[0], NF_COORD, 0, 0),
+	ESF(origin[1], NF_COORD, 0, 0),
+	ESF(origin[2], NF_COORD, 0, 0),
+	ESF(angles[1], NF_ANGLE, 8, 0),
+	ESF(frame, NF_INT, 16, 0),
+	ESF(event, NF_EVENT, 8, 0),
+	ESF(angles[0], NF_ANGLE, 8, 0),
+	ESF(angles[2], NF_ANGLE, 8, 0),
+	ESF(animationIdx, NF_INT, 8, 0),
+	ESF(animStartTime, NF_INT, 32, 0),
+	ESF(effects, NF_INT, 32, 0),
+	ESF(renderFlags, NF_INT, 32, 0),
+	ESF(renderAlpha, NF_QUANT, 8, 255),
+	ESF(loopingSound, NF_INT, 16, 0),
+	ESF(modelindex, NF_INT, 16, 0),
+	ESF(hidePartBits, NF_INT, 8, 0),
+	ESF(skinnum, NF_INT, 8, 0),
+	ESF(eType, NF_INT, 8, 0),
+	ESF(packedSolid, NF_INT, 32, 0),
+	ESF(renderScale, NF_QUANT, 8, 16),
+	ESF(renderColor[0], NF_QUANT, 8, 255),
+	ESF(renderColor[1], NF_QUANT, 8, 255),
+	ESF(renderColor[2], NF_QUANT, 8, 255),
+	ESF(attachments[0].modelindex, NF_INT, 16, 0),
+	ESF(attachments[0].parentTag, NF_INT, 8, 0),
+	ESF(attachments[1].modelindex, NF_INT, 16, 0),
+	ESF(attachments[1].parentTag, NF_INT, 8, 0),
+	ESF(attachments[2].modelindex, NF_INT, 16, 0),
+	ESF(attachments[2].parentTag, NF_INT, 8, 0)
+};
+
+static const netfield_t playerStateFields[] =
+{
+	PSF(pmove.origin[0], NF_COORD, 0, 0),
+	PSF(pmove.origin[1], NF_COORD, 0, 0),
+	PSF(pmove.origin[2], NF_COORD, 0, 0),
+	PSF(pmove.velocity[0], NF_COORD, 0, 0),
+	PSF(pmove.velocity[1], NF_COORD, 0, 0),
+	PSF(pmove.velocity[2], NF_COORD, 0, 0),
+	PSF(viewangles[1], NF_ANGLE, 16, 0),
+	PSF(viewangles[0], NF_ANGLE, 16, 0),
+	PSF(pmove.pm_flags, NF_INT, 32, 0),
+	PSF(pmove.pm_time, NF_INT, 8, 0),
+	PSF(viewmodel_frame, NF_INT, 8, 0),
+	PSF(kick_angles[0], NF_SQUANT, 8, 4),
+	PSF(kick_angles[1], NF_SQUANT, 8, 4),
+	PSF(kick_angles[2], NF_SQUANT, 8, 4),
+	PSF(viewmodel_offset[0], NF_SQUANT, 8, 4),
+	PSF(viewmodel_offset[1], NF_SQUANT, 8, 4),
+	PSF(viewmodel_offset[2], NF_SQUANT, 8, 4),
+	PSF(viewmodel_angles[0], NF_SQUANT, 8, 4),
+	PSF(viewmodel_angles[1], NF_SQUANT, 8, 4),
+	PSF(viewmodel_angles[2], NF_SQUANT, 8, 4),
+	PSF(viewoffset[2], NF_SQUANT, 8, 1),
+	PSF(viewangles[2], NF_ANGLE, 16, 0),
+	PSF(viewoffset[0], NF_SQUANT, 8, 1),
+	PSF(viewoffset[1], NF_SQUANT, 8, 1),
+	PSF(pmove.delta_angles[0], NF_INT, 16, 0),
+	PSF(pmove.delta_angles[1], NF_INT, 16, 0),
+	PSF(pmove.delta_angles[2], NF_INT, 16, 0),
+	PSF(pmove.pm_type, NF_INT, 8, 0),
+	PSF(pmove.gravity, NF_INT, 16, 0),
+	PSF(pmove.mins[0], NF_SQUANT, 8, 1),
+	PSF(pmove.mins[1], NF_SQUANT, 8, 1),
+	PSF(pmove.mins[2], NF_SQUANT, 8, 1),
+	PSF(pmove.maxs[0], NF_SQUANT, 8, 1),
+	PSF(pmove.maxs[1], NF_SQUANT, 8, 1),
+	PSF(pmove.maxs[2], NF_SQUANT, 8, 1),
+	PSF(viewmodel[0], NF_INT, 16, 0),
+	PSF(viewmodel[1], NF_INT, 16, 0),
+	PSF(fx.blend[0], NF_QUANT, 8, 255),
+	PSF(fx.blend[1], NF_QUANT, 8, 255),
+	PSF(fx.blend[2], NF_QUANT, 8, 255),
+	PSF(fx.blend[3], NF_QUANT, 8, 255),
+	PSF(fx.blur, NF_QUANT, 8, 32),
+	PSF(fx.contrast, NF_QUANT, 8, 32),
+	PSF(fx.grayscale, NF_QUANT, 8, 255),
+	PSF(fx.inverse, NF_QUANT, 1, 1),
+	PSF(fx.noise, NF_QUANT, 8, 255),
+	PSF(fx.intensity, NF_QUANT, 8, 32),
+	PSF(fov, NF_QUANT, 8, 1),
+	PSF(rdflags, NF_INT, 8, 0)
+};
+
+#define NUM_ENTITY_FIELDS	(sizeof(entityStateFields) / sizeof(entityStateFields[0]))
+#define NUM_PLAYER_FIELDS	(sizeof(playerStateFields) / sizeof(playerStateFields[0]))
+
+static unsigned int MSG_GetFieldInt(const netfield_t* field, const byte* base)
+{
+	switch (field->size)
+	{
+	case 1:
+		return *(const byte*)(base + field->offset);
+	case 2:
+		return *(const unsigned short*)(base + field->offset);
+	default:
+		return *(const unsigned int*)(base + field->offset);
+	}
+}
+
+static void MSG_SetFieldInt(const netfield_t* field, byte* base, unsigned int value)
+{
+	switch (field->size)
+	{
+	case 1:
+		*(byte*)(base + field->offset) = value;
+		break;
+	case 2:
+		*(unsigned short*)(base + field->offset) = value;
+		break;
+	default:
+		*(unsigned int*)(base + field->offset) = value;
+		break;
+	}
+}
+
+// returns the number of fields up to and including the last one that has to be sent
+static int MSG_LastChangedField(const netfield_t* fields, int numfields, const byte* from, const byte* to)
+{
+	int		i, lc;
+
+	lc = 0;
+	for (i = 0; i < numfields; i++)
+	{
+		if (fields[i].type == NF_EVENT)
+		{
+			if (MSG_GetFieldInt(&fields[i], to))
+				lc = i + 1;
+		}
+		else if (MSG_GetFieldInt(&fields[i], from) != MSG_GetFieldInt(&fields[i], to))
+			lc = i + 1;
+	}
+	return lc;
+}
+
+static void MSG_WriteField(sizebuf_t* sb, const netfield_t* field, const byte* base)
+{
+	float	f;
+	int		q, max;
+
+	if (field->type == NF_INT || field->type == NF_EVENT)
+	{
+		MSG_WriteBits(sb, MSG_GetFieldInt(field, base), field->bits);
+		return;
+	}
+
+	f = *(const float*)(base + field->offset);
+	switch (field->type)
+	{
+	case NF_COORD:
+		MSG_WriteBitsCoord(sb, f);
+		break;
+	case NF_ANGLE:
+		MSG_WriteBits(sb, (int)(f * (1 << field->bits) / 360) & ((1 << field->bits) - 1), field->bits);
+		break;
+	case NF_QUANT:
+		q = (int)(f * field->scale);
+		max = (1 << field->bits) - 1;
+		MSG_WriteBits(sb, q < 0 ? 0 : (q > max ? max : q), field->bits);
+		break;
+	case NF_SQUANT:
+		q = (int)(f * field->scale);
+		max = (1 << (field->bits - 1)) - 1;
+		q = q < -max ? -max : (q > max ? max : q);
+		MSG_WriteBits(sb, q & ((1 << field->bits) - 1), field->bits);
+		break;
+	}
+}
+
+static void MSG_ReadField(sizebuf_t* msg_read, const netfield_t* field, byte* base)
+{
+	float	*f;
+	int		q;
+
+	if (field->type == NF_INT || field->type == NF_EVENT)
+	{
+		MSG_SetFieldInt(field, base, MSG_ReadBits(msg_read, field->bits));
+		return;
+	}
+
+	f = (float*)(base + field->offset);
+	switch (field->type)
+	{
+	case NF_COORD:
+		*f = MSG_ReadBitsCoord(msg_read);
+		break;
+	case NF_ANGLE:
+		*f = MSG_ReadBits(msg_read, field->bits) * (360.0f / (1 << field->bits));
+		break;
+	case NF_QUANT:
+		*f = MSG_ReadBits(msg_read, field->bits) / field->scale;
+		break;
+	case NF_SQUANT:
+		q = MSG_ReadBits(msg_read, field->bits);
+		if (q & (1 << (field->bits - 1)))
+			q -= 1 << field->bits;
+		*f = q / field->scale;
+		break;
+	}
+}
+
+static void MSG_WriteDeltaFields(sizebuf_t* sb, const netfield_t* fields, int lc, const byte* from, const byte* to)
+{
+	int		i;
+
+	MSG_WriteBits(sb, lc, NETFIELD_COUNT_BITS);
+	for (i = 0; i < lc; i++)
+	{
+		if (fields[i].type == NF_EVENT ? !MSG_GetFieldInt(&fields[i], to) : MSG_GetFieldInt(&fields[i], from) == MSG_GetFieldInt(&fields[i], to))
+		{
+			MSG_WriteBits(sb, 0, 1);
+			continue;
+		}
+		MSG_WriteBits(sb, 1, 1);
+		MSG_WriteField(sb, &fields[i], to);
+	}
+}
+
+// to must already hold the state delta is from
+static void MSG_ReadDeltaFields(sizebuf_t* msg_read, const netfield_t* fields, int numfields, byte* to)
+{
+	int		i, lc;
+
+	lc = MSG_ReadBits(msg_read, NETFIELD_COUNT_BITS);
+	if (lc < 0 || lc > numfields)
+		lc = numfields; // caller will notice end of message
+
+	for (i = 0; i < numfields; i++)
+	{
+		if (i < lc && MSG_ReadBits(msg_read, 1) == 1)
+			MSG_ReadField(msg_read, &fields[i], to);
+		else if (fields[i].type == NF_EVENT)
+			MSG_SetFieldInt(&fields[i], to, 0);
+	}
+}
+
+/*
+==================
+MSG_WriteEntityNumBits
+
+Starts an entity in bit packed SVC_PACKET_ENTITIES, numbers must be written
+in increasing order beginning with lastnumber 0. Most entities follow the
+previous one so the gap is run length coded.
+==================
+*/
+void MSG_WriteEntityNumBits(sizebuf_t* sb, int number, int lastnumber, qboolean remove)
+{
+	int		gap;
+
+	MSG_WriteBits(sb, 1, 1); // more entities follow
+
+	gap = number - lastnumber - 1;
+	if (!gap)
+		MSG_WriteBits(sb, 1, 1);
+	else if (gap > 0 && gap < 15)
+	{
+		MSG_WriteBits(sb, 0, 1);
+		MSG_WriteBits(sb, gap, 4);
+	}
+	else
+	{
+		MSG_WriteBits(sb, 0, 1);
+		MSG_WriteBits(sb, 15, 4);
+		MSG_WriteBits(sb, number, ENTITYNUM_BITS);
+	}
+
+	MSG_WriteBits(sb, remove ? 1 : 0, 1);
+}
+
+/*
+==================
+MSG_ReadEntityNumBits
+
+Returns the next entity number or 0 at the end of packet entities
+==================
+*/
+int MSG_ReadEntityNumBits(sizebuf_t* msg_read, int lastnumber, qboolean* remove)
+{
+	int		number, gap;
+
+	*remove = false;
+	if (MSG_ReadBits(msg_read, 1) != 1)
+		return 0;
+
+	if (MSG_ReadBits(msg_read, 1) == 1)
+		number = lastnumber + 1;
+	else
+	{
+		gap = MSG_ReadBits(msg_read, 4);
+		if (gap == 15)
+			number = MSG_ReadBits(msg_read, ENTITYNUM_BITS);
+		else
+			number = lastnumber + 1 + gap;
+	}
+
+	*remove = MSG_ReadBits(msg_read, 1) == 1;
+	return number;
+}
+
+/*
+==================
+MSG_WriteDeltaEntityBits
+
+Bit packed MSG_WriteDeltaEntity without the entity number.
+Writes nothing and returns false when the entity has not changed and force is not set.
+==================
+*/
+qboolean MSG_WriteDeltaEntityBits(sizebuf_t* sb, entity_state_t* from, entity_state_t* to, qboolean force, qboolean newentity)
+{
+	qboolean	oldorigin;
+	int			i, lc;
+
+	lc = MSG_LastChangedField(entityStateFields, NUM_ENTITY_FIELDS, (byte*)from, (byte*)to);
+
+	// receiver starts old_origin from previous origin
+	oldorigin = false;
+	if (newentity || (to->renderFlags & RF_BEAM))
+		oldorigin = !VectorCompare(to->old_origin, from->origin);
+
+	if (!lc && !oldorigin && !force)
+		return false;
+
+	MSG_WriteDeltaFields(sb, entityStateFields, lc, (byte*)from, (byte*)to);
+
+	MSG_WriteBits(sb, oldorigin ? 1 : 0, 1);
+	if (oldorigin)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			if (to->old_origin[i] == from->origin[i])
+			{
+				MSG_WriteBits(sb, 0, 1);
+				continue;
+			}
+			MSG_WriteBits(sb, 1, 1);
+			MSG_WriteBitsCoord(sb, to->old_origin[i]);
+		}
+	}
+	return true;
+}
+
+/*
+==================
+MSG_ReadDeltaEntityBits
+
+Can go from either a baseline or a previous packet entity
+==================
+*/
+void MSG_ReadDeltaEntityBits(sizebuf_t* msg_read, entity_state_t* from, entity_state_t* to, int number)
+{
+	int		i;
+
+	*to = *from;
+	VectorCopy(from->origin, to->old_origin);
+	to->number = number;
+
+	MSG_ReadDeltaFields(msg_read, entityStateFields, NUM_ENTITY_FIELDS, (byte*)to);
+
+	if (MSG_ReadBits(msg_read, 1) == 1)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			if (MSG_ReadBits(msg_read, 1) == 1)
+				to->old_origin[i] = MSG_ReadBitsCoord(msg_read);
+		}
+	}
+}
+
+/*
+==================
+MSG_WriteDeltaPlayerstateBits
+
+Stats are sent after the table fields with a mask of changed ones
+==================
+*/
+void MSG_WriteDeltaPlayerstateBits(sizebuf_t* sb, player_state_t* from, player_state_t* to)
+{
+	int			i;
+	unsigned	statbits;
+
+	MSG_WriteDeltaFields(sb, playerStateFields, MSG_LastChangedField(playerStateFields, NUM_PLAYER_FIELDS, (byte*)from, (byte*)to), (byte*)from, (byte*)to);
+
+	statbits = 0;
+	for (i = 0; i < MAX_STATS; i++)
+		if (to->stats[i] != from->stats[i])
+			statbits |= 1u << i;
+
+	if (!statbits)
+	{
+		MSG_WriteBits(sb, 0, 1);
+		return;
+	}
+
+	MSG_WriteBits(sb, 1, 1);
+	MSG_WriteBits(sb, statbits, MAX_STATS);
+	for (i = 0; i < MAX_STATS; i++)
+		if (statbits & (1u << i))
+			MSG_WriteBits(sb, to->stats[i], 16);
+}
+
+void MSG_ReadDeltaPlayerstateBits(sizebuf_t* msg_read, player_state_t* from, player_state_t* to)
+{
+	int			i;
+	unsigned	statbits;
+
+	*to = *from;
+	MSG_ReadDeltaFields(msg_read, playerStateFields, NUM_PLAYER_FIELDS, (byte*)to);
+
+	if (MSG_ReadBits(msg_read, 1) != 1)
+		return;
+
+	statbits = MSG_ReadBits(msg_read, MAX_STATS);
+	for (i = 0; i < MAX_STATS; i++)
+		if (statbits & (1u << i))
+			to->stats[i] = (short)MSG_ReadBits(msg_read, 16);
+}
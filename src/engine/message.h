@@ -55,6 +55,19 @@ float	MSG_ReadAngle16(sizebuf_t* sb);
 void	MSG_ReadDir(sizebuf_t* sb, vec3_t vector);
 void	MSG_ReadData(sizebuf_t* sb, void* buffer, int size);
 
+void	MSG_BeginWritingBits(sizebuf_t* sb);
+void	MSG_WriteBits(sizebuf_t* sb, unsigned int value, int bits);
+void	MSG_WriteBitData(sizebuf_t* sb, const byte* data, int bits);
+void	MSG_BeginReadingBits(sizebuf_t* sb);
+int		MSG_ReadBits(sizebuf_t* sb, int bits);
+
+void	MSG_WriteEntityNumBits(sizebuf_t* sb, int number, int lastnumber, qboolean remove);
+int		MSG_ReadEntityNumBits(sizebuf_t* sb, int lastnumber, qboolean* remove);
+qboolean MSG_WriteDeltaEntityBits(sizebuf_t* sb, entity_state_t* from, entity_state_t* to, qboolean force, qboolean newentity);
+void	MSG_ReadDeltaEntityBits(sizebuf_t* sb, entity_state_t* from, entity_state_t* to, int number);
+void	MSG_WriteDeltaPlayerstateBits(sizebuf_t* sb, player_state_t* from, player_state_t* to);
+void	MSG_ReadDeltaPlayerstateBits(sizebuf_t* sb, player_state_t* from, player_state_t* to);
+
 int		MSG_PackSolid32(const vec3_t mins, const vec3_t maxs);
 void	MSG_UnpackSolid32(int packedsolid, vec3_t mins, vec3_t maxs);
 
@@ -67,8 +67,8 @@ Mod_ForName
 static cached_model_t* Mod_ForName(const cacheuser_t user, const char* name, const qboolean bMustLoad)
 {
 	cached_model_t* mod;
-	unsigned* buf;
-	int index, filelen;
+	fsmapped_t file;
+	int index;
 
 	if (name[0] == (0 || '\0'))
 		Com_Error(ERR_DROP, "%s: NULL name.\n", __FUNCTION__);
@@ -134,8 +134,7 @@ static cached_model_t* Mod_ForName(const cacheuser_t user, const char* name, con
 	}
 
 	// all the others are loaded from file
-	filelen = FS_LoadFile(mod->name, &buf);
-	if (!buf)
+	if (!FS_MapFile(mod->name, &file))
 	{
 		if (bMustLoad)
 			Com_Error(ERR_DROP, "%s: model '%s' not found.\n", __FUNCTION__, mod->name);
@@ -146,7 +145,7 @@ static cached_model_t* Mod_ForName(const cacheuser_t user, const char* name, con
 		return NULL;
 	}
 
-	switch (LittleLong(*(unsigned*)buf))
+	switch (file.length < 4 ? 0 : LittleLong(*(const unsigned*)file.data))
 	{
 	case BSP_IDENT:
 	case QBISM_IDENT:
@@ -165,7 +164,7 @@ static cached_model_t* Mod_ForName(const cacheuser_t user, const char* name, con
 		break;
 	}
 
-	FS_FreeFile(buf);
+	FS_UnmapFile(&file);
 
 	return mod;
 }
@@ -14,12 +14,24 @@ See the attached GNU General Public License v2 for more details.
 
 packet header
 -------------
-31	sequence
+30	sequence
+1	is this packet a fragment
 1	does this message contain a reliable payload
 31	acknowledge sequence
 1	acknowledge receipt of even/odd message
 16	qport
 
+fragments also have
+16	offset of fragment in message
+15	fragment length
+1	is this the last fragment
+
+Messages which don't fit in MAX_MSGLEN are split into net_fragsize
+fragments which all carry the same sequence. Receiver joins them in
+Netchan_Process and handles the message once the last one arrives,
+a missing fragment drops the whole message. Fragments which exceed
+fragment_budget are sent with Netchan_TransmitNextFragment later.
+
 The remote connection never knows if it missed a reliable message, the
 local side detects that it has been dropped by seeing a sequence acknowledge
 higher thatn the last reliable sequence, but without the correct evon/odd
@@ -67,10 +79,14 @@ unacknowledged reliable
 cvar_t		*net_showpackets;
 cvar_t		*net_showdrop;
 cvar_t		*net_qport;
+cvar_t		*net_fragsize;
 
 netadr_t	net_from;
 sizebuf_t	net_message;
-byte		net_message_buffer[MAX_MSGLEN];
+byte		net_message_buffer[MAX_FRAGMSGLEN];
+
+#define	FRAGMENT_BIT	(1u<<30)	// in sequence
+#define	FRAGMENT_LAST	0x8000		// in fragment length
 
 /*
 ===============
@@ -88,6 +104,7 @@ void Netchan_Init (void)
 	net_showpackets = Cvar_Get ("net_showpackets", "0", 0, NULL);
 	net_showdrop = Cvar_Get ("net_showdrop", "0", 0, NULL);
 	net_qport = Cvar_Get ("qport", va("%i", port), CVAR_NOSET, NULL);
+	net_fragsize = Cvar_Get ("net_fragsize", "1200", 0, NULL);
 }
 
 /*
@@ -203,9 +220,10 @@ A 0 length will still generate a packet and deal with the reliable messages.
 void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 {
 	sizebuf_t	send;
-	byte		send_buf[MAX_MSGLEN];
+	byte		send_buf[MAX_FRAGMSGLEN];
 	qboolean	send_reliable;
 	unsigned	w1, w2;
+	int			headerlen, maxpacket;
 
 // check for message overflow
 	if (chan->message.overflowed)
@@ -215,6 +233,10 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 		return;
 	}
 
+	// a new message can't start before the last one is fully sent
+	if (chan->unsent_fragments)
+		Netchan_TransmitNextFragment (chan, 0);
+
 	send_reliable = Netchan_NeedReliable (chan);
 
 	if (!chan->reliable_length && chan->message.cursize)
@@ -229,7 +251,7 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 // write the packet header
 	SZ_Init (&send, send_buf, sizeof(send_buf));
 
-	w1 = ( chan->outgoing_sequence & ~(1<<31) ) | (send_reliable<<31);
+	w1 = ( chan->outgoing_sequence & ~(3u<<30) ) | (send_reliable<<31);
 	w2 = ( chan->incoming_sequence & ~(1<<31) ) | (chan->incoming_reliable_sequence<<31);
 
 	chan->outgoing_sequence++;
@@ -241,6 +263,7 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 	// send the qport if we are a client
 	if (chan->sock == NS_CLIENT)
 		MSG_WriteShort (&send, net_qport->value);
+	headerlen = send.cursize;
 
 // copy the reliable message to the packet first
 	if (send_reliable)
@@ -255,6 +278,20 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 	else
 		Com_Printf ("Netchan_Transmit: dumped unreliable\n");
 
+// split it when it is too big for a single packet, loopback takes any size
+	maxpacket = (chan->remote_address.type == NA_LOOPBACK) ? MAX_FRAGMSGLEN : MAX_MSGLEN;
+	if (send.cursize > maxpacket)
+	{
+		chan->unsent_fragments = true;
+		chan->unsent_header = w1;
+		chan->unsent_start = 0;
+		chan->unsent_length = send.cursize - headerlen;
+		memcpy (chan->unsent_buf, send.data + headerlen, chan->unsent_length);
+
+		Netchan_TransmitNextFragment (chan, chan->fragment_budget);
+		return;
+	}
+
 // send the datagram
 	NET_SendPacket (chan->sock, send.cursize, send.data, chan->remote_address);
 
@@ -276,6 +313,65 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 	}
 }
 
+/*
+===============
+Netchan_TransmitNextFragment
+
+Sends fragments of the pending message until budget bytes went out,
+budget of 0 sends all of them
+================
+*/
+void Netchan_TransmitNextFragment (netchan_t *chan, int budget)
+{
+	sizebuf_t	send;
+	byte		send_buf[MAX_MSGLEN];
+	int			fragsize, length, sent;
+	qboolean	last;
+
+	fragsize = (int)net_fragsize->value;
+	if (fragsize < 256)
+		fragsize = 256;
+	else if (fragsize > MAX_MSGLEN - 16)
+		fragsize = MAX_MSGLEN - 16;
+
+	sent = 0;
+	while (chan->unsent_fragments)
+	{
+		length = chan->unsent_length - chan->unsent_start;
+		last = (length <= fragsize);
+		if (!last)
+			length = fragsize;
+
+		SZ_Init (&send, send_buf, sizeof(send_buf));
+		MSG_WriteLong (&send, chan->unsent_header | FRAGMENT_BIT);
+		MSG_WriteLong (&send, ( chan->incoming_sequence & ~(1<<31) ) | (chan->incoming_reliable_sequence<<31));
+		if (chan->sock == NS_CLIENT)
+			MSG_WriteShort (&send, net_qport->value);
+		MSG_WriteShort (&send, chan->unsent_start);
+		MSG_WriteShort (&send, length | (last ? FRAGMENT_LAST : 0));
+		SZ_Write (&send, chan->unsent_buf + chan->unsent_start, length);
+
+		NET_SendPacket (chan->sock, send.cursize, send.data, chan->remote_address);
+
+		if (net_showpackets->value)
+			Com_Printf ("send %4i : seq=%i fragment=%i/%i\n"
+				, send.cursize
+				, chan->unsent_header & ~(3u<<30)
+				, chan->unsent_start
+				, chan->unsent_length);
+
+		chan->unsent_start += length;
+		if (last)
+			chan->unsent_fragments = false;
+
+		sent += send.cursize;
+		if (budget > 0 && sent >= budget)
+			break;
+	}
+
+	chan->last_sent = curtime;
+}
+
 /*
 =================
 Netchan_Process
@@ -289,6 +385,8 @@ qboolean Netchan_Process (netchan_t *chan, sizebuf_t *msg)
 	unsigned	sequence, sequence_ack;
 	unsigned	reliable_ack, reliable_message;
 	int			qport;
+	qboolean	fragmented, last;
+	int			headerlen, fragstart, fraglength;
 
 // get sequence numbers		
 	MSG_BeginReading (msg);
@@ -301,10 +399,22 @@ qboolean Netchan_Process (netchan_t *chan, sizebuf_t *msg)
 
 	reliable_message = sequence >> 31;
 	reliable_ack = sequence_ack >> 31;
+	fragmented = (sequence & FRAGMENT_BIT) != 0;
 
-	sequence &= ~(1<<31);
+	sequence &= ~(3u<<30);
 	sequence_ack &= ~(1<<31);	
 
+	headerlen = msg->readcount;
+	fragstart = fraglength = 0;
+	last = false;
+	if (fragmented)
+	{
+		fragstart = MSG_ReadShort (msg) & 0xffff;
+		fraglength = MSG_ReadShort (msg) & 0xffff;
+		last = (fraglength & FRAGMENT_LAST) != 0;
+		fraglength &= ~FRAGMENT_LAST;
+	}
+
 	if (net_showpackets->value)
 	{
 		if (reliable_message)
@@ -335,6 +445,52 @@ qboolean Netchan_Process (netchan_t *chan, sizebuf_t *msg)
 		return false;
 	}
 
+//
+// join fragments, the message is used when the last one arrives
+//
+	if (fragmented)
+	{
+		if (sequence != (unsigned)chan->fragment_sequence)
+		{
+			chan->fragment_sequence = sequence;
+			chan->fragment_length = 0;
+		}
+
+		if (fragstart != chan->fragment_length)
+		{
+			if (net_showdrop->value)
+				Com_Printf ("%s: Dropped a message fragment %i of %i\n"
+					, NET_AdrToString (chan->remote_address)
+					, fragstart
+					, sequence);
+			return false;
+		}
+
+		if (msg->readcount + fraglength > msg->cursize
+			|| chan->fragment_length + fraglength > sizeof(chan->fragment_buf)
+			|| headerlen + chan->fragment_length + fraglength > msg->maxsize)
+		{
+			if (net_showdrop->value)
+				Com_Printf ("%s: Illegal fragment length %i at %i\n"
+					, NET_AdrToString (chan->remote_address)
+					, fraglength
+					, sequence);
+			return false;
+		}
+
+		memcpy (chan->fragment_buf + chan->fragment_length, msg->data + msg->readcount, fraglength);
+		chan->fragment_length += fraglength;
+
+		if (!last)
+			return false;
+
+		// continue as if the whole message came in one packet
+		memcpy (msg->data + headerlen, chan->fragment_buf, chan->fragment_length);
+		msg->cursize = headerlen + chan->fragment_length;
+		msg->readcount = headerlen;
+		chan->fragment_length = 0;
+	}
+
 //
 // dropped packets don't keep the message from being used
 //
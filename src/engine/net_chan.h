@@ -55,18 +55,32 @@ typedef struct
 // message is copied to this buffer when it is first transfered
 	int			reliable_length;
 	byte		reliable_buf[MAX_MSGLEN - 16];	// unacked reliable message
+
+// message too large for a single packet is sent in fragments
+	int			fragment_budget;	// bytes of fragments sent by each Netchan_Transmit, 0 = all
+	qboolean	unsent_fragments;
+	unsigned	unsent_header;		// first header word of fragmented message
+	int			unsent_start;
+	int			unsent_length;
+	byte		unsent_buf[MAX_FRAGMSGLEN];
+
+// incoming fragments are joined here
+	int			fragment_sequence;
+	int			fragment_length;
+	byte		fragment_buf[MAX_FRAGMSGLEN];
 } netchan_t;
 
 
 extern	netadr_t	net_from;
 extern	sizebuf_t	net_message;
-extern	byte		net_message_buffer[MAX_MSGLEN];
+extern	byte		net_message_buffer[MAX_FRAGMSGLEN];
 
 void Netchan_Init(void);
 void Netchan_Setup(netsrc_t sock, netchan_t* chan, netadr_t adr, int qport);
 
 qboolean Netchan_NeedReliable(netchan_t* chan);
 void Netchan_Transmit(netchan_t* chan, int length, byte* data);
+void Netchan_TransmitNextFragment(netchan_t* chan, int budget);
 void Netchan_OutOfBand(int net_socket, netadr_t adr, int length, byte* data);
 void Netchan_OutOfBandPrint(int net_socket, netadr_t adr, char* format, ...);
 qboolean Netchan_Process(netchan_t* chan, sizebuf_t* msg);
@@ -48,6 +48,9 @@ Pragma's interface to the networking layer.
 // max length of a message
 #define	MAX_MSGLEN		1400	
 
+// max length of a netchan message sent in MAX_MSGLEN fragments
+#define	MAX_FRAGMSGLEN	16384
+
 // size of header in each packet two ints and a short
 //#define	PACKET_HEADER	10		// braxi: commented out, unused	
 
@@ -17,7 +17,7 @@ See the attached GNU General Public License v2 for more details.
 
 typedef struct
 {
-	byte	data[MAX_MSGLEN];
+	byte	data[MAX_FRAGMSGLEN];	// loopback is never fragmented
 	int		datalen;
 } loopmsg_t;
 
@@ -193,6 +193,9 @@ void Com_Error (int code, char *fmt, ...)
 		Sys_Error ("recursive error after: %s", msg);
 	recursive = true;
 
+	// error may come from a job running on main thread
+	Job_Abort();
+
 	va_start (argptr,fmt);
 	vsprintf (msg,fmt,argptr);
 	va_end (argptr);
@@ -750,25 +753,92 @@ void Info_Print (char *s)
 
 						ZONE MEMORY ALLOCATION
 
-just cleared malloc with counters now...
+Every tag has its own zone. Small blocks are carved from per tag chunks and
+recycled through size class free lists, larger ones are malloced and linked
+into their zone's chain. Z_FreeTags drops the whole zone at once without
+looking at other tags' blocks.
 
 ==============================================================================
 */
 
 #define	Z_MAGIC		0x1d1d
 
+#define Z_MIN_CLASS_SHIFT	5	// smallest pooled block is 32 bytes including header
+#define Z_NUM_CLASSES		6	// 32, 64, 128, 256, 512, 1024
+#define Z_MAX_POOLED		(1 << (Z_MIN_CLASS_SHIFT + Z_NUM_CLASSES - 1))
+#define Z_CHUNK_SIZE		(64 * 1024)
 
 typedef struct zhead_s
 {
-	struct zhead_s	*prev, *next;
+	struct zhead_s	*prev, *next;	// next is the next free block when pooled block is free
 	short		magic;
+	short		sizeclass;		// -1 when malloced on its own
 	memtag_t	tag;			// for group free
 	int			size;
 } zhead_t;
 
-zhead_t		z_chain;
+typedef union zchunk_u
+{
+	union zchunk_u	*next;
+	double			align;		// keep blocks carved from chunk aligned
+} zchunk_t;
+
+typedef struct zpool_s
+{
+	zhead_t		*freelist;		// blocks freed with Z_Free
+	byte		*bump, *end;	// untouched part of the newest chunk
+} zpool_t;
+
+typedef struct zone_s
+{
+	zhead_t		chain;			// blocks too large for pools
+	zchunk_t	*chunks;
+	zpool_t		pools[Z_NUM_CLASSES];
+
+	int			count, bytes;
+	int			peakCount, peakBytes;
+	int			chunkBytes;		// reserved for pools
+} zone_t;
+
+static zone_t	z_zones[NUM_MEMORY_TAGS];
 int		z_count, z_bytes;
 
+static const char* z_tagNames[NUM_MEMORY_TAGS] =
+{
+	"none", "fx", "nav nodes", "server game", "client game", "gui", "qcvm", "qcvm svgame", "qcvm cgame", "qcvm gui"
+};
+
+/*
+========================
+Z_Init
+========================
+*/
+static void Z_Init (void)
+{
+	memset (z_zones, 0, sizeof(z_zones));
+	for (int i = 0; i < NUM_MEMORY_TAGS; i++)
+		z_zones[i].chain.next = z_zones[i].chain.prev = &z_zones[i].chain;
+}
+
+/*
+========================
+Z_SizeClass
+
+Returns pool index for block of size (including header), or -1 if too large
+========================
+*/
+static int Z_SizeClass (int size)
+{
+	int sizeclass = 0;
+
+	if (size > Z_MAX_POOLED)
+		return -1;
+
+	while ((1 << (Z_MIN_CLASS_SHIFT + sizeclass)) < size)
+		sizeclass++;
+	return sizeclass;
+}
+
 /*
 ========================
 Z_Free
@@ -777,17 +847,31 @@ Z_Free
 void Z_Free (void *ptr)
 {
 	zhead_t	*z;
+	zone_t	*zone;
 
 	z = ((zhead_t *)ptr) - 1;
 
 	if (z->magic != Z_MAGIC)
 		Com_Error (ERR_FATAL, "Z_Free: bad magic");
 
-	z->prev->next = z->next;
-	z->next->prev = z->prev;
-
+	zone = &z_zones[z->tag];
+	zone->count--;
+	zone->bytes -= z->size;
 	z_count--;
 	z_bytes -= z->size;
+
+	z->magic = 0;
+
+	if (z->sizeclass >= 0)
+	{
+		// back to pool, chunk is released with the rest of the tag
+		z->next = zone->pools[z->sizeclass].freelist;
+		zone->pools[z->sizeclass].freelist = z;
+		return;
+	}
+
+	z->prev->next = z->next;
+	z->next->prev = z->prev;
 	free (z);
 }
 
@@ -799,7 +883,19 @@ Z_Stats_f
 */
 void Z_Stats_f (void)
 {
+	zone_t	*zone;
+
 	Com_Printf ("%i bytes in %i blocks\n", z_bytes, z_count);
+	Com_Printf ("%-12s %10s %8s %10s %8s %10s\n", "tag", "bytes", "blocks", "peak bytes", "peak", "pooled");
+
+	for (int i = 0; i < NUM_MEMORY_TAGS; i++)
+	{
+		zone = &z_zones[i];
+		if (!zone->peakCount)
+			continue;
+
+		Com_Printf ("%-12s %10i %8i %10i %8i %10i\n", z_tagNames[i], zone->bytes, zone->count, zone->peakBytes, zone->peakCount, zone->chunkBytes);
+	}
 }
 
 /*
@@ -809,14 +905,77 @@ Z_FreeTags
 */
 void Z_FreeTags (memtag_t tag)
 {
-	zhead_t	*z, *next;
+	zone_t		*zone;
+	zhead_t		*z, *next;
+	zchunk_t	*chunk, *nextchunk;
+
+	zone = &z_zones[tag];
 
-	for (z=z_chain.next ; z != &z_chain ; z=next)
+	for (z = zone->chain.next; z != &zone->chain; z = next)
 	{
 		next = z->next;
-		if (z->tag == tag)
-			Z_Free ((void *)(z+1));
+		free (z);
+	}
+
+	for (chunk = zone->chunks; chunk; chunk = nextchunk)
+	{
+		nextchunk = chunk->next;
+		free (chunk);
+	}
+
+	z_count -= zone->count;
+	z_bytes -= zone->bytes;
+
+	zone->chain.next = zone->chain.prev = &zone->chain;
+	zone->chunks = NULL;
+	memset (zone->pools, 0, sizeof(zone->pools));
+	zone->count = zone->bytes = 0;
+	zone->chunkBytes = 0;
+}
+
+/*
+========================
+Z_PoolAlloc
+
+Returns cleared block from pool, grabbing new chunk when it runs dry
+========================
+*/
+static zhead_t *Z_PoolAlloc (zone_t *zone, int sizeclass)
+{
+	zpool_t		*pool;
+	zchunk_t	*chunk;
+	zhead_t		*z;
+	int			blocksize;
+
+	pool = &zone->pools[sizeclass];
+	blocksize = 1 << (Z_MIN_CLASS_SHIFT + sizeclass);
+
+	if (pool->freelist)
+	{
+		z = pool->freelist;
+		pool->freelist = z->next;
+		memset (z, 0, blocksize);
+		return z;
+	}
+
+	if (pool->bump + blocksize > pool->end)
+	{
+		// chunks come from calloc, so fresh blocks are already cleared
+		chunk = calloc (1, sizeof(zchunk_t) + Z_CHUNK_SIZE);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = zone->chunks;
+		zone->chunks = chunk;
+		zone->chunkBytes += Z_CHUNK_SIZE;
+
+		pool->bump = (byte *)(chunk + 1);
+		pool->end = pool->bump + Z_CHUNK_SIZE;
 	}
+
+	z = (zhead_t *)pool->bump;
+	pool->bump += blocksize;
+	return z;
 }
 
 /*
@@ -827,9 +986,23 @@ Z_TagMalloc
 void *Z_TagMalloc (int size, memtag_t tag)
 {
 	zhead_t	*z;
-	
+	zone_t	*zone;
+	int		sizeclass;
+
+	if (tag < 0 || tag >= NUM_MEMORY_TAGS)
+	{
+		Com_Error(ERR_FATAL, "Z_TagMalloc: bad tag %i", tag);
+		return NULL; //msvc..
+	}
+
+	zone = &z_zones[tag];
 	size = size + sizeof(zhead_t);
-	z = malloc(size);
+	sizeclass = Z_SizeClass(size);
+
+	if (sizeclass >= 0)
+		z = Z_PoolAlloc(zone, sizeclass);
+	else
+		z = calloc(1, size);
 
 	if (!z)
 	{
@@ -837,19 +1010,28 @@ void *Z_TagMalloc (int size, memtag_t tag)
 		return NULL; //msvc..
 	}
 
-	memset (z, 0, size);
-
 	z_count++;
 	z_bytes += size;
 
+	zone->count++;
+	zone->bytes += size;
+	if (zone->count > zone->peakCount)
+		zone->peakCount = zone->count;
+	if (zone->bytes > zone->peakBytes)
+		zone->peakBytes = zone->bytes;
+
 	z->magic = Z_MAGIC;
 	z->tag = tag;
 	z->size = size;
+	z->sizeclass = sizeclass;
 
-	z->next = z_chain.next;
-	z->prev = &z_chain;
-	z_chain.next->prev = z;
-	z_chain.next = z;
+	if (sizeclass < 0)
+	{
+		z->next = zone->chain.next;
+		z->prev = &zone->chain;
+		zone->chain.next->prev = z;
+		zone->chain.next = z;
+	}
 
 	return (void *)(z+1);
 }
@@ -1172,7 +1354,7 @@ void Qcommon_Init (int argc, char **argv)
 	if (setjmp (abortframe) )
 		Sys_Error ("Error during initialization");
 
-	z_chain.next = z_chain.prev = &z_chain;
+	Z_Init ();
 
 	// prepare enough of the subsystems to handle
 	// cvar and command buffer management
@@ -1244,6 +1426,7 @@ void Qcommon_Init (int argc, char **argv)
 
 
 	Sys_Init ();
+	Job_Init ();
 	NET_Init ();
 	Netchan_Init ();
 
@@ -1405,4 +1588,5 @@ Qcommon_Shutdown
 */
 void Qcommon_Shutdown (void)
 {
+	Job_Shutdown ();
 }
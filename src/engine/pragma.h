@@ -72,7 +72,9 @@ extern qboolean print_time;
 #include "network.h"
 #include "net_chan.h"
 #include "cmodel.h"
+#include "jobs.h"
 #include "filesystem.h"
+#include "inflate.h"
 #include "message.h"
 #include "usercmd.h"
 
@@ -282,6 +284,23 @@ void	Sys_Error (char *error, ...);
 void	Sys_Quit (void);
 char	*Sys_GetClipboardData( void );
 
+// threads, only for work that doesn't touch zone memory or other globals
+typedef void *sys_thread_t;
+typedef void *sys_semaphore_t;
+
+sys_thread_t	Sys_CreateThread(void (*func)(void* param), void* param);
+void			Sys_WaitThread(sys_thread_t thread);
+sys_semaphore_t	Sys_CreateSemaphore(int count);
+void			Sys_DestroySemaphore(sys_semaphore_t sem);
+void			Sys_SemaphorePost(sys_semaphore_t sem, int count);
+void			Sys_SemaphoreWait(sys_semaphore_t sem);
+int				Sys_AtomicIncrement(volatile int* value);
+int				Sys_NumProcessors(void);
+
+// read only file mappings, NULL when file can't be mapped
+void	*Sys_MapFile(const char* path, int* size);
+void	Sys_UnmapFile(void* base, int size);
+
 /*
 ==============================================================
 
@@ -25,9 +25,16 @@ the svc_strings[] array in cl_parse.c should mirror svc_ops_e enum
 #ifndef _PRAGMA_PROTOCOL_H_
 #define _PRAGMA_PROTOCOL_H_
 
-#define PROTOCOL_REVISION	5
+#define PROTOCOL_REVISION	6
 #define	PROTOCOL_VERSION	('B'+'X'+PROTOCOL_REVISION)
 
+// same protocol but SVC_PLAYERINFO and SVC_PACKET_ENTITIES are bit packed
+// using field tables from message.c, clients connect with PROTOCOL_VERSION
+// and ask for it in extra connect argument, server confirms it in SVC_SERVERDATA
+#define	PROTOCOL_VERSION_BITS	(PROTOCOL_VERSION + 1000)
+
+#define ENTITYNUM_BITS		11	// (1<<ENTITYNUM_BITS) must be >= MAX_GENTITIES
+
 
 // copies of entity_state_t to keep buffered
 #define	UPDATE_BACKUP	16	
@@ -199,5 +206,8 @@ enum clc_ops_e
 
 #define	U_FREE4				(1<<31)
 
+// never sent, tells client the entity has bit packed delta (PROTOCOL_VERSION_BITS)
+#define	U_BITPACKED			U_FREE4
+
 
 #endif /*_PRAGMA_PROTOCOL_H_*/
@@ -26,6 +26,26 @@ char* Scr_ValueStringDeveloper(etype_t type, eval_t* val);
 
 #define ENTVARSOFFSET(ent) (int*)(&ent[0] + active_qcvm->offsetToEntVars)
 
+// instructions made from statement pairs by Scr_TranslateProgram, numbered past all progs opcodes
+enum
+{
+	OPX_UNKNOWN = 512,
+	OPX_LT_IFNOT,
+	OPX_LE_IFNOT,
+	OPX_GT_IFNOT,
+	OPX_GE_IFNOT,
+	OPX_EQ_F_IFNOT,
+	OPX_NE_F_IFNOT,
+	OPX_EQ_E_IFNOT,
+	OPX_NE_E_IFNOT,
+	OPX_NOT_F_IFNOT,
+	OPX_NOT_ENT_IFNOT,
+	OPX_LOAD_F_IFNOT,
+	OPX_ADDRESS_STOREP,
+	OPX_ADDRESS_STOREP_V,
+	OPX_NUM
+};
+
 
 
 
@@ -165,6 +185,9 @@ int ScrInternal_EnterFunction(dfunction_t* f)
 	if (active_qcvm->localstack_used + c > SCR_LOCALSTACK_SIZE)
 		Scr_RunError("Locals stack overflow.", vmDefs[active_qcvm->progsType].name);
 
+	if (active_qcvm->profile)
+		Scr_ProfileEnter(active_qcvm, (int)(f - active_qcvm->pFunctions));
+
 #if QCVM_DEBUG_LEVEL > 1
 	printf("[%s:#%i] Enter %s:%s - %i parms.\n", vmDefs[active_qcvm->progsType].name, active_qcvm->stackDepth, COM_SkipPath(Scr_GetString(f->s_file)), Scr_GetString(f->s_name),f->numparms);
 #endif
@@ -216,6 +239,8 @@ int ScrInternal_LeaveFunction()
 
 	// up stack
 	active_qcvm->stackDepth--;
+	if (active_qcvm->profile)
+		Scr_ProfileLeave(active_qcvm);
 #if QCVM_DEBUG_LEVEL > 1
 	printf("[%s:#%i] Leave %s:%s()\n", vmDefs[active_qcvm->progsType].name, active_qcvm->stackDepth, COM_SkipPath(Scr_GetString(active_qcvm->xfunction->s_file)), Scr_GetString(active_qcvm->xfunction->s_name));
 #endif
@@ -223,25 +248,228 @@ int ScrInternal_LeaveFunction()
 	return active_qcvm->stack[active_qcvm->stackDepth].s;
 }
 
+/*
+====================
+Scr_TranslateProgram
+
+Translates statements of loaded program for Scr_Execute, operands are resolved to
+pointers into globals and common statement pairs are fused into single instruction.
+Translated instructions map 1:1 to statements, so jumps and xstatement stay valid.
+====================
+*/
+void Scr_TranslateProgram(qcvm_t* vm)
+{
+	dstatement_t	*st;
+	qcinstr_t		*ins;
+	int				i;
+
+	vm->code = (qcinstr_t*)Z_TagMalloc(vm->progs->numStatements * sizeof(qcinstr_t), TAG_QCVM_MEMORY + vm->progsType);
+
+	for (i = 0; i < vm->progs->numStatements; i++)
+	{
+		st = &vm->pStatements[i];
+		ins = &vm->code[i];
+
+		ins->baseop = (st->op < OPX_UNKNOWN) ? st->op : OPX_UNKNOWN;
+		ins->op = ins->baseop;
+		ins->jump = (st->op == OP_GOTO) ? st->a : st->b;
+		ins->a = (eval_t*)&vm->pGlobals[st->a];
+		ins->b = (eval_t*)&vm->pGlobals[st->b];
+		ins->c = (eval_t*)&vm->pGlobals[st->c];
+	}
+
+	// fuse pairs, the second statement is kept as is in case something jumps to it
+	for (i = 0; i < vm->progs->numStatements - 1; i++)
+	{
+		st = &vm->pStatements[i];
+		ins = &vm->code[i];
+
+		if (st[1].op == OP_IFNOT)
+		{
+			switch (st->op)
+			{
+			case OP_LT: ins->op = OPX_LT_IFNOT; break;
+			case OP_LE: ins->op = OPX_LE_IFNOT; break;
+			case OP_GT: ins->op = OPX_GT_IFNOT; break;
+			case OP_GE: ins->op = OPX_GE_IFNOT; break;
+			case OP_EQ_F: ins->op = OPX_EQ_F_IFNOT; break;
+			case OP_NE_F: ins->op = OPX_NE_F_IFNOT; break;
+			case OP_EQ_E: ins->op = OPX_EQ_E_IFNOT; break;
+			case OP_NE_E: ins->op = OPX_NE_E_IFNOT; break;
+			case OP_NOT_F: ins->op = OPX_NOT_F_IFNOT; break;
+			case OP_NOT_ENT: ins->op = OPX_NOT_ENT_IFNOT; break;
+			}
+		}
+		else if (st->op == OP_ADDRESS)
+		{
+			switch (st[1].op)
+			{
+			case OP_STOREP_F:
+			case OP_STOREP_ENT:
+			case OP_STOREP_FLD:
+			case OP_STOREP_S:
+			case OP_STOREP_FNC:
+			case OP_STOREP_I:
+				ins->op = OPX_ADDRESS_STOREP;
+				break;
+			case OP_STOREP_V:
+				ins->op = OPX_ADDRESS_STOREP_V;
+				break;
+			}
+		}
+		else if (st->op == OP_LOAD_F && st[1].op == OP_IFNOT)
+		{
+			ins->op = OPX_LOAD_F_IFNOT;
+		}
+	}
+}
+
+/*
+====================
+ScrInternal_DebugStatement
+
+Slow path of Scr_Execute, counts statements for profiling and prints trace
+====================
+*/
+static void ScrInternal_DebugStatement(qcvm_t* vm, int s)
+{
+	dstatement_t	*st;
+	int				i;
+
+	st = &vm->pStatements[s];
+
+	vm->xfunction->profile++;
+	vm->xstatement = s;
+
+	if (vm->traceEnabled)
+	{
+#if QCVM_DEBUG_LEVEL > 0
+		printf("OP: %s\n", qcvm_op_names[st->op]);
+#endif
+		Scr_PrintStatement(st);
+		int addr[] = { st->a, st->b, st->c };
+		static const char *stnames[] = { "st->a", "st->b", "st->c" };
+		ddef_t* def;
+		for (i = 0; i != 3; i++)
+		{
+			if (addr[i])
+			{
+				def = ScrInternal_GlobalAtOfs(addr[i]);
+				if (def)
+					Com_Printf("%s = %s\n", stnames[i], Scr_GetString(def->s_name));
+			}
+		}
+	}
+}
+
 /*
 ====================
 Scr_Execute
 
 Execute script program
+
+Runs instructions from Scr_TranslateProgram. With gcc/clang every instruction
+jumps straight to the next one through a label table, other compilers go through
+the switch. Profiling and tracing are checked once per statement and when enabled
+every statement goes through ScrInternal_DebugStatement and runs unfused.
 ====================
 */
 
+#if defined(__GNUC__)
+	#define QCVM_COMPUTED_GOTO 1
+#else
+	#define QCVM_COMPUTED_GOTO 0
+#endif
+
+#if QCVM_COMPUTED_GOTO
+	#define VM_CASE(x)	L_##x:
+	#define VM_DISPATCH() \
+		do { \
+			ins = &code[s]; \
+			if (!--runaway) goto runaway_error; \
+			a = ins->a; b = ins->b; c = ins->c; \
+			goto *table[ins->op]; \
+		} while (0)
+#else
+	#define VM_CASE(x)	case x:
+	#define VM_DISPATCH() continue
+#endif
+
+#define VM_NEXT()	{ s++; VM_DISPATCH(); }
+
+// evaluate comparison into c and then run following OP_IFNOT
+#define VM_FUSED_IFNOT(x, expr) \
+	VM_CASE(x) \
+		c->_float = expr; \
+		if (!--runaway) { s++; goto runaway_error; } \
+		if (!ins[1].a->_int) \
+			s += 1 + ins[1].jump; \
+		else \
+			s += 2; \
+		VM_DISPATCH();
+
 void Scr_Execute(vmType_t vmtype, scr_func_t fnum, char* callFromFuncName)
 {
 	eval_t			*a, *b, *c, *ptr;
-	int				s, i, exitdepth;
-	dstatement_t	*st;
+	int				s, i, exitdepth, runaway;
+	qboolean		slowpath;
+	qcinstr_t		*code, *ins;
 	dfunction_t		*f, *newf;
 	qcvm_t			*vm;
 	vm_entity_t		*ent;
 	const char* str_a;
 	const char* str_b;
 
+#if QCVM_COMPUTED_GOTO
+	// opcodes without a label fall back to L_unknown, set first and overridden below
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+	static void *dispatch[OPX_NUM] =
+	{
+		[0 ... OPX_NUM - 1] = &&L_unknown,
+#define OP_LABEL(x) [x] = &&L_##x
+		OP_LABEL(OP_DONE), OP_LABEL(OP_MUL_F), OP_LABEL(OP_MUL_V), OP_LABEL(OP_MUL_FV), OP_LABEL(OP_MUL_VF),
+		OP_LABEL(OP_DIV_F), OP_LABEL(OP_ADD_F), OP_LABEL(OP_ADD_V), OP_LABEL(OP_SUB_F), OP_LABEL(OP_SUB_V),
+		OP_LABEL(OP_EQ_F), OP_LABEL(OP_EQ_V), OP_LABEL(OP_EQ_S), OP_LABEL(OP_EQ_E), OP_LABEL(OP_EQ_FNC),
+		OP_LABEL(OP_NE_F), OP_LABEL(OP_NE_V), OP_LABEL(OP_NE_S), OP_LABEL(OP_NE_E), OP_LABEL(OP_NE_FNC),
+		OP_LABEL(OP_LE), OP_LABEL(OP_GE), OP_LABEL(OP_LT), OP_LABEL(OP_GT),
+		OP_LABEL(OP_LOAD_F), OP_LABEL(OP_LOAD_V), OP_LABEL(OP_LOAD_S), OP_LABEL(OP_LOAD_ENT), OP_LABEL(OP_LOAD_FLD), OP_LABEL(OP_LOAD_FNC),
+		OP_LABEL(OP_ADDRESS),
+		OP_LABEL(OP_STORE_F), OP_LABEL(OP_STORE_V), OP_LABEL(OP_STORE_S), OP_LABEL(OP_STORE_ENT), OP_LABEL(OP_STORE_FLD), OP_LABEL(OP_STORE_FNC),
+		OP_LABEL(OP_STOREP_F), OP_LABEL(OP_STOREP_V), OP_LABEL(OP_STOREP_S), OP_LABEL(OP_STOREP_ENT), OP_LABEL(OP_STOREP_FLD), OP_LABEL(OP_STOREP_FNC),
+		OP_LABEL(OP_RETURN), OP_LABEL(OP_NOT_F), OP_LABEL(OP_NOT_V), OP_LABEL(OP_NOT_S), OP_LABEL(OP_NOT_ENT), OP_LABEL(OP_NOT_FNC),
+		OP_LABEL(OP_IF), OP_LABEL(OP_IFNOT),
+		OP_LABEL(OP_CALL0), OP_LABEL(OP_CALL1), OP_LABEL(OP_CALL2), OP_LABEL(OP_CALL3), OP_LABEL(OP_CALL4),
+		OP_LABEL(OP_CALL5), OP_LABEL(OP_CALL6), OP_LABEL(OP_CALL7), OP_LABEL(OP_CALL8),
+		OP_LABEL(OP_STATE), OP_LABEL(OP_GOTO), OP_LABEL(OP_AND), OP_LABEL(OP_OR), OP_LABEL(OP_BITAND), OP_LABEL(OP_BITOR),
+
+		OP_LABEL(OP_ADD_I), OP_LABEL(OP_ADD_FI), OP_LABEL(OP_ADD_IF), OP_LABEL(OP_SUB_I), OP_LABEL(OP_SUB_FI), OP_LABEL(OP_SUB_IF),
+		OP_LABEL(OP_CONV_ITOF), OP_LABEL(OP_CONV_FTOI),
+		OP_LABEL(OP_LOADP_ITOF), OP_LABEL(OP_LOADP_FTOI), OP_LABEL(OP_LOADA_I), OP_LABEL(OP_LOADP_I),
+		OP_LABEL(OP_MUL_I), OP_LABEL(OP_DIV_I), OP_LABEL(OP_EQ_I), OP_LABEL(OP_NE_I), OP_LABEL(OP_NOT_I),
+		OP_LABEL(OP_EQ_IF), OP_LABEL(OP_EQ_FI), OP_LABEL(OP_BITXOR_I), OP_LABEL(OP_RSHIFT_I), OP_LABEL(OP_LSHIFT_I),
+		OP_LABEL(OP_LE_I), OP_LABEL(OP_LE_IF), OP_LABEL(OP_LE_FI), OP_LABEL(OP_GT_I), OP_LABEL(OP_GT_IF), OP_LABEL(OP_GT_FI),
+		OP_LABEL(OP_LT_I), OP_LABEL(OP_LT_IF), OP_LABEL(OP_LT_FI), OP_LABEL(OP_GE_I), OP_LABEL(OP_GE_IF), OP_LABEL(OP_GE_FI),
+		OP_LABEL(OP_MUL_IF), OP_LABEL(OP_MUL_FI), OP_LABEL(OP_MUL_VI), OP_LABEL(OP_MUL_IV), OP_LABEL(OP_DIV_IF), OP_LABEL(OP_DIV_FI),
+		OP_LABEL(OP_BITAND_IF), OP_LABEL(OP_BITOR_IF), OP_LABEL(OP_BITAND_FI), OP_LABEL(OP_BITOR_FI),
+		OP_LABEL(OP_BITAND_I), OP_LABEL(OP_BITOR_I),
+		OP_LABEL(OP_AND_I), OP_LABEL(OP_OR_I), OP_LABEL(OP_AND_IF), OP_LABEL(OP_OR_IF), OP_LABEL(OP_AND_FI), OP_LABEL(OP_OR_FI),
+		OP_LABEL(OP_NE_IF), OP_LABEL(OP_NE_FI),
+		OP_LABEL(OP_STORE_IF), OP_LABEL(OP_STORE_FI), OP_LABEL(OP_STORE_I),
+		OP_LABEL(OP_STOREP_IF), OP_LABEL(OP_STOREP_FI), OP_LABEL(OP_STOREP_I),
+		OP_LABEL(OP_LOAD_I),
+
+		OP_LABEL(OPX_LT_IFNOT), OP_LABEL(OPX_LE_IFNOT), OP_LABEL(OPX_GT_IFNOT), OP_LABEL(OPX_GE_IFNOT),
+		OP_LABEL(OPX_EQ_F_IFNOT), OP_LABEL(OPX_NE_F_IFNOT), OP_LABEL(OPX_EQ_E_IFNOT), OP_LABEL(OPX_NE_E_IFNOT),
+		OP_LABEL(OPX_NOT_F_IFNOT), OP_LABEL(OPX_NOT_ENT_IFNOT), OP_LABEL(OPX_LOAD_F_IFNOT),
+		OP_LABEL(OPX_ADDRESS_STOREP), OP_LABEL(OPX_ADDRESS_STOREP_V)
+#undef OP_LABEL
+	};
+#pragma GCC diagnostic pop
+	static void *slowpathDispatch[OPX_NUM] = { [0 ... OPX_NUM - 1] = &&slow_statement };
+	void **table;
+#endif
+
 	if (fnum == -1)
 		return;
 
@@ -276,521 +504,519 @@ void Scr_Execute(vmType_t vmtype, scr_func_t fnum, char* callFromFuncName)
 	}
 
 	f = &vm->pFunctions[fnum];
+	code = vm->code;
 
 	vm->runawayCounter = (int)vm_runaway->value;
 	vm->traceEnabled = false;
 
 	// make a stack frame
 	exitdepth = vm->stackDepth;
+	Scr_ProfileBegin(vm);
 
-	s = ScrInternal_EnterFunction(f);
+	s = ScrInternal_EnterFunction(f) + 1;
+
+	runaway = vm->runawayCounter;
+	slowpath = (vm_profile->value != 0);
+#if QCVM_COMPUTED_GOTO
+	table = slowpath ? slowpathDispatch : dispatch;
+#endif
 
 	//vm->traceEnabled = true;
 
+#if QCVM_COMPUTED_GOTO
+	VM_DISPATCH();
+
+slow_statement:
+	ScrInternal_DebugStatement(vm, s);
+	goto *dispatch[ins->baseop];
+#else
 	while (1)
 	{
-		s++;	// next statement
-
-		st = &vm->pStatements[s];
-		a = (eval_t*)&vm->pGlobals[st->a];
-		b = (eval_t*)&vm->pGlobals[st->b];
-		c = (eval_t*)&vm->pGlobals[st->c];
+		ins = &code[s];
+		if (!--runaway)
+			goto runaway_error;
 
-		if (!--vm->runawayCounter)
-		{
-			Scr_RunError("Infinite loop in function %s (%s).", Scr_GetString(f->s_name), vmDefs[vm->progsType].filename);
-		}
+		a = ins->a;
+		b = ins->b;
+		c = ins->c;
 
-		vm->xfunction->profile++;
-		vm->xstatement = s;
+		if (slowpath)
+			ScrInternal_DebugStatement(vm, s);
 
-		if (vm->traceEnabled)
+		switch (slowpath ? ins->baseop : ins->op)
 		{
-
-#if QCVM_DEBUG_LEVEL > 0
-			printf("OP: %s\n", qcvm_op_names[st->op]);
 #endif
-			Scr_PrintStatement(st);
-			int addr[] = { st->a, st->b, st->c };
-			static const char *stnames[] = { "st->a", "st->b", "st->c" };
-			ddef_t* def;
-			for (i = 0; i != 3; i++)
-			{
-				if (addr[i])
-				{
-					def = ScrInternal_GlobalAtOfs(addr[i]);
-					if (def)
-						Com_Printf("%s = %s\n", stnames[i], Scr_GetString(def->s_name));
-				}
-			}
-		}
-
-
-		switch (st->op)
-		{
-		case OP_ADD_F: // float + float
+		VM_CASE(OP_ADD_F) // float + float
 			c->_float = a->_float + b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_ADD_V: // vector + vector
+		VM_CASE(OP_ADD_V) // vector + vector
 			c->vector[0] = a->vector[0] + b->vector[0];
 			c->vector[1] = a->vector[1] + b->vector[1];
 			c->vector[2] = a->vector[2] + b->vector[2];
-			break;
+			VM_NEXT();
 
 			/* FTEQC: begin int */
-		case OP_ADD_I: // int + int
+		VM_CASE(OP_ADD_I) // int + int
 			c->_int = a->_int + b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_ADD_FI: // float + int
+		VM_CASE(OP_ADD_FI) // float + int
 			c->_float = a->_float + (float)b->_int;
-			break;
-		case OP_ADD_IF: // int + float
+			VM_NEXT();
+		VM_CASE(OP_ADD_IF) // int + float
 			c->_float = (float)a->_int + b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_SUB_I: // int - int
+		VM_CASE(OP_SUB_I) // int - int
 			c->_int = a->_int - b->_int;
-			break;
-		case OP_SUB_FI: // float - int
+			VM_NEXT();
+		VM_CASE(OP_SUB_FI) // float - int
 			c->_float = a->_float - (float)b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_SUB_IF: // int - float
+		VM_CASE(OP_SUB_IF) // int - float
 			c->_float = (float)a->_int - b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_CONV_ITOF:
+		VM_CASE(OP_CONV_ITOF)
 			c->_float = (float)a->_int;
-			break;
-		case OP_CONV_FTOI:
+			VM_NEXT();
+		VM_CASE(OP_CONV_FTOI)
 			c->_int = (int)a->_float;
-			break;
+			VM_NEXT();
 
-		case OP_LOADP_ITOF:
-		case OP_LOADP_FTOI:
-		case OP_LOADA_I:
-		case OP_LOADP_I:
-			Scr_RunError("Unsupported FTEQC opcode %s in %s.", qcvm_op_names[st->op], vmDefs[vm->progsType].filename);
-			break;
+		VM_CASE(OP_LOADP_ITOF)
+		VM_CASE(OP_LOADP_FTOI)
+		VM_CASE(OP_LOADA_I)
+		VM_CASE(OP_LOADP_I)
+			vm->xstatement = s;
+			Scr_RunError("Unsupported FTEQC opcode %s in %s.", qcvm_op_names[vm->pStatements[s].op], vmDefs[vm->progsType].filename);
+			VM_NEXT();
 
-		case OP_MUL_I:
+		VM_CASE(OP_MUL_I)
 			c->_int = a->_int * b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_DIV_I:
+		VM_CASE(OP_DIV_I)
 			if (b->_int == 0)
 			{
+				vm->xstatement = s;
 				Scr_RunError("Integer division by zero in %s.", vmDefs[vm->progsType].filename);
 				//c->_int = 0; // commented out for no mercy, hahaha. fix your code
 			}
 			else
 				c->_int = a->_int / b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_EQ_I:
+		VM_CASE(OP_EQ_I)
 			c->_int = (a->_int == b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_NE_I:
+		VM_CASE(OP_NE_I)
 			c->_int = (a->_int != b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_NOT_I:
+		VM_CASE(OP_NOT_I)
 			c->_int = !a->_int;
-			break;
+			VM_NEXT();
 
-		case OP_EQ_IF:
+		VM_CASE(OP_EQ_IF)
 			c->_int = (float)(a->_int == b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_EQ_FI:
+		VM_CASE(OP_EQ_FI)
 			c->_int = (float)(a->_float == b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_BITXOR_I:
+		VM_CASE(OP_BITXOR_I)
 			c->_int = a->_int ^ b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_RSHIFT_I:
+		VM_CASE(OP_RSHIFT_I)
 			c->_int = a->_int >> b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_LSHIFT_I:
+		VM_CASE(OP_LSHIFT_I)
 			c->_int = a->_int << b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_LE_I:
+		VM_CASE(OP_LE_I)
 			c->_int = (int)(a->_int <= b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_LE_IF:
+		VM_CASE(OP_LE_IF)
 			c->_int = (int)(a->_int <= b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_LE_FI:
+		VM_CASE(OP_LE_FI)
 			c->_int = (int)(a->_float <= b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_GT_I:
+		VM_CASE(OP_GT_I)
 			c->_int = (int)(a->_int > b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_GT_IF:
+		VM_CASE(OP_GT_IF)
 			c->_int = (int)(a->_int > b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_GT_FI:
+		VM_CASE(OP_GT_FI)
 			c->_int = (int)(a->_float > b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_LT_I:
+		VM_CASE(OP_LT_I)
 			c->_int = (int)(a->_int < b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_LT_IF:
+		VM_CASE(OP_LT_IF)
 			c->_int = (int)(a->_int < b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_LT_FI:
+		VM_CASE(OP_LT_FI)
 			c->_int = (int)(a->_float < b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_GE_I:
+		VM_CASE(OP_GE_I)
 			c->_int = (int)(a->_int >= b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_GE_IF:
+		VM_CASE(OP_GE_IF)
 			c->_int = (int)(a->_int >= b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_GE_FI:
+		VM_CASE(OP_GE_FI)
 			c->_int = (int)(a->_float >= b->_int);
-			break;
+			VM_NEXT();
 
 
-		case OP_MUL_IF:
+		VM_CASE(OP_MUL_IF)
 			c->_float = (a->_int * b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_MUL_FI:
+		VM_CASE(OP_MUL_FI)
 			c->_float = (a->_float * b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_MUL_VI:
+		VM_CASE(OP_MUL_VI)
 			c->vector[0] = a->vector[0] * b->_int;
 			c->vector[1] = a->vector[1] * b->_int;
 			c->vector[2] = a->vector[2] * b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_MUL_IV:
+		VM_CASE(OP_MUL_IV)
 			c->vector[0] = a->_int * b->vector[0];
 			c->vector[1] = a->_int * b->vector[1];
 			c->vector[2] = a->_int * b->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_DIV_IF:
+		VM_CASE(OP_DIV_IF)
 			c->_float = (a->_int / b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_DIV_FI:
+		VM_CASE(OP_DIV_FI)
 			c->_float = (a->_float / b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_BITAND_IF:
+		VM_CASE(OP_BITAND_IF)
 			c->_int = (a->_int & (int)b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_BITOR_IF:
+		VM_CASE(OP_BITOR_IF)
 			c->_int = (a->_int | (int)b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_BITAND_FI:
+		VM_CASE(OP_BITAND_FI)
 			c->_int = ((int)a->_float & b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_BITOR_FI:
+		VM_CASE(OP_BITOR_FI)
 			c->_int = ((int)a->_float | b->_int);
-			break;
+			VM_NEXT();
 
 
-		case OP_AND_I:
+		VM_CASE(OP_AND_I)
 			c->_int = (a->_int && b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_OR_I:
+		VM_CASE(OP_OR_I)
 			c->_int = (a->_int || b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_AND_IF:
+		VM_CASE(OP_AND_IF)
 			c->_int = (a->_int && b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_OR_IF:
+		VM_CASE(OP_OR_IF)
 			c->_int = (a->_int || b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_AND_FI:
+		VM_CASE(OP_AND_FI)
 			c->_int = (a->_float && b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_OR_FI:
+		VM_CASE(OP_OR_FI)
 			c->_int = (a->_float || b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_NE_IF:
+		VM_CASE(OP_NE_IF)
 			c->_int = (a->_int != b->_float);
-			break;
+			VM_NEXT();
 
-		case OP_NE_FI:
+		VM_CASE(OP_NE_FI)
 			c->_int = (a->_float != b->_int);
-			break;
+			VM_NEXT();
 			/* FTEQC: end int */
 
-		case OP_SUB_F: // - float
+		VM_CASE(OP_SUB_F) // - float
 			c->_float = a->_float - b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_SUB_V: // - vector
+		VM_CASE(OP_SUB_V) // - vector
 			c->vector[0] = a->vector[0] - b->vector[0];
 			c->vector[1] = a->vector[1] - b->vector[1];
 			c->vector[2] = a->vector[2] - b->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_MUL_F: // * float
+		VM_CASE(OP_MUL_F) // * float
 			c->_float = a->_float * b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_MUL_V: // * vector
+		VM_CASE(OP_MUL_V) // * vector
 			c->_float = a->vector[0] * b->vector[0]
 				+ a->vector[1] * b->vector[1]
 				+ a->vector[2] * b->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_MUL_FV: // float * vector
+		VM_CASE(OP_MUL_FV) // float * vector
 			c->vector[0] = a->_float * b->vector[0];
 			c->vector[1] = a->_float * b->vector[1];
 			c->vector[2] = a->_float * b->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_MUL_VF: // vector * float
+		VM_CASE(OP_MUL_VF) // vector * float
 			c->vector[0] = b->_float * a->vector[0];
 			c->vector[1] = b->_float * a->vector[1];
 			c->vector[2] = b->_float * a->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_DIV_F: // / float
+		VM_CASE(OP_DIV_F) // / float
 			c->_float = a->_float / b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_BITAND: // (& float)
+		VM_CASE(OP_BITAND) // (& float)
 			c->_float = (int)a->_float & (int)b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_BITOR: // (| float)
+		VM_CASE(OP_BITOR) // (| float)
 			c->_float = (int)a->_float | (int)b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_BITAND_I:
+		VM_CASE(OP_BITAND_I)
 			c->_int = (a->_int & b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_BITOR_I:
+		VM_CASE(OP_BITOR_I)
 			c->_int = (a->_int | b->_int);
-			break;
+			VM_NEXT();
 
-		case OP_GE: // >= float
+		VM_CASE(OP_GE) // >= float
 			c->_float = a->_float >= b->_float;
-			break;
-		case OP_LE: // <= float
+			VM_NEXT();
+		VM_CASE(OP_LE) // <= float
 			c->_float = a->_float <= b->_float;
-			break;
-		case OP_GT: // > float
+			VM_NEXT();
+		VM_CASE(OP_GT) // > float
 			c->_float = a->_float > b->_float;
-			break;
-		case OP_LT: // < float
+			VM_NEXT();
+		VM_CASE(OP_LT) // < float
 			c->_float = a->_float < b->_float;
-			break;
-		case OP_AND: // (&& float)
+			VM_NEXT();
+		VM_CASE(OP_AND) // (&& float)
 			c->_float = a->_float && b->_float;
-			break;
-		case OP_OR:// (|| float)
+			VM_NEXT();
+		VM_CASE(OP_OR)// (|| float)
 			c->_float = a->_float || b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_NOT_F: //not float
+		VM_CASE(OP_NOT_F) //not float
 			c->_float = !a->_float;
-			break;
-		case OP_NOT_V: // not vector
+			VM_NEXT();
+		VM_CASE(OP_NOT_V) // not vector
 			c->_float = !a->vector[0] && !a->vector[1] && !a->vector[2];
-			break;
-		case OP_NOT_S: // not string
+			VM_NEXT();
+		VM_CASE(OP_NOT_S) // not string
 			c->_float = !a->string || !vm->pStrings[a->string];
-			break;
-		case OP_NOT_FNC: // not function
+			VM_NEXT();
+		VM_CASE(OP_NOT_FNC) // not function
 			c->_float = !a->function;
-			break;
-		case OP_NOT_ENT: // not entity
+			VM_NEXT();
+		VM_CASE(OP_NOT_ENT) // not entity
 			c->_float = (VM_TO_ENT(a->edict) == vm->entities);
-			break;
+			VM_NEXT();
 
-		case OP_EQ_F: // == float
+		VM_CASE(OP_EQ_F) // == float
 			c->_float = a->_float == b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_EQ_V: // == vector
+		VM_CASE(OP_EQ_V) // == vector
 			c->_float = (a->vector[0] == b->vector[0]) &&
 				(a->vector[1] == b->vector[1]) &&
 				(a->vector[2] == b->vector[2]);
-			break;
+			VM_NEXT();
 
-		case OP_EQ_S: // == string
+		VM_CASE(OP_EQ_S) // == string
 			str_a = Scr_GetString(a->string);
 			str_b = Scr_GetString(b->string);
 			c->_float = !strcmp(str_a, str_b);
-			break;
+			VM_NEXT();
 
-		case OP_EQ_E: // equal int
+		VM_CASE(OP_EQ_E) // equal int
 			c->_float = a->_int == b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_EQ_FNC: // equal func
+		VM_CASE(OP_EQ_FNC) // equal func
 			c->_float = a->function == b->function;
-			break;
+			VM_NEXT();
 
-		case OP_NE_F: // not equal float
+		VM_CASE(OP_NE_F) // not equal float
 			c->_float = a->_float != b->_float;
-			break;
+			VM_NEXT();
 
-		case OP_NE_V: // not equal vector
+		VM_CASE(OP_NE_V) // not equal vector
 			c->_float = (a->vector[0] != b->vector[0]) ||
 				(a->vector[1] != b->vector[1]) ||
 				(a->vector[2] != b->vector[2]);
-			break;
+			VM_NEXT();
 
-		case OP_NE_S: // not equal string
+		VM_CASE(OP_NE_S) // not equal string
 			str_a = Scr_GetString(a->string);
 			str_b = Scr_GetString(b->string);
 			c->_float = strcmp(str_a, str_b);
-			break;
+			VM_NEXT();
 
-		case OP_NE_E: // not equal int
+		VM_CASE(OP_NE_E) // not equal int
 			c->_float = a->_int != b->_int;
-			break;
+			VM_NEXT();
 
-		case OP_NE_FNC: //not equal function
+		VM_CASE(OP_NE_FNC) //not equal function
 			c->_float = a->function != b->function;
-			break;
+			VM_NEXT();
 
 			//==================
-		case OP_STORE_IF: // FTE: int -> float
+		VM_CASE(OP_STORE_IF) // FTE: int -> float
 			b->_float = (float)a->_int;
-			break;
-		case OP_STORE_FI:  // FTE: float -> int
+			VM_NEXT();
+		VM_CASE(OP_STORE_FI)  // FTE: float -> int
 			b->_int = (int)a->_float;
-			break;
-
-		case OP_STORE_F:
-		case OP_STORE_ENT:
-		case OP_STORE_FLD:		// integers
-		case OP_STORE_S:
-		case OP_STORE_I:		// FTE: int
-		case OP_STORE_FNC:		// pointers
+			VM_NEXT();
+
+		VM_CASE(OP_STORE_F)
+		VM_CASE(OP_STORE_ENT)
+		VM_CASE(OP_STORE_FLD)		// integers
+		VM_CASE(OP_STORE_S)
+		VM_CASE(OP_STORE_I)		// FTE: int
+		VM_CASE(OP_STORE_FNC)		// pointers
 			b->_int = a->_int;
-			break;
+			VM_NEXT();
 
-		case OP_STORE_V: //store vector
+		VM_CASE(OP_STORE_V) //store vector
 			b->vector[0] = a->vector[0];
 			b->vector[1] = a->vector[1];
 			b->vector[2] = a->vector[2];
-			break;
+			VM_NEXT();
 
 
 /* FTE: int store a value to a pointer */
-		case OP_STOREP_IF:
+		VM_CASE(OP_STOREP_IF)
 			ptr = (eval_t*)((byte*)vm->entities + b->_int);
 			ptr->_float = (float)a->_int;
-		break;
+		VM_NEXT();
 
-		case OP_STOREP_FI:
+		VM_CASE(OP_STOREP_FI)
 			ptr = (eval_t*)((byte*)vm->entities + b->_int);
 			ptr->_int = (int)a->_float;
-		break;
+		VM_NEXT();
 /*FTE end of int*/
 
-		case OP_STOREP_I: // FTE
-		case OP_STOREP_F:
-		case OP_STOREP_ENT:
-		case OP_STOREP_FLD:		// integers
-		case OP_STOREP_S:
-		case OP_STOREP_FNC:		// pointers
+		VM_CASE(OP_STOREP_I) // FTE
+		VM_CASE(OP_STOREP_F)
+		VM_CASE(OP_STOREP_ENT)
+		VM_CASE(OP_STOREP_FLD)		// integers
+		VM_CASE(OP_STOREP_S)
+		VM_CASE(OP_STOREP_FNC)		// pointers
 			ptr = (eval_t*)((byte*)vm->entities + b->_int);
 			ptr->_int = a->_int;
-			break;
-		case OP_STOREP_V:
+			VM_NEXT();
+		VM_CASE(OP_STOREP_V)
 			ptr = (eval_t*)((byte*)vm->entities + b->_int);
 			ptr->vector[0] = a->vector[0];
 			ptr->vector[1] = a->vector[1];
 			ptr->vector[2] = a->vector[2];
-			break;
+			VM_NEXT();
 
-		case OP_ADDRESS:
+		VM_CASE(OP_ADDRESS)
 			ent = VM_TO_ENT(a->edict);
 			if (ent == vm->entities && (vm->progsType == VM_SVGAME && Com_IsServerActive()))
 			{
+				vm->xstatement = s;
 				//Scr_StackTrace();
 				Scr_RunError("Worldspawn entity fields are read only.");
 			}
 			c->_int = (byte*)(ENTVARSOFFSET(ent) + b->_int) - (byte*)vm->entities;
-			break;
+			VM_NEXT();
 
 		//load a field to a value
-		case OP_LOAD_F:
-		case OP_LOAD_I: // FTE
-		case OP_LOAD_FLD:
-		case OP_LOAD_ENT:
-		case OP_LOAD_S:
-		case OP_LOAD_FNC:
+		VM_CASE(OP_LOAD_F)
+		VM_CASE(OP_LOAD_I) // FTE
+		VM_CASE(OP_LOAD_FLD)
+		VM_CASE(OP_LOAD_ENT)
+		VM_CASE(OP_LOAD_S)
+		VM_CASE(OP_LOAD_FNC)
 			ent = VM_TO_ENT(a->edict);
 			a = (eval_t*)(ENTVARSOFFSET(ent) + b->_int);
 			c->_int = a->_int;
-			break;
+			VM_NEXT();
 
-		case OP_LOAD_V:
+		VM_CASE(OP_LOAD_V)
 			ent = VM_TO_ENT(a->edict);
 			a = (eval_t*)(ENTVARSOFFSET(ent) + b->_int);
 			c->vector[0] = a->vector[0];
 			c->vector[1] = a->vector[1];
 			c->vector[2] = a->vector[2];
-			break;
+			VM_NEXT();
 
 			//==================
 
-		case OP_IFNOT:
+		VM_CASE(OP_IFNOT)
 			if (!a->_int)
-				s += st->b - 1;	// offset the s++
-			break;
+				s += ins->jump;
+			else
+				s++;
+			VM_DISPATCH();
 
-		case OP_IF:
+		VM_CASE(OP_IF)
 			if (a->_int)
-				s += st->b - 1;	// offset the s++
-			break;
-
-		case OP_GOTO:
-			s += st->a - 1;	// offset the s++
-			break;
-
-		case OP_CALL0:
-		case OP_CALL1:
-		case OP_CALL2:
-		case OP_CALL3:
-		case OP_CALL4:
-		case OP_CALL5:
-		case OP_CALL6:
-		case OP_CALL7:
-		case OP_CALL8:
-			vm->argc = st->op - OP_CALL0; //sets the number of arguments a function takes
+				s += ins->jump;
+			else
+				s++;
+			VM_DISPATCH();
+
+		VM_CASE(OP_GOTO)
+			s += ins->jump;
+			VM_DISPATCH();
+
+		VM_CASE(OP_CALL0)
+		VM_CASE(OP_CALL1)
+		VM_CASE(OP_CALL2)
+		VM_CASE(OP_CALL3)
+		VM_CASE(OP_CALL4)
+		VM_CASE(OP_CALL5)
+		VM_CASE(OP_CALL6)
+		VM_CASE(OP_CALL7)
+		VM_CASE(OP_CALL8)
+			vm->xstatement = s;
+			vm->argc = ins->baseop - OP_CALL0; //sets the number of arguments a function takes
 			if (!a->function)
 				Scr_RunError("Call to undefined function.");
 
@@ -810,28 +1036,46 @@ void Scr_Execute(vmType_t vmtype, scr_func_t fnum, char* callFromFuncName)
 #if QCVM_DEBUG_LEVEL > 0
 				printf("BUILTIN: %s (%i args)\n", scr_builtins[i].name, vm->argc);
 #endif
+				// builtins may reset runaway counter, enable tracing or run another program
+				vm->runawayCounter = runaway;
 				vm->currentBuiltinFunc = &scr_builtins[i]; // development aid
-				scr_builtins[i].func();
+				if (vm->profile)
+				{
+					Scr_ProfileEnter(vm, -1 - i);
+					scr_builtins[i].func();
+					Scr_ProfileLeave(vm);
+				}
+				else
+					scr_builtins[i].func();
 				vm->currentBuiltinFunc = NULL;
+				runaway = vm->runawayCounter;
+				slowpath = (vm->traceEnabled || vm_profile->value != 0);
+#if QCVM_COMPUTED_GOTO
+				table = slowpath ? slowpathDispatch : dispatch;
+#endif
 
-				break;
+				VM_NEXT();
 			}
 
-			s = ScrInternal_EnterFunction(newf);
-			break;
+			s = ScrInternal_EnterFunction(newf) + 1;
+			VM_DISPATCH();
 
-		case OP_DONE:
-		case OP_RETURN:
-			vm->pGlobals[OFS_RETURN] = vm->pGlobals[st->a];
-			vm->pGlobals[OFS_RETURN + 1] = vm->pGlobals[st->a + 1];
-			vm->pGlobals[OFS_RETURN + 2] = vm->pGlobals[st->a + 2];
+		VM_CASE(OP_DONE)
+		VM_CASE(OP_RETURN)
+			vm->pGlobals[OFS_RETURN] = a->vector[0];
+			vm->pGlobals[OFS_RETURN + 1] = a->vector[1];
+			vm->pGlobals[OFS_RETURN + 2] = a->vector[2];
 
 			s = ScrInternal_LeaveFunction();
 			if (vm->stackDepth == exitdepth)
+			{
+				vm->runawayCounter = runaway;
 				return;		// all done
-			break;
+			}
+			VM_NEXT();
 
-		case OP_STATE:
+		VM_CASE(OP_STATE)
+			vm->xstatement = s;
 			if (vm->progsType == VM_SVGAME)
 			{
 				extern void Scr_SV_OP(eval_t * a, eval_t * b, eval_t * c);
@@ -849,18 +1093,86 @@ void Scr_Execute(vmType_t vmtype, scr_func_t fnum, char* callFromFuncName)
 //				ent->v.animFrame = a->_float;
 //			}
 //			ent->v.think = b->function;
-			break;
+			VM_NEXT();
+
+			//==================
+			// fused pairs from Scr_TranslateProgram
+
+		VM_FUSED_IFNOT(OPX_LT_IFNOT, a->_float < b->_float)
+		VM_FUSED_IFNOT(OPX_LE_IFNOT, a->_float <= b->_float)
+		VM_FUSED_IFNOT(OPX_GT_IFNOT, a->_float > b->_float)
+		VM_FUSED_IFNOT(OPX_GE_IFNOT, a->_float >= b->_float)
+		VM_FUSED_IFNOT(OPX_EQ_F_IFNOT, a->_float == b->_float)
+		VM_FUSED_IFNOT(OPX_NE_F_IFNOT, a->_float != b->_float)
+		VM_FUSED_IFNOT(OPX_EQ_E_IFNOT, a->_int == b->_int)
+		VM_FUSED_IFNOT(OPX_NE_E_IFNOT, a->_int != b->_int)
+		VM_FUSED_IFNOT(OPX_NOT_F_IFNOT, !a->_float)
+		VM_FUSED_IFNOT(OPX_NOT_ENT_IFNOT, (VM_TO_ENT(a->edict) == vm->entities))
+
+		VM_CASE(OPX_LOAD_F_IFNOT)
+			ent = VM_TO_ENT(a->edict);
+			a = (eval_t*)(ENTVARSOFFSET(ent) + b->_int);
+			c->_int = a->_int;
+			if (!--runaway) { s++; goto runaway_error; }
+			if (!ins[1].a->_int)
+				s += 1 + ins[1].jump;
+			else
+				s += 2;
+			VM_DISPATCH();
+
+		VM_CASE(OPX_ADDRESS_STOREP)
+		VM_CASE(OPX_ADDRESS_STOREP_V)
+			ent = VM_TO_ENT(a->edict);
+			if (ent == vm->entities && (vm->progsType == VM_SVGAME && Com_IsServerActive()))
+			{
+				vm->xstatement = s;
+				Scr_RunError("Worldspawn entity fields are read only.");
+			}
+			c->_int = (byte*)(ENTVARSOFFSET(ent) + b->_int) - (byte*)vm->entities;
+
+			s++;
+			if (!--runaway)
+				goto runaway_error;
+			ptr = (eval_t*)((byte*)vm->entities + ins[1].b->_int);
+			a = ins[1].a;
+			if (ins->op == OPX_ADDRESS_STOREP)
+			{
+				ptr->_int = a->_int;
+			}
+			else
+			{
+				ptr->vector[0] = a->vector[0];
+				ptr->vector[1] = a->vector[1];
+				ptr->vector[2] = a->vector[2];
+			}
+			VM_NEXT();
 
+#if QCVM_COMPUTED_GOTO
+	L_unknown:
+#else
 		default:
-			if(st->op > 0 && st->op < 269)
-				Scr_RunError("Unknown program opcode %i [%s].", st->op, qcvm_op_names[st->op]);
+#endif
+			vm->xstatement = s;
+			if(vm->pStatements[s].op > 0 && vm->pStatements[s].op < 269)
+				Scr_RunError("Unknown program opcode %i [%s].", vm->pStatements[s].op, qcvm_op_names[vm->pStatements[s].op]);
 			else
-				Scr_RunError("Unknown program opcode %i.\n", st->op);
+				Scr_RunError("Unknown program opcode %i.\n", vm->pStatements[s].op);
+			return;
+#if !QCVM_COMPUTED_GOTO
 		}
 	}
+#endif
 
+runaway_error:
+	vm->xstatement = s;
+	Scr_RunError("Infinite loop in function %s (%s).", Scr_GetString(f->s_name), vmDefs[vm->progsType].filename);
 }
 
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_FUSED_IFNOT
+
 //static int	type_size[8] = { 1,sizeof(scr_string_t) / 4,1,3,1,1,sizeof(scr_func_t) / 4,sizeof(void*) / 4 }; // funily enough this lived not updated in pragma for nearly 5 months
 static int type_size[9] =
 {
@@ -13,6 +13,7 @@ See the attached GNU General Public License v2 for more details.
 #include "qcvm_private.h"
 
 cvar_t* vm_runaway;
+cvar_t* vm_profile;
 
 qcvm_t* qcvm[NUM_SCRIPT_VMS];
 qcvm_t* active_qcvm; // qcvm currently in use
@@ -31,6 +32,7 @@ const qcvmdef_t vmDefs[NUM_SCRIPT_VMS] =
 	{VM_GUI, "progs/gui.dat", 0, "user interface"}
 };
 
+
 void Cmd_PrintVMEntity_f(void);
 void Cmd_PrintAllVMEntities_f(void);
 
@@ -88,6 +90,64 @@ ddef_t* ScrInternal_FieldAtOfs(int ofs)
 	return NULL;
 }
 
+/*
+============
+Scr_HashName
+============
+*/
+static unsigned int Scr_HashName(const char* name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = (hash * 33) ^ (byte)*name++;
+	return hash;
+}
+
+/*
+============
+Scr_FirstNameInHash
+Returns first def index which may match name, or -1
+============
+*/
+static int Scr_FirstNameInHash(qcvm_namehash_t* hash, const char* name)
+{
+	if (!hash->size)
+		return -1;
+	return hash->head[Scr_HashName(name) & (hash->size - 1)];
+}
+
+/*
+============
+Scr_BuildNameHash
+Hashes names of numDefs defs, names are offsets to progs strings.
+Defs are inserted backwards so lookups find the first def of a duplicated name, like linear search did.
+============
+*/
+static void Scr_BuildNameHash(qcvm_t* vm, qcvm_namehash_t* hash, int numDefs, int (*getName)(qcvm_t* vm, int index))
+{
+	int i, bucket;
+
+	hash->size = 64;
+	while (hash->size < numDefs)
+		hash->size <<= 1;
+
+	hash->head = Z_TagMalloc(hash->size * sizeof(int), TAG_QCVM_MEMORY + vm->progsType);
+	hash->next = Z_TagMalloc((numDefs + 1) * sizeof(int), TAG_QCVM_MEMORY + vm->progsType);
+	memset(hash->head, -1, hash->size * sizeof(int));
+
+	for (i = numDefs - 1; i >= 0; i--)
+	{
+		bucket = Scr_HashName(vm->pStrings + getName(vm, i)) & (hash->size - 1);
+		hash->next[i] = hash->head[bucket];
+		hash->head[bucket] = i;
+	}
+}
+
+static int Scr_FunctionName(qcvm_t* vm, int i) { return vm->pFunctions[i].s_name; }
+static int Scr_GlobalName(qcvm_t* vm, int i) { return vm->pGlobalDefs[i].s_name; }
+static int Scr_FieldName(qcvm_t* vm, int i) { return vm->pFieldDefs[i].s_name; }
+
 /*
 ============
 Scr_FindEntityField
@@ -96,17 +156,13 @@ Returns ddef for an entity field matching name in active qcvm
 */
 ddef_t* Scr_FindEntityField(char* name)
 {
-	ddef_t	*def;
 	int		i;
 
 	CheckScriptVM(__FUNCTION__);
-	for (i = 0; i < active_qcvm->progs->numFieldDefs; i++)
+	for (i = Scr_FirstNameInHash(&active_qcvm->fieldHash, name); i != -1; i = active_qcvm->fieldHash.next[i])
 	{
-		def = &active_qcvm->pFieldDefs[i];
-		if (!strcmp(Scr_GetString(def->s_name), name))
-		{
-			return def;
-		}
+		if (!strcmp(Scr_GetString(active_qcvm->pFieldDefs[i].s_name), name))
+			return &active_qcvm->pFieldDefs[i];
 	}
 	return NULL;
 }
@@ -270,15 +326,13 @@ Returns ddef for a global variable in active qcvm
 */
 ddef_t* Scr_FindGlobal(char* name)
 {
-	ddef_t* def;
-	int			i;
+	int		i;
 
 	CheckScriptVM(__FUNCTION__);
-	for (i = 0; i < active_qcvm->progs->numGlobalDefs; i++)
+	for (i = Scr_FirstNameInHash(&active_qcvm->globalHash, name); i != -1; i = active_qcvm->globalHash.next[i])
 	{
-		def = &active_qcvm->pGlobalDefs[i];
-		if (!strcmp(Scr_GetString(def->s_name), name))
-			return def;
+		if (!strcmp(Scr_GetString(active_qcvm->pGlobalDefs[i].s_name), name))
+			return &active_qcvm->pGlobalDefs[i];
 	}
 	return NULL;
 }
@@ -292,15 +346,13 @@ Finds a function with specified name in active qcvm or NULL if not found
 */
 dfunction_t* Scr_FindFunction(const char* name)
 {
-	dfunction_t* func;
-	int				i;
+	int		i;
 
 	CheckScriptVM(__FUNCTION__);
-	for (i = 0; i < active_qcvm->progs->numFunctions; i++)
+	for (i = Scr_FirstNameInHash(&active_qcvm->functionHash, name); i != -1; i = active_qcvm->functionHash.next[i])
 	{
-		func = &active_qcvm->pFunctions[i];
-		if (!strcmp(Scr_GetString(func->s_name), name))
-			return func;
+		if (!strcmp(Scr_GetString(active_qcvm->pFunctions[i].s_name), name))
+			return &active_qcvm->pFunctions[i];
 	}
 	return NULL;
 }
@@ -467,6 +519,29 @@ void Scr_LoadProgram(qcvm_t *vm, char* filename)
 
 	for (i = 0; i < vm->progs->numGlobals; i++)
 		((int*)vm->pGlobals)[i] = LittleLong(((int32_t*)vm->pGlobals)[i]);
+
+	for (i = 0; i < vm->progs->numFunctions; i++)
+	{
+		if (vm->pFunctions[i].s_name < 0 || vm->pFunctions[i].s_name >= vm->progs->numstrings)
+			Com_Error(ERR_FATAL, "Bad name of function %i in %s.\n", i, filename);
+	}
+	for (i = 0; i < vm->progs->numGlobalDefs; i++)
+	{
+		if (vm->pGlobalDefs[i].s_name < 0 || vm->pGlobalDefs[i].s_name >= vm->progs->numstrings)
+			Com_Error(ERR_FATAL, "Bad name of global %i in %s.\n", i, filename);
+	}
+	for (i = 0; i < vm->progs->numFieldDefs; i++)
+	{
+		if (vm->pFieldDefs[i].s_name < 0 || vm->pFieldDefs[i].s_name >= vm->progs->numstrings)
+			Com_Error(ERR_FATAL, "Bad name of field %i in %s.\n", i, filename);
+	}
+
+	// hash names for Scr_FindFunction, Scr_FindGlobal and Scr_FindEntityField
+	Scr_BuildNameHash(vm, &vm->functionHash, vm->progs->numFunctions, Scr_FunctionName);
+	Scr_BuildNameHash(vm, &vm->globalHash, vm->progs->numGlobalDefs, Scr_GlobalName);
+	Scr_BuildNameHash(vm, &vm->fieldHash, vm->progs->numFieldDefs, Scr_FieldName);
+
+	Scr_TranslateProgram(vm);
 }
 
 /*
@@ -587,11 +662,8 @@ void Scr_FreeScriptVM(vmType_t vmtype)
 	if(vm->progsType != VM_NONE)
 		Z_FreeTags(TAG_QCVM_MEMORY + vm->progsType);
 
-	if (vm->strTable.stringTable != NULL)
-	{
-		free((void*)vm->strTable.stringTable);
-		vm->strTable.stringTable = NULL;
-	}
+	Scr_FreeStringTable(&vm->strTable);
+	Scr_ProfileFree(vm);
 
 	if (vm->entities)
 		Z_Free(vm->entities);
@@ -768,11 +840,14 @@ void Scr_PreInitVMs()
 	SV_InitScriptBuiltins();
 
 	vm_runaway = Cvar_Get("vm_runaway", va("%i", VM_DEFAULT_RUNAWAY), 0, "Count of executed QC instructions to trigger runaway error.");
+	vm_profile = Cvar_Get("vm_profile", "0", 0, "Count executed QC statements per function, runs programs on slower path.");
 
 	// add developer comands
 	Cmd_AddCommand("vm_printent", Cmd_PrintVMEntity_f);
 	Cmd_AddCommand("vm_printents", Cmd_PrintAllVMEntities_f);
 	Cmd_AddCommand("vm_generatedefs", Cmd_VM_GenerateDefs_f);
+
+	Scr_InitProfiler();
 }
 
 /*
@@ -789,6 +864,7 @@ void Scr_Shutdown()
 	Cmd_RemoveCommand("vm_printent");
 	Cmd_RemoveCommand("vm_printents");
 	Cmd_RemoveCommand("vm_generatedefs");
+	Scr_ShutdownProfiler();
 
 	if (scr_builtins)
 	{
@@ -87,6 +87,15 @@ typedef struct statement_s
 	int16_t	a, b, c;
 } dstatement_t;
 
+// statement translated for execution by Scr_TranslateProgram
+typedef struct
+{
+	uint16_t	op;			// instruction to run, may be a fused pair
+	uint16_t	baseop;		// statement's own opcode, for slow path
+	int32_t		jump;		// offset of OP_IF, OP_IFNOT and OP_GOTO
+	eval_t		*a, *b, *c;	// operands resolved to globals
+} qcinstr_t;
+
 
 typedef struct
 {
@@ -143,6 +152,13 @@ typedef struct
 	char	field[SCR_MAX_FIELD_LEN];
 } gefv_cache;
 
+typedef struct
+{
+	int		*head;		// name hash -> first def index, -1 when empty
+	int		*next;		// next def with the same hash, in ascending order
+	int		size;
+} qcvm_namehash_t;
+
 typedef struct
 {
 	int32_t			s;
@@ -152,16 +168,36 @@ typedef struct
 #define PR_TEMP_STRINGS 32 // number of temporary string buffers
 #define	PR_TEMP_STRING_LEN 512 // length of a temporary string buffer
 
+// stringFlags
+#define STR_TEMP	1	// one of tempStrings buffers
+#define STR_OWNED	2	// allocated by Scr_AllocString, freed when collected
+#define STR_PINNED	4	// referenced from C code, never collected
+#define STR_MARKED	8	// reachable in current Scr_CollectStrings pass
+
 typedef struct qcvm_strings_s
 {
 	const char** stringTable;
+	byte* stringFlags;
+	int* stringNext;		// next slot in hash chain, or in free list for empty slots
 	int stringTableSize;
-	int numStringsInTable;
+	int numStringsInTable;	// slots used so far, including free ones
+
+	int* hashHead;			// string pointer -> first slot
+	int hashSize;
+	int freeSlot;			// first empty slot or -1
+
+	int numLiveStrings;
+	int numNewStrings;		// added since last collection
+	int collectThreshold;
+	int* stringFields;		// offsets of string entity fields, built on first collection
+	int numStringFields;
 
 	char tempStrings[PR_TEMP_STRINGS][PR_TEMP_STRING_LEN];
 	int numTempStrings;
 }qcvm_strings_t;
 
+typedef struct qcvm_profile_s qcvm_profile_t; // qcvm_profile.c
+
 typedef struct qcvm_s
 {
 	vmType_t		progsType;		// SCRVM_
@@ -173,6 +209,7 @@ typedef struct qcvm_s
 	ddef_t			*pGlobalDefs;
 	ddef_t			*pFieldDefs;	
 	dstatement_t	*pStatements;
+	qcinstr_t		*code;			// pStatements translated for execution
 
 //	sv_globalvars_t	*globals_struct;
 	unsigned int	num_entities;		// number of allocated entities
@@ -188,7 +225,12 @@ typedef struct qcvm_s
 
 	gefv_cache		gefvCache[SCR_GEFV_CACHESIZE];
 
+	qcvm_namehash_t	functionHash;
+	qcvm_namehash_t	globalHash;
+	qcvm_namehash_t	fieldHash;
+
 	qboolean		traceEnabled;
+	qcvm_profile_t	*profile;		// allocated while vm_profile_start is running
 
 	prstack_t		stack[SCR_MAX_STACK_DEPTH];
 	int				stackDepth;
@@ -229,6 +271,19 @@ void Scr_InitSharedBuiltins();
 void CheckScriptVM(const char* func);
 
 dfunction_t* Scr_FindFunction(const char* name);
+const char* Scr_GetScriptName(vmType_t vm);
+
+void Scr_FreeStringTable(qcvm_strings_t* strTable);
+void Scr_TranslateProgram(qcvm_t* vm);
+
+extern cvar_t* vm_profile;
+
+void Scr_InitProfiler();
+void Scr_ShutdownProfiler();
+void Scr_ProfileBegin(qcvm_t* vm);
+void Scr_ProfileEnter(qcvm_t* vm, int id);
+void Scr_ProfileLeave(qcvm_t* vm);
+void Scr_ProfileFree(qcvm_t* vm);
 
 
 #define	G_INT(o)			(*(int *)&active_qcvm->pGlobals[o])
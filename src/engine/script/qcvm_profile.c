@@ -0,0 +1,501 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+
+// qcvm_profile.c - timing of qc functions and builtins
+
+#include "../pragma.h"
+#include "qcvm_private.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	#include <intrin.h>
+	#define ScrProfile_Ticks() __rdtsc()
+#elif defined(__i386__) || defined(__x86_64__)
+	#include <x86intrin.h>
+	#define ScrProfile_Ticks() __rdtsc()
+#else
+	#define ScrProfile_Ticks() Sys_Microseconds()
+#endif
+
+#define PROFILE_MAX_DEPTH	256		// deeper calls are counted but not timed
+#define PROFILE_MAX_NODES	65536	// distinct call stacks, deeper ones are merged into their parent
+#define PROFILE_NODE_HASH	4096
+
+typedef struct
+{
+	int				calls;
+	int				active;		// recursion depth, inclusive time is counted for outermost call only
+	uint64_t		inclusive;
+	uint64_t		exclusive;
+} profstat_t;
+
+typedef struct
+{
+	int				parent;		// -1 when called from engine
+	int				id;			// function number, or -1 - builtin number
+	int				hashNext;
+	int				calls;
+	uint64_t		exclusive;
+} profnode_t;
+
+typedef struct
+{
+	int				node;
+	int				id;
+	uint64_t		start;
+	uint64_t		children;
+} profframe_t;
+
+struct qcvm_profile_s
+{
+	profstat_t		*functions;
+	int				numFunctions;
+	profstat_t		*builtins;
+	int				numBuiltins;
+
+	profnode_t		*nodes;
+	int				numNodes, maxNodes;
+	int				nodeHash[PROFILE_NODE_HASH];
+
+	profframe_t		stack[PROFILE_MAX_DEPTH];
+	int				depth;
+};
+
+static qboolean		scr_profiling = false;
+
+// ticks are converted to microseconds with rate measured while profiler was running
+static uint64_t		profileTicks, profileStartTicks;
+static uint64_t		profileMicroseconds, profileStartMicroseconds;
+
+extern qcvm_t* qcvm[NUM_SCRIPT_VMS];
+
+/*
+============
+Scr_ProfileFree
+============
+*/
+void Scr_ProfileFree(qcvm_t* vm)
+{
+	qcvm_profile_t* prof = vm->profile;
+
+	if (!prof)
+		return;
+
+	free(prof->functions);
+	free(prof->builtins);
+	free(prof->nodes);
+	free(prof);
+	vm->profile = NULL;
+}
+
+/*
+============
+Scr_ProfileBegin
+Called by Scr_Execute, sets up profile for the vm when profiler is running.
+============
+*/
+void Scr_ProfileBegin(qcvm_t* vm)
+{
+	qcvm_profile_t* prof;
+	int i;
+
+	if (!scr_profiling)
+		return;
+
+	prof = vm->profile;
+	if (!prof)
+	{
+		prof = vm->profile = calloc(1, sizeof(qcvm_profile_t));
+		if (!prof)
+			return;
+
+		prof->numFunctions = vm->progs->numFunctions;
+		prof->numBuiltins = scr_numBuiltins;
+		prof->functions = calloc(prof->numFunctions, sizeof(profstat_t));
+		prof->builtins = calloc(prof->numBuiltins, sizeof(profstat_t));
+		prof->maxNodes = 1024;
+		prof->nodes = malloc(prof->maxNodes * sizeof(profnode_t));
+		memset(prof->nodeHash, -1, sizeof(prof->nodeHash));
+
+		if (!prof->functions || !prof->builtins || !prof->nodes)
+		{
+			Scr_ProfileFree(vm);
+			return;
+		}
+	}
+
+	// previous program was aborted by runtime error, calls it left open never return
+	if (vm->stackDepth == 0 && prof->depth)
+	{
+		prof->depth = 0;
+		for (i = 0; i < prof->numFunctions; i++)
+			prof->functions[i].active = 0;
+		for (i = 0; i < prof->numBuiltins; i++)
+			prof->builtins[i].active = 0;
+	}
+}
+
+/*
+============
+Scr_ProfileNode
+Returns call stack node for id called from parent.
+============
+*/
+static int Scr_ProfileNode(qcvm_profile_t* prof, int parent, int id)
+{
+	profnode_t	*node, *nodes;
+	int			n, hash;
+
+	hash = ((unsigned int)(parent * 31 + id) * 2654435761u) & (PROFILE_NODE_HASH - 1);
+	for (n = prof->nodeHash[hash]; n != -1; n = prof->nodes[n].hashNext)
+	{
+		if (prof->nodes[n].parent == parent && prof->nodes[n].id == id)
+			return n;
+	}
+
+	if (prof->numNodes == prof->maxNodes)
+	{
+		if (prof->maxNodes >= PROFILE_MAX_NODES || !(nodes = realloc(prof->nodes, prof->maxNodes * 2 * sizeof(profnode_t))))
+			return parent; // out of nodes, time goes to caller
+
+		prof->nodes = nodes;
+		prof->maxNodes *= 2;
+	}
+
+	n = prof->numNodes++;
+	node = &prof->nodes[n];
+	node->parent = parent;
+	node->id = id;
+	node->calls = 0;
+	node->exclusive = 0;
+	node->hashNext = prof->nodeHash[hash];
+	prof->nodeHash[hash] = n;
+	return n;
+}
+
+/*
+============
+Scr_ProfileEnter
+Called when qc function or builtin is entered, id is function number or -1 - builtin number.
+============
+*/
+void Scr_ProfileEnter(qcvm_t* vm, int id)
+{
+	qcvm_profile_t	*prof = vm->profile;
+	profstat_t		*stat;
+	profframe_t		*frame;
+	int				parent;
+
+	if (!scr_profiling)
+		return;
+
+	if (id >= 0 && id < prof->numFunctions)
+		stat = &prof->functions[id];
+	else if (id < 0 && -1 - id < prof->numBuiltins)
+		stat = &prof->builtins[-1 - id];
+	else
+		stat = NULL;
+
+	if (stat)
+	{
+		stat->calls++;
+		stat->active++;
+	}
+
+	if (prof->depth++ >= PROFILE_MAX_DEPTH)
+		return;
+
+	frame = &prof->stack[prof->depth - 1];
+	parent = (prof->depth > 1) ? frame[-1].node : -1;
+	frame->node = Scr_ProfileNode(prof, parent, id);
+	frame->id = id;
+	frame->children = 0;
+	if (frame->node >= 0)
+		prof->nodes[frame->node].calls++;
+
+	frame->start = ScrProfile_Ticks();
+}
+
+/*
+============
+Scr_ProfileLeave
+============
+*/
+void Scr_ProfileLeave(qcvm_t* vm)
+{
+	uint64_t		now, elapsed, exclusive;
+	qcvm_profile_t	*prof = vm->profile;
+	profstat_t		*stat;
+	profframe_t		*frame;
+
+	now = ScrProfile_Ticks();
+
+	if (!scr_profiling || prof->depth <= 0)
+		return; // profiler was started in the middle of a call
+
+	if (prof->depth-- > PROFILE_MAX_DEPTH)
+		return;
+
+	frame = &prof->stack[prof->depth];
+	elapsed = now - frame->start;
+	exclusive = elapsed > frame->children ? elapsed - frame->children : 0;
+
+	if (frame->id >= 0 && frame->id < prof->numFunctions)
+		stat = &prof->functions[frame->id];
+	else if (frame->id < 0 && -1 - frame->id < prof->numBuiltins)
+		stat = &prof->builtins[-1 - frame->id];
+	else
+		stat = NULL;
+
+	if (stat)
+	{
+		stat->exclusive += exclusive;
+		if (stat->active > 0 && --stat->active == 0)
+			stat->inclusive += elapsed;
+	}
+
+	if (frame->node >= 0)
+		prof->nodes[frame->node].exclusive += exclusive;
+
+	if (prof->depth > 0)
+		frame[-1].children += elapsed;
+}
+
+/*
+============
+Scr_ProfileMicroseconds
+============
+*/
+static double Scr_ProfileMicroseconds(uint64_t ticks)
+{
+	uint64_t t = profileTicks, us = profileMicroseconds;
+
+	if (scr_profiling)
+	{
+		t += ScrProfile_Ticks() - profileStartTicks;
+		us += Sys_Microseconds() - profileStartMicroseconds;
+	}
+
+	if (!t || !us)
+		return 0.0;
+	return (double)ticks * ((double)us / (double)t);
+}
+
+/*
+============
+Scr_ProfileName
+============
+*/
+static const char* Scr_ProfileName(qcvm_t* vm, int id)
+{
+	if (id >= 0)
+		return vm->pStrings + vm->pFunctions[id].s_name;
+	if (-1 - id < scr_numBuiltins)
+		return va("%s [builtin]", scr_builtins[-1 - id].name);
+	return "?";
+}
+
+/*
+============
+Scr_ProfilePrint
+Prints functions and builtins which took the most time.
+============
+*/
+static void Scr_ProfilePrint(qcvm_t* vm, int count)
+{
+	qcvm_profile_t	*prof = vm->profile;
+	profstat_t		*stat, *best;
+	qboolean		*printed;
+	int				i, n, total, bestId;
+
+	total = prof->numFunctions + prof->numBuiltins;
+	printed = calloc(total, sizeof(qboolean));
+	if (!printed)
+		return;
+
+	Com_Printf("---- %s QCVM profile ----\n", Scr_GetScriptName(vm->progsType));
+	Com_Printf("%10s %10s %8s  %s\n", "excl ms", "incl ms", "calls", "name");
+
+	for (n = 0; n < count; n++)
+	{
+		best = NULL;
+		bestId = 0;
+		for (i = 0; i < total; i++)
+		{
+			stat = (i < prof->numFunctions) ? &prof->functions[i] : &prof->builtins[i - prof->numFunctions];
+			if (printed[i] || !stat->calls)
+				continue;
+			if (!best || stat->exclusive > best->exclusive)
+			{
+				best = stat;
+				bestId = i;
+			}
+		}
+		if (!best)
+			break;
+
+		printed[bestId] = true;
+		Com_Printf("%10.3f %10.3f %8i  %s\n", Scr_ProfileMicroseconds(best->exclusive) / 1000.0, Scr_ProfileMicroseconds(best->inclusive) / 1000.0, best->calls,
+			Scr_ProfileName(vm, bestId < prof->numFunctions ? bestId : -1 - (bestId - prof->numFunctions)));
+	}
+
+	free(printed);
+}
+
+/*
+============
+Scr_ProfileWriteStacks
+Writes collapsed stacks, one line per call stack: "vm;func;func;builtin microseconds"
+============
+*/
+static int Scr_ProfileWriteStacks(qcvm_t* vm, FILE* f)
+{
+	qcvm_profile_t	*prof = vm->profile;
+	char			vmname[MAX_QPATH];
+	int				*path, i, n, len, lines;
+	unsigned int	us;
+
+	path = malloc(PROFILE_MAX_DEPTH * sizeof(int));
+	if (!path)
+		return 0;
+
+	COM_FileBase(vmDefs[vm->progsType].filename, vmname);
+
+	lines = 0;
+	for (i = 0; i < prof->numNodes; i++)
+	{
+		us = (unsigned int)Scr_ProfileMicroseconds(prof->nodes[i].exclusive);
+		if (!us)
+			continue;
+
+		len = 0;
+		for (n = i; n != -1 && len < PROFILE_MAX_DEPTH; n = prof->nodes[n].parent)
+			path[len++] = n;
+
+		fprintf(f, "%s", vmname);
+		while (len--)
+			fprintf(f, ";%s", Scr_ProfileName(vm, prof->nodes[path[len]].id));
+		fprintf(f, " %u\n", us);
+		lines++;
+	}
+
+	free(path);
+	return lines;
+}
+
+/*
+============
+Cmd_VM_ProfileStart_f
+============
+*/
+static void Cmd_VM_ProfileStart_f(void)
+{
+	vmType_t i;
+
+	for (i = 0; i < NUM_SCRIPT_VMS; i++)
+	{
+		if (qcvm[i])
+			Scr_ProfileFree(qcvm[i]);
+	}
+
+	scr_profiling = true;
+	profileTicks = profileMicroseconds = 0;
+	profileStartTicks = ScrProfile_Ticks();
+	profileStartMicroseconds = Sys_Microseconds();
+
+	Com_Printf("QC profiler started.\n");
+}
+
+/*
+============
+Cmd_VM_ProfileStop_f
+============
+*/
+static void Cmd_VM_ProfileStop_f(void)
+{
+	vmType_t i;
+
+	if (!scr_profiling)
+	{
+		Com_Printf("QC profiler is not running.\n");
+		return;
+	}
+
+	profileTicks += ScrProfile_Ticks() - profileStartTicks;
+	profileMicroseconds += Sys_Microseconds() - profileStartMicroseconds;
+	scr_profiling = false;
+
+	for (i = 0; i < NUM_SCRIPT_VMS; i++)
+	{
+		if (qcvm[i] && qcvm[i]->profile)
+			Scr_ProfilePrint(qcvm[i], 20);
+	}
+	Com_Printf("QC profiler stopped after %.1f seconds, use vm_profile_dump to save call stacks.\n", profileMicroseconds / 1000000.0);
+}
+
+/*
+============
+Cmd_VM_ProfileDump_f
+
+vm_profile_dump [filename]
+Writes collapsed call stacks of all vms for flame graph tools.
+============
+*/
+static void Cmd_VM_ProfileDump_f(void)
+{
+	char		name[MAX_OSPATH];
+	FILE		*f;
+	vmType_t	i;
+	int			lines = 0;
+
+	Com_sprintf(name, sizeof(name), "%s/%s", FS_Gamedir(), Cmd_Argc() > 1 ? Cmd_Argv(1) : "qcprofile.txt");
+	FS_CreatePath(name);
+
+	f = fopen(name, "w");
+	if (!f)
+	{
+		Com_Printf("Couldn't write %s.\n", name);
+		return;
+	}
+
+	for (i = 0; i < NUM_SCRIPT_VMS; i++)
+	{
+		if (qcvm[i] && qcvm[i]->profile)
+			lines += Scr_ProfileWriteStacks(qcvm[i], f);
+	}
+	fclose(f);
+
+	Com_Printf("Wrote %i call stacks to %s.\n", lines, name);
+}
+
+/*
+============
+Scr_InitProfiler
+============
+*/
+void Scr_InitProfiler()
+{
+	Cmd_AddCommand("vm_profile_start", Cmd_VM_ProfileStart_f);
+	Cmd_AddCommand("vm_profile_stop", Cmd_VM_ProfileStop_f);
+	Cmd_AddCommand("vm_profile_dump", Cmd_VM_ProfileDump_f);
+}
+
+/*
+============
+Scr_ShutdownProfiler
+============
+*/
+void Scr_ShutdownProfiler()
+{
+	scr_profiling = false;
+
+	Cmd_RemoveCommand("vm_profile_start");
+	Cmd_RemoveCommand("vm_profile_stop");
+	Cmd_RemoveCommand("vm_profile_dump");
+}
@@ -16,6 +16,9 @@ See the attached GNU General Public License v2 for more details.
 
 static qcvm_strings_t* pVMStr = NULL;
 
+#define STR_HASH(ptr, size)	((unsigned int)(((uintptr_t)(ptr) >> 3) * 2654435761u) & ((size) - 1))
+#define STR_COLLECT_MIN	256	// don't bother collecting when there's fewer strings allocated since last collection
+
 /*
 ============
 Scr_MapTempStringsToStringTable
@@ -29,10 +32,42 @@ static void Scr_MapTempStringsToStringTable()
 	for (strindex = 0; strindex < PR_TEMP_STRINGS; strindex++)
 	{
 		pVMStr->stringTable[strindex] = pVMStr->tempStrings[strindex];
+		pVMStr->stringFlags[strindex] = STR_TEMP;
 		pVMStr->numStringsInTable++;
 	}
 }
 
+/*
+============
+Scr_RehashStringTable
+Rebuilds pointer hash after the table has grown, keeps the hash at least as large as the table.
+============
+*/
+static void Scr_RehashStringTable()
+{
+	int strindex, hash;
+
+	while (pVMStr->hashSize < pVMStr->stringTableSize)
+		pVMStr->hashSize = pVMStr->hashSize ? pVMStr->hashSize * 2 : 256;
+
+	free(pVMStr->hashHead);
+	pVMStr->hashHead = (int*)malloc(pVMStr->hashSize * sizeof(int));
+	if (pVMStr->hashHead == NULL)
+	{
+		Com_Error(ERR_FATAL, "Could not allocate string table hash.\n");
+		return;
+	}
+	memset(pVMStr->hashHead, -1, pVMStr->hashSize * sizeof(int));
+
+	for (strindex = PR_TEMP_STRINGS; strindex < pVMStr->numStringsInTable; strindex++)
+	{
+		if (!pVMStr->stringTable[strindex])
+			continue; // on the free list, keep the link
+		hash = STR_HASH(pVMStr->stringTable[strindex], pVMStr->hashSize);
+		pVMStr->stringNext[strindex] = pVMStr->hashHead[hash];
+		pVMStr->hashHead[hash] = strindex;
+	}
+}
 
 /*
 ============
@@ -43,37 +78,147 @@ Reserves first few slots for the temporary strings mambo jambo.
 */
 static void Scr_CreateStringTable()
 {
+	qboolean created;
+
 	CheckScriptVM(__FUNCTION__);
 	pVMStr = &active_qcvm->strTable;
 
-	pVMStr->stringTableSize += 128;
-
-	// if no string table was initialized, create one
-	if (pVMStr->stringTable == NULL)
+	created = (pVMStr->stringTable == NULL);
+	if (created)
 	{
 		pVMStr->numStringsInTable = 0;
-		pVMStr->stringTableSize += PR_TEMP_STRINGS; // add some space for tempstrings
+		pVMStr->stringTableSize = PR_TEMP_STRINGS + 128; // add some space for tempstrings
+		pVMStr->freeSlot = -1;
+		pVMStr->collectThreshold = STR_COLLECT_MIN;
+	}
+	else
+	{
+		pVMStr->stringTableSize *= 2; // grow geometrically so long maps don't keep reallocating
+	}
 
-		pVMStr->stringTable = (const char**)malloc(pVMStr->stringTableSize * sizeof(char*));
-		if (pVMStr->stringTable == NULL)
-		{
-			Com_Error(ERR_FATAL, "Could not allocate space for string table.\n");
-			return;
-		}
+	pVMStr->stringTable = (const char**)realloc((void*)pVMStr->stringTable, pVMStr->stringTableSize * sizeof(char*));
+	pVMStr->stringNext = (int*)realloc(pVMStr->stringNext, pVMStr->stringTableSize * sizeof(int));
+	pVMStr->stringFlags = (byte*)realloc(pVMStr->stringFlags, pVMStr->stringTableSize * sizeof(byte));
+	if (pVMStr->stringTable == NULL || pVMStr->stringNext == NULL || pVMStr->stringFlags == NULL)
+	{
+		Com_Error(ERR_FATAL, "Could not %s string table.\n", created ? "allocate space for" : "expand");
+		return;
+	}
 
+	if (created)
 		Scr_MapTempStringsToStringTable();
-		return;
+	else
+		Com_Printf("Scr_AllocStringTable: %d string slots.\n", pVMStr->stringTableSize);
+
+	Scr_RehashStringTable();
+}
+
+/*
+============
+Scr_FreeStringTable
+Releases string table of a VM, strings allocated in it are freed with VM's memory tag.
+============
+*/
+void Scr_FreeStringTable(qcvm_strings_t* strTable)
+{
+	free((void*)strTable->stringTable);
+	free(strTable->stringNext);
+	free(strTable->stringFlags);
+	free(strTable->hashHead);
+	free(strTable->stringFields);
+
+	strTable->stringFields = NULL;
+	strTable->numStringFields = 0;
+	strTable->stringTable = NULL;
+	strTable->stringNext = NULL;
+	strTable->stringFlags = NULL;
+	strTable->hashHead = NULL;
+	strTable->stringTableSize = strTable->hashSize = 0;
+	strTable->numStringsInTable = 0;
+
+	if (strTable == pVMStr)
+		pVMStr = NULL;
+}
+
+/*
+============
+Scr_FindStringSlot
+Returns table index for string pointer, or -1 when it's not in table.
+============
+*/
+static int Scr_FindStringSlot(const char* str)
+{
+	int strindex;
+
+	for (strindex = pVMStr->hashHead[STR_HASH(str, pVMStr->hashSize)]; strindex != -1; strindex = pVMStr->stringNext[strindex])
+	{
+		if (pVMStr->stringTable[strindex] == str)
+			return strindex;
 	}
+	return -1;
+}
 
-	// if the table exists -- expand it
-	void* ptr = (void*)pVMStr->stringTable;
-	pVMStr->stringTable = (const char**)realloc(ptr, pVMStr->stringTableSize * sizeof(char*));
-	if (pVMStr->stringTable == NULL)
+/*
+============
+Scr_NewStringSlot
+Takes a slot from free list or the end of table and hashes str into it.
+============
+*/
+static int Scr_NewStringSlot(const char* str, int flags)
+{
+	int strindex, hash;
+
+	if (pVMStr->freeSlot != -1)
 	{
-		Com_Error(ERR_FATAL, "Could not expand string table.\n");
+		strindex = pVMStr->freeSlot;
+		pVMStr->freeSlot = pVMStr->stringNext[strindex];
+	}
+	else
+	{
+		if (pVMStr->numStringsInTable >= pVMStr->stringTableSize)
+		{
+			// string table is at full capacity, allocate space for more entries
+			Scr_CreateStringTable();
+		}
+		strindex = pVMStr->numStringsInTable++;
 	}
 
-	Com_Printf("Scr_AllocStringTable: %d string slots.\n", pVMStr->stringTableSize);
+	hash = STR_HASH(str, pVMStr->hashSize);
+	pVMStr->stringTable[strindex] = str;
+	pVMStr->stringFlags[strindex] = flags;
+	pVMStr->stringNext[strindex] = pVMStr->hashHead[hash];
+	pVMStr->hashHead[hash] = strindex;
+
+	pVMStr->numLiveStrings++;
+	pVMStr->numNewStrings++;
+
+	return strindex;
+}
+
+/*
+============
+Scr_FreeStringSlot
+Unhashes the slot and puts it on free list, frees the string if VM allocated it.
+============
+*/
+static void Scr_FreeStringSlot(int strindex)
+{
+	int *link;
+
+	link = &pVMStr->hashHead[STR_HASH(pVMStr->stringTable[strindex], pVMStr->hashSize)];
+	while (*link != strindex)
+		link = &pVMStr->stringNext[*link];
+	*link = pVMStr->stringNext[strindex];
+
+	if (pVMStr->stringFlags[strindex] & STR_OWNED)
+		Z_Free((void*)pVMStr->stringTable[strindex]);
+
+	pVMStr->stringTable[strindex] = NULL;
+	pVMStr->stringFlags[strindex] = 0;
+	pVMStr->stringNext[strindex] = pVMStr->freeSlot;
+	pVMStr->freeSlot = strindex;
+
+	pVMStr->numLiveStrings--;
 }
 
 /*
@@ -136,24 +281,18 @@ int Scr_SetString(const char* str)
 		return (int)(str - active_qcvm->pStrings);
 	}
 
-	// negative str addresses are remapped to string table
-	for (strindex = 0; strindex < pVMStr->numStringsInTable; strindex++)
-	{
-		if (pVMStr->stringTable[strindex] == str)
-			return -1 - strindex;
-	}
-
-	if (strindex >= pVMStr->stringTableSize)
-	{
-		// string table is at full capacity, allocate space for more entries
+	if (pVMStr->stringTable == NULL)
 		Scr_CreateStringTable();
-	}
 
-	pVMStr->numStringsInTable++;
-	pVMStr->stringTable[strindex] = str;
+	// negative str addresses are remapped to string table
+	strindex = Scr_FindStringSlot(str);
+	if (strindex != -1)
+		return -1 - strindex;
+
+	strindex = Scr_NewStringSlot(str, 0);
 
 #ifdef _DEBUG
-	Com_Printf("New string '%s' (%i strings, strtable for %i)\n", str, pVMStr->numStringsInTable, pVMStr->stringTableSize);
+	Com_Printf("New string '%s' (%i strings, strtable for %i)\n", str, pVMStr->numLiveStrings, pVMStr->stringTableSize);
 #endif
 	return -1 - strindex;
 }
@@ -254,6 +393,7 @@ Allocates a new string and puts it in string table.
 scr_string_t Scr_AllocString(int size, char** ptr)
 {
 	scr_string_t strindex;
+	char* newstr;
 
 	if (!size)
 		return 0;
@@ -261,23 +401,15 @@ scr_string_t Scr_AllocString(int size, char** ptr)
 	CheckScriptVM(__FUNCTION__);
 	pVMStr = &active_qcvm->strTable;
 
-	for (strindex = 0; strindex < pVMStr->numStringsInTable; strindex++)
-	{
-		if (!pVMStr->stringTable[strindex])
-			break;
-	}
-
-	if (strindex >= pVMStr->stringTableSize)
-	{
+	if (pVMStr->stringTable == NULL)
 		Scr_CreateStringTable();
-	}
 
-	pVMStr->stringTable[strindex] = (char*)Z_TagMalloc(size, (TAG_QCVM_MEMORY + active_qcvm->progsType));
-	pVMStr->numStringsInTable++;
+	newstr = (char*)Z_TagMalloc(size, (TAG_QCVM_MEMORY + active_qcvm->progsType));
+	strindex = Scr_NewStringSlot(newstr, STR_OWNED);
 
 	if (ptr)
 	{
-		*ptr = (char*)pVMStr->stringTable[strindex];
+		*ptr = newstr;
 	}
 
 	return -1 - strindex;
@@ -314,4 +446,110 @@ scr_string_t Scr_NewString(const char* string)
 	}
 
 	return num;
-}
\ No newline at end of file
+}
+
+
+/*
+============
+Scr_PinString
+Keeps string alive across Scr_CollectStrings, for strings which are only referenced from C code.
+============
+*/
+void Scr_PinString(scr_string_t str)
+{
+	CheckScriptVM(__FUNCTION__);
+	pVMStr = &active_qcvm->strTable;
+
+	if (str < 0 && str >= -pVMStr->numStringsInTable && pVMStr->stringTable[-1 - str])
+		pVMStr->stringFlags[-1 - str] |= STR_PINNED;
+}
+
+/*
+============
+Scr_MarkString
+============
+*/
+static void Scr_MarkString(int num)
+{
+	if (num < -PR_TEMP_STRINGS && num >= -pVMStr->numStringsInTable)
+		pVMStr->stringFlags[-1 - num] |= STR_MARKED;
+}
+
+/*
+============
+Scr_CollectStrings
+Frees table strings which are no longer referenced by globals or entity fields.
+
+Globals are scanned as a whole because locals and arrays have no string defs, entity
+fields only where they're declared as strings. Must be called outside of QC execution
+and only once the number of strings has grown since the last collection.
+============
+*/
+void Scr_CollectStrings()
+{
+	int			i, j, strindex, freed;
+	int			*entvars;
+	ddef_t		*def;
+
+	CheckScriptVM(__FUNCTION__);
+	pVMStr = &active_qcvm->strTable;
+
+	if (pVMStr->stringTable == NULL || active_qcvm->stackDepth != 0)
+		return;
+
+	if (pVMStr->numNewStrings < pVMStr->collectThreshold)
+		return;
+
+	// mark
+	for (i = 0; i < active_qcvm->progs->numGlobals; i++)
+		Scr_MarkString(((int*)active_qcvm->pGlobals)[i]);
+
+	if (pVMStr->stringFields == NULL)
+	{
+		pVMStr->stringFields = (int*)malloc((active_qcvm->progs->numFieldDefs + 1) * sizeof(int));
+		if (pVMStr->stringFields == NULL)
+		{
+			Com_Error(ERR_FATAL, "Could not allocate string field list.\n");
+			return;
+		}
+
+		pVMStr->numStringFields = 0;
+		for (i = 0; i < active_qcvm->progs->numFieldDefs; i++)
+		{
+			def = &active_qcvm->pFieldDefs[i];
+			if ((def->type & ~DEF_SAVEGLOBAL) == ev_string)
+				pVMStr->stringFields[pVMStr->numStringFields++] = def->ofs;
+		}
+	}
+
+	for (i = 0; i < (int)active_qcvm->num_entities; i++)
+	{
+		entvars = (int*)(active_qcvm->entities + i * active_qcvm->entity_size + active_qcvm->offsetToEntVars);
+		for (j = 0; j < pVMStr->numStringFields; j++)
+			Scr_MarkString(entvars[pVMStr->stringFields[j]]);
+	}
+
+	// sweep
+	freed = 0;
+	for (strindex = PR_TEMP_STRINGS; strindex < pVMStr->numStringsInTable; strindex++)
+	{
+		if (!pVMStr->stringTable[strindex])
+			continue;
+
+		if (pVMStr->stringFlags[strindex] & (STR_MARKED | STR_PINNED))
+		{
+			pVMStr->stringFlags[strindex] &= ~STR_MARKED;
+			continue;
+		}
+
+		Scr_FreeStringSlot(strindex);
+		freed++;
+	}
+
+	// survivors won't be scanned again until as many new strings have been added
+	pVMStr->numNewStrings = 0;
+	pVMStr->collectThreshold = max(STR_COLLECT_MIN, pVMStr->numLiveStrings);
+
+	if (freed)
+		Com_DPrintf(DP_SCRIPT, "%s QCVM: collected %i strings, %i in use.\n", Scr_GetScriptName(active_qcvm->progsType), freed, pVMStr->numLiveStrings);
+}
@@ -62,8 +62,6 @@ scr_func_t Scr_FindFunctionIndex(const char* funcname)
 	return -1;
 }
 
-
-
 /*
 ============
 ScrInternal_GetParmOffset
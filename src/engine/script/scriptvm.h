@@ -108,6 +108,8 @@ int Scr_SetString(const char* str);
 const char* Scr_GetString(int num);
 const char* Scr_VarString(int first);
 scr_string_t Scr_NewString(const char* string);
+void Scr_PinString(scr_string_t str);
+void Scr_CollectStrings();
 
 
 // scr_utils.c
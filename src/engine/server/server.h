@@ -163,6 +163,7 @@ typedef struct client_s
 	char			userinfo[MAX_INFO_STRING];		// name, etc
 
 	int				lastframe;			// for delta compression
+	int				protocol;			// PROTOCOL_VERSION or PROTOCOL_VERSION_BITS
 	usercmd_t		lastcmd;			// for filling in big drops
 
 	int				commandMsec;		// every seconds this is reset, if user
@@ -230,6 +231,7 @@ typedef struct
 	int			num_client_entities;		// maxclients->value*UPDATE_BACKUP*MAX_PACKET_ENTITIES
 	int			next_client_entities;		// next client_entity to use
 	entity_state_t	*client_entities;		// [num_client_entities]
+	int			*client_entity_stamps;		// [num_client_entities] send pass state was copied from entity in, -1 if changed for client
 
 	int			last_heartbeat;
 
@@ -266,6 +268,13 @@ extern	cvar_t		*sv_enforcetime;
 	
 extern	cvar_t		*sv_maxvelocity;
 extern	cvar_t		*sv_gravity;
+extern	cvar_t		*sv_broadphase;
+extern	cvar_t		*sv_tracethreads;
+extern	cvar_t		*sv_physicsislands;
+extern	cvar_t		*sv_parallelframes;
+extern	cvar_t		*sv_deltacache;
+extern	cvar_t		*sv_bitpacked;
+extern	cvar_t		*sv_fragbudget;
 
 extern	client_t	*sv_client;
 extern	gentity_t	*sv_player;
@@ -323,6 +332,15 @@ void SV_Physics_None(gentity_t* ent);
 void SV_Physics_Noclip(gentity_t* ent);
 void SV_Physics_Step(gentity_t* ent);
 void SV_Physics_Toss(gentity_t* ent);
+int SV_FlyMove(gentity_t* ent, float time, int mask);
+trace_t SV_PushEntity(gentity_t* ent, vec3_t push);
+
+// toss and step physics split around the move for sv_islands.c
+qboolean SV_Physics_TossBegin(gentity_t* ent, vec3_t move);
+void SV_Physics_TossEnd(gentity_t* ent, trace_t* trace, vec3_t old_origin);
+qboolean SV_Physics_StepBegin(gentity_t* ent, qboolean* onground, qboolean* hitground);
+void SV_Physics_StepEnd(gentity_t* ent, qboolean wasonground, qboolean hitsound);
+int SV_Physics_StepMask(gentity_t* ent);
 
 //
 // sv_send.c
@@ -359,10 +377,17 @@ void SV_Status_f (void);
 //
 // sv_write.c
 //
-void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg);
+void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg, int thread); // thread picks delta cache, 0 on main thread
+void SV_DeltaCacheStats_f(void);
 void SV_RecordDemoMessage (void);
 void SV_BuildClientFrame (client_t *client);
 
+void SV_BeginClientFrames(void);
+qboolean SV_CanBuildClientFrameOnJobs(client_t* client);
+void SV_BuildClientFramesOnJobs(client_t** clients, sizebuf_t** msgs, int count);
+// with sv_parallelframes frames of clients which can't see entities with
+// EntityStateForClient callbacks are culled and encoded on job threads
+
 //
 // sv_gentity.c
 //
@@ -378,10 +403,49 @@ qboolean SV_RunThink(gentity_t* ent);
 void SV_InitDevTools();
 void SV_FreeDevTools();
 
+//
+// sv_perf.c
+//
+typedef enum
+{
+	SVPERF_FRAME,			// whole SV_Frame, excluding sleep
+	SVPERF_READPACKETS,
+	SVPERF_GAMEFRAME,		// SV_RunGameFrame, includes stages below
+	SVPERF_PRETHINK,
+	SVPERF_THINK,			// entity thinks and client frames
+	SVPERF_PHYSICS,			// excluding thinks
+	SVPERF_ENDFRAME,
+	SVPERF_SENDMESSAGES,	// SV_SendClientMessages, includes stages below
+	SVPERF_BUILDFRAME,		// all clients
+	SVPERF_WRITEFRAME,		// delta encoding
+	SVPERF_TRANSMIT,
+	SVPERF_NUM_STAGES
+} svperfstage_t;
+
+unsigned int SV_PerfAdd(svperfstage_t stage, unsigned long long start);
+void SV_PerfSubtract(svperfstage_t stage, unsigned int usec);
+void SV_PerfEndFrame(void);
+void SV_Perf_f(void);
+void SV_PerfDump_f(void);
+
 //
 // sv_world.c
 //
 extern int SV_TouchEntities(gentity_t* ent, int areatype);
+void SV_BroadphaseBench_f(void);
+void SV_ClusterEntityBits(byte* pvs, unsigned int* bits);
+
+//
+// sv_aabbtree.c
+//
+typedef struct sv_aabbtree_s sv_aabbtree_t;
+
+sv_aabbtree_t* SV_AABBTree_Create();
+void SV_AABBTree_Free(sv_aabbtree_t* tree);
+void SV_AABBTree_Link(sv_aabbtree_t* tree, int id, vec3_t mins, vec3_t maxs);
+void SV_AABBTree_Unlink(sv_aabbtree_t* tree, int id);
+int SV_AABBTree_Query(sv_aabbtree_t* tree, vec3_t mins, vec3_t maxs, int* ids, int maxcount);
+int SV_AABBTree_Height(sv_aabbtree_t* tree);
 
 //============================================================
 
@@ -433,4 +497,58 @@ trace_t SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, gentity_t *
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+int SV_HullForEntity(gentity_t* ent);
+void SV_TraceBounds(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, vec3_t boxmins, vec3_t boxmaxs);
+
+//
+// sv_tracebatch.c
+//
+typedef struct
+{
+	vec3_t		start, end;
+	vec3_t		mins, maxs;		// relative, vec3_origin for lines
+	trace_t		trace;			// result
+} svtrace_t;
+
+void SV_TraceBatch(svtrace_t* traces, int count, gentity_t* passedict, int contentmask);
+// same as calling SV_Trace for every trace, but entities are gathered once for
+// traces close to each other and the work is split across threads
+
+typedef struct
+{
+	gentity_t	*ent;
+	int			headnode;	// -1 for boxes, those are built in context of tracing thread
+	float		*angles;
+} svcandidate_t;
+
+cmcontext_t** SV_TraceContexts(void);
+int SV_GatherCandidates(vec3_t mins, vec3_t maxs, svcandidate_t* list, int maxcount);
+trace_t SV_TraceCandidates(cmcontext_t* ctx, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, gentity_t* passedict, int contentmask, svcandidate_t* list, int count);
+// gathering must be done on main thread, tracing against gathered
+// candidates is safe from job threads
+
+//
+// sv_islands.c
+//
+#define SV_MAX_DEFERRED_IMPACTS	4	// one for each SV_FlyMove bump
+
+typedef struct
+{
+	cmcontext_t		*ctx;
+	svcandidate_t	*candidates;
+	int				numCandidates;
+
+	trace_t			impacts[SV_MAX_DEFERRED_IMPACTS];	// run later on main thread
+	int				numImpacts;
+} svphysdefer_t;
+
+int SV_FlyMoveDeferred(gentity_t* ent, float time, int mask, svphysdefer_t* defer);
+
+void SV_BeginIslandPhysics(void);
+qboolean SV_DeferEntityPhysics(gentity_t* ent);
+void SV_RunIslandPhysics(void);
+// with sv_physicsislands toss and step entities only think during entity loop,
+// their moves are traced on job threads in groups that can't touch each other
+// and the rest of their physics and callbacks are run in entity order after
+
 #endif /*_PRAGMA_SERVER_H_*/
\ No newline at end of file
@@ -0,0 +1,512 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// sv_aabbtree.c -- dynamic bounding volume tree for entity area queries
+
+#include "server.h"
+
+/*
+	Leaves hold entity bounds grown by AABB_MARGIN, relinking an entity which
+	still fits in its leaf costs nothing. Leaves are inserted next to the node
+	which grows the least in surface area and the tree is kept balanced with
+	AVL rotations, like in Box2D's b2DynamicTree.
+
+	Node bounds are kept in separate arrays (minx[], miny[], ...) so queries
+	only touch the floats they compare.
+*/
+
+#define AABB_NULL		-1
+#define AABB_MARGIN		16.0f
+#define AABB_STACK		256
+
+struct sv_aabbtree_s
+{
+	float	*mins[3];
+	float	*maxs[3];
+	int		*parent;		// next free node for nodes in free list
+	int		*child[2];		// AABB_NULL for leafs
+	int		*height;		// 0 for leafs, -1 for free nodes
+	int		*id;			// entity id for leafs
+
+	int		root;
+	int		numNodes, maxNodes;
+	int		freeList;
+
+	int		*proxy;			// leaf of an entity id or AABB_NULL
+	int		maxIds;
+};
+
+/*
+===============
+SV_AABBTree_Grow
+===============
+*/
+static void SV_AABBTree_Grow(sv_aabbtree_t* tree, int maxNodes)
+{
+	sv_aabbtree_t	old = *tree;
+	int				i;
+
+	for (i = 0; i < 3; i++)
+	{
+		tree->mins[i] = Z_Malloc(maxNodes * sizeof(float));
+		tree->maxs[i] = Z_Malloc(maxNodes * sizeof(float));
+	}
+	tree->parent = Z_Malloc(maxNodes * sizeof(int));
+	tree->child[0] = Z_Malloc(maxNodes * sizeof(int));
+	tree->child[1] = Z_Malloc(maxNodes * sizeof(int));
+	tree->height = Z_Malloc(maxNodes * sizeof(int));
+	tree->id = Z_Malloc(maxNodes * sizeof(int));
+
+	if (old.maxNodes)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			memcpy(tree->mins[i], old.mins[i], old.maxNodes * sizeof(float));
+			memcpy(tree->maxs[i], old.maxs[i], old.maxNodes * sizeof(float));
+			Z_Free(old.mins[i]);
+			Z_Free(old.maxs[i]);
+		}
+		memcpy(tree->parent, old.parent, old.maxNodes * sizeof(int));
+		memcpy(tree->child[0], old.child[0], old.maxNodes * sizeof(int));
+		memcpy(tree->child[1], old.child[1], old.maxNodes * sizeof(int));
+		memcpy(tree->height, old.height, old.maxNodes * sizeof(int));
+		memcpy(tree->id, old.id, old.maxNodes * sizeof(int));
+		Z_Free(old.parent);
+		Z_Free(old.child[0]);
+		Z_Free(old.child[1]);
+		Z_Free(old.height);
+		Z_Free(old.id);
+	}
+
+	// chain new nodes into free list
+	for (i = old.maxNodes; i < maxNodes; i++)
+	{
+		tree->parent[i] = (i + 1 < maxNodes) ? i + 1 : AABB_NULL;
+		tree->height[i] = -1;
+	}
+	tree->freeList = old.maxNodes;
+	tree->maxNodes = maxNodes;
+}
+
+/*
+===============
+SV_AABBTree_Create
+===============
+*/
+sv_aabbtree_t* SV_AABBTree_Create()
+{
+	sv_aabbtree_t* tree;
+
+	tree = Z_Malloc(sizeof(sv_aabbtree_t));
+	tree->root = AABB_NULL;
+	SV_AABBTree_Grow(tree, 256);
+	return tree;
+}
+
+/*
+===============
+SV_AABBTree_Free
+===============
+*/
+void SV_AABBTree_Free(sv_aabbtree_t* tree)
+{
+	int i;
+
+	if (!tree)
+		return;
+
+	for (i = 0; i < 3; i++)
+	{
+		Z_Free(tree->mins[i]);
+		Z_Free(tree->maxs[i]);
+	}
+	Z_Free(tree->parent);
+	Z_Free(tree->child[0]);
+	Z_Free(tree->child[1]);
+	Z_Free(tree->height);
+	Z_Free(tree->id);
+	if (tree->proxy)
+		Z_Free(tree->proxy);
+	Z_Free(tree);
+}
+
+static int SV_AABBTree_AllocNode(sv_aabbtree_t* tree)
+{
+	int node;
+
+	if (tree->freeList == AABB_NULL)
+		SV_AABBTree_Grow(tree, tree->maxNodes * 2);
+
+	node = tree->freeList;
+	tree->freeList = tree->parent[node];
+	tree->parent[node] = AABB_NULL;
+	tree->child[0][node] = tree->child[1][node] = AABB_NULL;
+	tree->height[node] = 0;
+	tree->numNodes++;
+	return node;
+}
+
+static void SV_AABBTree_FreeNode(sv_aabbtree_t* tree, int node)
+{
+	tree->parent[node] = tree->freeList;
+	tree->height[node] = -1;
+	tree->freeList = node;
+	tree->numNodes--;
+}
+
+// node = union of a and b
+static __inline void SV_AABBTree_Union(sv_aabbtree_t* tree, int node, int a, int b)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		tree->mins[i][node] = min(tree->mins[i][a], tree->mins[i][b]);
+		tree->maxs[i][node] = max(tree->maxs[i][a], tree->maxs[i][b]);
+	}
+}
+
+// half surface area of union of a and b, b may be AABB_NULL
+static __inline float SV_AABBTree_Area(sv_aabbtree_t* tree, int a, int b)
+{
+	float d[3];
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (b == AABB_NULL)
+			d[i] = tree->maxs[i][a] - tree->mins[i][a];
+		else
+			d[i] = max(tree->maxs[i][a], tree->maxs[i][b]) - min(tree->mins[i][a], tree->mins[i][b]);
+	}
+	return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static __inline void SV_AABBTree_Refit(sv_aabbtree_t* tree, int node)
+{
+	int c0 = tree->child[0][node], c1 = tree->child[1][node];
+
+	tree->height[node] = 1 + max(tree->height[c0], tree->height[c1]);
+	SV_AABBTree_Union(tree, node, c0, c1);
+}
+
+/*
+===============
+SV_AABBTree_Balance
+
+Rotates the taller grandchild of node a up if children heights differ by more than one.
+Returns the node which took place of a.
+===============
+*/
+static int SV_AABBTree_Balance(sv_aabbtree_t* tree, int a)
+{
+	int b, c, f, g, up, side, balance;
+
+	if (tree->child[0][a] == AABB_NULL || tree->height[a] < 2)
+		return a;
+
+	b = tree->child[0][a];
+	c = tree->child[1][a];
+	balance = tree->height[c] - tree->height[b];
+
+	if (balance > 1)
+	{
+		up = c;
+		side = 1;	// a keeps b as child[0], c's grandchild goes to a's child[1]
+	}
+	else if (balance < -1)
+	{
+		up = b;
+		side = 0;
+	}
+	else
+	{
+		return a;
+	}
+
+	f = tree->child[0][up];
+	g = tree->child[1][up];
+
+	// swap a and up
+	tree->child[0][up] = a;
+	tree->parent[up] = tree->parent[a];
+	tree->parent[a] = up;
+
+	if (tree->parent[up] != AABB_NULL)
+	{
+		if (tree->child[0][tree->parent[up]] == a)
+			tree->child[0][tree->parent[up]] = up;
+		else
+			tree->child[1][tree->parent[up]] = up;
+	}
+	else
+	{
+		tree->root = up;
+	}
+
+	// taller grandchild stays under up, the other one goes to a
+	if (tree->height[f] > tree->height[g])
+	{
+		tree->child[1][up] = f;
+		tree->child[side][a] = g;
+		tree->parent[g] = a;
+	}
+	else
+	{
+		tree->child[1][up] = g;
+		tree->child[side][a] = f;
+		tree->parent[f] = a;
+	}
+
+	SV_AABBTree_Refit(tree, a);
+	SV_AABBTree_Refit(tree, up);
+	return up;
+}
+
+/*
+===============
+SV_AABBTree_InsertLeaf
+===============
+*/
+static void SV_AABBTree_InsertLeaf(sv_aabbtree_t* tree, int leaf)
+{
+	int		node, sibling, oldParent, newParent, c0, c1;
+	float	area, combined, cost, inherit, cost0, cost1;
+
+	if (tree->root == AABB_NULL)
+	{
+		tree->root = leaf;
+		tree->parent[leaf] = AABB_NULL;
+		return;
+	}
+
+	// find the best sibling, one that grows the tree least
+	node = tree->root;
+	while (tree->child[0][node] != AABB_NULL)
+	{
+		c0 = tree->child[0][node];
+		c1 = tree->child[1][node];
+
+		area = SV_AABBTree_Area(tree, node, AABB_NULL);
+		combined = SV_AABBTree_Area(tree, node, leaf);
+
+		// cost of creating a new parent for this node and the new leaf
+		cost = 2.0f * combined;
+		// minimum cost of pushing the leaf further down the tree
+		inherit = 2.0f * (combined - area);
+
+		cost0 = SV_AABBTree_Area(tree, c0, leaf) + inherit;
+		if (tree->child[0][c0] != AABB_NULL)
+			cost0 -= SV_AABBTree_Area(tree, c0, AABB_NULL);
+
+		cost1 = SV_AABBTree_Area(tree, c1, leaf) + inherit;
+		if (tree->child[0][c1] != AABB_NULL)
+			cost1 -= SV_AABBTree_Area(tree, c1, AABB_NULL);
+
+		if (cost < cost0 && cost < cost1)
+			break;
+
+		node = (cost0 < cost1) ? c0 : c1;
+	}
+	sibling = node;
+
+	// create a new parent
+	oldParent = tree->parent[sibling];
+	newParent = SV_AABBTree_AllocNode(tree);
+	tree->parent[newParent] = oldParent;
+	tree->child[0][newParent] = sibling;
+	tree->child[1][newParent] = leaf;
+	tree->parent[sibling] = newParent;
+	tree->parent[leaf] = newParent;
+	SV_AABBTree_Refit(tree, newParent);
+
+	if (oldParent != AABB_NULL)
+	{
+		if (tree->child[0][oldParent] == sibling)
+			tree->child[0][oldParent] = newParent;
+		else
+			tree->child[1][oldParent] = newParent;
+	}
+	else
+	{
+		tree->root = newParent;
+	}
+
+	// fix heights and bounds up to the root
+	for (node = tree->parent[leaf]; node != AABB_NULL; node = tree->parent[node])
+	{
+		node = SV_AABBTree_Balance(tree, node);
+		SV_AABBTree_Refit(tree, node);
+	}
+}
+
+/*
+===============
+SV_AABBTree_RemoveLeaf
+===============
+*/
+static void SV_AABBTree_RemoveLeaf(sv_aabbtree_t* tree, int leaf)
+{
+	int parent, grandParent, sibling, node;
+
+	if (leaf == tree->root)
+	{
+		tree->root = AABB_NULL;
+		return;
+	}
+
+	parent = tree->parent[leaf];
+	grandParent = tree->parent[parent];
+	sibling = (tree->child[0][parent] == leaf) ? tree->child[1][parent] : tree->child[0][parent];
+
+	if (grandParent == AABB_NULL)
+	{
+		tree->root = sibling;
+		tree->parent[sibling] = AABB_NULL;
+		SV_AABBTree_FreeNode(tree, parent);
+		return;
+	}
+
+	// replace parent with sibling
+	if (tree->child[0][grandParent] == parent)
+		tree->child[0][grandParent] = sibling;
+	else
+		tree->child[1][grandParent] = sibling;
+	tree->parent[sibling] = grandParent;
+	SV_AABBTree_FreeNode(tree, parent);
+
+	for (node = grandParent; node != AABB_NULL; node = tree->parent[node])
+	{
+		node = SV_AABBTree_Balance(tree, node);
+		SV_AABBTree_Refit(tree, node);
+	}
+}
+
+/*
+===============
+SV_AABBTree_Link
+
+Adds entity id with bounds to tree or moves it, ids are small non negative numbers.
+===============
+*/
+void SV_AABBTree_Link(sv_aabbtree_t* tree, int id, vec3_t mins, vec3_t maxs)
+{
+	int		leaf, i, maxIds, *proxy;
+
+	if (id >= tree->maxIds)
+	{
+		maxIds = max(id + 1, tree->maxIds * 2);
+		maxIds = max(maxIds, 64);
+		proxy = Z_Malloc(maxIds * sizeof(int));
+		for (i = 0; i < maxIds; i++)
+			proxy[i] = (i < tree->maxIds) ? tree->proxy[i] : AABB_NULL;
+		if (tree->proxy)
+			Z_Free(tree->proxy);
+		tree->proxy = proxy;
+		tree->maxIds = maxIds;
+	}
+
+	leaf = tree->proxy[id];
+	if (leaf != AABB_NULL)
+	{
+		// refit is free while entity stays inside its fat bounds
+		if (mins[0] >= tree->mins[0][leaf] && mins[1] >= tree->mins[1][leaf] && mins[2] >= tree->mins[2][leaf]
+			&& maxs[0] <= tree->maxs[0][leaf] && maxs[1] <= tree->maxs[1][leaf] && maxs[2] <= tree->maxs[2][leaf])
+			return;
+
+		SV_AABBTree_RemoveLeaf(tree, leaf);
+	}
+	else
+	{
+		leaf = SV_AABBTree_AllocNode(tree);
+		tree->id[leaf] = id;
+		tree->proxy[id] = leaf;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		tree->mins[i][leaf] = mins[i] - AABB_MARGIN;
+		tree->maxs[i][leaf] = maxs[i] + AABB_MARGIN;
+	}
+	SV_AABBTree_InsertLeaf(tree, leaf);
+}
+
+/*
+===============
+SV_AABBTree_Unlink
+===============
+*/
+void SV_AABBTree_Unlink(sv_aabbtree_t* tree, int id)
+{
+	int leaf;
+
+	if (id < 0 || id >= tree->maxIds || tree->proxy[id] == AABB_NULL)
+		return;
+
+	leaf = tree->proxy[id];
+	SV_AABBTree_RemoveLeaf(tree, leaf);
+	SV_AABBTree_FreeNode(tree, leaf);
+	tree->proxy[id] = AABB_NULL;
+}
+
+/*
+===============
+SV_AABBTree_Query
+
+Fills ids of entities whose fat bounds touch mins/maxs, callers must check exact bounds.
+===============
+*/
+int SV_AABBTree_Query(sv_aabbtree_t* tree, vec3_t mins, vec3_t maxs, int* ids, int maxcount)
+{
+	int		stack[AABB_STACK];
+	int		sp, node, count;
+
+	if (tree->root == AABB_NULL)
+		return 0;
+
+	count = 0;
+	sp = 0;
+	stack[sp++] = tree->root;
+
+	while (sp)
+	{
+		node = stack[--sp];
+
+		if (tree->mins[0][node] > maxs[0] || tree->mins[1][node] > maxs[1] || tree->mins[2][node] > maxs[2]
+			|| tree->maxs[0][node] < mins[0] || tree->maxs[1][node] < mins[1] || tree->maxs[2][node] < mins[2])
+			continue;
+
+		if (tree->child[0][node] == AABB_NULL)
+		{
+			if (count == maxcount)
+				break;
+			ids[count++] = tree->id[node];
+			continue;
+		}
+
+		if (sp + 2 > AABB_STACK)
+		{
+			Com_Error(ERR_DROP, "%s: tree too deep\n", __FUNCTION__);
+			return count;
+		}
+		stack[sp++] = tree->child[1][node];
+		stack[sp++] = tree->child[0][node];
+	}
+	return count;
+}
+
+/*
+===============
+SV_AABBTree_Height
+===============
+*/
+int SV_AABBTree_Height(sv_aabbtree_t* tree)
+{
+	return (tree->root == AABB_NULL) ? 0 : tree->height[tree->root];
+}
@@ -14,41 +14,16 @@ int Nav_AddPathNode(float x, float y, float z);
 qboolean Nav_AddPathNodeLink(int nodeId, int linkTo);
 int Nav_GetNodeLinkCount(int node);
 int Nav_GetMaxLinksCount();
+int Nav_GetNearestNodes(vec3_t origin, float maxDist, int* nodes, int maxNodes);
+void Nav_GetNodePos(int num, float* x, float* y, float* z);
 
-static vec3_t node_origin; // for qsorting distance
-typedef struct // for qsorting pathnodes from closest to farthest
-{
-	int	index;
-	vec3_t origin;
-} tempnode_t;
-
-float dist3d(vec3_t p1, vec3_t p2)
-{
-	vec3_t vtemp;
-	VectorSubtract(p1, p2, vtemp);
-	return VectorLength(vtemp);
-}
+#define MAX_NODE_CANDIDATES 32
 
 static char* vtos(vec3_t p)
 {
 	return va("[%i %i %i]", (int)p[0], (int)p[1], (int)p[2]);
 }
 
-int CompareNodeDistances(const void* a, const void* b)
-{
-	tempnode_t* nodeA = (tempnode_t*)a;
-	tempnode_t* nodeB = (tempnode_t*)b;
-
-	float distanceA = dist3d(nodeA->origin, node_origin);
-	float distanceB = dist3d(nodeB->origin, node_origin);
-
-	if (distanceA < distanceB)
-		return -1;
-	else if (distanceA > distanceB)
-		return 1;
-	else return 0; // distances are equal so the order doesn't matter
-}
-
 /*
 ================
 SV_LinkPathNode
@@ -58,17 +33,13 @@ Link pathnode to neighbors
 */
 static void SV_LinkPathNode(gentity_t* self)
 {
-	int			i, num;
-	gentity_t* other;
+	int			i, num, count;
 	vec3_t		mins, maxs;
 	trace_t		trace;
-	tempnode_t nodes[32];
+	int			nodes[MAX_NODE_CANDIDATES + 1];
 
 	static const int nodeLinkDist = 148;
 
-	num = 0;
-	VectorCopy(self->v.origin, node_origin);
-
 	if ((int)self->v.nodeIndex == -1 || self->v.solid != SOLID_PATHNODE)
 	{
 		Com_Printf("WARNING: %s at %s is not a path node.\n", Scr_GetString(self->v.classname), vtos(self->v.origin));
@@ -81,50 +52,30 @@ static void SV_LinkPathNode(gentity_t* self)
 		return; // already linked
 	}
 
-	//	static vec3_t expand = { nodeLinkDist, nodeLinkDist, nodeLinkDist };
-	//	VectorSubtract(self->v.absmin, expand, mins);
-	//	VectorAdd(self->v.absmax, expand, maxs);
-	//	num = SV_AreaEntities(mins, maxs, nodes, MAX_GENTITIES, AREA_PATHNODES);
+	//
+	// find nodes within reasonable distance to self, sorted from closest to farthest
+	//
+	num = Nav_GetNearestNodes(self->v.origin, nodeLinkDist, nodes, MAX_NODE_CANDIDATES + 1);
 
-		//
-		// find nodes within reasonable distance to self
-		//
-	for (i = svs.max_clients; i < sv.max_edicts; i++)
+	count = 0;
+	for (i = 0; i < num; i++)
 	{
-		other = ENT_FOR_NUM(i);
-		if (!other->inuse)
-			continue;
-		if (other == self)
-			continue;
-		if (other->v.solid != SOLID_PATHNODE)
-			continue;
-		if (dist3d(self->v.origin, other->v.origin) > nodeLinkDist)
+		if (nodes[i] == (int)self->v.nodeIndex)
 			continue;
+		nodes[count++] = nodes[i];
+	}
 
-		VectorCopy(other->v.origin, nodes[num].origin);
-		nodes[num].index = other->v.nodeIndex;
-		num++;
-
-		if (num == 32)
-		{
-			Com_Printf("WARNING: Path node %i at %s is crowded (32 neighbors or more).\n", (int)self->v.nodeIndex, vtos(self->v.origin));
-			break;
-		}
+	if (count == MAX_NODE_CANDIDATES)
+	{
+		Com_Printf("WARNING: Path node %i at %s is crowded (%i neighbors or more).\n", (int)self->v.nodeIndex, vtos(self->v.origin), MAX_NODE_CANDIDATES);
 	}
 
-	if (!num)
+	if (!count)
 	{
 		Com_Printf("WARNING: Path node at %s is too far from other nodes (node %i will not be linked).\n", vtos(self->v.origin), (int)self->v.nodeIndex);
 		return;
 	}
 
-
-	//
-	// sort the nodes from closest to farthest
-	//
-	qsort(nodes, sizeof(nodes) / sizeof(nodes[0]), sizeof(tempnode_t), CompareNodeDistances);
-
-
 	//
 	// do a trace check to see if we can link with nodes
 	//
@@ -135,16 +86,16 @@ static void SV_LinkPathNode(gentity_t* self)
 	VectorCopy(self->v.origin, start);
 	start[2] += 16;
 
-	for (i = 0; i < num; i++)
+	for (i = 0; i < count; i++)
 	{
-		VectorCopy(nodes[i].origin, end);
+		Nav_GetNodePos(nodes[i], &end[0], &end[1], &end[2]);
 		end[2] += 16;
 		trace = SV_Trace(start, mins, maxs, end, self, MASK_MONSTERSOLID);
 
 		if (trace.fraction != 1.0)
 			continue;
 
-		if (!Nav_AddPathNodeLink(self->v.nodeIndex, nodes[i].index))
+		if (!Nav_AddPathNodeLink(self->v.nodeIndex, nodes[i]))
 		{
 			Com_Printf("WARNING: Path node %i at %s reached link count limit (nodes are too crowded)\n", (int)self->v.nodeIndex, vtos(self->v.origin));
 			break;
@@ -222,63 +173,37 @@ void SV_LinkAllPathNodes()
 
 /*
 ================
-SV_GetNearestNode
+SV_GetNearestVisiblePathNode
 
-Like Nav_GetNearestNode, but does a trace so the node doesn't ent up behind a wall
+Like Nav_GetNearestNode, but does a trace so the node doesn't end up behind a wall.
+Only the maxCandidates closest nodes are traced, returns -1 if none is visible.
 ================
 */
-static void SV_GetNearestPathNode(vec3_t point)
+int SV_GetNearestVisiblePathNode(vec3_t point, gentity_t* passent, int maxCandidates)
 {
-	int			i, num, cnt;
-	gentity_t* node;
-	vec3_t		mins, maxs;
+	int			i, num;
 	trace_t		trace;
-	tempnode_t nodes[32];
-
-	VectorSet(mins, 196, 196, 196);
-	VectorAdd(mins, point, mins);
-	VectorSet(maxs, 196, 196, 196);
-	VectorAdd(maxs, point, maxs);
-
-	gentity_t* areanodes[MAX_GENTITIES];
-	num = SV_AreaEntities(mins, maxs, areanodes, MAX_GENTITIES, AREA_PATHNODES);
-
-	if (!num)
-	{
-		Com_Printf("SV_GetNearestPathNode: no nearby nodes\n");
-		return;
-	}
-
-	cnt = 0;
-	for (i = 0; i < num; i++)
-	{
-		node = areanodes[i];
-		if (!node->inuse)
-			continue;
+	int			nodes[MAX_NODE_CANDIDATES];
+	vec3_t		start, end;
 
-		VectorCopy(node->v.origin, nodes[cnt].origin);
-		nodes[cnt].index = node->v.nodeIndex;
+	if (maxCandidates <= 0 || maxCandidates > MAX_NODE_CANDIDATES)
+		maxCandidates = MAX_NODE_CANDIDATES;
 
-		if (cnt == 32)
-			break;
-	}
-
-	// sort the nodes from closest to farthest
-	qsort(nodes, sizeof(nodes) / sizeof(nodes[0]), sizeof(tempnode_t), CompareNodeDistances);
+	num = Nav_GetNearestNodes(point, 0, nodes, maxCandidates);
 
-	vec3_t start, end;
 	VectorCopy(point, start);
 	start[2] += 16;
 
 	for (i = 0; i < num; i++)
 	{
-		VectorCopy(nodes[i].origin, end);
+		Nav_GetNodePos(nodes[i], &end[0], &end[1], &end[2]);
 		end[2] += 16;
-		trace = SV_Trace(start, vec3_origin, vec3_origin, end, NULL, MASK_MONSTERSOLID);
+		trace = SV_Trace(start, vec3_origin, vec3_origin, end, passent, MASK_SOLID);
 
-		if (trace.fraction != 1.0)
-			continue;
+		if (trace.fraction == 1.0)
+			return nodes[i];
 	}
+	return -1;
 }
 
 
@@ -699,6 +699,107 @@ void PFSV_tracebox(void)
 	trace = SV_Trace(start, min, max, end, ignoreEnt, contentmask);
 	CopyTraceToProgs(trace);
 }
+
+#define MAX_SCRIPT_TRACES 1024
+
+static svtrace_t	scriptTraces[MAX_SCRIPT_TRACES];
+static int			numScriptTraces, numScriptTraceResults;
+static gentity_t	*scriptTraceIgnoreEnt;
+static int			scriptTraceContentMask;
+
+/*
+=================
+PFSV_tracebatch_begin
+
+Starts a new batch of traces, all of them ignore the same entity and use the same contentmask.
+
+void tracebatch_begin(entity ignoreEnt, int contentmask)
+=================
+*/
+void PFSV_tracebatch_begin(void)
+{
+	scriptTraceIgnoreEnt = Scr_GetParmEntity(0);
+	scriptTraceContentMask = Scr_GetParmInt(1);
+
+	if (scriptTraceIgnoreEnt == sv.edicts)
+		scriptTraceIgnoreEnt = NULL;
+
+	numScriptTraces = numScriptTraceResults = 0;
+}
+
+/*
+=================
+PFSV_tracebatch_add
+
+Adds a trace to batch, mins and maxs are '0 0 0' for lines. Returns index of trace or -1 when batch is full.
+
+float tracebatch_add(vector start, vector end, vector mins, vector maxs)
+=================
+*/
+void PFSV_tracebatch_add(void)
+{
+	svtrace_t *t;
+
+	if (numScriptTraces == MAX_SCRIPT_TRACES)
+	{
+		Scr_ReturnFloat(-1);
+		return;
+	}
+
+	t = &scriptTraces[numScriptTraces];
+	VectorCopy(Scr_GetParmVector(0), t->start);
+	VectorCopy(Scr_GetParmVector(1), t->end);
+	VectorCopy(Scr_GetParmVector(2), t->mins);
+	VectorCopy(Scr_GetParmVector(3), t->maxs);
+
+	Scr_ReturnFloat(numScriptTraces++);
+}
+
+/*
+=================
+PFSV_tracebatch_run
+
+Runs all traces added to batch, returns their number.
+
+float tracebatch_run()
+=================
+*/
+void PFSV_tracebatch_run(void)
+{
+	SV_TraceBatch(scriptTraces, numScriptTraces, scriptTraceIgnoreEnt, scriptTraceContentMask);
+	numScriptTraceResults = numScriptTraces;
+	Scr_ReturnFloat(numScriptTraceResults);
+}
+
+/*
+=================
+PFSV_tracebatch_result
+
+Sets trace_ globals to result of trace from batch, the same way traceline does, and returns trace_fraction.
+
+float tracebatch_result(float index)
+
+tracebatch_begin(self, MASK_SOLID);
+for (i = 0; i < 8; i++)
+	tracebatch_add(self.origin, self.origin + dirs[i] * 256, '0 0 0', '0 0 0');
+tracebatch_run();
+for (i = 0; i < 8; i++)
+	dist[i] = tracebatch_result(i) * 256;
+=================
+*/
+void PFSV_tracebatch_result(void)
+{
+	int index = (int)Scr_GetParmFloat(0);
+
+	if (index < 0 || index >= numScriptTraceResults)
+	{
+		Scr_RunError("tracebatch_result: index %i out of range (%i traces in last batch)\n", index, numScriptTraceResults);
+		return;
+	}
+
+	CopyTraceToProgs(scriptTraces[index].trace);
+	Scr_ReturnFloat(scriptTraces[index].trace.fraction);
+}
 // =================================================================================
 
 /*
@@ -797,23 +898,21 @@ void PFSV_inPVS(void)
 {
 	float	*p1, *p2;
 	int		leafnum;
-	int		cluster;
+	int		cluster1, cluster2;
 	int		area1, area2;
-	byte	*mask;
 
 	p1 = Scr_GetParmVector(0);
 	p2 = Scr_GetParmVector(1);
 
 	leafnum = CM_PointLeafnum(p1);
-	cluster = CM_LeafCluster(leafnum);
+	cluster1 = CM_LeafCluster(leafnum);
 	area1 = CM_LeafArea(leafnum);
-	mask = CM_ClusterPVS(cluster);
 
 	leafnum = CM_PointLeafnum(p2);
-	cluster = CM_LeafCluster(leafnum);
+	cluster2 = CM_LeafCluster(leafnum);
 	area2 = CM_LeafArea(leafnum);
 
-	if (mask && (!(mask[cluster >> 3] & (1 << (cluster & 7)))))
+	if (!CM_ClusterVisible(cluster1, cluster2, false))
 	{
 		Scr_ReturnFloat(0);
 		return;
@@ -842,23 +941,21 @@ void PFSV_inPHS(void)
 {
 	float	*p1, *p2;
 	int		leafnum;
-	int		cluster;
+	int		cluster1, cluster2;
 	int		area1, area2;
-	byte	*mask;
 
 	p1 = Scr_GetParmVector(0);
 	p2 = Scr_GetParmVector(1);
 
 	leafnum = CM_PointLeafnum(p1);
-	cluster = CM_LeafCluster(leafnum);
+	cluster1 = CM_LeafCluster(leafnum);
 	area1 = CM_LeafArea(leafnum);
-	mask = CM_ClusterPHS(cluster);
 
 	leafnum = CM_PointLeafnum(p2);
-	cluster = CM_LeafCluster(leafnum);
+	cluster2 = CM_LeafCluster(leafnum);
 	area2 = CM_LeafArea(leafnum);
 
-	if (mask && (!(mask[cluster >> 3] & (1 << (cluster & 7)))))
+	if (!CM_ClusterVisible(cluster1, cluster2, true))
 	{
 		// more than one bounce away
 		Scr_ReturnFloat(0);
@@ -1824,6 +1921,25 @@ void PFSV_nav_getnearestnode(void)
 	Scr_ReturnFloat(Nav_GetNearestNode(v));
 }
 
+/*
+=================
+PFSV_nav_getnearestvisiblenode
+
+float node = nav_getnearestvisiblenode(vector pos, entity ignore, float candidates)
+Like nav_getnearestnode, but traces to the closest candidates and returns the first one 
+that is not behind a wall, or -1
+=================
+*/
+extern int SV_GetNearestVisiblePathNode(vec3_t point, gentity_t* passent, int maxCandidates);
+void PFSV_nav_getnearestvisiblenode(void)
+{
+	vec3_t v;
+	float* pos = Scr_GetParmVector(0);
+	gentity_t* ignore = Scr_GetParmEntity(1);
+	VectorCopy(pos, v);
+	Scr_ReturnFloat(SV_GetNearestVisiblePathNode(v, ignore, (int)Scr_GetParmFloat(2)));
+}
+
 /*
 =================
 PFSV_nav_searchpath
@@ -1899,6 +2015,83 @@ void PFSV_nav_getnodelink(void)
 }
 
 
+/*
+=================
+PFSV_nav_findpath
+
+float nav_findpath(entity e, float start, float goal)
+Finds the whole route from start to goal and stores it in entity's path buffer, 
+returns the number of nodes in path or 0 if there's no route
+=================
+*/
+extern int Nav_FindPathForEntity(int entnum, int startWaypoint, int goalWaypoint);
+void PFSV_nav_findpath(void)
+{
+	gentity_t* ent = Scr_GetParmEntity(0);
+	Scr_ReturnFloat( Nav_FindPathForEntity(NUM_FOR_EDICT(ent), (int)Scr_GetParmFloat(1), (int)Scr_GetParmFloat(2)) );
+}
+
+/*
+=================
+PFSV_nav_requestpath
+
+float nav_requestpath(entity e, float start, float goal)
+Queues path request which is resolved at the end of server frame together with
+requests from other entities, returns true if request was queued
+=================
+*/
+extern qboolean Nav_RequestPath(int entnum, int startWaypoint, int goalWaypoint);
+void PFSV_nav_requestpath(void)
+{
+	gentity_t* ent = Scr_GetParmEntity(0);
+	Scr_ReturnFloat( Nav_RequestPath(NUM_FOR_EDICT(ent), (int)Scr_GetParmFloat(1), (int)Scr_GetParmFloat(2)) );
+}
+
+/*
+=================
+PFSV_nav_getpathlength
+
+float nav_getpathlength(entity e)
+Returns the number of nodes in entity's path, 0 if there's no route or -1 if request is still pending
+=================
+*/
+extern int Nav_GetPathLength(int entnum);
+void PFSV_nav_getpathlength(void)
+{
+	gentity_t* ent = Scr_GetParmEntity(0);
+	Scr_ReturnFloat( Nav_GetPathLength(NUM_FOR_EDICT(ent)) );
+}
+
+/*
+=================
+PFSV_nav_getpathnode
+
+float nav_getpathnode(entity e, float idx)
+Returns node at index in entity's path, index 0 is the node after start, or -1
+=================
+*/
+extern int Nav_GetPathNode(int entnum, int index);
+void PFSV_nav_getpathnode(void)
+{
+	gentity_t* ent = Scr_GetParmEntity(0);
+	Scr_ReturnFloat( Nav_GetPathNode(NUM_FOR_EDICT(ent), (int)Scr_GetParmFloat(1)) );
+}
+
+/*
+=================
+PFSV_nav_clearpath
+
+void nav_clearpath(entity e)
+=================
+*/
+extern void Nav_ClearPath(int entnum);
+void PFSV_nav_clearpath(void)
+{
+	gentity_t* ent = Scr_GetParmEntity(0);
+	Nav_ClearPath(NUM_FOR_EDICT(ent));
+}
+
+
 /*
 =================
 PFSV_getframescount
@@ -2215,4 +2408,18 @@ void SV_InitScriptBuiltins()
 	Scr_DefineBuiltin(PFSV_drawpoint, PF_SV, "drawpoint", "void(vector p, vector c, float th, float dt, float t)");
 	Scr_DefineBuiltin(PFSV_drawbox, PF_SV, "drawbox", "void(vector p, vector p1, vector p2, vector c, float th, float dt, float t)"); // fixme?
 	Scr_DefineBuiltin(PFSV_drawstring, PF_SV, "drawstring", "void(vector p, vector c, float fs, float dt, float t, string s, ...)");
+
+	// navigation paths (appended so builtin numbers of compiled progs don't shift)
+	Scr_DefineBuiltin(PFSV_nav_findpath, PF_SV, "nav_findpath", "float(entity e, float n1, float n2)");
+	Scr_DefineBuiltin(PFSV_nav_requestpath, PF_SV, "nav_requestpath", "float(entity e, float n1, float n2)");
+	Scr_DefineBuiltin(PFSV_nav_getpathlength, PF_SV, "nav_getpathlength", "float(entity e)");
+	Scr_DefineBuiltin(PFSV_nav_getpathnode, PF_SV, "nav_getpathnode", "float(entity e, float i)");
+	Scr_DefineBuiltin(PFSV_nav_clearpath, PF_SV, "nav_clearpath", "void(entity e)");
+	Scr_DefineBuiltin(PFSV_nav_getnearestvisiblenode, PF_SV, "nav_getnearestvisiblenode", "float(vector p, entity ie, float c)");
+
+	// batched traces (appended so builtin numbers of compiled progs don't shift)
+	Scr_DefineBuiltin(PFSV_tracebatch_begin, PF_SV, "tracebatch_begin", "void(entity e, int c)");
+	Scr_DefineBuiltin(PFSV_tracebatch_add, PF_SV, "tracebatch_add", "float(vector p1, vector p2, vector v1, vector v2)");
+	Scr_DefineBuiltin(PFSV_tracebatch_run, PF_SV, "tracebatch_run", "float()");
+	Scr_DefineBuiltin(PFSV_tracebatch_result, PF_SV, "tracebatch_result", "float(float i)");
 }
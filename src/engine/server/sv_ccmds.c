@@ -1073,6 +1073,8 @@ void SV_KillServer_f (void)
 
 //===========================================================
 
+extern void Nav_Stats_f(void); // astar_navigation.c
+
 /*
 ==================
 SV_InitOperatorCommands
@@ -1092,6 +1094,12 @@ void SV_InitOperatorCommands (void)
 	Cmd_AddCommand ("setmaster", SV_SetMaster_f);
 
 	Cmd_AddCommand("sv_modellist", SV_ModelList_f);
+	Cmd_AddCommand("nav_stats", Nav_Stats_f);
+	Cmd_AddCommand("cm_visstats", CM_VisCacheStats_f);
+	Cmd_AddCommand("sv_perf", SV_Perf_f);
+	Cmd_AddCommand("sv_perf_dump", SV_PerfDump_f);
+	Cmd_AddCommand("sv_broadphase_bench", SV_BroadphaseBench_f);
+	Cmd_AddCommand("sv_deltastats", SV_DeltaCacheStats_f);
 
 	if ( dedicated->value )
 		Cmd_AddCommand ("say", SV_ConSay_f);
@@ -14,6 +14,7 @@ See the attached GNU General Public License v2 for more details.
 
 extern ddef_t* Scr_FindEntityField(char* name); //scr_main.c
 extern qboolean Scr_ParseEpair(void* base, ddef_t* key, char* s, int memtag); //scr_main.c
+extern void Nav_ClearPath(int entnum); //astar_navigation.c
 
 /*
 =================
@@ -109,6 +110,7 @@ void SV_FreeEntity(gentity_t* self)
 	}
 
 	SV_UnlinkEdict(self);
+	Nav_ClearPath(NUM_FOR_EDICT(self));
 
 	Scr_BindVM(VM_SVGAME);
 
@@ -160,6 +162,7 @@ Runs thinking code for this frame if necessary
 qboolean SV_RunThink(gentity_t* ent)
 {
 	float	thinktime;
+	unsigned long long t;
 
 	thinktime = ent->v.nextthink;
 	if (thinktime <= 0)
@@ -167,7 +170,10 @@ qboolean SV_RunThink(gentity_t* ent)
 	if (thinktime > sv.gameTime + 0.001)
 		return true;
 
+	// thinks are run from physics, don't count them twice
+	t = Sys_Microseconds();
 	Scr_Think(ent);
+	SV_PerfSubtract(SVPERF_PHYSICS, SV_PerfAdd(SVPERF_THINK, t));
 
 	return false;
 }
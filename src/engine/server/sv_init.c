@@ -19,6 +19,7 @@ server_t		sv;					// local server
 
 void SV_ScriptMain();
 void Nav_Init();
+void Nav_BuildNextHopTable(const char* mapname);
 void SV_LinkAllPathNodes();
 
 /*
@@ -155,6 +156,13 @@ static void SV_CreateConstStrings()
 	sv.cstr.player = Scr_NewString("player"); 
 	sv.cstr.disconnected = Scr_NewString("disconnected"); // when player disconnects
 	sv.cstr.worldspawn = Scr_NewString("worldspawn");
+
+	// these are only held by server code, keep them through string collection
+	Scr_PinString(sv.cstr.free);
+	Scr_PinString(sv.cstr.no_class);
+	Scr_PinString(sv.cstr.player);
+	Scr_PinString(sv.cstr.disconnected);
+	Scr_PinString(sv.cstr.worldspawn);
 }
 
 /*
@@ -211,6 +219,7 @@ void SV_SpawnServer (char *mapname, char *spawnpoint, server_state_t serverstate
 		svs.clients = Z_Malloc(sizeof(client_t) * sv_maxclients->value);
 		svs.num_client_entities = sv_maxclients->value * UPDATE_BACKUP * 64;
 		svs.client_entities = Z_Malloc(sizeof(entity_state_t) * svs.num_client_entities);
+		svs.client_entity_stamps = Z_Malloc(sizeof(int) * svs.num_client_entities);
 	}
 	
 	// force all clients to reconnect
@@ -335,6 +344,7 @@ void SV_SpawnServer (char *mapname, char *spawnpoint, server_state_t serverstate
 	// create paths for AI
 	Nav_Init();
 	SV_LinkAllPathNodes(); 
+	Nav_BuildNextHopTable(sv.mapname);
 
 	// one more frame to settle everything
 	SV_RunWorldFrame();
@@ -449,6 +459,7 @@ void SV_InitGame (void)
 	svs.clients = Z_Malloc (sizeof(client_t)*sv_maxclients->value);
 	svs.num_client_entities = sv_maxclients->value*UPDATE_BACKUP*64;
 	svs.client_entities = Z_Malloc (sizeof(entity_state_t)*svs.num_client_entities);
+	svs.client_entity_stamps = Z_Malloc (sizeof(int)*svs.num_client_entities);
 
 	// init network stuff
 	NET_Config ( (sv_maxclients->value > 1) );
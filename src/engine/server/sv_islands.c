@@ -0,0 +1,474 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// sv_islands.c -- parallel moves of toss and step entities
+
+#include "server.h"
+
+/*
+	With sv_physicsislands enabled, toss and step entities run their think and
+	the part of physics before the move in the regular entity loop, and the
+	move is only queued. After the loop every queued move gets a box covering
+	anywhere it can reach this frame, and moves with touching boxes are joined
+	into islands. An island never touches a moving entity of another island,
+	so islands are traced on job threads against candidates gathered for them
+	up front, each island moving its entities in entity order.
+
+	Linking, impact and touch callbacks and the rest of physics are then run
+	on main thread in entity order, so results don't depend on thread count.
+	Unlike serial physics a move can't be changed by callbacks of an entity
+	with lower number in the same frame, and an impact can't stop a step move
+	in the middle. When the entity a toss move hit is gone by the time its
+	impact runs, the move is traced again on main thread like SV_PushEntity
+	retries it.
+*/
+
+typedef enum
+{
+	MOVER_TOSS,
+	MOVER_STEP
+} svmoverkind_t;
+
+typedef struct
+{
+	gentity_t		*ent;
+	svmoverkind_t	kind;
+	int				island;		// union-find parent while partitioning, then island index
+	qboolean		solid;		// can be clipped against by other moves
+
+	vec3_t			sweepMins, sweepMaxs;
+
+	vec3_t			move;		// toss
+	vec3_t			old_origin;
+	trace_t			trace;
+
+	qboolean		wasonground, hitsound;	// step
+	int				numImpacts;
+	trace_t			impacts[SV_MAX_DEFERRED_IMPACTS];
+} svmover_t;
+
+typedef struct
+{
+	int				firstMover, numMovers;	// in svIslandMovers
+	int				firstCandidate, numCandidates;
+} svisland_t;
+
+static svmover_t		*svMovers;
+static int				svNumMovers;
+
+static int				*svIslandMovers;	// mover indexes grouped by island
+static svisland_t		*svIslands;
+static int				svNumIslands;
+
+static svcandidate_t	*svIslandCandidates;
+static int				svNumIslandCandidates, svMaxIslandCandidates;
+
+static int				svIslandOfEntity[MAX_GENTITIES];	// -1 when entity isn't moving
+static int				*svSortedMovers, *svMoverRoots, *svRootIsland;
+
+/*
+================
+SV_BeginIslandPhysics
+
+Called before entity loop of a frame.
+================
+*/
+void SV_BeginIslandPhysics(void)
+{
+	if (!svMovers)
+	{
+		svMovers = Z_Malloc(MAX_GENTITIES * sizeof(svmover_t));
+		svIslandMovers = Z_Malloc(MAX_GENTITIES * sizeof(int));
+		svSortedMovers = Z_Malloc(MAX_GENTITIES * sizeof(int));
+		svMoverRoots = Z_Malloc(MAX_GENTITIES * sizeof(int));
+		svRootIsland = Z_Malloc(MAX_GENTITIES * sizeof(int));
+		svIslands = Z_Malloc(MAX_GENTITIES * sizeof(svisland_t));
+	}
+	svNumMovers = 0;
+}
+
+/*
+================
+SV_DeferEntityPhysics
+
+Runs physics of entity up to its move and queues the move. Returns false when
+entity must run regular physics.
+================
+*/
+qboolean SV_DeferEntityPhysics(gentity_t* ent)
+{
+	svmover_t	*m;
+	int			movetype = (int)ent->v.movetype;
+
+	if (movetype != MOVETYPE_TOSS && movetype != MOVETYPE_BOUNCE && movetype != MOVETYPE_FLY && movetype != MOVETYPE_FLYMISSILE && movetype != MOVETYPE_STEP)
+		return false;
+
+	// teams move together and brush models need rotated bounds
+	if (ent->teamchain || ((int)ent->v.flags & FL_TEAMSLAVE) || ent->v.solid == SOLID_BSP)
+		return false;
+
+	m = &svMovers[svNumMovers];
+	m->ent = ent;
+	m->numImpacts = 0;
+
+	if (movetype == MOVETYPE_STEP)
+	{
+		m->kind = MOVER_STEP;
+		if (!SV_Physics_StepBegin(ent, &m->wasonground, &m->hitsound))
+		{
+			SV_RunThink(ent);
+			return true;
+		}
+	}
+	else
+	{
+		m->kind = MOVER_TOSS;
+		if (!SV_Physics_TossBegin(ent, m->move))
+			return true;
+	}
+
+	svNumMovers++;
+	return true;
+}
+
+/*
+================
+SV_SweepMover
+
+Bounds of everything mover can reach this frame. Thinks of later entities may
+move it or change its velocity after it was queued, so this is done from the
+state right before moves run.
+================
+*/
+static void SV_SweepMover(svmover_t* m)
+{
+	gentity_t	*ent = m->ent;
+	float		reach;
+	int			i;
+
+	m->solid = (ent->v.solid != SOLID_NOT && ent->v.solid != SOLID_TRIGGER);
+
+	if (m->kind == MOVER_STEP)
+	{
+		// clipping against planes never makes entity faster
+		reach = VectorLength(ent->v.velocity) * SV_FRAMETIME + 2;
+		for (i = 0; i < 3; i++)
+		{
+			m->sweepMins[i] = ent->v.origin[i] + ent->v.mins[i] - reach;
+			m->sweepMaxs[i] = ent->v.origin[i] + ent->v.maxs[i] + reach;
+		}
+	}
+	else
+	{
+		VectorCopy(ent->v.origin, m->old_origin);
+		for (i = 0; i < 3; i++)
+		{
+			m->sweepMins[i] = ent->v.origin[i] + ent->v.mins[i] + min(m->move[i], 0) - 2;
+			m->sweepMaxs[i] = ent->v.origin[i] + ent->v.maxs[i] + max(m->move[i], 0) + 2;
+		}
+	}
+}
+
+static int SV_IslandFind(int i)
+{
+	while (svMovers[i].island != i)
+	{
+		svMovers[i].island = svMovers[svMovers[i].island].island;
+		i = svMovers[i].island;
+	}
+	return i;
+}
+
+static int SV_IslandCompareMins(const void* a, const void* b)
+{
+	float x = svMovers[*(const int*)a].sweepMins[0], y = svMovers[*(const int*)b].sweepMins[0];
+
+	if (x != y)
+		return (x > y) - (x < y);
+	return *(const int*)a - *(const int*)b;
+}
+
+/*
+================
+SV_BuildIslands
+
+Joins movers with touching sweeps and gathers candidates of every island.
+================
+*/
+static void SV_BuildIslands(void)
+{
+	svmover_t		*a, *b;
+	svisland_t		*island;
+	svcandidate_t	*c;
+	vec3_t			mins, maxs;
+	int				i, j, k, root, num, count;
+
+	// movers removed by later thinks don't move
+	for (i = 0, count = 0; i < svNumMovers; i++)
+	{
+		if (svMovers[i].ent->inuse)
+			svMovers[count++] = svMovers[i];
+	}
+	svNumMovers = count;
+
+	// sweep and prune along x
+	for (i = 0; i < svNumMovers; i++)
+	{
+		SV_SweepMover(&svMovers[i]);
+		svMovers[i].island = i;
+		svSortedMovers[i] = i;
+	}
+	qsort(svSortedMovers, svNumMovers, sizeof(int), SV_IslandCompareMins);
+
+	for (i = 0; i < svNumMovers; i++)
+	{
+		a = &svMovers[svSortedMovers[i]];
+		for (j = i + 1; j < svNumMovers; j++)
+		{
+			b = &svMovers[svSortedMovers[j]];
+			if (b->sweepMins[0] > a->sweepMaxs[0])
+				break;
+
+			if (!a->solid && !b->solid)
+				continue;	// neither can hit the other
+
+			if (b->sweepMins[1] > a->sweepMaxs[1] || b->sweepMaxs[1] < a->sweepMins[1]
+				|| b->sweepMins[2] > a->sweepMaxs[2] || b->sweepMaxs[2] < a->sweepMins[2])
+				continue;
+
+			root = SV_IslandFind(svSortedMovers[j]);
+			k = SV_IslandFind(svSortedMovers[i]);
+			if (root != k)
+				svMovers[max(root, k)].island = min(root, k);
+		}
+	}
+
+	// islands in order of their first entity, movers in entity order
+	for (i = 0; i < svNumMovers; i++)
+		svMoverRoots[i] = SV_IslandFind(i);
+
+	svNumIslands = 0;
+	for (i = 0; i < svNumMovers; i++)
+	{
+		if (svMoverRoots[i] == i) // root is the lowest mover of island
+		{
+			svIslands[svNumIslands].numMovers = 0;
+			svRootIsland[i] = svNumIslands++;
+		}
+		svMovers[i].island = svRootIsland[svMoverRoots[i]];
+		svIslands[svMovers[i].island].numMovers++;
+	}
+
+	for (i = 0, count = 0; i < svNumIslands; i++)
+	{
+		svIslands[i].firstMover = count;
+		count += svIslands[i].numMovers;
+		svIslands[i].numMovers = 0;
+	}
+
+	for (i = 0; i < MAX_GENTITIES; i++)
+		svIslandOfEntity[i] = -1;
+
+	for (i = 0; i < svNumMovers; i++)
+	{
+		island = &svIslands[svMovers[i].island];
+		svIslandMovers[island->firstMover + island->numMovers++] = i;
+		svIslandOfEntity[NUM_FOR_EDICT(svMovers[i].ent)] = svMovers[i].island;
+	}
+
+	// candidates, moving entities of other islands are never reached
+	svNumIslandCandidates = 0;
+	for (i = 0; i < svNumIslands; i++)
+	{
+		island = &svIslands[i];
+
+		a = &svMovers[svIslandMovers[island->firstMover]];
+		VectorCopy(a->sweepMins, mins);
+		VectorCopy(a->sweepMaxs, maxs);
+		for (j = 1; j < island->numMovers; j++)
+		{
+			b = &svMovers[svIslandMovers[island->firstMover + j]];
+			for (k = 0; k < 3; k++)
+			{
+				mins[k] = min(mins[k], b->sweepMins[k]);
+				maxs[k] = max(maxs[k], b->sweepMaxs[k]);
+			}
+		}
+
+		if (svNumIslandCandidates + MAX_GENTITIES > svMaxIslandCandidates)
+		{
+			svMaxIslandCandidates = max(svMaxIslandCandidates * 2, svNumIslandCandidates + MAX_GENTITIES);
+			c = Z_Malloc(svMaxIslandCandidates * sizeof(svcandidate_t));
+			if (svIslandCandidates)
+			{
+				memcpy(c, svIslandCandidates, svNumIslandCandidates * sizeof(svcandidate_t));
+				Z_Free(svIslandCandidates);
+			}
+			svIslandCandidates = c;
+		}
+
+		c = &svIslandCandidates[svNumIslandCandidates];
+		num = SV_GatherCandidates(mins, maxs, c, MAX_GENTITIES);
+
+		island->firstCandidate = svNumIslandCandidates;
+		island->numCandidates = 0;
+		for (j = 0; j < num; j++)
+		{
+			k = svIslandOfEntity[NUM_FOR_EDICT(c[j].ent)];
+			if (k != -1 && k != i)
+				continue;
+			c[island->numCandidates++] = c[j];
+		}
+		svNumIslandCandidates += island->numCandidates;
+	}
+}
+
+/*
+================
+SV_MoveIsland
+
+Job which moves all entities of an island.
+================
+*/
+static void SV_MoveIsland(void* data, int index, int thread)
+{
+	svisland_t		*island = &svIslands[index];
+	svphysdefer_t	defer;
+	svmover_t		*m;
+	gentity_t		*ent;
+	vec3_t			end;
+	int				i, mask;
+
+	defer.ctx = ((cmcontext_t**)data)[thread];
+	defer.candidates = &svIslandCandidates[island->firstCandidate];
+	defer.numCandidates = island->numCandidates;
+
+	for (i = 0; i < island->numMovers; i++)
+	{
+		m = &svMovers[svIslandMovers[island->firstMover + i]];
+		ent = m->ent;
+
+		if (m->kind == MOVER_TOSS)
+		{
+			mask = ent->v.clipmask ? (int)ent->v.clipmask : MASK_SOLID;
+			VectorAdd(ent->v.origin, m->move, end);
+			m->trace = SV_TraceCandidates(defer.ctx, ent->v.origin, ent->v.mins, ent->v.maxs, end, ent, mask, defer.candidates, defer.numCandidates);
+			VectorCopy(m->trace.endpos, ent->v.origin);
+		}
+		else
+		{
+			defer.numImpacts = 0;
+			SV_FlyMoveDeferred(ent, SV_FRAMETIME, SV_Physics_StepMask(ent), &defer);
+			m->numImpacts = defer.numImpacts;
+			memcpy(m->impacts, defer.impacts, defer.numImpacts * sizeof(trace_t));
+		}
+
+		// later moves of island clip against the new position, linking is done on main thread
+		VectorAdd(ent->v.origin, ent->v.mins, ent->v.absmin);
+		VectorAdd(ent->v.origin, ent->v.maxs, ent->v.absmax);
+		ent->v.absmin[0] -= 1;
+		ent->v.absmin[1] -= 1;
+		ent->v.absmin[2] -= 1;
+		ent->v.absmax[0] += 1;
+		ent->v.absmax[1] += 1;
+		ent->v.absmax[2] += 1;
+	}
+}
+
+// entity hit during move may have been removed by an earlier callback
+static qboolean SV_IslandImpactValid(trace_t* trace)
+{
+	return trace->ent == sv.edicts || trace->ent->inuse;
+}
+
+/*
+================
+SV_RunIslandPhysics
+
+Moves queued entities and runs rest of their physics.
+================
+*/
+void SV_RunIslandPhysics(void)
+{
+	svmover_t	*m;
+	gentity_t	*ent;
+	qboolean	retry;
+	int			i, j;
+
+	if (!svNumMovers)
+		return;
+
+	SV_BuildIslands();
+	Job_ParallelFor(svNumIslands, SV_MoveIsland, SV_TraceContexts());
+
+	// link everything first so callbacks see all entities at their new positions
+	for (i = 0; i < svNumMovers; i++)
+		SV_LinkEdict(svMovers[i].ent);
+
+	for (i = 0; i < svNumMovers; i++)
+	{
+		m = &svMovers[i];
+		ent = m->ent;
+
+		if (!ent->inuse)
+			continue;	// removed by a callback of other entity
+
+		sv_entity = ent;
+
+		if (m->kind == MOVER_TOSS)
+		{
+			// same as end of SV_PushEntity
+			retry = false;
+			if (m->trace.fraction != 1.0)
+			{
+				if (SV_IslandImpactValid(&m->trace))
+				{
+					Scr_Event_Impact(ent, &m->trace);
+					retry = (!m->trace.ent->inuse && ent->inuse);
+				}
+				else
+				{
+					retry = true;
+				}
+			}
+
+			if (retry)
+			{
+				// entity in the way went away, move again from the start like SV_PushEntity does
+				VectorCopy(m->old_origin, ent->v.origin);
+				SV_LinkEdict(ent);
+				m->trace = SV_PushEntity(ent, m->move);
+			}
+			else if (ent->inuse)
+			{
+				SV_TouchEntities(ent, AREA_TRIGGERS);
+			}
+			if (!ent->inuse)
+				continue;
+
+			SV_Physics_TossEnd(ent, &m->trace, m->old_origin);
+		}
+		else
+		{
+			for (j = 0; j < m->numImpacts && ent->inuse; j++)
+			{
+				if (SV_IslandImpactValid(&m->impacts[j]))
+					Scr_Event_Impact(ent, &m->impacts[j]);
+			}
+			if (!ent->inuse)
+				continue;
+
+			SV_Physics_StepEnd(ent, m->wasonground, m->hitsound);
+			if (!ent->inuse)
+				continue;
+
+			SV_RunThink(ent);
+		}
+	}
+}
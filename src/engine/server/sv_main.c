@@ -35,6 +35,13 @@ cvar_t	*sv_password;
 cvar_t	*sv_maxclients;	
 cvar_t	*sv_maxentities;
 cvar_t	*sv_showclamp;
+cvar_t	*sv_broadphase;
+cvar_t	*sv_tracethreads;
+cvar_t	*sv_physicsislands;
+cvar_t	*sv_parallelframes;
+cvar_t	*sv_deltacache;
+cvar_t	*sv_bitpacked;
+cvar_t	*sv_fragbudget;
 cvar_t	*sv_cheats;
 
 cvar_t *sv_nolateloading;
@@ -311,6 +318,7 @@ void SVC_DirectConnect (void)
 	int			version;
 	int			qport;
 	int			challenge;
+	int			bitsversion;
 
 	adr = net_from;
 
@@ -331,6 +339,9 @@ void SVC_DirectConnect (void)
 	strncpy (userinfo, Cmd_Argv(4), sizeof(userinfo)-1);
 	userinfo[sizeof(userinfo) - 1] = 0;
 
+	// optional, clients which want bit packed frames send PROTOCOL_VERSION_BITS
+	bitsversion = atoi(Cmd_Argv(5));
+
 	// force the IP key/value pair so the game can filter based on ip
 	Info_SetValueForKey (userinfo, "ip", NET_AdrToString(net_from));
 
@@ -418,6 +429,10 @@ gotnewcl:
 	newcl->edict = ent;
 	newcl->challenge = challenge; // save challenge for checksumming
 
+	// bit packed frames are used only when both sides want them,
+	// client learns the outcome from protocol sent in svc_serverdata
+	newcl->protocol = (bitsversion == PROTOCOL_VERSION_BITS && sv_bitpacked->value) ? PROTOCOL_VERSION_BITS : PROTOCOL_VERSION;
+
 
 	// give progs a chance to reject this connection or modify the userinfo
 	if (!(Scr_ClientConnect(ent, userinfo)))
@@ -757,6 +772,8 @@ SV_RunGameFrame
 */
 void SV_RunGameFrame (void)
 {
+	unsigned long long start = Sys_Microseconds();
+
 	time_before_game = Sys_Milliseconds ();
 
 	// we always need to bump framenum, even if we don't run the world, otherwise 
@@ -779,6 +796,7 @@ void SV_RunGameFrame (void)
 	}
 
 	time_after_game = Sys_Milliseconds ();
+	SV_PerfAdd(SVPERF_GAMEFRAME, start);
 }
 
 /*
@@ -859,6 +877,8 @@ SV_Frame
 */
 void SV_Frame (int msec)
 {
+	unsigned long long start, t;
+
 	time_before_game = time_after_game = 0;
 
 	// if server is not active, do nothing
@@ -869,10 +889,14 @@ void SV_Frame (int msec)
 		Scr_BindVM(VM_SVGAME);
 
     svs.realtime += msec;
-	
+	start = Sys_Microseconds();
+
 	rand();				// keep the random time dependent, WHY SO OFTEN?
 	SV_CheckTimeouts();	// check timeouts
+
+	t = Sys_Microseconds();
 	SV_ReadPackets();	// get packets from clients
+	SV_PerfAdd(SVPERF_READPACKETS, t);
 
 	// move autonomous things around if enough time has passed
 	if (!sv_timedemo->value && svs.realtime < sv.time)
@@ -884,6 +908,7 @@ void SV_Frame (int msec)
 				Com_Printf ("WARNING: server lowclamp\n");
 			svs.realtime = sv.time - SV_FRAMETIME_MSEC;
 		}
+		SV_PerfAdd(SVPERF_FRAME, start); // counted in next game frame
 		NET_Sleep(sv.time - svs.realtime);
 		return;
 	}
@@ -893,10 +918,17 @@ void SV_Frame (int msec)
 	SV_CalcPings();				// update ping based on the last known frame from all clients
 	SV_GiveMsec();				// give the clients some timeslices
 	SV_RunGameFrame();			// let everything in the world think and move
+
+	t = Sys_Microseconds();
 	SV_SendClientMessages();	// send messages back to the clients that had packets read this frame
+	SV_PerfAdd(SVPERF_SENDMESSAGES, t);
+
 	SV_RecordDemoMessage();		// save the entire world state if recording a serverdemo
 	Master_Heartbeat();			// send a heartbeat to the master if needed
 	SV_PrepWorldFrame();		// clear teleport flags, etc for next frame
+
+	SV_PerfAdd(SVPERF_FRAME, start);
+	SV_PerfEndFrame();
 }
 
 //============================================================================
@@ -1052,6 +1084,13 @@ void SV_Init (void)
 	sv_maxentities = Cvar_Get("sv_maxentities", va("%i", MAX_GENTITIES), CVAR_LATCH, "Maximum number of server entities. Better don't change.");
 	sv_maxvelocity = Cvar_Get("sv_maxevelocity", "1500", 0, "Maximum velocity of an entities (excluding players).");
 	sv_gravity = Cvar_Get("sv_gravity", "800", 0, "Gravity (default 800).");
+	sv_broadphase = Cvar_Get("sv_broadphase", "1", CVAR_LATCH, "Entity area lookups: 0 = fixed area nodes, 1 = dynamic AABB tree.");
+	sv_tracethreads = Cvar_Get("sv_tracethreads", "1", 0, "Use worker threads for batched traces.");
+	sv_physicsislands = Cvar_Get("sv_physicsislands", "0", 0, "Trace toss and step entity moves on worker threads, callbacks run after all moves.");
+	sv_parallelframes = Cvar_Get("sv_parallelframes", "1", 0, "Build and encode client frames on worker threads, clients seeing EntityStateForClient entities are done on main thread.");
+	sv_deltacache = Cvar_Get("sv_deltacache", "1", 0, "Reuse encoded entity deltas for clients which see the same entity state.");
+	sv_bitpacked = Cvar_Get("sv_bitpacked", "1", 0, "Send bit packed frames to clients which ask for them when connecting.");
+	sv_fragbudget = Cvar_Get("sv_fragbudget", "4800", 0, "Bytes of a fragmented frame sent to a client each server frame, the rest goes in next frames (0 = no limit).");
 
 	sv_hostname = Cvar_Get ("hostname", "pragma server", CVAR_SERVERINFO | CVAR_ARCHIVE, "This is the server's name.");
 
@@ -1174,6 +1213,12 @@ void SV_Shutdown (char *finalmsg, qboolean reconnect)
 		svs.client_entities = NULL;
 	}
 
+	if (svs.client_entity_stamps)
+	{
+		Z_Free(svs.client_entity_stamps);
+		svs.client_entity_stamps = NULL;
+	}
+
 	// close another sv sdemo?
 	if (svs.demofile)
 	{
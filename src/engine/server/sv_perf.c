@@ -0,0 +1,251 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// sv_perf.c -- per frame timing of server stages
+
+#include "server.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#define SV_PERF_BARRIER() _ReadWriteBarrier()
+#else
+	#define SV_PERF_BARRIER() __sync_synchronize()
+#endif
+
+#define SV_PERF_FRAMES	1024	// must be power of two
+
+typedef struct
+{
+	int				framenum;
+	int				numClients;		// clients that were sent a frame
+	unsigned int	usec[SVPERF_NUM_STAGES];
+} svperf_frame_t;
+
+static const char* svPerfStageNames[SVPERF_NUM_STAGES] =
+{
+	"frame",
+	"readpackets",
+	"gameframe",
+	"prethink",
+	"think",
+	"physics",
+	"endframe",
+	"sendmessages",
+	"buildframe",
+	"writeframe",
+	"transmit"
+};
+
+// ring of finished frames, written only by server frame and read by
+// commands, a frame becomes visible after svPerfHead is advanced past it
+static svperf_frame_t	svPerfFrames[SV_PERF_FRAMES];
+static volatile unsigned int svPerfHead;
+
+// frame being recorded
+static long long		svPerfCurrent[SVPERF_NUM_STAGES];
+static int				svPerfClients;
+
+/*
+================
+SV_PerfAdd
+
+Adds time elapsed since start to stage and returns it.
+================
+*/
+unsigned int SV_PerfAdd(svperfstage_t stage, unsigned long long start)
+{
+	unsigned int elapsed = (unsigned int)(Sys_Microseconds() - start);
+
+	svPerfCurrent[stage] += elapsed;
+	if (stage == SVPERF_BUILDFRAME)
+		svPerfClients++;
+	return elapsed;
+}
+
+/*
+================
+SV_PerfSubtract
+
+Removes time of nested stage from its parent, ie. think from physics.
+================
+*/
+void SV_PerfSubtract(svperfstage_t stage, unsigned int usec)
+{
+	svPerfCurrent[stage] -= usec;
+}
+
+/*
+================
+SV_PerfEndFrame
+
+Stores timings of current frame in ring and starts a new one.
+================
+*/
+void SV_PerfEndFrame(void)
+{
+	svperf_frame_t	*frame;
+	int				i;
+
+	frame = &svPerfFrames[svPerfHead & (SV_PERF_FRAMES - 1)];
+	frame->framenum = sv.framenum;
+	frame->numClients = svPerfClients;
+	for (i = 0; i < SVPERF_NUM_STAGES; i++)
+	{
+		frame->usec[i] = svPerfCurrent[i] > 0 ? (unsigned int)svPerfCurrent[i] : 0;
+		svPerfCurrent[i] = 0;
+	}
+	svPerfClients = 0;
+
+	SV_PERF_BARRIER();
+	svPerfHead++;
+}
+
+/*
+================
+SV_PerfCopyFrames
+
+Copies up to count most recent frames, oldest first, returns number of frames copied.
+================
+*/
+static int SV_PerfCopyFrames(svperf_frame_t* out, int count)
+{
+	unsigned int head, first, i;
+
+	head = svPerfHead;
+	SV_PERF_BARRIER();
+
+	if (count > SV_PERF_FRAMES - 1)
+		count = SV_PERF_FRAMES - 1; // slot at head may be getting written
+	if ((unsigned int)count > head)
+		count = head;
+
+	first = head - count;
+	for (i = 0; i < (unsigned int)count; i++)
+		out[i] = svPerfFrames[(first + i) & (SV_PERF_FRAMES - 1)];
+
+	// drop frames that were overwritten while copying
+	SV_PERF_BARRIER();
+	head = svPerfHead - (SV_PERF_FRAMES - 1);
+	if ((int)(head - first) > 0)
+	{
+		i = head - first;
+		if (i > (unsigned int)count)
+			i = count;
+		memmove(out, out + i, (count - i) * sizeof(svperf_frame_t));
+		count -= i;
+	}
+	return count;
+}
+
+static int SV_PerfCompare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+	return (x > y) - (x < y);
+}
+
+/*
+================
+SV_Perf_f
+
+sv_perf [frames]
+Prints p50/p99/max of every server frame stage over the last frames.
+================
+*/
+void SV_Perf_f(void)
+{
+	svperf_frame_t	*frames;
+	unsigned int	*values;
+	int				i, stage, count;
+	double			avg;
+
+	count = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : SV_PERF_FRAMES;
+	if (count <= 0)
+	{
+		Com_Printf("usage: sv_perf [frames]\n");
+		return;
+	}
+
+	frames = Z_Malloc(SV_PERF_FRAMES * sizeof(svperf_frame_t));
+	values = Z_Malloc(SV_PERF_FRAMES * sizeof(unsigned int));
+
+	count = SV_PerfCopyFrames(frames, count);
+	if (!count)
+	{
+		Com_Printf("No server frames recorded.\n");
+	}
+	else
+	{
+		Com_Printf("Server frame %i-%i (%i frames), times in ms:\n", frames[0].framenum, frames[count - 1].framenum, count);
+		Com_Printf("%-14s %8s %8s %8s %8s\n", "stage", "avg", "p50", "p99", "max");
+		for (stage = 0; stage < SVPERF_NUM_STAGES; stage++)
+		{
+			avg = 0;
+			for (i = 0; i < count; i++)
+			{
+				values[i] = frames[i].usec[stage];
+				avg += values[i];
+			}
+			avg /= count;
+			qsort(values, count, sizeof(unsigned int), SV_PerfCompare);
+
+			Com_Printf("%-14s %8.3f %8.3f %8.3f %8.3f\n", svPerfStageNames[stage], avg / 1000.0,
+				values[count / 2] / 1000.0, values[(count * 99) / 100] / 1000.0, values[count - 1] / 1000.0);
+		}
+	}
+
+	Z_Free(values);
+	Z_Free(frames);
+}
+
+/*
+================
+SV_PerfDump_f
+
+sv_perf_dump [filename]
+Writes timings of recorded frames to a CSV file in game directory.
+================
+*/
+void SV_PerfDump_f(void)
+{
+	char			name[MAX_OSPATH];
+	svperf_frame_t	*frames;
+	FILE			*f;
+	int				i, stage, count;
+
+	Com_sprintf(name, sizeof(name), "%s/%s", FS_Gamedir(), Cmd_Argc() > 1 ? Cmd_Argv(1) : "sv_perf.csv");
+	FS_CreatePath(name);
+
+	f = fopen(name, "w");
+	if (!f)
+	{
+		Com_Printf("Couldn't write %s.\n", name);
+		return;
+	}
+
+	frames = Z_Malloc(SV_PERF_FRAMES * sizeof(svperf_frame_t));
+	count = SV_PerfCopyFrames(frames, SV_PERF_FRAMES);
+
+	fprintf(f, "framenum,clients");
+	for (stage = 0; stage < SVPERF_NUM_STAGES; stage++)
+		fprintf(f, ",%s_us", svPerfStageNames[stage]);
+	fprintf(f, "\n");
+
+	for (i = 0; i < count; i++)
+	{
+		fprintf(f, "%i,%i", frames[i].framenum, frames[i].numClients);
+		for (stage = 0; stage < SVPERF_NUM_STAGES; stage++)
+			fprintf(f, ",%u", frames[i].usec[stage]);
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+	Z_Free(frames);
+
+	Com_Printf("Wrote %i server frames to %s.\n", count, name);
+}
@@ -215,7 +215,38 @@ Returns the clipflags if the velocity was modified (hit something solid)
 ============
 */
 #define	MAX_CLIP_PLANES	5
+
+static trace_t SV_PhysicsTrace(svphysdefer_t* defer, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, gentity_t* passedict, int mask)
+{
+	if (defer)
+		return SV_TraceCandidates(defer->ctx, start, mins, maxs, end, passedict, mask, defer->candidates, defer->numCandidates);
+	return SV_Trace(start, mins, maxs, end, passedict, mask);
+}
+
+static void SV_PhysicsImpact(svphysdefer_t* defer, gentity_t* ent, trace_t* trace)
+{
+	if (defer)
+	{
+		if (defer->numImpacts < SV_MAX_DEFERRED_IMPACTS)
+			defer->impacts[defer->numImpacts++] = *trace;
+		return;
+	}
+	Scr_Event_Impact(ent, trace);
+}
+
 int SV_FlyMove(gentity_t* ent, float time, int mask)
+{
+	return SV_FlyMoveDeferred(ent, time, mask, NULL);
+}
+
+/*
+============
+SV_FlyMoveDeferred
+When defer is set traces only clip against its candidates and impacts are
+stored in it instead of being run, so it can be called from job threads
+============
+*/
+int SV_FlyMoveDeferred(gentity_t* ent, float time, int mask, svphysdefer_t* defer)
 {
 	gentity_t* hit;
 	int			bumpcount, numbumps;
@@ -245,7 +276,7 @@ int SV_FlyMove(gentity_t* ent, float time, int mask)
 		for (i = 0; i < 3; i++)
 			end[i] = ent->v.origin[i] + time_left * ent->v.velocity[i];
 
-		trace = SV_Trace(ent->v.origin, ent->v.mins, ent->v.maxs, end, ent, mask);
+		trace = SV_PhysicsTrace(defer, ent->v.origin, ent->v.mins, ent->v.maxs, end, ent, mask);
 
 		if (trace.allsolid)
 		{	// entity is trapped in another solid
@@ -282,7 +313,7 @@ int SV_FlyMove(gentity_t* ent, float time, int mask)
 		//
 		// run the impact function
 		//
-		Scr_Event_Impact(ent, &trace);
+		SV_PhysicsImpact(defer, ent, &trace);
 		if (!ent->inuse)
 			break;		// removed by the impact function
 
@@ -683,28 +714,20 @@ TOSS / BOUNCE
 
 /*
 =============
-SV_Physics_Toss
-Toss, bounce, and fly movement. When onground, do nothing.
+SV_Physics_TossBegin
+Thinks and accelerates, returns true with move set when entity isn't on ground
 =============
 */
-void SV_Physics_Toss(gentity_t* ent)
+qboolean SV_Physics_TossBegin(gentity_t* ent, vec3_t move)
 {
-	trace_t		trace;
-	vec3_t		move;
-	float		backoff;
-	gentity_t* slave;
-	qboolean	wasinwater;
-	qboolean	isinwater;
-	vec3_t		old_origin;
-
 	// regular thinking
 	SV_RunThink(ent);
 	if (!ent->inuse)
-		return; // could have deleted itself in think
+		return false; // could have deleted itself in think
 
 	// if not a team captain, so movement will be handled elsewhere
 	if ((int)ent->v.flags & FL_TEAMSLAVE)
-		return;
+		return false;
 
 	if (ent->v.velocity[2] > 0)
 		ent->v.groundentity_num = ENTITYNUM_NULL;
@@ -721,9 +744,7 @@ void SV_Physics_Toss(gentity_t* ent)
 
 	// if onground, return without moving
 	if (groundent)
-		return;
-
-	VectorCopy(ent->v.origin, old_origin);
+		return false;
 
 	SV_CheckVelocity(ent);
 
@@ -736,33 +757,45 @@ void SV_Physics_Toss(gentity_t* ent)
 
 	// move origin
 	VectorScale(ent->v.velocity, SV_FRAMETIME, move);
-	trace = SV_PushEntity(ent, move);
-	if (!ent->inuse)
-		return;
+	return true;
+}
+
+/*
+=============
+SV_Physics_TossEnd
+Bounces or stops entity after move, old_origin is where the move started
+=============
+*/
+void SV_Physics_TossEnd(gentity_t* ent, trace_t* trace, vec3_t old_origin)
+{
+	float		backoff;
+	gentity_t* slave;
+	qboolean	wasinwater;
+	qboolean	isinwater;
 
-	if (trace.fraction < 1)
+	if (trace->fraction < 1)
 	{
 		if (ent->v.movetype == MOVETYPE_BOUNCE)
 			backoff = 1.5;
 		else
 			backoff = 1;
 
-		ClipVelocity(ent->v.velocity, trace.plane.normal, ent->v.velocity, backoff);
+		ClipVelocity(ent->v.velocity, trace->plane.normal, ent->v.velocity, backoff);
 
 		// stop if on ground
-		if (trace.plane.normal[2] > 0.7)
+		if (trace->plane.normal[2] > 0.7)
 		{
 			if (ent->v.velocity[2] < 60 || ent->v.movetype != MOVETYPE_BOUNCE)
 			{
-				ent->v.groundentity_num = trace.entitynum;
-				ent->v.groundentity_linkcount = trace.ent->v.linkcount;
+				ent->v.groundentity_num = trace->entitynum;
+				ent->v.groundentity_linkcount = trace->ent->v.linkcount;
 				VectorCopy(vec3_origin, ent->v.velocity);
 				VectorCopy(vec3_origin, ent->v.avelocity);
 			}
 		}
 
 //		if (ent->touch)
-//			ent->touch (ent, trace.ent, &trace.plane, trace.surface);
+//			ent->touch (ent, trace->ent, &trace->plane, trace->surface);
 	}
 
 	// check for water transition
@@ -788,6 +821,30 @@ void SV_Physics_Toss(gentity_t* ent)
 	}
 }
 
+/*
+=============
+SV_Physics_Toss
+Toss, bounce, and fly movement. When onground, do nothing.
+=============
+*/
+void SV_Physics_Toss(gentity_t* ent)
+{
+	trace_t		trace;
+	vec3_t		move;
+	vec3_t		old_origin;
+
+	if (!SV_Physics_TossBegin(ent, move))
+		return;
+
+	VectorCopy(ent->v.origin, old_origin);
+
+	trace = SV_PushEntity(ent, move);
+	if (!ent->inuse)
+		return;
+
+	SV_Physics_TossEnd(ent, &trace, old_origin);
+}
+
 /*
 ===============================================================================
 STEPPING MOVEMENT
@@ -826,7 +883,13 @@ void SV_AddRotationalFriction(gentity_t* ent)
 	}
 }
 
-void SV_Physics_Step(gentity_t* ent)
+/*
+=============
+SV_Physics_StepBegin
+Applies gravity and friction, returns true when entity has to move
+=============
+*/
+qboolean SV_Physics_StepBegin(gentity_t* ent, qboolean* onground, qboolean* hitground)
 {
 	qboolean	wasonground;
 	qboolean	hitsound = false;
@@ -834,7 +897,6 @@ void SV_Physics_Step(gentity_t* ent)
 	float		speed, newspeed, control;
 	float		friction;
 	gentity_t* groundentity = NULL;
-	int			mask;
 
 	// airborn monsters should always check for ground
 	if ((int)ent->v.groundentity_num == ENTITYNUM_NULL)
@@ -891,44 +953,74 @@ void SV_Physics_Step(gentity_t* ent)
 		ent->v.velocity[2] *= newspeed;
 	}
 
-	if (ent->v.velocity[2] || ent->v.velocity[1] || ent->v.velocity[0])
-	{
-		// apply friction
-		// let dead monsters who aren't completely onground slide
-		if ((wasonground) || ((int)ent->v.flags & (FL_SWIM | FL_FLY)))
-			if (!(ent->v.health <= 0.0 && !SV_CheckBottom(ent)))
+	*onground = wasonground;
+	*hitground = hitsound;
+
+	if (!ent->v.velocity[2] && !ent->v.velocity[1] && !ent->v.velocity[0])
+		return false;
+
+	// apply friction
+	// let dead monsters who aren't completely onground slide
+	if ((wasonground) || ((int)ent->v.flags & (FL_SWIM | FL_FLY)))
+		if (!(ent->v.health <= 0.0 && !SV_CheckBottom(ent)))
+		{
+			vel = ent->v.velocity;
+			speed = sqrt(vel[0] * vel[0] + vel[1] * vel[1]);
+			if (speed)
 			{
-				vel = ent->v.velocity;
-				speed = sqrt(vel[0] * vel[0] + vel[1] * vel[1]);
-				if (speed)
-				{
-					friction = sv_friction;
+				friction = sv_friction;
 
-					control = speed < sv_stopspeed ? sv_stopspeed : speed;
-					newspeed = speed - SV_FRAMETIME * control * friction;
+				control = speed < sv_stopspeed ? sv_stopspeed : speed;
+				newspeed = speed - SV_FRAMETIME * control * friction;
 
-					if (newspeed < 0)
-						newspeed = 0;
-					newspeed /= speed;
+				if (newspeed < 0)
+					newspeed = 0;
+				newspeed /= speed;
 
-					vel[0] *= newspeed;
-					vel[1] *= newspeed;
-				}
+				vel[0] *= newspeed;
+				vel[1] *= newspeed;
 			}
+		}
 
-		if ((int)ent->v.svflags & SVF_MONSTER)
-			mask = MASK_MONSTERSOLID;
-		else
-			mask = MASK_SOLID;
-		SV_FlyMove(ent, SV_FRAMETIME, mask);
+	return true;
+}
 
-		SV_LinkEdict(ent);
-		SV_TouchEntities(ent, AREA_TRIGGERS);
+/*
+=============
+SV_Physics_StepEnd
+Links entity after move and plays landing sound
+=============
+*/
+void SV_Physics_StepEnd(gentity_t* ent, qboolean wasonground, qboolean hitsound)
+{
+	SV_LinkEdict(ent);
+	SV_TouchEntities(ent, AREA_TRIGGERS);
+	if (!ent->inuse)
+		return;
+
+	if ((int)ent->v.groundentity_num != ENTITYNUM_NULL && !wasonground && hitsound)
+		SV_StartSound(NULL, ent, 0, SV_SoundIndex("world/land.wav"), 1, 1, 0);
+}
+
+int SV_Physics_StepMask(gentity_t* ent)
+{
+	if ((int)ent->v.svflags & SVF_MONSTER)
+		return MASK_MONSTERSOLID;
+	return MASK_SOLID;
+}
+
+void SV_Physics_Step(gentity_t* ent)
+{
+	qboolean	wasonground;
+	qboolean	hitsound;
+
+	if (SV_Physics_StepBegin(ent, &wasonground, &hitsound))
+	{
+		SV_FlyMove(ent, SV_FRAMETIME, SV_Physics_StepMask(ent));
+
+		SV_Physics_StepEnd(ent, wasonground, hitsound);
 		if (!ent->inuse)
 			return;
-
-		if ((int)ent->v.groundentity_num != ENTITYNUM_NULL && !wasonground && hitsound)
-			SV_StartSound(NULL, ent, 0, SV_SoundIndex("world/land.wav"), 1, 1, 0);
 	}
 
 	// regular thinking
@@ -412,12 +412,15 @@ SV_SendClientDatagram
 */
 extern void SV_EntityStateToProgVars(gentity_t* ent, entity_state_t* state);
 extern void SV_RestoreEntityStateAfterClient(gentity_t* ent);
+static void SV_TransmitClientDatagram(client_t *client, sizebuf_t *msg);
 
 qboolean SV_SendClientDatagram(client_t *client)
 {
-	byte		msg_buf[MAX_MSGLEN];
+	byte		msg_buf[MAX_FRAGMSGLEN];
 	sizebuf_t	msg;
+	unsigned long long t;
 
+	t = Sys_Microseconds();
 	SV_BuildClientFrame (client);
 
 #if 1 //#ifdef PARANOID
@@ -433,38 +436,57 @@ qboolean SV_SendClientDatagram(client_t *client)
 		SV_RestoreEntityStateAfterClient(ent);
 	}
 #endif
+	SV_PerfAdd(SVPERF_BUILDFRAME, t);
 
 	SZ_Init (&msg, msg_buf, sizeof(msg_buf));
 	msg.allowoverflow = true;
 
 	// send over all the relevant entity_state_t and the player_state_t
-	SV_WriteFrameToClient (client, &msg);
-		
+	t = Sys_Microseconds();
+	SV_WriteFrameToClient (client, &msg, 0);
+	SV_PerfAdd(SVPERF_WRITEFRAME, t);
+
+	SV_TransmitClientDatagram (client, &msg);
+	return true;
+}
+
+
+/*
+=======================
+SV_TransmitClientDatagram
+
+Appends multicast datagram to the encoded frame and sends it
+=======================
+*/
+static void SV_TransmitClientDatagram(client_t *client, sizebuf_t *msg)
+{
+	unsigned long long t;
+
 	// copy the accumulated multicast datagram for this client out to the message
 	// it is necessary for this to be after the WriteEntities so that entity references will be current
 	if (client->datagram.overflowed)
 		Com_Printf ("WARNING: datagram overflowed for %s\n", client->name);
 	else
-		SZ_Write (&msg, client->datagram.data, client->datagram.cursize);
+		SZ_Write (msg, client->datagram.data, client->datagram.cursize);
 	SZ_Clear (&client->datagram);
 
 #if 0 //handy stats
-	Com_Printf("#%i - datagram for %i (%s): %i/%ib (%i ents)\n", sv.framenum , client->edict->s.number-1, client->name, msg.cursize, msg.maxsize, client->frames[sv.framenum & UPDATE_MASK].num_entities);
+	Com_Printf("#%i - datagram for %i (%s): %i/%ib (%i ents)\n", sv.framenum , client->edict->s.number-1, client->name, msg->cursize, msg->maxsize, client->frames[sv.framenum & UPDATE_MASK].num_entities);
 #endif
 
-	if (msg.overflowed)
+	if (msg->overflowed)
 	{	// must have room left for the packet header
 		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear (&msg);
+		SZ_Clear (msg);
 	}
 
 	// send the datagram
-	Netchan_Transmit (&client->netchan, msg.cursize, msg.data);
+	t = Sys_Microseconds();
+	Netchan_Transmit (&client->netchan, msg->cursize, msg->data);
+	SV_PerfAdd(SVPERF_TRANSMIT, t);
 
 	// record the size for rate estimation
-	client->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
-
-	return true;
+	client->message_size[sv.framenum % RATE_MESSAGES] = msg->cursize;
 }
 
 
@@ -522,6 +544,68 @@ qboolean SV_RateDrop (client_t *c)
 	return false;
 }
 
+/*
+=======================
+SV_PrepareClientDatagrams
+
+Runs client independent frame checks, then builds and encodes frames of
+spawned clients on job threads. The datagrams are finished and sent in
+client order by SV_SendClientMessages.
+=======================
+*/
+#define SVFRAME_SERIAL		0	// built by SV_SendClientDatagram
+#define SVFRAME_PREPARED	1	// encoded to svPreparedMsg
+#define SVFRAME_RATEDROP	2	// over its bandwidth, nothing to send
+
+static byte			svFrameMode[MAX_CLIENTS];
+static sizebuf_t	svPreparedMsg[MAX_CLIENTS];
+static byte			svPreparedMsgBuf[MAX_CLIENTS][MAX_FRAGMSGLEN];
+
+static void SV_PrepareClientDatagrams(void)
+{
+	client_t	*clients[MAX_CLIENTS];
+	sizebuf_t	*msgs[MAX_CLIENTS];
+	client_t	*c;
+	int			i, count;
+
+	memset (svFrameMode, SVFRAME_SERIAL, sizeof(svFrameMode));
+
+	if (sv.state == ss_cinematic || sv.state == ss_demo || sv.state == ss_pic)
+		return;
+
+	SV_BeginClientFrames ();
+
+	if (!sv_parallelframes->value || Job_NumThreads() < 2 || sv.state != ss_game)
+		return;
+
+	count = 0;
+	for (i = 0, c = svs.clients; i < sv_maxclients->value; i++, c++)
+	{
+		// overflowed clients are dropped before sending
+		if (c->state != cs_spawned || c->netchan.message.overflowed)
+			continue;
+
+		if (!SV_CanBuildClientFrameOnJobs (c) || c->netchan.unsent_fragments)
+			continue;
+
+		if (SV_RateDrop (c))
+		{
+			svFrameMode[i] = SVFRAME_RATEDROP;
+			continue;
+		}
+
+		SZ_Init (&svPreparedMsg[i], svPreparedMsgBuf[i], sizeof(svPreparedMsgBuf[i]));
+		svPreparedMsg[i].allowoverflow = true;
+
+		svFrameMode[i] = SVFRAME_PREPARED;
+		clients[count] = c;
+		msgs[count] = &svPreparedMsg[i];
+		count++;
+	}
+
+	SV_BuildClientFramesOnJobs (clients, msgs, count);
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -532,7 +616,7 @@ void SV_SendClientMessages (void)
 	int			i;
 	client_t	*c;
 	int			msglen;
-	byte		msgbuf[MAX_MSGLEN];
+	byte		msgbuf[MAX_FRAGMSGLEN];
 	size_t		r;
 
 	msglen = 0;
@@ -557,7 +641,7 @@ void SV_SendClientMessages (void)
 				SV_DemoCompleted ();
 				return;
 			}
-			if (msglen > MAX_MSGLEN)
+			if (msglen > MAX_FRAGMSGLEN)
 				Com_Error (ERR_DROP, "SV_SendClientMessages: msglen (%i) overflow in DEMO!", msglen);
 
 			r = fread (msgbuf, (size_t)msglen, (size_t)1, sv.demofile);
@@ -569,12 +653,16 @@ void SV_SendClientMessages (void)
 		}
 	}
 
+	SV_PrepareClientDatagrams ();
+
 	// send a message to each connected client
 	for (i = 0, c = svs.clients; i < sv_maxclients->value; i++, c++)
 	{
 		if (!c->state)
 			continue;
 
+		c->netchan.fragment_budget = (int)sv_fragbudget->value;
+
 		// if the reliable message overflowed, drop the client
 		if (c->netchan.message.overflowed)
 		{
@@ -591,6 +679,22 @@ void SV_SendClientMessages (void)
 		}
 		else if (c->state == cs_spawned)
 		{
+			if (svFrameMode[i] == SVFRAME_PREPARED)
+			{
+				SV_TransmitClientDatagram (c, &svPreparedMsg[i]);
+				continue;
+			}
+			if (svFrameMode[i] == SVFRAME_RATEDROP)
+				continue;
+
+			// last frame didn't fit in the budget, send rest of it instead of a new one
+			if (c->netchan.unsent_fragments)
+			{
+				Netchan_TransmitNextFragment (&c->netchan, c->netchan.fragment_budget);
+				c->message_size[sv.framenum % RATE_MESSAGES] = 0; // counted with the whole frame
+				continue;
+			}
+
 			// don't overrun bandwidth
 			if (SV_RateDrop (c))
 				continue;
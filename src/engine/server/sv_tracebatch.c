@@ -0,0 +1,369 @@
+/*
+pragma
+Copyright (C) 2023-2024 BraXi.
+
+Quake 2 Engine 'Id Tech 2'
+Copyright (C) 1997-2001 Id Software, Inc.
+
+See the attached GNU General Public License v2 for more details.
+*/
+// sv_tracebatch.c -- many traces with shared passedict and contentmask
+
+#include "server.h"
+
+/*
+	Traces which are close to each other are grouped and SV_AreaEntities is
+	called once for the bounds of a whole group. Candidates which don't depend
+	on the trace (passedict, owner and svflags checks) are filtered once too,
+	then every trace of group only tests candidates which touch its own bounds.
+
+	Groups are independent and can be traced by worker threads, each thread
+	has its own collision context. Results are the same as from SV_Trace.
+*/
+
+#define TRACEBATCH_GROUP		32		// max traces sharing one area query
+#define TRACEBATCH_MERGE		4.0f	// max ratio of group volume to volume of its traces
+#define TRACEBATCH_THREADED		32		// min traces in batch for use of workers
+
+typedef struct
+{
+	int			firstTrace, numTraces;
+	int			firstCandidate, numCandidates;
+} tbgroup_t;
+
+typedef struct
+{
+	svtrace_t		*traces;
+	gentity_t		*passedict;
+	int				contentmask;
+
+	tbgroup_t		*groups;
+	int				numGroups, maxGroups;
+
+	svcandidate_t	*candidates;
+	int				numCandidates, maxCandidates;
+} tracebatch_t;
+
+static tracebatch_t	tb;
+static cmcontext_t	*svTraceContexts[JOB_MAX_THREADS];
+
+/*
+==================
+SV_TraceContexts
+
+Returns collision contexts for every job thread, must be called from main thread.
+==================
+*/
+cmcontext_t** SV_TraceContexts(void)
+{
+	int i, numThreads;
+
+	numThreads = Job_NumThreads();
+	for (i = 0; i < numThreads; i++)
+	{
+		if (!svTraceContexts[i])
+			svTraceContexts[i] = CM_NewContext();
+	}
+	return svTraceContexts;
+}
+
+/*
+==================
+SV_GatherCandidates
+
+Fills list with solid entities touching mins/maxs which traces can clip against
+from any thread. Brush model hulls are resolved here as SV_HullForEntity may
+throw script errors.
+==================
+*/
+int SV_GatherCandidates(vec3_t mins, vec3_t maxs, svcandidate_t* list, int maxcount)
+{
+	static gentity_t	*touchlist[MAX_GENTITIES];
+	svcandidate_t		*c;
+	gentity_t			*touch;
+	int					i, num, count;
+
+	num = SV_AreaEntities(mins, maxs, touchlist, MAX_GENTITIES, AREA_SOLID);
+
+	count = 0;
+	for (i = 0; i < num && count < maxcount; i++)
+	{
+		touch = touchlist[i];
+
+		if ((int)touch->v.solid == SOLID_NOT)
+			continue;
+
+		c = &list[count];
+		c->ent = touch;
+
+		if (touch->v.solid == SOLID_BSP || (SV_IsBrushModel((int)touch->v.modelindex) && touch->v.solid == SOLID_TRIGGER))
+		{
+			c->headnode = SV_HullForEntity(touch);
+			if (c->headnode < 0)
+				continue;
+		}
+		else
+		{
+			c->headnode = -1;
+		}
+
+		c->angles = (touch->v.solid == SOLID_BSP) ? touch->v.angles : vec3_origin; // boxes don't rotate
+		count++;
+	}
+	return count;
+}
+
+/*
+==================
+SV_TraceCandidates
+
+SV_Trace against world and given candidates only, safe to call from job threads.
+==================
+*/
+trace_t SV_TraceCandidates(cmcontext_t* ctx, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, gentity_t* passedict, int contentmask, svcandidate_t* list, int count)
+{
+	svcandidate_t	*c;
+	gentity_t		*touch;
+	trace_t			result, trace;
+	vec3_t			boxmins, boxmaxs;
+	int				i, headnode;
+
+	// clip to world
+	result = CM_BoxTraceCtx(ctx, start, end, mins, maxs, 0, contentmask);
+	result.ent = sv.edicts;
+	result.entitynum = 0;
+
+	if (result.fraction == 0)
+		return result;		// blocked by the world
+
+	SV_TraceBounds(start, mins, maxs, end, boxmins, boxmaxs);
+
+	// clip to other solid entities, like SV_ClipMoveToEntities does
+	for (i = 0; i < count; i++)
+	{
+		c = &list[i];
+		touch = c->ent;
+
+		if (touch->v.absmin[0] > boxmaxs[0]
+		|| touch->v.absmin[1] > boxmaxs[1]
+		|| touch->v.absmin[2] > boxmaxs[2]
+		|| touch->v.absmax[0] < boxmins[0]
+		|| touch->v.absmax[1] < boxmins[1]
+		|| touch->v.absmax[2] < boxmins[2])
+			continue;		// not touching this trace
+
+		if (touch == passedict)
+			continue;
+
+		if (result.allsolid)
+			break;
+
+		if (passedict)
+		{
+			if (PROG_TO_GENT(touch->v.owner) == passedict)
+				continue;	// don't clip against own missiles
+			if (PROG_TO_GENT(passedict->v.owner) == touch)
+				continue;	// don't clip against owner
+		}
+
+		if (!(contentmask & CONTENTS_DEADMONSTER) && ((int)touch->v.svflags & SVF_DEADMONSTER))
+			continue;
+
+		if (!(contentmask & CONTENTS_PLAYER) && ((int)touch->v.svflags & SVF_PLAYER))
+			continue; // don't clip player against other players
+
+		headnode = c->headnode;
+		if (headnode == -1)
+			headnode = CM_HeadnodeForBoxCtx(ctx, touch->v.mins, touch->v.maxs);
+
+		trace = CM_TransformedBoxTraceCtx(ctx, start, end, mins, maxs, headnode, contentmask, touch->v.origin, c->angles);
+
+		if (trace.allsolid || trace.startsolid || trace.fraction < result.fraction)
+		{
+			trace.ent = touch;
+			if (result.startsolid)
+			{
+				result = trace;
+				result.startsolid = true;
+			}
+			else
+				result = trace;
+		}
+		else if (trace.startsolid)
+			result.startsolid = true;
+	}
+
+	result.entitynum = (result.ent == NULL) ? ENTITYNUM_NULL : NUM_FOR_EDICT(result.ent);
+	return result;
+}
+
+/*
+==================
+SV_TraceBatchGroup
+==================
+*/
+static void SV_TraceBatchGroup(void* data, int index, int thread)
+{
+	tbgroup_t	*group = &tb.groups[index];
+	svtrace_t	*t;
+	int			i;
+
+	for (i = 0; i < group->numTraces; i++)
+	{
+		t = &tb.traces[group->firstTrace + i];
+		t->trace = SV_TraceCandidates(svTraceContexts[thread], t->start, t->mins, t->maxs, t->end, tb.passedict, tb.contentmask,
+			&tb.candidates[group->firstCandidate], group->numCandidates);
+	}
+}
+
+static __inline float SV_TraceBatchVolume(vec3_t mins, vec3_t maxs)
+{
+	return (maxs[0] - mins[0]) * (maxs[1] - mins[1]) * (maxs[2] - mins[2]);
+}
+
+/*
+==================
+SV_TraceBatchAddGroup
+
+Gathers candidate entities for traces first..first+count-1 touching mins/maxs.
+==================
+*/
+static void SV_TraceBatchAddGroup(int first, int count, vec3_t mins, vec3_t maxs)
+{
+	svcandidate_t		*c;
+	tbgroup_t			*group;
+	gentity_t			*touch;
+	int					i, num;
+
+	if (tb.numGroups == tb.maxGroups)
+	{
+		tb.maxGroups = tb.maxGroups ? tb.maxGroups * 2 : 64;
+		group = Z_Malloc(tb.maxGroups * sizeof(tbgroup_t));
+		if (tb.groups)
+		{
+			memcpy(group, tb.groups, tb.numGroups * sizeof(tbgroup_t));
+			Z_Free(tb.groups);
+		}
+		tb.groups = group;
+	}
+
+	if (tb.numCandidates + MAX_GENTITIES > tb.maxCandidates)
+	{
+		tb.maxCandidates = max(tb.maxCandidates * 2, tb.numCandidates + MAX_GENTITIES);
+		c = Z_Malloc(tb.maxCandidates * sizeof(svcandidate_t));
+		if (tb.candidates)
+		{
+			memcpy(c, tb.candidates, tb.numCandidates * sizeof(svcandidate_t));
+			Z_Free(tb.candidates);
+		}
+		tb.candidates = c;
+	}
+
+	group = &tb.groups[tb.numGroups++];
+	group->firstTrace = first;
+	group->numTraces = count;
+	group->firstCandidate = tb.numCandidates;
+
+	c = &tb.candidates[tb.numCandidates];
+	num = SV_GatherCandidates(mins, maxs, c, MAX_GENTITIES);
+
+	// drop entities every trace of batch would skip
+	group->numCandidates = 0;
+	for (i = 0; i < num; i++)
+	{
+		touch = c[i].ent;
+
+		if (touch == tb.passedict)
+			continue;
+
+		if (tb.passedict)
+		{
+			if (PROG_TO_GENT(touch->v.owner) == tb.passedict)
+				continue;
+			if (PROG_TO_GENT(tb.passedict->v.owner) == touch)
+				continue;
+		}
+
+		if (!(tb.contentmask & CONTENTS_DEADMONSTER) && ((int)touch->v.svflags & SVF_DEADMONSTER))
+			continue;
+
+		if (!(tb.contentmask & CONTENTS_PLAYER) && ((int)touch->v.svflags & SVF_PLAYER))
+			continue;
+
+		c[group->numCandidates++] = c[i];
+	}
+	tb.numCandidates += group->numCandidates;
+}
+
+/*
+==================
+SV_TraceBatch
+
+Moves every trace's mins/maxs volume from start to end and stores the result
+in its trace, the same way SV_Trace would. Mins and maxs must be set, use
+vec3_origin for lines.
+==================
+*/
+void SV_TraceBatch(svtrace_t* traces, int count, gentity_t* passedict, int contentmask)
+{
+	vec3_t		groupMins, groupMaxs, mins, maxs, newMins, newMaxs;
+	float		volume, newVolume;
+	int			i, j, first;
+
+	if (count <= 0)
+		return;
+
+	SV_TraceContexts();
+
+	tb.traces = traces;
+	tb.passedict = passedict;
+	tb.contentmask = contentmask;
+	tb.numGroups = 0;
+	tb.numCandidates = 0;
+
+	// group traces in order while their bounds stay close
+	first = 0;
+	SV_TraceBounds(traces[0].start, traces[0].mins, traces[0].maxs, traces[0].end, groupMins, groupMaxs);
+	volume = SV_TraceBatchVolume(groupMins, groupMaxs);
+
+	for (i = 1; i <= count; i++)
+	{
+		if (i < count && i - first < TRACEBATCH_GROUP)
+		{
+			SV_TraceBounds(traces[i].start, traces[i].mins, traces[i].maxs, traces[i].end, mins, maxs);
+			for (j = 0; j < 3; j++)
+			{
+				newMins[j] = min(groupMins[j], mins[j]);
+				newMaxs[j] = max(groupMaxs[j], maxs[j]);
+			}
+
+			newVolume = volume + SV_TraceBatchVolume(mins, maxs);
+			if (SV_TraceBatchVolume(newMins, newMaxs) <= TRACEBATCH_MERGE * newVolume)
+			{
+				VectorCopy(newMins, groupMins);
+				VectorCopy(newMaxs, groupMaxs);
+				volume = newVolume;
+				continue;
+			}
+		}
+
+		SV_TraceBatchAddGroup(first, i - first, groupMins, groupMaxs);
+
+		if (i == count)
+			break;
+
+		first = i;
+		SV_TraceBounds(traces[i].start, traces[i].mins, traces[i].maxs, traces[i].end, groupMins, groupMaxs);
+		volume = SV_TraceBatchVolume(groupMins, groupMaxs);
+	}
+
+	if (sv_tracethreads->value && count >= TRACEBATCH_THREADED)
+	{
+		Job_ParallelFor(tb.numGroups, SV_TraceBatchGroup, NULL);
+	}
+	else
+	{
+		for (i = 0; i < tb.numGroups; i++)
+			SV_TraceBatchGroup(NULL, i, 0);
+	}
+}
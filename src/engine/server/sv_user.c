@@ -78,7 +78,7 @@ void SV_New_f (void)
 
 	// send the serverdata
 	MSG_WriteByte (&sv_client->netchan.message, SVC_SERVERDATA);
-	MSG_WriteLong (&sv_client->netchan.message, PROTOCOL_VERSION);
+	MSG_WriteLong (&sv_client->netchan.message, sv_client->protocol);
 	MSG_WriteLong (&sv_client->netchan.message, svs.spawncount);
 	MSG_WriteByte (&sv_client->netchan.message, sv.attractloop);
 	MSG_WriteString (&sv_client->netchan.message, gamedir);
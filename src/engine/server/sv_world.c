@@ -31,6 +31,7 @@ void SV_ScriptStartFrame();
 void SV_ScriptEndFrame();
 
 void SV_ProgVarsToEntityState(gentity_t* ent);
+extern void Nav_ResolvePathRequests();
 //void SV_EntityStateToProgVars(gentity_t* ent, entity_state_t* state);
 
 //======================================================================
@@ -45,6 +46,9 @@ void SV_EndWorldFrame(void)
 	int		i;
 	gentity_t* ent;
 
+	// resolve paths requested by entities during think
+	Nav_ResolvePathRequests();
+
 	// build the playerstate_t structures for all players
 	for (i = 1; i <= svs.max_clients; i++)
 	{
@@ -67,6 +71,9 @@ void SV_EndWorldFrame(void)
 
 	}
 	SV_ScriptEndFrame();
+
+	// free strings scripts no longer reference
+	Scr_CollectStrings();
 }
 
 void M_CheckGround(gentity_t* ent)
@@ -124,6 +131,8 @@ void SV_RunWorldFrame(void)
 {
 	int		i;
 	gentity_t* ent;
+	unsigned long long t;
+	qboolean islands;
 
 	sv.gameFrame++;
 	sv.gameTime = sv.gameFrame * SV_FRAMETIME;
@@ -136,6 +145,7 @@ void SV_RunWorldFrame(void)
 
 	SV_ScriptStartFrame();
 
+	t = Sys_Microseconds();
 	// run prethink!
 	for (i = 0; i < sv.max_edicts; i++)
 	{
@@ -146,6 +156,11 @@ void SV_RunWorldFrame(void)
 		sv_entity = ent;
 		Scr_EntityPreThink(ent);
 	}
+	SV_PerfAdd(SVPERF_PRETHINK, t);
+
+	islands = sv_physicsislands->value != 0;
+	if (islands)
+		SV_BeginIslandPhysics();
 
 	for (i = 0; i < sv.max_edicts; i++)
 	{
@@ -184,13 +199,28 @@ void SV_RunWorldFrame(void)
 		}
 		if (i > 0 && i <= svs.max_clients)
 		{
+			t = Sys_Microseconds();
 			Scr_ClientBeginServerFrame(ent);
+			SV_PerfAdd(SVPERF_THINK, t);
 			continue;
 		}
 
-		SV_RunEntity(ent);
+		t = Sys_Microseconds();
+		if (!islands || !SV_DeferEntityPhysics(ent))
+			SV_RunEntity(ent);
+		SV_PerfAdd(SVPERF_PHYSICS, t);
+	}
+
+	if (islands)
+	{
+		t = Sys_Microseconds();
+		SV_RunIslandPhysics();
+		SV_PerfAdd(SVPERF_PHYSICS, t);
 	}
+
+	t = Sys_Microseconds();
 	SV_EndWorldFrame();
+	SV_PerfAdd(SVPERF_ENDFRAME, t);
 }
 
 
@@ -227,6 +257,20 @@ typedef struct areanode_s
 areanode_t	sv_areanodes[AREA_NODES];
 int			sv_numareanodes;
 
+// sv_broadphase 1 keeps entities in dynamic trees instead, one for each area type
+static sv_aabbtree_t	*sv_areatrees[3];
+static int				sv_areatreeIds[MAX_GENTITIES];
+
+// entities are also kept in lists of PVS clusters they touch so client frames
+// only check entities in visible clusters, every entity has MAX_ENT_CLUSTERS
+// list nodes numbered entnum * MAX_ENT_CLUSTERS + slot
+static int		*sv_clusterEntities;	// [sv_numClusterLists] first node in cluster, -1 if empty
+static int		sv_numClusterLists;
+static int		sv_clusterNodeNext[MAX_GENTITIES * MAX_ENT_CLUSTERS];
+static int		sv_clusterNodePrev[MAX_GENTITIES * MAX_ENT_CLUSTERS];
+static int		sv_clusterNodeCluster[MAX_GENTITIES * MAX_ENT_CLUSTERS];
+static byte		sv_entityNumClusterNodes[MAX_GENTITIES];
+
 float	*area_mins, *area_maxs;
 gentity_t	**area_list;
 int		area_count, area_maxcount;
@@ -308,9 +352,35 @@ SV_ClearWorld
 */
 void SV_ClearWorld (void)
 {
+	int i;
+
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
 	SV_CreateAreaNode (0, sv.models[MODELINDEX_WORLD].bmodel->mins, sv.models[MODELINDEX_WORLD].bmodel->maxs);
+
+	for (i = 0; i < 3; i++)
+	{
+		SV_AABBTree_Free(sv_areatrees[i]);
+		sv_areatrees[i] = NULL;
+		if (sv_broadphase->value)
+			sv_areatrees[i] = SV_AABBTree_Create();
+	}
+
+	if (sv_clusterEntities)
+		Z_Free(sv_clusterEntities);
+	sv_numClusterLists = CM_NumClusters();
+	sv_clusterEntities = Z_Malloc((sv_numClusterLists + 1) * sizeof(int));
+	memset(sv_clusterEntities, 0xff, (sv_numClusterLists + 1) * sizeof(int));
+	memset(sv_entityNumClusterNodes, 0, sizeof(sv_entityNumClusterNodes));
+}
+
+static int SV_AreaTypeForEntity(gentity_t* ent)
+{
+	if (ent->v.solid == SOLID_TRIGGER)
+		return AREA_TRIGGERS;
+	else if (ent->v.solid == SOLID_PATHNODE)
+		return AREA_PATHNODES;
+	return AREA_SOLID;
 }
 
 
@@ -322,8 +392,19 @@ SV_UnlinkEdict
 */
 void SV_UnlinkEdict (gentity_t *ent)
 {
+	int i;
+
 	if (!ent->area.prev)
 		return;		// not linked in anywhere
+
+	if (sv_areatrees[0])
+	{
+		for (i = 0; i < 3; i++)
+			SV_AABBTree_Unlink(sv_areatrees[i], NUM_FOR_EDICT(ent));
+		ent->area.prev = ent->area.next = NULL;
+		return;
+	}
+
 	RemoveLink (&ent->area);
 	ent->area.prev = ent->area.next = NULL;
 }
@@ -353,6 +434,121 @@ static int SV_PackSolid32(gentity_t* ent)
 	return packedsolid;
 }
 
+/*
+===============
+SV_LinkToAreaNode
+
+Links entity to the first area node its box crosses
+===============
+*/
+static void SV_LinkToAreaNode(gentity_t* ent)
+{
+	areanode_t	*node;
+
+	node = sv_areanodes;
+	while (1)
+	{
+		if (node->axis == -1)
+			break;
+		if (ent->v.absmin[node->axis] > node->dist)
+			node = node->children[0];
+		else if (ent->v.absmax[node->axis] < node->dist)
+			node = node->children[1];
+		else
+			break;		// crosses the node
+	}
+	
+	// link it in	
+	if (ent->v.solid == SOLID_TRIGGER)
+		InsertLinkBefore (&ent->area, &node->trigger_edicts);
+	else if (ent->v.solid == SOLID_PATHNODE)
+		InsertLinkBefore(&ent->area, &node->pathnode_edicts);
+	else
+		InsertLinkBefore (&ent->area, &node->solid_edicts);
+}
+
+/*
+===============
+SV_LinkToClusters
+
+Moves entity to the cluster lists of its clusternums, entities
+marked by headnode are not in any list
+===============
+*/
+static void SV_LinkToClusters(gentity_t* ent)
+{
+	int		entnum, first, node, count, i;
+
+	entnum = NUM_FOR_EDICT(ent);
+	first = entnum * MAX_ENT_CLUSTERS;
+	count = ent->num_clusters > 0 ? ent->num_clusters : 0;
+
+	// most entities stay in the same clusters
+	if (count == sv_entityNumClusterNodes[entnum])
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (sv_clusterNodeCluster[first + i] != ent->clusternums[i])
+				break;
+		}
+		if (i == count)
+			return;
+	}
+
+	for (i = 0; i < sv_entityNumClusterNodes[entnum]; i++)
+	{
+		node = first + i;
+		if (sv_clusterNodePrev[node] == -1)
+			sv_clusterEntities[sv_clusterNodeCluster[node]] = sv_clusterNodeNext[node];
+		else
+			sv_clusterNodeNext[sv_clusterNodePrev[node]] = sv_clusterNodeNext[node];
+		if (sv_clusterNodeNext[node] != -1)
+			sv_clusterNodePrev[sv_clusterNodeNext[node]] = sv_clusterNodePrev[node];
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		node = first + i;
+		sv_clusterNodeCluster[node] = ent->clusternums[i];
+		sv_clusterNodePrev[node] = -1;
+		sv_clusterNodeNext[node] = sv_clusterEntities[ent->clusternums[i]];
+		if (sv_clusterNodeNext[node] != -1)
+			sv_clusterNodePrev[sv_clusterNodeNext[node]] = node;
+		sv_clusterEntities[ent->clusternums[i]] = node;
+	}
+	sv_entityNumClusterNodes[entnum] = count;
+}
+
+/*
+===============
+SV_ClusterEntityBits
+
+Sets bits of entities linked to clusters which are set in pvs,
+safe to call from job threads
+===============
+*/
+void SV_ClusterEntityBits(byte* pvs, unsigned int* bits)
+{
+	int		cluster, node, e;
+
+	for (cluster = 0; cluster < sv_numClusterLists; cluster++)
+	{
+		if (!pvs[cluster >> 3])
+		{
+			cluster |= 7;	// skip whole byte
+			continue;
+		}
+		if (!(pvs[cluster >> 3] & (1 << (cluster & 7))))
+			continue;
+
+		for (node = sv_clusterEntities[cluster]; node != -1; node = sv_clusterNodeNext[node])
+		{
+			e = node / MAX_ENT_CLUSTERS;
+			bits[e >> 5] |= 1u << (e & 31);
+		}
+	}
+}
+
 /*
 ===============
 SV_LinkEdict
@@ -362,7 +558,6 @@ SV_LinkEdict
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEdict (gentity_t *ent)
 {
-	areanode_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			clusters[MAX_TOTAL_ENT_LEAFS];
 	int			num_leafs;
@@ -370,14 +565,18 @@ void SV_LinkEdict (gentity_t *ent)
 	int			area;
 	int			topnode;
 
-	if (ent->area.prev)
+	// area trees move the entity in place
+	if (ent->area.prev && !sv_areatrees[0])
 		SV_UnlinkEdict (ent);	// unlink from old position
 		
 	if (ent == sv.edicts)
 		return;		// don't add the world
 
 	if (!ent->inuse)
+	{
+		SV_UnlinkEdict(ent);
 		return;
+	}
 
 	// set the size
 	VectorSubtract (ent->v.maxs, ent->v.mins, ent->v.size);
@@ -451,6 +650,8 @@ void SV_LinkEdict (gentity_t *ent)
 	if (!num_leafs) 
 	{
 		Com_DPrintf(DP_SV, "%s: entity %i is outside the world at %i %i %i\n", __FUNCTION__, NUM_FOR_ENT(ent), (int)ent->v.origin[0], (int)ent->v.origin[1], (int)ent->v.origin[2]);
+		SV_LinkToClusters(ent);
+		SV_UnlinkEdict(ent);
 		return;
 	}
 
@@ -502,6 +703,8 @@ void SV_LinkEdict (gentity_t *ent)
 		}
 	}
 
+	SV_LinkToClusters(ent);
+
 	// if first time, make sure old_origin is valid
 	if (!ent->v.linkcount)
 	{
@@ -510,30 +713,26 @@ void SV_LinkEdict (gentity_t *ent)
 	ent->v.linkcount++;
 
 	if (ent->v.solid == SOLID_NOT)
+	{
+		SV_UnlinkEdict(ent);
 		return;
+	}
 
-// find the first node that the ent's box crosses
-	node = sv_areanodes;
-	while (1)
+	if (sv_areatrees[0])
 	{
-		if (node->axis == -1)
-			break;
-		if (ent->v.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if (ent->v.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+		area = SV_AreaTypeForEntity(ent);
+		for (i = 0; i < 3; i++)
+		{
+			if (i == area - 1)
+				SV_AABBTree_Link(sv_areatrees[i], NUM_FOR_EDICT(ent), ent->v.absmin, ent->v.absmax);
+			else if (ent->area.prev)
+				SV_AABBTree_Unlink(sv_areatrees[i], NUM_FOR_EDICT(ent)); // solid type changed
+		}
+		ent->area.prev = ent->area.next = &ent->area; // mark as linked
+		return;
 	}
-	
-	// link it in	
-	if (ent->v.solid == SOLID_TRIGGER)
-		InsertLinkBefore (&ent->area, &node->trigger_edicts);
-	else if (ent->v.solid == SOLID_PATHNODE)
-		InsertLinkBefore(&ent->area, &node->pathnode_edicts);
-	else
-		InsertLinkBefore (&ent->area, &node->solid_edicts);
 
+	SV_LinkToAreaNode(ent);
 }
 
 
@@ -608,8 +807,56 @@ SV_AreaEntities
 Returns the **list of entities within mins/maxs og a given type
 ================
 */
+/*
+================
+SV_AreaTreeEntities
+
+Gathers entities from area tree, ids are turned into entities of given size starting at base
+================
+*/
+static int SV_AreaTreeEntities(sv_aabbtree_t* tree, byte* base, int size, vec3_t mins, vec3_t maxs, gentity_t** list, int maxcount)
+{
+	gentity_t	*check;
+	int			i, num, count;
+
+	count = 0;
+	num = SV_AABBTree_Query(tree, mins, maxs, sv_areatreeIds, MAX_GENTITIES);
+	for (i = 0; i < num; i++)
+	{
+		check = (gentity_t*)(base + size * sv_areatreeIds[i]);
+
+		if (check->v.solid == SOLID_NOT)
+			continue;		// deactivated
+		if (check->v.absmin[0] > maxs[0]
+		|| check->v.absmin[1] > maxs[1]
+		|| check->v.absmin[2] > maxs[2]
+		|| check->v.absmax[0] < mins[0]
+		|| check->v.absmax[1] < mins[1]
+		|| check->v.absmax[2] < mins[2])
+			continue;		// not touching
+
+		if (count == maxcount)
+		{
+			Com_Printf ("SV_AreaEntities: hit MAXCOUNT (%i)\n", maxcount);
+			break;
+		}
+		list[count++] = check;
+	}
+	return count;
+}
+
 int SV_AreaEntities (vec3_t mins, vec3_t maxs, gentity_t **list, int maxcount, int areatype)
 {
+	if (sv_areatrees[0])
+	{
+		if (areatype < AREA_SOLID || areatype > AREA_PATHNODES)
+		{
+			Com_Error(ERR_DROP, "%s: unknown area_type %i\n", __FUNCTION__, areatype);
+			return 0;
+		}
+		return SV_AreaTreeEntities(sv_areatrees[areatype - 1], (byte*)sv.edicts, sv.entity_size, mins, maxs, list, maxcount);
+	}
+
 	area_mins = mins;
 	area_maxs = maxs;
 	area_list = list;
@@ -622,6 +869,122 @@ int SV_AreaEntities (vec3_t mins, vec3_t maxs, gentity_t **list, int maxcount, i
 	return area_count;
 }
 
+/*
+================
+SV_BroadphaseBench_f
+
+sv_broadphase_bench [entities] [queries]
+Times SV_AreaEntities with area nodes and area tree on a synthetic scene
+================
+*/
+void SV_BroadphaseBench_f(void)
+{
+	static areanode_t	savedNodes[AREA_NODES];
+	int					savedNumNodes;
+	sv_aabbtree_t		*tree;
+	gentity_t			*ents, *ent, **list;
+	vec3_t				worldMins, worldMaxs, mins, maxs;
+	unsigned long long	start;
+	unsigned int		usec[4];
+	int					numEnts, numQueries, i, j, hits[2];
+
+	numEnts = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 2000;
+	numQueries = (Cmd_Argc() > 2) ? atoi(Cmd_Argv(2)) : 10000;
+	if (numEnts <= 0 || numEnts > MAX_GENTITIES || numQueries <= 0)
+	{
+		Com_Printf("usage: sv_broadphase_bench [entities 1-%i] [queries]\n", MAX_GENTITIES);
+		return;
+	}
+
+	ents = Z_Malloc(numEnts * sizeof(gentity_t));
+	list = Z_Malloc(MAX_GENTITIES * sizeof(gentity_t*));
+
+	// world area nodes may be in use by running server
+	memcpy(savedNodes, sv_areanodes, sizeof(sv_areanodes));
+	savedNumNodes = sv_numareanodes;
+
+	VectorSet(worldMins, -4096, -4096, -1024);
+	VectorSet(worldMaxs, 4096, 4096, 1024);
+	memset(sv_areanodes, 0, sizeof(sv_areanodes));
+	sv_numareanodes = 0;
+	SV_CreateAreaNode(0, worldMins, worldMaxs);
+
+	// monster sized boxes, a few large ones like brush models
+	srand(1337);
+	for (i = 0; i < numEnts; i++)
+	{
+		ent = &ents[i];
+		ent->v.solid = SOLID_BBOX;
+		for (j = 0; j < 3; j++)
+		{
+			ent->v.origin[j] = worldMins[j] + (rand() % (int)(worldMaxs[j] - worldMins[j]));
+			ent->v.mins[j] = (i % 50) ? -16 : -256;
+			ent->v.maxs[j] = (i % 50) ? 16 : 256;
+		}
+		VectorAdd(ent->v.origin, ent->v.mins, ent->v.absmin);
+		VectorAdd(ent->v.origin, ent->v.maxs, ent->v.absmax);
+	}
+
+	tree = SV_AABBTree_Create();
+
+	start = Sys_Microseconds();
+	for (i = 0; i < numEnts; i++)
+		SV_LinkToAreaNode(&ents[i]);
+	usec[0] = (unsigned int)(Sys_Microseconds() - start);
+
+	start = Sys_Microseconds();
+	for (i = 0; i < numEnts; i++)
+		SV_AABBTree_Link(tree, i, ents[i].v.absmin, ents[i].v.absmax);
+	usec[1] = (unsigned int)(Sys_Microseconds() - start);
+
+	// trace sized queries, same set for both
+	hits[0] = hits[1] = 0;
+	for (j = 0; j < 2; j++)
+	{
+		srand(7331);
+		start = Sys_Microseconds();
+		for (i = 0; i < numQueries; i++)
+		{
+			mins[0] = worldMins[0] + (rand() % 8192);
+			mins[1] = worldMins[1] + (rand() % 8192);
+			mins[2] = worldMins[2] + (rand() % 2048);
+			VectorSet(maxs, mins[0] + 16 + (rand() % 512), mins[1] + 16 + (rand() % 512), mins[2] + 16 + (rand() % 128));
+
+			if (j == 0)
+			{
+				area_mins = mins;
+				area_maxs = maxs;
+				area_list = list;
+				area_count = 0;
+				area_maxcount = MAX_GENTITIES;
+				area_type = AREA_SOLID;
+				SV_AreaEdicts_r(sv_areanodes);
+				hits[0] += area_count;
+			}
+			else
+			{
+				hits[1] += SV_AreaTreeEntities(tree, (byte*)ents, sizeof(gentity_t), mins, maxs, list, MAX_GENTITIES);
+			}
+		}
+		usec[2 + j] = (unsigned int)(Sys_Microseconds() - start);
+	}
+
+	Com_Printf("%i entities, %i queries, tree height %i:\n", numEnts, numQueries, SV_AABBTree_Height(tree));
+	Com_Printf("%-10s %10s %10s %12s %10s\n", "broadphase", "link ms", "query ms", "us/query", "hits");
+	Com_Printf("%-10s %10.3f %10.3f %12.3f %10i\n", "areanodes", usec[0] / 1000.0, usec[2] / 1000.0, (float)usec[2] / numQueries, hits[0]);
+	Com_Printf("%-10s %10.3f %10.3f %12.3f %10i\n", "tree", usec[1] / 1000.0, usec[3] / 1000.0, (float)usec[3] / numQueries, hits[1]);
+	if (hits[0] != hits[1])
+		Com_Printf("WARNING: broadphases returned different number of entities.\n");
+
+	SV_AABBTree_Free(tree);
+
+	memcpy(sv_areanodes, savedNodes, sizeof(sv_areanodes));
+	sv_numareanodes = savedNumNodes;
+
+	Z_Free(list);
+	Z_Free(ents);
+}
+
 
 //===========================================================================
 
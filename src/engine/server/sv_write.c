@@ -19,6 +19,189 @@ Encode a client frame onto the network channel
 =============================================================================
 */
 
+/*
+	Clients which see the same entity state and delta from the same old state
+	get the same bytes, so each job thread keeps encoded entity deltas of
+	current send pass keyed by entity number and the pass its old state was
+	copied in. States changed for a single client are never cached.
+*/
+
+static int		svFrameStamp;	// bumped by SV_BeginClientFrames every send pass
+
+#define DELTACACHE_WAYS			4			// entries for different old frames of one entity
+#define DELTACACHE_DATA			0x40000		// bytes of encoded deltas per frame
+#define DELTACACHE_BASELINE		-2			// delta from sv.baselines
+
+#define SV_ENTITYBITS_SIZE		256			// bit packed entity delta is never longer than this
+
+typedef struct
+{
+	int			stamp;		// send pass entry was stored in
+	int			fromstamp;	// send pass of old state or DELTACACHE_BASELINE
+	qboolean	bitpacked;	// length is in bits and entity number is not included
+	int			offset, length;
+} svdeltaentry_t;
+
+typedef struct
+{
+	svdeltaentry_t	entries[MAX_GENTITIES][DELTACACHE_WAYS];
+	byte			data[DELTACACHE_DATA];
+	int				stamp, used;
+	int				hits, misses;
+} svdeltacache_t;
+
+static svdeltacache_t	*svDeltaCaches[JOB_MAX_THREADS];
+
+/*
+=============
+SV_DeltaCacheForThread
+
+Returns delta cache for job thread or NULL if disabled,
+allocates caches so must be called from main thread first.
+=============
+*/
+static svdeltacache_t* SV_DeltaCacheForThread(int thread)
+{
+	if (!sv_deltacache->value)
+		return NULL;
+	if (!svDeltaCaches[thread])
+		svDeltaCaches[thread] = Z_Malloc(sizeof(svdeltacache_t));
+	return svDeltaCaches[thread];
+}
+
+/*
+=============
+SV_WriteEntityBits
+
+Writes bit packed entity number followed by its delta body, nothing if body is empty
+=============
+*/
+static void SV_WriteEntityBits(sizebuf_t *msg, int number, int *lastnum, byte *body, int bodybits)
+{
+	if (!bodybits)
+		return;
+
+	MSG_WriteEntityNumBits (msg, number, *lastnum, false);
+	MSG_WriteBitData (msg, body, bodybits);
+	*lastnum = number;
+}
+
+/*
+=============
+SV_WriteCachedDeltaEntity
+
+MSG_WriteDeltaEntity which reuses bytes encoded earlier in this send pass,
+fromstamp and tostamp are svs.client_entity_stamps of the states.
+When lastnum is given the entity is written bit packed and lastnum
+is advanced if anything was sent.
+=============
+*/
+static void SV_WriteCachedDeltaEntity(svdeltacache_t *cache, entity_state_t *from, int fromstamp, entity_state_t *to, int tostamp, sizebuf_t *msg, qboolean force, qboolean newentity, int *lastnum)
+{
+	svdeltaentry_t	*entry, *store;
+	sizebuf_t		bodybuf;
+	byte			body[SV_ENTITYBITS_SIZE];
+	byte			*data;
+	int				i, start, length, size;
+	qboolean		bitpacked;
+
+	bitpacked = (lastnum != NULL);
+	store = NULL;
+
+	if (!cache || fromstamp == -1 || tostamp != svFrameStamp)
+		cache = NULL; // state is not shared with other clients
+	else
+	{
+		if (cache->stamp != svFrameStamp)
+		{
+			cache->stamp = svFrameStamp;
+			cache->used = 0;
+		}
+
+		for (i = 0; i < DELTACACHE_WAYS; i++)
+		{
+			entry = &cache->entries[to->number][i];
+			if (entry->stamp != svFrameStamp)
+			{
+				if (!store)
+					store = entry;
+				continue;
+			}
+
+			if (entry->fromstamp == fromstamp && entry->bitpacked == bitpacked)
+			{
+				if (bitpacked)
+					SV_WriteEntityBits (msg, to->number, lastnum, cache->data + entry->offset, entry->length);
+				else
+					SZ_Write (msg, cache->data + entry->offset, entry->length);
+				cache->hits++;
+				return;
+			}
+		}
+		cache->misses++;
+	}
+
+	if (bitpacked)
+	{
+		SZ_Init (&bodybuf, body, sizeof(body));
+		MSG_BeginWritingBits (&bodybuf);
+		MSG_WriteDeltaEntityBits (&bodybuf, from, to, force, newentity);
+
+		data = body;
+		length = bodybuf.bit;
+		size = bodybuf.cursize;
+		SV_WriteEntityBits (msg, to->number, lastnum, body, length);
+	}
+	else
+	{
+		start = msg->cursize;
+		MSG_WriteDeltaEntity (from, to, msg, force, newentity);
+
+		data = msg->data + start;
+		length = size = msg->cursize - start;
+	}
+
+	if (!cache || !store || msg->overflowed || size < 0 || cache->used + size > DELTACACHE_DATA)
+		return;
+
+	store->stamp = svFrameStamp;
+	store->fromstamp = fromstamp;
+	store->bitpacked = bitpacked;
+	store->offset = cache->used;
+	store->length = length;
+	memcpy (cache->data + cache->used, data, size);
+	cache->used += size;
+}
+
+/*
+=============
+SV_DeltaCacheStats_f
+
+Prints how many entity deltas were reused
+=============
+*/
+void SV_DeltaCacheStats_f(void)
+{
+	svdeltacache_t	*cache;
+	int				i, hits, misses;
+
+	hits = misses = 0;
+	for (i = 0; i < JOB_MAX_THREADS; i++)
+	{
+		cache = svDeltaCaches[i];
+		if (!cache)
+			continue;
+		hits += cache->hits;
+		misses += cache->misses;
+		cache->hits = cache->misses = 0;
+	}
+
+	Com_Printf("Delta cache: %i reused, %i encoded", hits, misses);
+	if (hits + misses)
+		Com_Printf(" (%.1f%% reused)", 100.0f * hits / (hits + misses));
+	Com_Printf("\n");
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -26,15 +209,21 @@ SV_EmitPacketEntities
 Writes a delta update of an entity_state_t list to the message.
 =============
 */
-void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
+void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t *msg, int thread, qboolean bitpacked)
 {
+	svdeltacache_t	*cache = SV_DeltaCacheForThread(thread);
 	entity_state_t	*oldent = NULL, *newent = NULL;
 	int		oldindex, newindex;
+	int		oldslot = 0, newslot = 0;
 	int		oldnum, newnum;
 	int		from_num_entities;
 	int		bits;
+	int		lastnum = 0;
+	int		*bitnum = bitpacked ? &lastnum : NULL;
 
 	MSG_WriteByte (msg, SVC_PACKET_ENTITIES);
+	if (bitpacked)
+		MSG_BeginWritingBits (msg);
 
 	if (!from)
 		from_num_entities = 0;
@@ -49,7 +238,8 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 			newnum = 9999;
 		else
 		{
-			newent = &svs.client_entities[(to->first_entity+newindex)%svs.num_client_entities];
+			newslot = (to->first_entity+newindex)%svs.num_client_entities;
+			newent = &svs.client_entities[newslot];
 			newnum = newent->number;
 		}
 
@@ -57,7 +247,8 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 			oldnum = 9999;
 		else
 		{
-			oldent = &svs.client_entities[(from->first_entity+oldindex)%svs.num_client_entities];
+			oldslot = (from->first_entity+oldindex)%svs.num_client_entities;
+			oldent = &svs.client_entities[oldslot];
 			oldnum = oldent->number;
 		}
 
@@ -67,7 +258,7 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping
-			MSG_WriteDeltaEntity (oldent, newent, msg, false, newent->number <= sv_maxclients->value);
+			SV_WriteCachedDeltaEntity (cache, oldent, svs.client_entity_stamps[oldslot], newent, svs.client_entity_stamps[newslot], msg, false, newent->number <= sv_maxclients->value, bitnum);
 			oldindex++;
 			newindex++;
 			continue;
@@ -75,13 +266,21 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 
 		if (newnum < oldnum)
 		{	// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (&sv.baselines[newnum], newent, msg, true, true);
+			SV_WriteCachedDeltaEntity (cache, &sv.baselines[newnum], DELTACACHE_BASELINE, newent, svs.client_entity_stamps[newslot], msg, true, true, bitnum);
 			newindex++;
 			continue;
 		}
 
 		if (newnum > oldnum)
 		{	// the old entity isn't present in the new message
+			if (bitpacked)
+			{
+				MSG_WriteEntityNumBits (msg, oldnum, lastnum, true);
+				lastnum = oldnum;
+				oldindex++;
+				continue;
+			}
+
 			bits = U_REMOVE;
 			if (oldnum >= 256)
 				bits |= U_NUMBER_16 | U_MOREBITS_1;
@@ -100,7 +299,10 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 		}
 	}
 
-	MSG_WriteShort (msg, 0);	// end of packetentities
+	if (bitpacked)
+		MSG_WriteBits (msg, 0, 1);	// end of packetentities
+	else
+		MSG_WriteShort (msg, 0);	// end of packetentities
 }
 
 
@@ -111,7 +313,7 @@ SV_WritePlayerstateToClient
 
 =============
 */
-void SV_WritePlayerstateToClient (client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
+void SV_WritePlayerstateToClient (client_frame_t *from, client_frame_t *to, sizebuf_t *msg, qboolean bitpacked)
 {
 	int				i;
 	int				pflags;
@@ -129,6 +331,14 @@ void SV_WritePlayerstateToClient (client_frame_t *from, client_frame_t *to, size
 	else
 		ops = &from->ps;
 
+	if (bitpacked)
+	{
+		MSG_WriteByte (msg, SVC_PLAYERINFO);
+		MSG_BeginWritingBits (msg);
+		MSG_WriteDeltaPlayerstateBits (msg, ops, ps);
+		return;
+	}
+
 	//
 	// determine what needs to be sent
 	//
@@ -387,7 +597,7 @@ void SV_WritePlayerstateToClient (client_frame_t *from, client_frame_t *to, size
 SV_WriteFrameToClient
 ==================
 */
-void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg)
+void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg, int thread)
 {
 	client_frame_t		*frame, *oldframe;
 	int					lastframe;
@@ -425,10 +635,10 @@ void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg)
 	SZ_Write (msg, frame->areabits, frame->areabytes);
 
 	// delta encode the playerstate
-	SV_WritePlayerstateToClient (oldframe, frame, msg);
+	SV_WritePlayerstateToClient (oldframe, frame, msg, client->protocol == PROTOCOL_VERSION_BITS);
 
 	// delta encode the entities
-	SV_EmitPacketEntities (oldframe, frame, msg);
+	SV_EmitPacketEntities (oldframe, frame, msg, thread, client->protocol == PROTOCOL_VERSION_BITS);
 }
 
 
@@ -442,19 +652,20 @@ Build a client frame structure
 
 byte		fatpvs[(MAX_MAP_LEAFS_QBSP*2) / 8];	// this needs to be double the leafs / 8 to accomodate bigger pvs
 //byte		fatpvs[65536 / 8];	// 32767 is MAX_MAP_LEAFS, braxi -- commented out because of new bsp format
+
 /*
 ============
-SV_FatPVS
+SV_FatPVSToBuffer
 
-The client will interpolate the view position, so we can't use a single PVS point
+Writes fat PVS to out, when row is given rows are decompressed into it
+instead of using shared PVS cache so job threads can call this
 ===========
 */
-void SV_FatPVS (vec3_t org)
+static void SV_FatPVSToBuffer (vec3_t org, byte *out, byte *row)
 {
 	int		leafs[64];
 	int		i, j, count;
-	int		longs;
-	byte	*src;
+	int		bytes;
 	vec3_t	mins, maxs;
 
 	for (i=0 ; i<3 ; i++)
@@ -466,13 +677,17 @@ void SV_FatPVS (vec3_t org)
 	count = CM_BoxLeafnums (mins, maxs, leafs, 64, NULL);
 	if (count < 1)
 		Com_Error (ERR_FATAL, "SV_FatPVS: count < 1");
-	longs = (CM_NumClusters()+31)>>5;
+	bytes = CM_ClusterBytes();
 
 	// convert leafs to clusters
 	for (i=0 ; i<count ; i++)
 		leafs[i] = CM_LeafCluster(leafs[i]);
 
-	memcpy (fatpvs, CM_ClusterPVS(leafs[0]), longs<<2);
+	if (row)
+		CM_DecompressClusterPVS (leafs[0], out);
+	else
+		memcpy (out, CM_ClusterPVS(leafs[0]), bytes);
+
 	// or in all the other leaf bits
 	for (i=1 ; i<count ; i++)
 	{
@@ -481,10 +696,154 @@ void SV_FatPVS (vec3_t org)
 				break;
 		if (j != i)
 			continue;		// already have the cluster we want
-		src = CM_ClusterPVS(leafs[i]);
-		for (j=0 ; j<longs ; j++)
-			((long *)fatpvs)[j] |= ((long *)src)[j];
+
+		if (row)
+		{
+			CM_DecompressClusterPVS (leafs[i], row);
+			CM_OrVisRows (out, row, bytes);
+		}
+		else
+			CM_OrVisRows (out, CM_ClusterPVS(leafs[i]), bytes);
+	}
+}
+
+/*
+============
+SV_FatPVS
+
+The client will interpolate the view position, so we can't use a single PVS point
+===========
+*/
+void SV_FatPVS (vec3_t org)
+{
+	SV_FatPVSToBuffer (org, fatpvs, NULL);
+}
+
+
+/*
+=============
+SV_EntityHiddenFromClient
+
+Checks which don't depend on client's position
+=============
+*/
+static qboolean SV_EntityHiddenFromClient(gentity_t* ent, gentity_t* clent)
+{
+	if (!ent->inuse)
+		return true; // ignore free entities
+	if (((int)ent->v.svflags & SVF_NOCLIENT))
+		return true; // SVF_NOCLIENT entities are never sent to anyone
+	if (((int)ent->v.svflags & SVF_SINGLECLIENT) && ent->v.showto != NUM_FOR_ENT(clent)) // to avoid -1 offset, just set showto = getentnum(self)
+		return true; // send entity only to _THAT ONE_ client	
+	if (((int)ent->v.svflags & SVF_ONLYTEAM) && ent->v.showto == clent->v.team)
+		return true; // send entity only to clients which are matching .team field
+	return false;
+}
+
+/*
+=============
+SV_EntityCulledForClient
+
+Area, PVS and PHS checks, safe to call from job threads
+=============
+*/
+static qboolean SV_EntityCulledForClient(gentity_t* ent, gentity_t* clent, vec3_t org, int clientarea, byte* pvs, byte* phs)
+{
+	byte	*bitvector;
+	int		i, l;
+
+	// always send ourselves (the player entity), but ignore others if not touching a PV leaf
+	// if entity has SVF_NOCULL flag it will be _always_ sent regardless of PVS/PHS
+	if (ent == clent || ((int)ent->v.svflags & SVF_NOCULL))
+		return false;
+
+	// check area
+	if (!CM_AreasConnected(clientarea, ent->areanum))
+	{	// doors can legally straddle two areas, so we may need to check another one
+		if (!ent->areanum2 || !CM_AreasConnected(clientarea, ent->areanum2))
+			return true;		// blocked by a door
+	}
+
+	// beams just check one point for PHS
+	if (ent->s.renderFlags & RF_BEAM)
+	{
+		l = ent->clusternums[0];
+		if (!(phs[l >> 3] & (1 << (l & 7))))
+			return true;
+		return false;
+	}
+
+	// FIXME: if an ent has a model and a sound, but isn't
+	// in the PVS, only the PHS, clear the model
+	if (ent->s.loopingSound)
+	{
+		bitvector = pvs;	//phs;
+	}
+	else
+		bitvector = pvs;
+
+	if (ent->num_clusters == -1)
+	{	// too many leafs for individual check, go by headnode
+		if (!CM_HeadnodeVisible(ent->headnode, bitvector))
+			return true;		// blocked by a door
+	}
+	else
+	{	// check individual leafs
+		for (i = 0; i < ent->num_clusters; i++)
+		{
+			l = ent->clusternums[i];
+			if (bitvector[l >> 3] & (1 << (l & 7)))
+				break;
+		}
+		if (i == ent->num_clusters)
+			return true;		// blocked by a door
+	}
+
+	if (ent->s.modelindex == 0)
+	{	// don't send sounds if they will be attenuated away
+		vec3_t	delta;
+		float	len;
+
+		VectorSubtract(org, ent->v.origin, delta);
+		len = VectorLength(delta);
+		if (len > 400)
+			return true;
+	}
+	return false;
+}
+
+
+static unsigned int	svFrameAlwaysBits[MAX_GENTITIES / 32];	// entities not culled by cluster lists, set by SV_BeginClientFrames
+
+/*
+=============
+SV_ClientFrameEntities
+
+Lists entities which may be visible to client in ascending order, those
+linked to clusters set in pvs and the ones which are always checked.
+Safe to call from job threads.
+=============
+*/
+static int SV_ClientFrameEntities(gentity_t* clent, byte* pvs, unsigned int* bits, unsigned short* list)
+{
+	unsigned int	word;
+	int				i, e, count;
+
+	memcpy (bits, svFrameAlwaysBits, sizeof(svFrameAlwaysBits));
+	e = NUM_FOR_EDICT(clent);
+	bits[e >> 5] |= 1u << (e & 31);	// always send ourselves
+	SV_ClusterEntityBits (pvs, bits);
+
+	count = 0;
+	for (i = 0; i < MAX_GENTITIES / 32; i++)
+	{
+		for (word = bits[i], e = i * 32; word; word >>= 1, e++)
+		{
+			if ((word & 1) && e > 0 && e < sv.max_edicts)
+				list[count++] = e;
+		}
 	}
+	return count;
 }
 
 
@@ -511,18 +870,17 @@ void SV_RestoreEntityStateAfterClient(gentity_t* ent)
 
 void SV_BuildClientFrame (client_t *client)
 {
-	int		e, i;
+	static unsigned int		bits[MAX_GENTITIES / 32];
+	static unsigned short	list[MAX_GENTITIES];
+	int		e, i, j, count;
 	vec3_t	org;
 	gentity_t	*ent;
 	gentity_t	*clent;
 	client_frame_t	*frame;
 	entity_state_t	*state;
-	int		l;
 	int		clientarea, clientcluster;
 	int		leafnum;
-	int		c_fullsend;
 	byte	*clientphs;
-	byte	*bitvector;
 
 	clent = client->edict;
 	if (!clent->client)
@@ -554,26 +912,20 @@ void SV_BuildClientFrame (client_t *client)
 	frame->num_entities = 0;
 	frame->first_entity = svs.next_client_entities;
 
-	c_fullsend = 0;
-	
 	Scr_BindVM(VM_SVGAME);
 
-	// ignore entity 0 which is world and begin from entity 1 which may be a player...
-	for (e = 1; e < sv.max_edicts; e++)
+	// only entities in visible clusters, world is never listed
+	count = SV_ClientFrameEntities(clent, fatpvs, bits, list);
+	for (j = 0; j < count; j++)
 	{
+		e = list[j];
 		ent = EDICT_NUM(e);
 
 		//
 		// ignore entities that are hidden to players or don't want to be broadcasted at all
 		//
-		if (!ent->inuse)
-			continue; // ignore free entities
-		if (((int)ent->v.svflags & SVF_NOCLIENT))
-			continue; // SVF_NOCLIENT entities are never sent to anyone
-		if (((int)ent->v.svflags & SVF_SINGLECLIENT) && ent->v.showto != NUM_FOR_ENT(clent)) // to avoid -1 offset, just set showto = getentnum(self)
-			continue; // send entity only to _THAT ONE_ client	
-		if (((int)ent->v.svflags & SVF_ONLYTEAM) && ent->v.showto == clent->v.team)
-			continue; // send entity only to clients which are matching .team field
+		if (SV_EntityHiddenFromClient(ent, clent))
+			continue;
 
 		//
 		// if entity has its EntityStateForClient callback run it and send
@@ -623,82 +975,10 @@ void SV_BuildClientFrame (client_t *client)
 			continue;
 		}		
 
-		// always send ourselves (the player entity), but ignore others if not touching a PV leaf
-		// if entity has SVF_NOCULL flag it will be _always_ sent regardless of PVS/PHS
-		if (ent != clent)
+		if (SV_EntityCulledForClient(ent, clent, org, clientarea, fatpvs, clientphs))
 		{
-			if (!((int)ent->v.svflags & SVF_NOCULL))
-			{
-				// check area
-				if (!CM_AreasConnected(clientarea, ent->areanum))
-				{	// doors can legally straddle two areas, so we may need to check another one
-					if (!ent->areanum2 || !CM_AreasConnected(clientarea, ent->areanum2))
-					{
-						SV_RestoreEntityStateAfterClient(ent);
-						continue;		// blocked by a door
-					}			
-				}
-
-				// beams just check one point for PHS
-				if (ent->s.renderFlags & RF_BEAM)
-				{
-					l = ent->clusternums[0];
-					if (!(clientphs[l >> 3] & (1 << (l & 7))))
-					{
-						SV_RestoreEntityStateAfterClient(ent);
-						continue;
-					}
-				}
-				else
-				{
-					// FIXME: if an ent has a model and a sound, but isn't
-					// in the PVS, only the PHS, clear the model
-					if (ent->s.loopingSound)
-					{
-						bitvector = fatpvs;	//clientphs;
-					}
-					else
-						bitvector = fatpvs;
-
-					if (ent->num_clusters == -1)
-					{	// too many leafs for individual check, go by headnode
-						if (!CM_HeadnodeVisible(ent->headnode, bitvector))
-						{
-							SV_RestoreEntityStateAfterClient(ent);
-							continue;		// blocked by a door
-						}
-						c_fullsend++;
-					}
-					else
-					{	// check individual leafs
-						for (i = 0; i < ent->num_clusters; i++)
-						{
-							l = ent->clusternums[i];
-							if (bitvector[l >> 3] & (1 << (l & 7)))
-								break;
-						}
-						if (i == ent->num_clusters)
-						{
-							SV_RestoreEntityStateAfterClient(ent);
-							continue;		// blocked by a door
-						}
-					}
-
-					if (ent->s.modelindex == 0)
-					{	// don't send sounds if they will be attenuated away
-						vec3_t	delta;
-						float	len;
-
-						VectorSubtract(org, ent->v.origin, delta);
-						len = VectorLength(delta);
-						if (len > 400)
-						{
-							SV_RestoreEntityStateAfterClient(ent);
-							continue;		// blocked by a door
-						}
-					}
-				}
-			}
+			SV_RestoreEntityStateAfterClient(ent);
+			continue;
 		}
 
 		// add it to the circular client_entities array
@@ -710,10 +990,14 @@ void SV_BuildClientFrame (client_t *client)
 		}
 
 		*state = ent->s; // this compiles to memcpy
+		svs.client_entity_stamps[svs.next_client_entities%svs.num_client_entities] = ent->bEntityStateForClientChanged ? -1 : svFrameStamp;
 
 		// don't mark players missiles as solid
 		if (PROG_TO_GENT(ent->v.owner) == client->edict)
+		{
 			state->packedSolid = 0;
+			svs.client_entity_stamps[svs.next_client_entities%svs.num_client_entities] = -1;
+		}
 
 		svs.next_client_entities++;
 		frame->num_entities++;
@@ -721,6 +1005,335 @@ void SV_BuildClientFrame (client_t *client)
 }
 
 
+
+/*
+=============================================================================
+
+Build and encode client frames on job threads
+
+=============================================================================
+*/
+
+// big enough for playerstate and a delta of every entity, never overflows
+#define SV_FRAMEMSG_SIZE	(MAX_MSGLEN + MAX_GENTITIES * (sizeof(entity_state_t) + 8))
+
+typedef struct
+{
+	byte			*pvs, *phs, *row;	// CM_ClusterBytes() each
+	byte			*msgbuf;			// SV_FRAMEMSG_SIZE
+
+	unsigned int	bits[MAX_GENTITIES / 32];
+	unsigned short	list[MAX_GENTITIES];
+} svframethread_t;
+
+typedef struct
+{
+	client_t		*client;
+	sizebuf_t		*msg;
+	int				numEntities;
+	unsigned short	entities[MAX_GENTITIES];
+} svframejob_t;
+
+static svframethread_t	svFrameThreads[JOB_MAX_THREADS];
+static int				svFrameRowBytes;
+
+static svframejob_t		svFrameJobs[MAX_CLIENTS];
+
+static qboolean			svFrameEntitySendable[MAX_GENTITIES];	// passed checks which don't depend on client
+static gentity_t		*svFrameSerialEnts[MAX_GENTITIES];	// clients which may see these build frames serially
+static int				svFrameNumSerialEnts;
+
+/*
+=============
+SV_EntityStateWritesQuietly
+
+False when writing the state would print or drop, which must not happen
+on job threads, the checks are the same as in MSG_WriteDeltaEntity and
+SV_WritePlayerstateToClient
+=============
+*/
+static qboolean SV_EntityStateWritesQuietly(entity_state_t* s)
+{
+	int		i;
+
+	if (s->renderScale > 15 || s->renderScale <= 0)
+		return false;
+	for (i = 0; i < 3; i++)
+	{
+		if (s->renderColor[i] > 1.0f || s->renderColor[i] < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+static qboolean SV_PlayerStateWritesQuietly(player_state_t* ps)
+{
+	int		i;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (ps->pmove.mins[i] > 127 || ps->pmove.mins[i] < -127 || ps->pmove.maxs[i] > 127 || ps->pmove.maxs[i] < -127)
+			return false;
+		if (ps->viewoffset[i] > 127 || ps->viewoffset[i] < -127)
+			return false;
+	}
+	return true;
+}
+
+/*
+=============
+SV_BeginClientFrames
+
+Does the client independent part of SV_BuildClientFrame once for all clients,
+must be called before building frames. Entities with EntityStateForClient
+callback or with state MSG_WriteDeltaEntity complains about are never sent
+from job threads.
+=============
+*/
+void SV_BeginClientFrames(void)
+{
+	gentity_t	*ent;
+	int			e;
+
+	svFrameStamp++;
+	memset (svFrameAlwaysBits, 0, sizeof(svFrameAlwaysBits));
+	svFrameNumSerialEnts = 0;
+	for (e = 1; e < sv.max_edicts; e++)
+	{
+		ent = EDICT_NUM(e);
+		svFrameEntitySendable[e] = false;
+
+		if (!ent->inuse || ((int)ent->v.svflags & SVF_NOCLIENT))
+			continue;
+
+		// cluster lists can't tell if these are visible, callbacks may change flags too
+		if (((int)ent->v.svflags & SVF_NOCULL) || (ent->s.renderFlags & RF_BEAM) || ent->num_clusters == -1 || ent->v.EntityStateForClient > 0)
+			svFrameAlwaysBits[e >> 5] |= 1u << (e & 31);
+
+		if (ent->v.EntityStateForClient > 0)
+		{
+			svFrameSerialEnts[svFrameNumSerialEnts++] = ent;
+			continue;
+		}
+
+		if (!SV_EntityCanBeDrawn(ent) && !ent->s.effects && !ent->s.loopingSound && !ent->s.event)
+			continue;
+
+		if (ent->s.number != e)
+		{
+			Com_DPrintf (DP_SV, "FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+		svFrameEntitySendable[e] = true;
+
+		if (!SV_EntityStateWritesQuietly(&ent->s))
+			svFrameSerialEnts[svFrameNumSerialEnts++] = ent;
+	}
+}
+
+/*
+=============
+SV_CanBuildClientFrameOnJobs
+
+False if client could see an entity with EntityStateForClient callback,
+those must run on main thread so the whole frame is built by SV_BuildClientFrame.
+The same goes for frames which would print or drop while being written,
+job functions must not do either.
+=============
+*/
+qboolean SV_CanBuildClientFrameOnJobs(client_t* client)
+{
+	int		i;
+
+	if (!client->edict->client)
+		return false;
+
+	if (!SV_PlayerStateWritesQuietly(&client->edict->client->ps))
+		return false;
+
+	for (i = 0; i < svFrameNumSerialEnts; i++)
+	{
+		if (!SV_EntityHiddenFromClient(svFrameSerialEnts[i], client->edict))
+			return false;
+	}
+	return true;
+}
+
+/*
+=============
+SV_CullClientFrameJob
+
+Lists entities visible to client, the same way SV_BuildClientFrame does
+=============
+*/
+static void SV_CullClientFrameJob(void* data, int index, int thread)
+{
+	svframejob_t	*job = &svFrameJobs[index];
+	svframethread_t	*t = &svFrameThreads[thread];
+	client_frame_t	*frame;
+	gentity_t		*clent, *ent;
+	vec3_t			org;
+	int				e, i, j, count;
+	int				leafnum, clientarea, clientcluster;
+
+	clent = job->client->edict;
+
+	// this is the frame we are creating
+	frame = &job->client->frames[sv.framenum & UPDATE_MASK];
+	frame->senttime = svs.realtime;
+
+	for (i = 0; i < 3; i++)
+		org[i] = clent->client->ps.pmove.origin[i] + clent->client->ps.viewoffset[i];
+
+	leafnum = CM_PointLeafnum (org);
+	clientarea = CM_LeafArea (leafnum);
+	clientcluster = CM_LeafCluster (leafnum);
+
+	frame->areabytes = CM_WriteAreaBits (frame->areabits, clientarea);
+	frame->ps = clent->client->ps;
+
+	SV_FatPVSToBuffer (org, t->pvs, t->row);
+	CM_DecompressClusterPHS (clientcluster, t->phs);
+
+	job->numEntities = 0;
+	count = SV_ClientFrameEntities (clent, t->pvs, t->bits, t->list);
+	for (j = 0; j < count; j++)
+	{
+		e = t->list[j];
+		if (!svFrameEntitySendable[e])
+			continue;
+
+		ent = EDICT_NUM(e);
+		if (SV_EntityHiddenFromClient(ent, clent))
+			continue;
+		if (SV_EntityCulledForClient(ent, clent, org, clientarea, t->pvs, t->phs))
+			continue;
+
+		job->entities[job->numEntities++] = e;
+	}
+}
+
+/*
+=============
+SV_EncodeClientFrameJob
+
+Copies visible entities to client's frame and delta encodes it to job's message
+=============
+*/
+static void SV_EncodeClientFrameJob(void* data, int index, int thread)
+{
+	svframejob_t	*job = &svFrameJobs[index];
+	svframethread_t	*t = &svFrameThreads[thread];
+	client_frame_t	*frame;
+	entity_state_t	*state;
+	gentity_t		*ent;
+	sizebuf_t		msg;
+	int				i, slot;
+
+	frame = &job->client->frames[sv.framenum & UPDATE_MASK];
+	for (i = 0; i < frame->num_entities; i++)
+	{
+		ent = EDICT_NUM(job->entities[i]);
+		slot = (frame->first_entity + i) % svs.num_client_entities;
+		state = &svs.client_entities[slot];
+		*state = ent->s;
+		svs.client_entity_stamps[slot] = svFrameStamp;
+
+		// don't mark players missiles as solid
+		if (PROG_TO_GENT(ent->v.owner) == job->client->edict)
+		{
+			state->packedSolid = 0;
+			svs.client_entity_stamps[slot] = -1;
+		}
+	}
+
+	SZ_Init (&msg, t->msgbuf, SV_FRAMEMSG_SIZE);
+	SV_WriteFrameToClient (job->client, &msg, thread);
+
+	// SZ_GetSpace would print from this thread, so overflow is checked here
+	if (msg.cursize > job->msg->maxsize)
+	{
+		SZ_Clear (job->msg);
+		job->msg->overflowed = true;
+		return;
+	}
+	memcpy (job->msg->data, msg.data, msg.cursize);
+	job->msg->cursize = msg.cursize;
+}
+
+/*
+=============
+SV_BuildClientFramesOnJobs
+
+Builds and encodes frames of clients to their msgs using job threads. Must be
+called after SV_BeginClientFrames and only for clients which passed
+SV_CanBuildClientFrameOnJobs. Entity states are reserved in client order so
+svs.client_entities looks the same as after serial SV_BuildClientFrame calls.
+=============
+*/
+void SV_BuildClientFramesOnJobs(client_t** clients, sizebuf_t** msgs, int count)
+{
+	svframethread_t		*t;
+	client_frame_t		*frame;
+	unsigned long long	time;
+	int					i, numThreads;
+
+	if (count <= 0)
+		return;
+
+	// per thread vis rows, these depend on map
+	numThreads = Job_NumThreads();
+	if (svFrameRowBytes != CM_ClusterBytes())
+	{
+		for (i = 0; i < JOB_MAX_THREADS; i++)
+		{
+			t = &svFrameThreads[i];
+			if (t->pvs)
+			{
+				Z_Free (t->pvs);
+				t->pvs = NULL;
+			}
+		}
+		svFrameRowBytes = CM_ClusterBytes();
+	}
+
+	for (i = 0; i < numThreads; i++)
+	{
+		t = &svFrameThreads[i];
+		if (!t->pvs)
+		{
+			t->pvs = Z_Malloc (svFrameRowBytes * 3);
+			t->phs = t->pvs + svFrameRowBytes;
+			t->row = t->phs + svFrameRowBytes;
+		}
+		if (!t->msgbuf)
+			t->msgbuf = Z_Malloc (SV_FRAMEMSG_SIZE);
+		SV_DeltaCacheForThread (i);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		svFrameJobs[i].client = clients[i];
+		svFrameJobs[i].msg = msgs[i];
+	}
+
+	time = Sys_Microseconds();
+	Job_ParallelFor (count, SV_CullClientFrameJob, NULL);
+
+	for (i = 0; i < count; i++)
+	{
+		frame = &clients[i]->frames[sv.framenum & UPDATE_MASK];
+		frame->first_entity = svs.next_client_entities;
+		frame->num_entities = svFrameJobs[i].numEntities;
+		svs.next_client_entities += frame->num_entities;
+	}
+	SV_PerfAdd (SVPERF_BUILDFRAME, time);
+
+	time = Sys_Microseconds();
+	Job_ParallelFor (count, SV_EncodeClientFrameJob, NULL);
+	SV_PerfAdd (SVPERF_WRITEFRAME, time);
+}
+
 /*
 ==================
 SV_RecordDemoMessage
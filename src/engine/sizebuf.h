@@ -30,6 +30,7 @@ typedef struct sizebuf_s
 	int		maxsize;
 	int		cursize;
 	int		readcount;
+	int		bit;			// read or write position in bits for MSG_ReadBits/MSG_WriteBits
 } sizebuf_t;
 
 void SZ_Init(sizebuf_t* buf, byte* data, const int length);
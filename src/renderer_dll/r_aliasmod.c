@@ -107,9 +107,11 @@ static void R_LerpAliasFrame(float lerp, int index, md3XyzNormal_t* oldVert, md3
 /*
 =================
 R_UploadAliasModelTris
+
+Vertices of all surfaces are stored in asset cache together, buffer is the md3 file
 =================
 */
-static void R_UploadAliasModelTris(model_t* mod)
+static void R_UploadAliasModelTris(model_t* mod, void* buffer)
 {
 	md3Header_t		*pModel = NULL;
 	md3Surface_t	*pSurface = NULL;
@@ -118,20 +120,50 @@ static void R_UploadAliasModelTris(model_t* mod)
 	md3XyzNormal_t	*pVert, *pOldVert;
 	vec3_t			v, n; //vert and normal after lerp
 	int				surf, tri, trivert, frame, oldframe;
-	int numverts;
+	int numverts, totalverts;
+	glvert_t		*verts, *out;
+	cacheblob_t		blob;
+	qboolean		cached;
+	unsigned		crc;
 
 	pModel = mod->alias;
 	frame = oldframe = 0;
 
-	R_GenerateSinTableForAliasModels();
+	totalverts = 0;
+	pSurface = (md3Surface_t*)((byte*)pModel + pModel->ofsSurfaces);
+	for (surf = 0; surf < pModel->numSurfaces; surf++)
+	{
+		totalverts += (pSurface->numTriangles * 3) * pModel->numFrames;
+		pSurface = (md3Surface_t*)((byte*)pSurface + pSurface->ofsEnd);
+	}
+
+	// vertices lerped and normalized in previous runs
+	cached = false;
+	crc = ri.CacheSourceCRC(buffer, modelFileLength);
+	if (ri.CacheFind("md3", crc, modelFileLength, sizeof(glvert_t), &blob))
+	{
+		if (blob.length == totalverts * (int)sizeof(glvert_t))
+			cached = true;
+		else
+			ri.CacheRelease(&blob);
+	}
 
+	if (cached)
+	{
+		verts = (glvert_t*)blob.data;
+	}
+	else
+	{
+		verts = ri.MemAlloc(totalverts * sizeof(glvert_t));
+		R_GenerateSinTableForAliasModels();
+	}
+
+	out = verts;
 	pSurface = (md3Surface_t*)((byte*)pModel + pModel->ofsSurfaces);
 	for (surf = 0; surf < pModel->numSurfaces; surf++)
 	{	
-		mod->vb[surf] = R_AllocVertexBuffer((V_UV | V_NORMAL), ((pSurface->numTriangles * 3) * pModel->numFrames), 0);
-		
 		numverts = 0;
-		for (frame = 0; frame < pModel->numFrames; frame++)
+		for (frame = 0; frame < pModel->numFrames && !cached; frame++) // nothing to build when cached
 		{
 			oldframe = frame;
 
@@ -148,19 +180,34 @@ static void R_UploadAliasModelTris(model_t* mod)
 
 					R_LerpAliasFrame(1.0f, index, &pOldVert[index], &pVert[index], v, n);
 
-					VectorCopy(v, mod->vb[surf]->verts[numverts].xyz);
+					VectorCopy(v, out[numverts].xyz);
 					VectorNormalize(n);
 
-					VectorCopy(n, mod->vb[surf]->verts[numverts].normal);
-					mod->vb[surf]->verts[numverts].st[0] = pTexCoord[index].st[0];
-					mod->vb[surf]->verts[numverts].st[1] = pTexCoord[index].st[1];
+					VectorCopy(n, out[numverts].normal);
+					out[numverts].st[0] = pTexCoord[index].st[0];
+					out[numverts].st[1] = pTexCoord[index].st[1];
 					numverts++;
 				}
 			}
 		}
-		R_UpdateVertexBuffer(mod->vb[surf], mod->vb[surf]->verts, numverts, (V_UV | V_NORMAL));
+
+		numverts = (pSurface->numTriangles * 3) * pModel->numFrames;
+		mod->vb[surf] = R_AllocVertexBuffer((V_UV | V_NORMAL), 0, 0);
+		R_UpdateVertexBuffer(mod->vb[surf], out, numverts, (V_UV | V_NORMAL));
+		out += numverts;
+
 		pSurface = (md3Surface_t*)((byte*)pSurface + pSurface->ofsEnd);
 	}
+
+	if (cached)
+	{
+		ri.CacheRelease(&blob);
+	}
+	else
+	{
+		ri.CacheStore("md3", crc, modelFileLength, sizeof(glvert_t), verts, totalverts * sizeof(glvert_t));
+		ri.MemFree(verts);
+	}
 }
 
 /*
@@ -383,7 +430,7 @@ void Mod_LoadAliasMD3(model_t* mod, void* buffer)
 	mod->radius = MD3_ModelRadius(mod->index);
 	MD3_ModelBounds(mod->index, mod->mins, mod->maxs);
 
-	R_UploadAliasModelTris(mod);
+	R_UploadAliasModelTris(mod, buffer);
 }
 
 /*
@@ -19,7 +19,7 @@ int		gl_tex_alpha_format = 4;
 int		gl_filter_min = GL_LINEAR_MIPMAP_NEAREST;
 int		gl_filter_max = GL_LINEAR;
 
-static void R_LoadTGA(const char* name, byte** pic, int* width, int* height);
+static void R_LoadTGA(const char* name, byte* buffer, byte** pic, int* width, int* height);
 
 static mte = false;
 
@@ -459,6 +459,60 @@ image_t *R_LoadTexture(const char *name, byte *pixels, int width, int height, te
 	return image;
 }
 
+// decoded pixels in asset cache
+typedef struct
+{
+	int		width, height;	// followed by rgba pixels
+} cachedpic_t;
+
+/*
+===============
+R_LoadCachedTexture
+
+Uploads pixels decoded from the same file in previous runs, NULL if there are none
+===============
+*/
+static image_t *R_LoadCachedTexture(const char* name, unsigned crc, int length, texType_t type)
+{
+	const cachedpic_t	*cached;
+	cacheblob_t			blob;
+	image_t				*image;
+
+	if (!ri.CacheFind("tex", crc, length, 0, &blob))
+		return NULL;
+
+	image = NULL;
+	cached = (const cachedpic_t*)blob.data;
+	if (blob.length >= (int)sizeof(cachedpic_t) && cached->width > 0 && cached->width <= 16384 && cached->height > 0 && cached->height <= 16384
+		&& blob.length == (int)sizeof(cachedpic_t) + cached->width * cached->height * 4)
+		image = R_LoadTexture(name, (byte*)(cached + 1), cached->width, cached->height, type, 32);
+
+	ri.CacheRelease(&blob);
+	return image;
+}
+
+/*
+===============
+R_StoreCachedTexture
+===============
+*/
+static void R_StoreCachedTexture(unsigned crc, int length, byte* pic, int width, int height)
+{
+	cachedpic_t	*cached;
+	int			size;
+
+	size = sizeof(cachedpic_t) + width * height * 4;
+	cached = malloc(size);
+	if (!cached)
+		return;
+
+	cached->width = width;
+	cached->height = height;
+	memcpy(cached + 1, pic, width * height * 4);
+	ri.CacheStore("tex", crc, length, 0, cached, size);
+	free(cached);
+}
+
 /*
 ===============
 R_FindTexture
@@ -470,8 +524,9 @@ image_t	*R_FindTexture(const char *name, texType_t type, qboolean load)
 {
 	image_t	*image;
 	int		i, len;
-	byte	*pic;
-	int		width, height;
+	byte	*pic, *buffer;
+	int		width, height, length;
+	unsigned	crc;
 
 	if (!name)
 	{
@@ -507,13 +562,22 @@ image_t	*R_FindTexture(const char *name, texType_t type, qboolean load)
 	pic = NULL;
 	if (!strcmp(name+len-4, ".tga"))
 	{
-		R_LoadTGA (name, &pic, &width, &height);
-		if (!pic)
+		length = ri.LoadFile (name, (void**)&buffer);
+		if (!buffer)
 		{
 //			ri.Printf(PRINT_LOW, "R_FindTexture: couldn't load %s\n", name);
 			return r_texture_missing;
 		}
-		image = R_LoadTexture (name, pic, width, height, type, 32);
+
+		crc = ri.CacheSourceCRC (buffer, length);
+		image = R_LoadCachedTexture (name, crc, length, type);
+		if (!image)
+		{
+			R_LoadTGA (name, buffer, &pic, &width, &height);
+			image = R_LoadTexture (name, pic, width, height, type, 32);
+			R_StoreCachedTexture (crc, length, pic, width, height);
+		}
+		ri.FreeFile (buffer);
 	}
 	else
 	{
@@ -640,32 +704,22 @@ typedef struct _TargaHeader {
 /*
 =============
 R_LoadTGA
+
+Decodes tga file loaded into buffer
 =============
 */
-static void R_LoadTGA(const char* name, byte** pic, int* width, int* height)
+static void R_LoadTGA(const char* name, byte* buffer, byte** pic, int* width, int* height)
 {
 	int		columns, rows, numPixels;
 	byte* pixbuf;
 	int		row, column;
 	byte* buf_p;
-	byte* buffer;
-	int		length;
 	TargaHeader		targa_header;
 	byte* targa_rgba;
 	byte tmp[2];
 
 	*pic = NULL;
 
-	//
-	// load the file
-	//
-	length = ri.LoadFile(name, (void**)&buffer);
-	if (!buffer)
-	{
-		//		ri.Printf (PRINT_DEVELOPER, "Bad tga file %s\n", name);
-		return;
-	}
-
 	buf_p = buffer;
 
 	targa_header.id_length = *buf_p++;
@@ -837,5 +891,4 @@ static void R_LoadTGA(const char* name, byte** pic, int* width, int* height)
 		breakOut:;
 		}
 	}
-	ri.FreeFile(buffer);
 }
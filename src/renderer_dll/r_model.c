@@ -84,7 +84,9 @@ Loads in a model for the given name
 model_t* R_ModelForName(const char* name, qboolean crash)
 {
 	model_t* mod;
-	unsigned* buf;
+	const void* data;
+	void	*handle, *buf;
+	unsigned	ident;
 	int		i;
 
 	if (!name[0])
@@ -134,8 +136,8 @@ model_t* R_ModelForName(const char* name, qboolean crash)
 	//
 	// load the file
 	//
-	modelFileLength = ri.LoadFile(mod->name, &buf);
-	if (!buf)
+	modelFileLength = ri.MapFile(mod->name, &data, &handle);
+	if (!data)
 	{
 		if (crash)
 			ri.Error(ERR_DROP, "%s: %s not found.\n", __FUNCTION__, mod->name);
@@ -148,10 +150,22 @@ model_t* R_ModelForName(const char* name, qboolean crash)
 
 	pLoadModel = mod;
 
+	// md3 loader copies the file to hunk before swapping it and can read straight
+	// from the mapping, others swap the file in place and need a writable copy
+	buf = NULL;
+	ident = LittleLong(*(unsigned*)data);
+	if (ident != MD3_IDENT)
+	{
+		buf = ri.MemAlloc(modelFileLength);
+		memcpy(buf, data, modelFileLength);
+		ri.UnmapFile(handle);
+		handle = NULL;
+	}
+
 	//
 	// call the apropriate loader
 	//
-	switch (LittleLong(*(unsigned*)buf))
+	switch (ident)
 	{
 	case PMODEL_IDENT: /* Pragma's own model format */
 		pLoadModel->extradata = Hunk_Begin(RD_MAX_PMOD_HUNKSIZE, "Model (Renderer)");
@@ -160,7 +174,7 @@ model_t* R_ModelForName(const char* name, qboolean crash)
 
 	case MD3_IDENT: /* Quake3 .md3 model */
 		pLoadModel->extradata = Hunk_Begin(RD_MAX_MD3_HUNKSIZE, "Alias Model (Renderer)");
-		Mod_LoadAliasMD3(mod, buf);
+		Mod_LoadAliasMD3(mod, (void*)data);
 		break;
 
 	case BSP_IDENT: /* Quake2 .bsp v38*/
@@ -180,7 +194,10 @@ model_t* R_ModelForName(const char* name, qboolean crash)
 		break;
 	}
 
-	ri.FreeFile(buf);
+	if (buf)
+		ri.MemFree(buf);
+	else
+		ri.UnmapFile(handle);
 
 	return mod;
 }
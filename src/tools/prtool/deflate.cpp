@@ -0,0 +1,506 @@
+/*
+prtool, part of pragma
+Copyright (C) 2024 BraXi.
+
+See the attached GNU General Public License v2 for more details.
+*/
+
+//
+// deflate.cpp: deflate (RFC 1951) encoder for .pk3 packages
+// hash chain LZ77 with one step lazy matching and a dynamic huffman block per 64k symbols
+//
+
+#include "prtool.h"
+
+#define WINDOW_SIZE		32768
+#define WINDOW_MASK		(WINDOW_SIZE - 1)
+#define HASH_BITS		15
+#define HASH_SIZE		(1 << HASH_BITS)
+#define MIN_MATCH		3
+#define MAX_MATCH		258
+#define MAX_CHAIN		128		// how many earlier positions are tried for a match
+#define GOOD_MATCH		32		// don't look for a better match after finding one this long
+#define BLOCK_SYMBOLS	65536
+
+#define NUM_LITLEN		286
+#define NUM_DIST		30
+#define NUM_CODELEN		19
+
+static const int lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static const byte codeLengthOrder[NUM_CODELEN] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+typedef struct
+{
+	unsigned short litlen;	// literal, or match length when dist is not 0
+	unsigned short dist;
+} lzsymbol_t;
+
+typedef struct
+{
+	std::vector<byte> *out;
+	unsigned int bitbuf;
+	int bitcount;
+} bitwriter_t;
+
+static void PutBits(bitwriter_t* w, unsigned int value, int count)
+{
+	w->bitbuf |= value << w->bitcount;
+	w->bitcount += count;
+	while (w->bitcount >= 8)
+	{
+		w->out->push_back((byte)(w->bitbuf & 255));
+		w->bitbuf >>= 8;
+		w->bitcount -= 8;
+	}
+}
+
+static void FlushBits(bitwriter_t* w)
+{
+	if (w->bitcount > 0)
+		w->out->push_back((byte)(w->bitbuf & 255));
+	w->bitbuf = 0;
+	w->bitcount = 0;
+}
+
+static int LengthCode(int len)
+{
+	int i;
+	for (i = 28; lengthBase[i] > len; i--)
+		;
+	return i;
+}
+
+static int DistCode(int dist)
+{
+	int i;
+	for (i = 29; distBase[i] > dist; i--)
+		;
+	return i;
+}
+
+/*
+=================
+BuildLengths
+Huffman code lengths for given symbol frequencies, no longer than maxbits.
+Frequencies are flattened until the tree fits.
+=================
+*/
+static void BuildLengths(const int* freqs, int numsymbols, int maxbits, byte* lengths)
+{
+	int f[NUM_LITLEN], parent[2 * NUM_LITLEN], weight[2 * NUM_LITLEN];
+	int i, n, maxlen, len, node, a, b;
+
+	for (i = 0; i < numsymbols; i++)
+		f[i] = freqs[i];
+
+	while (1)
+	{
+		memset(lengths, 0, numsymbols);
+
+		// leaves
+		n = 0;
+		for (i = 0; i < numsymbols; i++)
+		{
+			if (f[i])
+			{
+				weight[i] = f[i];
+				parent[i] = -1;
+				n++;
+			}
+		}
+
+		if (n == 0)
+			return;
+		if (n == 1)
+		{
+			for (i = 0; i < numsymbols; i++)
+				if (f[i])
+					lengths[i] = 1;
+			return;
+		}
+
+		// join two lightest nodes until one is left, fine for a few hundred symbols
+		node = numsymbols;
+		while (n > 1)
+		{
+			a = b = -1;
+			for (i = 0; i < node; i++)
+			{
+				if ((i < numsymbols && !f[i]) || parent[i] != -1)
+					continue;
+				if (a == -1 || weight[i] < weight[a])
+				{
+					b = a;
+					a = i;
+				}
+				else if (b == -1 || weight[i] < weight[b])
+				{
+					b = i;
+				}
+			}
+			weight[node] = weight[a] + weight[b];
+			parent[node] = -1;
+			parent[a] = parent[b] = node;
+			node++;
+			n--;
+		}
+
+		maxlen = 0;
+		for (i = 0; i < numsymbols; i++)
+		{
+			if (!f[i])
+				continue;
+			for (len = 0, a = i; parent[a] != -1; a = parent[a])
+				len++;
+			lengths[i] = (byte)len;
+			if (len > maxlen)
+				maxlen = len;
+		}
+
+		if (maxlen <= maxbits)
+			return;
+
+		for (i = 0; i < numsymbols; i++)
+			if (f[i])
+				f[i] = (f[i] >> 1) | 1;
+	}
+}
+
+/*
+=================
+BuildCodes
+Canonical codes from lengths, bit reversed so they can be written LSB first
+=================
+*/
+static void BuildCodes(const byte* lengths, int numsymbols, unsigned short* codes)
+{
+	int count[16], next[16];
+	int i, len, code, r, reversed;
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < numsymbols; i++)
+		count[lengths[i]]++;
+	count[0] = 0;
+
+	code = 0;
+	for (len = 1; len < 16; len++)
+	{
+		code = (code + count[len - 1]) << 1;
+		next[len] = code;
+	}
+
+	for (i = 0; i < numsymbols; i++)
+	{
+		len = lengths[i];
+		if (!len)
+			continue;
+		code = next[len]++;
+		for (reversed = 0, r = 0; r < len; r++)
+			reversed |= ((code >> r) & 1) << (len - 1 - r);
+		codes[i] = (unsigned short)reversed;
+	}
+}
+
+/*
+=================
+WriteBlock
+Writes symbols as one dynamic huffman block
+=================
+*/
+static void WriteBlock(bitwriter_t* w, const lzsymbol_t* syms, int numsyms, bool last)
+{
+	int litFreq[NUM_LITLEN], distFreq[NUM_DIST], clFreq[NUM_CODELEN];
+	byte litLen[NUM_LITLEN], distLen[NUM_DIST], clLen[NUM_CODELEN];
+	unsigned short litCode[NUM_LITLEN], distCode[NUM_DIST], clCode[NUM_CODELEN];
+	byte all[NUM_LITLEN + NUM_DIST];
+	int rle[NUM_LITLEN + NUM_DIST][2], numrle;
+	int i, j, code, nlit, ndist, ncl, total, run;
+
+	memset(litFreq, 0, sizeof(litFreq));
+	memset(distFreq, 0, sizeof(distFreq));
+	for (i = 0; i < numsyms; i++)
+	{
+		if (syms[i].dist)
+		{
+			litFreq[257 + LengthCode(syms[i].litlen)]++;
+			distFreq[DistCode(syms[i].dist)]++;
+		}
+		else
+			litFreq[syms[i].litlen]++;
+	}
+	litFreq[256] = 1;
+
+	// some decoders want at least two distance codes
+	for (i = 0, j = 0; i < NUM_DIST; i++)
+		if (distFreq[i])
+			j++;
+	if (j < 2)
+		distFreq[0] = distFreq[1] = 1;
+
+	BuildLengths(litFreq, NUM_LITLEN, 15, litLen);
+	BuildLengths(distFreq, NUM_DIST, 15, distLen);
+	BuildCodes(litLen, NUM_LITLEN, litCode);
+	BuildCodes(distLen, NUM_DIST, distCode);
+
+	for (nlit = NUM_LITLEN; nlit > 257 && !litLen[nlit - 1]; nlit--)
+		;
+	for (ndist = NUM_DIST; ndist > 1 && !distLen[ndist - 1]; ndist--)
+		;
+
+	// run length encode the code lengths
+	memcpy(all, litLen, nlit);
+	memcpy(all + nlit, distLen, ndist);
+	total = nlit + ndist;
+	numrle = 0;
+	memset(clFreq, 0, sizeof(clFreq));
+	for (i = 0; i < total; i += run)
+	{
+		for (run = 1; i + run < total && all[i + run] == all[i]; run++)
+			;
+
+		if (all[i] == 0 && run >= 11)
+		{
+			if (run > 138)
+				run = 138;
+			rle[numrle][0] = 18;
+			rle[numrle][1] = run - 11;
+		}
+		else if (all[i] == 0 && run >= 3)
+		{
+			rle[numrle][0] = 17;
+			rle[numrle][1] = run - 3;
+		}
+		else if (all[i] != 0 && run >= 4)
+		{
+			// the length itself, then repeats of it
+			rle[numrle][0] = all[i];
+			rle[numrle][1] = 0;
+			clFreq[all[i]]++;
+			numrle++;
+			run--;
+			if (run > 6)
+				run = 6;
+			rle[numrle][0] = 16;
+			rle[numrle][1] = run - 3;
+			run++;
+			clFreq[16]++;
+			numrle++;
+			continue;
+		}
+		else
+		{
+			run = 1;
+			rle[numrle][0] = all[i];
+			rle[numrle][1] = 0;
+		}
+		clFreq[rle[numrle][0]]++;
+		numrle++;
+	}
+
+	BuildLengths(clFreq, NUM_CODELEN, 7, clLen);
+	BuildCodes(clLen, NUM_CODELEN, clCode);
+	for (ncl = NUM_CODELEN; ncl > 4 && !clLen[codeLengthOrder[ncl - 1]]; ncl--)
+		;
+
+	// header
+	PutBits(w, last ? 1 : 0, 1);
+	PutBits(w, 2, 2);
+	PutBits(w, nlit - 257, 5);
+	PutBits(w, ndist - 1, 5);
+	PutBits(w, ncl - 4, 4);
+	for (i = 0; i < ncl; i++)
+		PutBits(w, clLen[codeLengthOrder[i]], 3);
+
+	for (i = 0; i < numrle; i++)
+	{
+		code = rle[i][0];
+		PutBits(w, clCode[code], clLen[code]);
+		if (code == 16)
+			PutBits(w, rle[i][1], 2);
+		else if (code == 17)
+			PutBits(w, rle[i][1], 3);
+		else if (code == 18)
+			PutBits(w, rle[i][1], 7);
+	}
+
+	// data
+	for (i = 0; i < numsyms; i++)
+	{
+		if (syms[i].dist)
+		{
+			code = LengthCode(syms[i].litlen);
+			PutBits(w, litCode[257 + code], litLen[257 + code]);
+			PutBits(w, syms[i].litlen - lengthBase[code], lengthExtra[code]);
+
+			code = DistCode(syms[i].dist);
+			PutBits(w, distCode[code], distLen[code]);
+			PutBits(w, syms[i].dist - distBase[code], distExtra[code]);
+		}
+		else
+		{
+			PutBits(w, litCode[syms[i].litlen], litLen[syms[i].litlen]);
+		}
+	}
+	PutBits(w, litCode[256], litLen[256]);
+}
+
+static inline unsigned int Hash3(const byte* p)
+{
+	return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (HASH_SIZE - 1);
+}
+
+/*
+=================
+LongestMatch
+=================
+*/
+static int LongestMatch(const byte* in, size_t pos, size_t inlen, const int* head, const int* prev, int* matchdist)
+{
+	int chain, best, len, maxlen;
+	long long cand;
+	const byte* cur, * ref;
+
+	maxlen = (int)(inlen - pos < MAX_MATCH ? inlen - pos : MAX_MATCH);
+	if (maxlen < MIN_MATCH)
+		return 0;
+
+	best = 0;
+	cur = in + pos;
+	cand = head[Hash3(cur)];
+	for (chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++)
+	{
+		if (pos - cand > WINDOW_SIZE - 1 || cand >= (long long)pos)
+			break;
+
+		ref = in + cand;
+		if (ref[best] == cur[best] && ref[0] == cur[0])
+		{
+			for (len = 0; len < maxlen && ref[len] == cur[len]; len++)
+				;
+			if (len > best)
+			{
+				best = len;
+				*matchdist = (int)(pos - cand);
+				if (len >= GOOD_MATCH || len == maxlen)
+					break;
+			}
+		}
+		cand = prev[cand & WINDOW_MASK];
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+/*
+=================
+Deflate
+Compresses in into out as raw deflate stream, returns compressed size
+=================
+*/
+size_t Deflate(const byte* in, size_t inlen, std::vector<byte>& out)
+{
+	std::vector<int> head(HASH_SIZE, -1), prev(WINDOW_SIZE, -1);
+	std::vector<lzsymbol_t> syms;
+	bitwriter_t w;
+	size_t pos, i;
+	int len, dist, nextlen, nextdist;
+	lzsymbol_t sym;
+
+	out.clear();
+	w.out = &out;
+	w.bitbuf = 0;
+	w.bitcount = 0;
+
+	syms.reserve(BLOCK_SYMBOLS);
+
+	pos = 0;
+	while (pos < inlen)
+	{
+		len = LongestMatch(in, pos, inlen, head.data(), prev.data(), &dist);
+
+		// lazy matching, emit a literal if next position has a longer match
+		if (len && len < GOOD_MATCH && pos + 1 < inlen)
+		{
+			if (pos + MIN_MATCH <= inlen)
+			{
+				prev[pos & WINDOW_MASK] = head[Hash3(in + pos)];
+				head[Hash3(in + pos)] = (int)pos;
+			}
+			nextlen = LongestMatch(in, pos + 1, inlen, head.data(), prev.data(), &nextdist);
+			if (nextlen > len)
+			{
+				sym.litlen = in[pos];
+				sym.dist = 0;
+				syms.push_back(sym);
+				pos++;
+				len = nextlen;
+				dist = nextdist;
+			}
+			else
+			{
+				// current position is already hashed
+				sym.litlen = (unsigned short)len;
+				sym.dist = (unsigned short)dist;
+				syms.push_back(sym);
+				for (i = pos + 1; i < pos + len; i++)
+				{
+					if (i + MIN_MATCH <= inlen)
+					{
+						prev[i & WINDOW_MASK] = head[Hash3(in + i)];
+						head[Hash3(in + i)] = (int)i;
+					}
+				}
+				pos += len;
+				goto flush;
+			}
+		}
+
+		if (len)
+		{
+			sym.litlen = (unsigned short)len;
+			sym.dist = (unsigned short)dist;
+		}
+		else
+		{
+			sym.litlen = in[pos];
+			sym.dist = 0;
+			len = 1;
+		}
+		syms.push_back(sym);
+
+		for (i = pos; i < pos + len; i++)
+		{
+			if (i + MIN_MATCH <= inlen)
+			{
+				prev[i & WINDOW_MASK] = head[Hash3(in + i)];
+				head[Hash3(in + i)] = (int)i;
+			}
+		}
+		pos += len;
+
+flush:
+		if (syms.size() >= BLOCK_SYMBOLS)
+		{
+			WriteBlock(&w, syms.data(), (int)syms.size(), pos >= inlen);
+			syms.clear();
+		}
+	}
+
+	if (syms.size() || inlen == 0)
+		WriteBlock(&w, syms.data(), (int)syms.size(), true);
+
+	FlushBits(&w);
+	return out.size();
+}
@@ -9,6 +9,7 @@ See the attached GNU General Public License v2 for more details.
 */
 
 #include "prtool.h"
+#include <time.h>
 
 typedef enum
 {
@@ -494,19 +495,278 @@ static void Pak_WritePak()
 	}
 }
 
-void Opt_CreatePack()
+
+/*
+=================
+ZipCRC32
+=================
+*/
+static unsigned int ZipCRC32(const byte* data, size_t len)
 {
-	char fileName[MAXPATH];
+	static unsigned int table[256];
+	unsigned int crc, c;
+	int i, j;
 
-	assert(sizeof(dpackfile_t) == 64);
+	if (!table[1])
+	{
+		for (i = 0; i < 256; i++)
+		{
+			c = i;
+			for (j = 0; j < 8; j++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+
+	crc = 0xffffffff;
+	while (len--)
+		crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void ZipPutShort(std::vector<byte>& buf, unsigned int value)
+{
+	buf.push_back(value & 0xff);
+	buf.push_back((value >> 8) & 0xff);
+}
+
+static void ZipPutLong(std::vector<byte>& buf, unsigned int value)
+{
+	ZipPutShort(buf, value & 0xffff);
+	ZipPutShort(buf, value >> 16);
+}
+
+typedef struct
+{
+	char name[MAX_QPATH];
+	unsigned int crc;
+	int method;
+	unsigned int complen, filelen;
+	unsigned int offset; // of local header
+} zipentry_t;
+
+static std::vector<zipentry_t> zipEntries;
+static unsigned int zipDosTime, zipDosDate;
+static size_t zipCompressedSize;
+
+/*
+=================
+ZipFile
+Write a single file into a pk3, compressed unless it doesn't get smaller
+=================
+*/
+static void ZipFile(char* src, char* name)
+{
+	FILE* in;
+	long fileLen;
+	byte* buf;
+	std::vector<byte> packed, header;
+	zipentry_t entry;
+	const byte* data;
+
+	in = Com_OpenReadFile(src, true);
+	fileLen = Com_FileLength(in);
+	pakFilesSize += fileLen;
+
+	buf = (byte*)Com_SafeMalloc((size_t)(fileLen + (size_t)1), __FUNCTION__);
+	Com_SafeRead(in, buf, fileLen);
+	fclose(in);
 
+	memset(&entry, 0, sizeof(entry));
+	strncpy(entry.name, name, sizeof(entry.name) - 1);
+	entry.crc = ZipCRC32(buf, fileLen);
+	entry.filelen = fileLen;
+	entry.offset = (unsigned int)ftell(pakFileHandle);
+
+	Deflate(buf, fileLen, packed);
+	if (packed.size() < (size_t)fileLen)
+	{
+		entry.method = ZIP_METHOD_DEFLATE;
+		entry.complen = (unsigned int)packed.size();
+		data = packed.data();
+	}
+	else
+	{
+		entry.method = ZIP_METHOD_STORED;
+		entry.complen = fileLen;
+		data = buf;
+	}
+	zipCompressedSize += entry.complen;
+
+	if (g_verbose)
+		Com_Printf(" %56s : %10i bytes (%i%%)\n", entry.name, fileLen, fileLen ? (int)(100.0 * entry.complen / fileLen) : 100);
+
+	// local file header
+	ZipPutLong(header, ZIP_LOCAL_SIG);
+	ZipPutShort(header, ZIP_VERSION_NEEDED);
+	ZipPutShort(header, 0); // flags
+	ZipPutShort(header, entry.method);
+	ZipPutShort(header, zipDosTime);
+	ZipPutShort(header, zipDosDate);
+	ZipPutLong(header, entry.crc);
+	ZipPutLong(header, entry.complen);
+	ZipPutLong(header, entry.filelen);
+	ZipPutShort(header, (unsigned int)strlen(entry.name));
+	ZipPutShort(header, 0); // extra field
+	header.insert(header.end(), entry.name, entry.name + strlen(entry.name));
+
+	Com_SafeWrite(pakFileHandle, header.data(), (unsigned int)header.size());
+	if (entry.complen)
+		Com_SafeWrite(pakFileHandle, (void*)data, entry.complen);
+
+	zipEntries.push_back(entry);
+	numFilesInPak++;
+	free(buf);
+}
+
+/*
+=================
+Pak_WriteZip
+Write files into a pk3 (zip with deflate)
+=================
+*/
+static void Pak_WriteZip()
+{
+	char destfile[MAXPATH];
+	char srcfile[MAXPATH];
+	std::vector<byte> dir;
+	unsigned int dirofs, dirlen;
+	time_t now;
+	struct tm* t;
+
+	if (numAssetsTotal == 0)
+	{
+		Com_Error("Nothing to pack!");
+	}
+
+	now = time(NULL);
+	t = localtime(&now);
+	zipDosTime = (t->tm_hour << 11) | (t->tm_min << 5) | (t->tm_sec >> 1);
+	zipDosDate = ((t->tm_year - 80) << 9) | ((t->tm_mon + 1) << 5) | t->tm_mday;
+
+	sprintf(destfile, "%s/%s.pk3", g_gamedir, pakname);
+	pakFileHandle = Com_OpenWriteFile(destfile, true);
+	Com_Printf("Writing package \"%s\" to %s ...\n", pakname, destfile);
+
+	zipEntries.clear();
+	zipCompressedSize = 0;
+
+	for (int type = ASSET_RAWFILE; type < NUM_ASSET_TYPES; type++)
+	{
+		if (numAssetsByType[type] <= 0)
+			continue;
+
+		for (int idx = 0; idx < numAssetsTotal; idx++)
+		{
+			if (!assetList[idx].isok || assetList[idx].type != type)
+				continue;
+
+			sprintf(srcfile, "./%s/%s", g_devdir, assetList[idx].name);
+
+			if (g_verbose)
+				Com_Printf("%8s ", assetTypeNames[assetList[idx].type]);
+
+			ZipFile(srcfile, assetList[idx].name);
+		}
+	}
+
+	if (zipEntries.size() > 0xffff)
+		Com_Error("More than %i files in a pk3", 0xffff);
+
+	// central directory
+	dirofs = (unsigned int)ftell(pakFileHandle);
+	for (size_t i = 0; i < zipEntries.size(); i++)
+	{
+		zipentry_t* e = &zipEntries[i];
+
+		ZipPutLong(dir, ZIP_CENTRAL_SIG);
+		ZipPutShort(dir, ZIP_VERSION_NEEDED); // made by
+		ZipPutShort(dir, ZIP_VERSION_NEEDED);
+		ZipPutShort(dir, 0); // flags
+		ZipPutShort(dir, e->method);
+		ZipPutShort(dir, zipDosTime);
+		ZipPutShort(dir, zipDosDate);
+		ZipPutLong(dir, e->crc);
+		ZipPutLong(dir, e->complen);
+		ZipPutLong(dir, e->filelen);
+		ZipPutShort(dir, (unsigned int)strlen(e->name));
+		ZipPutShort(dir, 0); // extra field
+		ZipPutShort(dir, 0); // comment
+		ZipPutShort(dir, 0); // disk
+		ZipPutShort(dir, 0); // internal attributes
+		ZipPutLong(dir, 0); // external attributes
+		ZipPutLong(dir, e->offset);
+		dir.insert(dir.end(), e->name, e->name + strlen(e->name));
+	}
+
+	// end of central directory
+	dirlen = (unsigned int)dir.size();
+	ZipPutLong(dir, ZIP_END_SIG);
+	ZipPutShort(dir, 0); // this disk
+	ZipPutShort(dir, 0); // disk with directory
+	ZipPutShort(dir, (unsigned int)zipEntries.size());
+	ZipPutShort(dir, (unsigned int)zipEntries.size());
+	ZipPutLong(dir, dirlen);
+	ZipPutLong(dir, dirofs);
+	ZipPutShort(dir, 0); // comment
+
+	Com_SafeWrite(pakFileHandle, dir.data(), (unsigned int)dir.size());
+	fclose(pakFileHandle);
+
+	Com_Printf("Done writing %s - %i files in total (%i KB, %i KB compressed).\n\n", destfile, numFilesInPak, (pakFilesSize / 1024), (int)(zipCompressedSize / 1024));
+
+	for (int i = 0; i < NUM_ASSET_TYPES; i++)
+	{
+		if (numAssetsByType[i] == 0)
+			continue;
+
+		Com_HappyPrintf("   %4i %s%s\n", numAssetsByType[i], assetTypeNames[i], (numAssetsByType[i] > 1 ? "s" : ""));
+	}
+
+	if (numMissingFiles > 0)
+	{
+		Com_Printf("\n****** %i %s missing %s ******\n", numMissingFiles, numMissingFiles == 1 ? "file is" : "files are", g_verbose == true ? "" : "(see warnings above)");
+
+		if (g_verbose)
+		{
+			for (int i = 0; i < numMissingFiles; i++)
+			{
+				Com_Printf("   %s\n", missingFileNames[i]);
+			}
+		}
+	}
+}
+
+static void Pak_Reset()
+{
 	numFilesInPak = 0;
 	numAssetsTotal = 0;
+	numMissingFiles = 0;
 	pakFilesSize = 0;
 	memset(&assetList, 0, sizeof(assetList));
 	memset(pakname, 0, sizeof(pakname));
 	memset(numAssetsByType, 0, sizeof(numAssetsByType));
-	
+}
+
+void Opt_CreateZipPack()
+{
+	char fileName[MAXPATH];
+
+	Pak_Reset();
+
+	sprintf(fileName, "%s/%s/%s", g_devdir, PAKLIST_DIR, g_controlFileName);
+
+	Pak_ParseFileList(fileName);
+	Pak_WriteZip();
+}
+
+void Opt_CreatePack()
+{
+	char fileName[MAXPATH];
+
+	assert(sizeof(dpackfile_t) == 64);
+
+	Pak_Reset();
 
 	sprintf(fileName, "%s/%s/%s", g_devdir, PAKLIST_DIR, g_controlFileName);
 
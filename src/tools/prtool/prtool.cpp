@@ -21,12 +21,14 @@ static void Opt_NotImplemented()
 }
 
 extern void Opt_CreatePack();
+extern void Opt_CreateZipPack();
 extern void Opt_ConvertAsset();
 
 command_t commands[] =
 {
 	{"convert", Opt_ConvertAsset},
 	{"pack", Opt_CreatePack},
+	{"pk3", Opt_CreateZipPack},
 	{"extract", Opt_NotImplemented},
 	{"info", Opt_NotImplemented},
 	{"decompile", Opt_NotImplemented}
@@ -117,6 +119,7 @@ int main(int argc, char** argv)
 		Com_Printf("Options: \n");
 		Com_Printf("   prtool -convert file.qc : Convert assets defined in control file.\n");
 		Com_Printf("   -pack filelist.txt : Build PAK archive, will automaticaly find and pack dependencies.\n");
+		Com_Printf("   -pk3 filelist.txt : Same as -pack but builds compressed PK3 archive.\n");
 		//Com_Printf("   -extract data.pak outdir : Extract PAK archive into directory.\n");
 		//Com_Printf("   -info file.ext : Print informations about BSP, PAK, MD3, TGA, MOD or ANM file.\n");
 		//Com_Printf("   -decompile file.ext : Convert MOD or ANM file back into SMD(s) and write QC control file.\n\n");
@@ -59,6 +59,12 @@ extern model_t* LoadModel(const char* modelname, const char* filename);
 #include "../../common/pragma_files.h"
 
 
+//
+// deflate.cpp
+//
+
+extern size_t Deflate(const byte* in, size_t inlen, std::vector<byte>& out);
+
 //
 // smd.cpp
 //